@@ -17,7 +17,6 @@
 
 #include <algorithm>
 #include <chrono>
-#include <queue>
 #include <map>
 #include <sstream>
 #include <iomanip>
@@ -384,12 +383,14 @@ bool Audit::configure(void) {
     auditfile.reconfigure(config);
 
     // iterate through the events map and update the sync and enabled flags
+    filter.reset();
     typedef std::map<uint32_t, EventDescriptor*>::iterator it_type;
     for(it_type iterator = events.begin(); iterator != events.end(); iterator++) {
         iterator->second->setSync(config.is_event_sync(iterator->first));
         if (config.is_event_disabled(iterator->first)) {
             iterator->second->setEnabled(false);
         }
+        filter.setEnabled(iterator->first, iterator->second->isEnabled());
     }
     // create event to say done reconfiguration
     if (is_enabled_before_reconfig || config.is_auditd_enabled()) {
@@ -434,6 +435,30 @@ bool Audit::configure(void) {
 }
 
 
+bool Audit::enqueue_event(Event* event) {
+    if (queued_events.fetch_add(1) >= max_audit_queue) {
+        --queued_events;
+        logger->log(EXTENSION_LOG_WARNING, NULL,
+                    "Audit: Dropping audit event %u: %s",
+                    event->id, event->payload.c_str());
+        dropped_events++;
+        delete event;
+        return false;
+    }
+
+    eventqueue.push(event);
+
+    // Pairs with the fence in wait_for_events so that either we see
+    // that the consumer is waiting, or the consumer sees the event
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumer_waiting.load()) {
+        cb_mutex_enter(&producer_consumer_lock);
+        cb_cond_broadcast(&events_arrived);
+        cb_mutex_exit(&producer_consumer_lock);
+    }
+    return true;
+}
+
 bool Audit::add_to_filleventqueue(const uint32_t event_id,
                                   const char *payload,
                                   const size_t length) {
@@ -442,44 +467,33 @@ bool Audit::add_to_filleventqueue(const uint32_t event_id,
     //       in the correct fields.. if not we should add an
     //       event to the audit trail saying it is one in an illegal
     //       format (or missing fields)
-    bool res;
-    Event* new_event = new Event(event_id, payload, length);
-    cb_mutex_enter(&producer_consumer_lock);
-    if (filleventqueue->size() < max_audit_queue) {
-        filleventqueue->push(new_event);
-        cb_cond_broadcast(&events_arrived);
-        res = true;
-    } else {
-        logger->log(EXTENSION_LOG_WARNING, NULL,
-                    "Audit: Dropping audit event %u: %s",
-                    new_event->id, new_event->payload.c_str());
-        dropped_events++;
-        delete new_event;
-        res = false;
-    }
-    cb_mutex_exit(&producer_consumer_lock);
-    return res;
+    return enqueue_event(new Event(event_id, payload, length));
 }
 
+bool Audit::add_to_filleventqueue(const uint32_t event_id,
+                                  AuditEventRecord record) {
+    return enqueue_event(new Event(event_id, std::move(record)));
+}
 
 bool Audit::add_reconfigure_event(const char* configfile, const void *cookie) {
-    bool res;
-    ConfigureEvent* new_event = new ConfigureEvent(configfile, cookie);
+    return enqueue_event(new ConfigureEvent(configfile, cookie));
+}
+
+bool Audit::wait_for_events(void) {
     cb_mutex_enter(&producer_consumer_lock);
-    if (filleventqueue->size() < max_audit_queue) {
-        filleventqueue->push(new_event);
-        cb_cond_broadcast(&events_arrived);
-        res = true;
-    } else {
-        Audit::logger->log(EXTENSION_LOG_WARNING, NULL,
-                           "Audit: Dropping configure event: %s",
-                           new_event->payload.c_str());
-        dropped_events++;
-        delete new_event;
-        res = false;
+    consumer_waiting.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (eventqueue.empty() && !terminate_audit_daemon) {
+        // Wake up in time for the next rotation (or the next sync of
+        // the data written to the file)
+        const uint32_t timeout = std::min(
+                auditfile.get_seconds_to_rotation() * 1000,
+                auditfile.get_milliseconds_to_sync());
+        cb_cond_timedwait(&events_arrived, &producer_consumer_lock, timeout);
     }
+    consumer_waiting.store(false);
     cb_mutex_exit(&producer_consumer_lock);
-    return res;
+    return !eventqueue.empty();
 }
 
 
@@ -493,14 +507,9 @@ void Audit::clear_events_map(void) {
 
 
 void Audit::clear_events_queues(void) {
-    while(!processeventqueue->empty()) {
-        Event *event = processeventqueue->front();
-        processeventqueue->pop();
-        delete event;
-    }
-    while(!filleventqueue->empty()) {
-        Event *event = filleventqueue->front();
-        filleventqueue->pop();
+    Event* event;
+    while ((event = eventqueue.pop()) != nullptr) {
+        --queued_events;
         delete event;
     }
 }
@@ -20,35 +20,43 @@
 #include <inttypes.h>
 #include <map>
 #include <memory>
-#include <queue>
 #include <atomic>
 
 #include <cJSON.h>
+#include <utilities/mpsc_queue.h>
 #include "memcached/audit_interface.h"
 #include "memcached/types.h"
 #include "auditconfig.h"
 #include "auditfile.h"
 #include "auditd.h"
+#include "event.h"
 #include "eventdescriptor.h"
-
-class Event;
+#include "eventfilter.h"
 
 class Audit {
 public:
     AuditConfig config;
     std::map<uint32_t,EventDescriptor*> events;
 
-    // We maintain two Event queues. At any one time one will be used to accept
-    // new events, and the other will be processed. The two queues are swapped
-    // periodically.
-    std::unique_ptr<std::queue<Event*>> processeventqueue;
-    std::unique_ptr<std::queue<Event*>> filleventqueue;
+    // The events disabled in the configuration (so that the threads
+    // generating the events may skip them without formatting them)
+    EventFilter filter;
+
+    // The events waiting to be processed by the consumer thread. The
+    // producers add events to the queue without locking, and only
+    // need the producer_consumer_lock to wake the consumer thread when
+    // it is waiting for events to arrive.
+    IntrusiveMpscQueue<Event> eventqueue;
+    std::atomic<size_t> queued_events;
+    std::atomic_bool consumer_waiting;
 
-    bool terminate_audit_daemon;
+    // The buffer used by the consumer thread to format the events
+    std::string write_buffer;
+
+    std::atomic_bool terminate_audit_daemon;
     std::string configfile;
     cb_thread_t consumer_tid;
     std::atomic_bool consumer_thread_running;
-    cb_cond_t processeventqueue_empty;
     cb_cond_t events_arrived;
     cb_mutex_t producer_consumer_lock;
     static EXTENSION_LOGGER_DESCRIPTOR *logger;
@@ -59,20 +67,18 @@ public:
     std::atomic<uint32_t> dropped_events;
 
     Audit()
-        : processeventqueue(new std::queue<Event*>()),
-          filleventqueue(new std::queue<Event*>()),
+        : queued_events(0),
+          consumer_waiting(false),
           terminate_audit_daemon(false),
           dropped_events(0),
           max_audit_queue(50000) {
         consumer_thread_running.store(false);
-        cb_cond_initialize(&processeventqueue_empty);
         cb_cond_initialize(&events_arrived);
         cb_mutex_initialize(&producer_consumer_lock);
     }
 
     ~Audit(void) {
         clean_up();
-        cb_cond_destroy(&processeventqueue_empty);
         cb_cond_destroy(&events_arrived);
         cb_mutex_destroy(&producer_consumer_lock);
     }
@@ -90,7 +96,19 @@ public:
                                      payload.length());
     }
 
+    bool add_to_filleventqueue(const uint32_t event_id,
+                               AuditEventRecord record);
+
     bool add_reconfigure_event(const char *configfile, const void *cookie);
+
+    /**
+     * Wait for events to arrive (called by the consumer thread once the
+     * queue is drained)
+     *
+     * @return true if events arrived, false if we timed out (or the
+     *         daemon is terminating)
+     */
+    bool wait_for_events(void);
     bool create_audit_event(uint32_t event_id, cJSON *payload);
     bool terminate_consumer_thread(void);
     void clear_events_map(void);
@@ -102,6 +120,14 @@ public:
     static std::string load_file(const char *file);
 
 private:
+    /**
+     * Add the event to the queue and wake the consumer thread if it is
+     * waiting for events. The event is deleted if the queue is full.
+     *
+     * @return true if the event was added to the queue
+     */
+    bool enqueue_event(Event* event);
+
     size_t max_audit_queue;
 };
 
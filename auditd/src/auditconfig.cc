@@ -84,6 +84,10 @@ AuditConfig::AuditConfig(const cJSON *json) : AuditConfig() {
     set_rotate_interval(getObject(json, "rotate_interval", cJSON_Number));
     set_auditd_enabled(getObject(json, "auditd_enabled", -1));
     set_buffered(cJSON_GetObjectItem(const_cast<cJSON*>(json), "buffered"));
+    set_fsync_interval(cJSON_GetObjectItem(const_cast<cJSON*>(json),
+                                           "fsync_interval"));
+    set_fsync_event_count(cJSON_GetObjectItem(const_cast<cJSON*>(json),
+                                              "fsync_event_count"));
     set_log_directory(getObject(json, "log_path", cJSON_String));
     set_descriptors_path(getObject(json, "descriptors_path", cJSON_String));
     set_sync(getObject(json, "sync", cJSON_Array));
@@ -95,6 +99,8 @@ AuditConfig::AuditConfig(const cJSON *json) : AuditConfig() {
     tags["rotate_interval"] = 1;
     tags["auditd_enabled"] = 1;
     tags["buffered"] = 1;
+    tags["fsync_interval"] = 1;
+    tags["fsync_event_count"] = 1;
     tags["log_path"] = 1;
     tags["descriptors_path"] = 1;
     tags["sync"] = 1;
@@ -159,6 +165,22 @@ bool AuditConfig::is_buffered(void) const {
     return buffered;
 }
 
+void AuditConfig::set_fsync_interval(uint32_t interval) {
+    fsync_interval = interval;
+}
+
+uint32_t AuditConfig::get_fsync_interval(void) const {
+    return fsync_interval;
+}
+
+void AuditConfig::set_fsync_event_count(uint32_t count) {
+    fsync_event_count = count;
+}
+
+uint32_t AuditConfig::get_fsync_event_count(void) const {
+    return fsync_event_count;
+}
+
 void AuditConfig::set_log_directory(const std::string &directory) {
     std::lock_guard<std::mutex> guard(log_path_mutex);
     /* Sanitize path */
@@ -251,6 +273,39 @@ void AuditConfig::set_buffered(cJSON *obj) {
     }
 }
 
+/**
+ * Get the value of an optional (non-negative) number
+ *
+ * @param obj the object to get the value from (may be nullptr)
+ * @param name the name of the tag (used in the error message)
+ * @param value where to store the value (untouched if obj is nullptr)
+ */
+static void getOptionalNumber(const cJSON* obj,
+                              const char* name,
+                              uint32_t& value) {
+    if (obj) {
+        if (obj->type != cJSON_Number || obj->valueint < 0) {
+            std::stringstream ss;
+            ss << "Incorrect value for \"" << name
+               << "\". Should be a non-negative number";
+            throw ss.str();
+        }
+        value = uint32_t(obj->valueint);
+    }
+}
+
+void AuditConfig::set_fsync_interval(cJSON *obj) {
+    uint32_t value = get_fsync_interval();
+    getOptionalNumber(obj, "fsync_interval", value);
+    set_fsync_interval(value);
+}
+
+void AuditConfig::set_fsync_event_count(cJSON *obj) {
+    uint32_t value = get_fsync_event_count();
+    getOptionalNumber(obj, "fsync_event_count", value);
+    set_fsync_event_count(value);
+}
+
 void AuditConfig::set_log_directory(cJSON *obj) {
     set_log_directory(obj->valuestring);
 }
@@ -295,6 +350,9 @@ unique_cJSON_ptr AuditConfig::to_json() const {
     cJSON_AddNumberToObject(root, "rotate_size", get_rotate_size());
     cJSON_AddNumberToObject(root, "rotate_interval", get_rotate_interval());
     cJSON_AddBoolToObject(root, "buffered", is_buffered());
+    cJSON_AddNumberToObject(root, "fsync_interval", get_fsync_interval());
+    cJSON_AddNumberToObject(root, "fsync_event_count",
+                            get_fsync_event_count());
     cJSON_AddStringToObject(root, "log_path", get_log_directory().c_str());
     cJSON_AddStringToObject(root, "descriptors_path", get_descriptors_path().c_str());
 
@@ -320,6 +378,8 @@ void AuditConfig::initialize_config(const cJSON* json) {
     rotate_interval = other.rotate_interval;
     rotate_size = other.rotate_size;
     buffered = other.buffered;
+    fsync_interval = other.fsync_interval;
+    fsync_event_count = other.fsync_event_count;
     {
         std::lock_guard<std::mutex> guard(log_path_mutex);
         log_path = other.log_path;
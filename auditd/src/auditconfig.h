@@ -35,6 +35,8 @@ public:
         rotate_interval(900),
         rotate_size(20 * 1024 * 1024),
         buffered(true),
+        fsync_interval(0),
+        fsync_event_count(0),
         min_file_rotation_time(900), // 15 minutes
         max_file_rotation_time(604800), // 1 week
         max_rotate_file_size(500 * 1024 * 1024)
@@ -65,6 +67,10 @@ public:
     uint32_t get_rotate_interval(void) const;
     void set_buffered(bool enable);
     bool is_buffered(void) const;
+    void set_fsync_interval(uint32_t interval);
+    uint32_t get_fsync_interval(void) const;
+    void set_fsync_event_count(uint32_t count);
+    uint32_t get_fsync_event_count(void) const;
     void set_log_directory(const std::string &directory);
     std::string get_log_directory(void) const;
     void set_descriptors_path(const std::string &directory);
@@ -105,6 +111,8 @@ protected:
     void set_rotate_interval(cJSON *obj);
     void set_auditd_enabled(cJSON *obj);
     void set_buffered(cJSON *obj);
+    void set_fsync_interval(cJSON *obj);
+    void set_fsync_event_count(cJSON *obj);
     void set_log_directory(cJSON *obj);
     void set_descriptors_path(cJSON *obj);
     void add_array(std::vector<uint32_t> &vec, cJSON *array, const char *name);
@@ -115,6 +123,10 @@ protected:
     Couchbase::RelaxedAtomic<uint32_t> rotate_interval;
     Couchbase::RelaxedAtomic<size_t> rotate_size;
     Couchbase::RelaxedAtomic<bool> buffered;
+    // The number of milliseconds between each fdatasync (0 = disabled)
+    Couchbase::RelaxedAtomic<uint32_t> fsync_interval;
+    // The number of events between each fdatasync (0 = disabled)
+    Couchbase::RelaxedAtomic<uint32_t> fsync_event_count;
 
     mutable std::mutex log_path_mutex;
     std::string log_path;
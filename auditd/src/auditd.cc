@@ -24,6 +24,7 @@
 #include <memcached/isotime.h>
 #include <platform/strerror.h>
 #include <sstream>
+#include <thread>
 
 #include "audit.h"
 #include "auditd.h"
@@ -43,36 +44,34 @@ static void consume_events(void* arg) {
     }
     Audit& audit = *reinterpret_cast<Audit*>(arg);
 
-    cb_mutex_enter(&audit.producer_consumer_lock);
-    while (!audit.terminate_audit_daemon) {
-        if (audit.filleventqueue->empty()) {
-            cb_cond_timedwait(&audit.events_arrived,
-                              &audit.producer_consumer_lock,
-                              audit.auditfile.get_seconds_to_rotation() * 1000);
-            if (audit.filleventqueue->empty()) {
-                // We timed out, so just rotate the files
-                audit.auditfile.maybe_rotate_files();
-            }
-        }
-        /* now have producer_consumer lock!
-         * event(s) have arrived or shutdown requested
-         */
-        swap(audit.processeventqueue, audit.filleventqueue);
-        cb_mutex_exit(&audit.producer_consumer_lock);
-        // Now outside of the producer_consumer_lock
-
-        while (!audit.processeventqueue->empty()) {
-            Event* event = audit.processeventqueue->front();
+    while (true) {
+        Event* event = audit.eventqueue.pop();
+        if (event != nullptr) {
+            --audit.queued_events;
             if (!event->process(audit)) {
                 audit.dropped_events++;
             }
-            audit.processeventqueue->pop();
             delete event;
+            continue;
+        }
+
+        if (!audit.eventqueue.empty()) {
+            // A producer is in the middle of adding an event
+            std::this_thread::yield();
+            continue;
         }
+
+        // The queue is drained
         audit.auditfile.flush();
-        cb_mutex_enter(&audit.producer_consumer_lock);
+        if (audit.terminate_audit_daemon) {
+            break;
+        }
+
+        if (!audit.wait_for_events()) {
+            // We timed out, so just rotate the files
+            audit.auditfile.maybe_rotate_files();
+        }
     }
-    cb_mutex_exit(&audit.producer_consumer_lock);
 
     // close the auditfile
     audit.auditfile.close();
@@ -166,7 +165,8 @@ AUDIT_ERROR_CODE put_audit_event(Audit* handle,
     if (handle == nullptr) {
         throw std::invalid_argument("put_audit_event: handle can't be nullptr");
     }
-    if (handle->config.is_auditd_enabled()) {
+    if (handle->config.is_auditd_enabled() &&
+        handle->filter.isEnabled(audit_eventid)) {
         if (!handle->add_to_filleventqueue(audit_eventid,
                                            (const char*)payload,
                                            length)) {
@@ -176,6 +176,33 @@ AUDIT_ERROR_CODE put_audit_event(Audit* handle,
     return AUDIT_SUCCESS;
 }
 
+MEMCACHED_PUBLIC_API
+AUDIT_ERROR_CODE put_audit_event_record(Audit* handle,
+                                        uint32_t audit_eventid,
+                                        AuditEventRecord record) {
+    if (handle == nullptr) {
+        throw std::invalid_argument(
+            "put_audit_event_record: handle can't be nullptr");
+    }
+    if (handle->config.is_auditd_enabled() &&
+        handle->filter.isEnabled(audit_eventid)) {
+        if (!handle->add_to_filleventqueue(audit_eventid, std::move(record))) {
+            return AUDIT_FAILED;
+        }
+    }
+    return AUDIT_SUCCESS;
+}
+
+MEMCACHED_PUBLIC_API
+bool is_audit_event_enabled(Audit* handle, uint32_t audit_eventid) {
+    if (handle == nullptr) {
+        throw std::invalid_argument(
+            "is_audit_event_enabled: handle can't be nullptr");
+    }
+    return handle->config.is_auditd_enabled() &&
+           handle->filter.isEnabled(audit_eventid);
+}
+
 MEMCACHED_PUBLIC_API
 AUDIT_ERROR_CODE put_json_audit_event(Audit* handle,
                                       uint32_t id,
@@ -20,6 +20,14 @@
 #include <cJSON.h>
 #include <sys/stat.h>
 #include <cstring>
+#include <climits>
+#include <fcntl.h>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 #include <platform/dirutils.h>
 #include <memcached/isotime.h>
 #include <JSON_checker.h>
@@ -31,24 +39,9 @@
 #ifdef UNITTEST_AUDITFILE
 #define log_error(a,b)
 #define my_hostname "testing"
-
-static std::string load_file(const char *file) {
-    std::ifstream myfile(file, std::ios::in | std::ios::binary);
-    if (myfile.is_open()) {
-        std::string str((std::istreambuf_iterator<char>(myfile)),
-                        std::istreambuf_iterator<char>());
-        myfile.close();
-        return str;
-    } else {
-        std::string str;
-        return str;
-    }
-}
-
 #else
 #define log_error(a,b) Audit::log_error(a,b)
 #define my_hostname Audit::hostname
-#define load_file(a) Audit::load_file(a)
 #endif
 
 bool AuditFile::file_exists(const std::string& name) {
@@ -91,27 +84,45 @@ time_t AuditFile::auditd_time() {
 }
 
 bool AuditFile::open(void) {
-    cb_assert(file == NULL);
+    cb_assert(file == -1);
     cb_assert(open_time == 0);
 
     std::stringstream ss;
     ss << log_directory << DIRECTORY_SEPARATOR_CHARACTER << "audit.log";
     open_file_name = ss.str();
-    file = fopen(open_file_name.c_str(), "wb");
-    if (file == NULL) {
+#ifdef WIN32
+    file = _open(open_file_name.c_str(),
+                 _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                 _S_IREAD | _S_IWRITE);
+#else
+    file = ::open(open_file_name.c_str(),
+                  O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+#endif
+    if (file == -1) {
         log_error(AuditErrorCode::FILE_OPEN_ERROR, open_file_name.c_str());
         return false;
     }
     current_size = 0;
     open_time = auditd_time();
+    unsynced_events = 0;
+    sync_requested = false;
+    last_sync = std::chrono::steady_clock::now();
     return true;
 }
 
 
 void AuditFile::close_and_rotate_log(void) {
-    cb_assert(file != NULL);
-    fclose(file);
-    file = NULL;
+    cb_assert(file != -1);
+    // Make sure that everything is on disk before we archive the file
+    if (!write_blocks() || (unsynced_events != 0 && !sync())) {
+        log_error(AuditErrorCode::WRITING_TO_DISK_ERROR, strerror(errno));
+    }
+#ifdef WIN32
+    _close(file);
+#else
+    ::close(file);
+#endif
+    file = -1;
     if (current_size == 0) {
         remove(open_file_name.c_str());
         return;
@@ -154,16 +165,8 @@ void AuditFile::cleanup_old_logfile(const std::string& log_path) {
     std::string filename = file.str();
 
     if (file_exists(filename)) {
-        // open the audit.log that needs archiving
-        std::string str;
-        try {
-            str = load_file(filename.c_str());
-        } catch (...) {
-            std::stringstream ss;
-            ss << "Audit: Failed to read \"" << filename << "\"";
-            throw ss.str();
-        }
-        if (str.empty()) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) == 0 && st.st_size == 0) {
             // empty file, just remove it.
             if (remove(filename.c_str()) != 0) {
                 std::stringstream ss;
@@ -174,11 +177,17 @@ void AuditFile::cleanup_old_logfile(const std::string& log_path) {
             return;
         }
 
-        // extract the first event
-        std::size_t found = str.find_first_of("\n");
-        if (found != std::string::npos) {
-            str.erase(found+1, std::string::npos);
+        // We only need the first event (for the timestamp), so don't
+        // read the entire file (it may be large)
+        std::string str;
+        std::ifstream myfile(filename.c_str(),
+                             std::ios::in | std::ios::binary);
+        if (!myfile.is_open() || !std::getline(myfile, str)) {
+            std::stringstream ss;
+            ss << "Audit: Failed to read \"" << filename << "\"";
+            throw ss.str();
         }
+        myfile.close();
 
         // check that it is valid json (cJSON doesn't validate
         // and may run outside the buffers...)
@@ -249,25 +258,153 @@ void AuditFile::cleanup_old_logfile(const std::string& log_path) {
 
 bool AuditFile::write_event_to_disk(cJSON *output) {
     char *content = cJSON_PrintUnformatted(output);
+    if (content == nullptr) {
+        log_error(AuditErrorCode::MEMORY_ALLOCATION_ERROR,
+                  "failed to convert audit event");
+        return true;
+    }
+
+    std::string event(content);
+    cJSON_Free(content);
+    event.push_back('\n');
+    return write_event_to_disk(event, false);
+}
+
+bool AuditFile::write_event_to_disk(const std::string& event, bool sync) {
+    size_t offset = 0;
+    while (offset < event.size()) {
+        if (blocks.empty() || blocks.back().used == BlockSize) {
+            if (blocks.size() == MaxBlocks && !flush()) {
+                return false;
+            }
+            Block block;
+            if (spare_blocks.empty()) {
+                block.data.reset(new char[BlockSize]);
+            } else {
+                block.data = std::move(spare_blocks.back());
+                spare_blocks.pop_back();
+            }
+            block.used = 0;
+            blocks.push_back(std::move(block));
+        }
+
+        auto& block = blocks.back();
+        const size_t chunk = std::min(event.size() - offset,
+                                      BlockSize - block.used);
+        memcpy(block.data.get() + block.used, event.data() + offset, chunk);
+        block.used += chunk;
+        offset += chunk;
+    }
+
+    current_size += event.size();
+    ++unsynced_events;
+    if (sync) {
+        sync_requested = true;
+    }
+
+    if (!buffered ||
+        (fsync_event_count != 0 && unsynced_events >= fsync_event_count)) {
+        return flush();
+    }
+    return true;
+}
+
+bool AuditFile::write_blocks(void) {
     bool ret = true;
-    if (content) {
-        current_size += fprintf(file, "%s\n", content);
-        if (ferror(file)) {
-            log_error(AuditErrorCode::WRITING_TO_DISK_ERROR, strerror(errno));
+#ifdef WIN32
+    for (const auto& block : blocks) {
+        size_t offset = 0;
+        while (ret && offset < block.used) {
+            const int nw = _write(file, block.data.get() + offset,
+                                  unsigned(block.used - offset));
+            if (nw == -1) {
+                ret = false;
+            } else {
+                offset += size_t(nw);
+            }
+        }
+    }
+#else
+    std::vector<iovec> iov(blocks.size());
+    for (size_t ii = 0; ii < blocks.size(); ++ii) {
+        iov[ii].iov_base = blocks[ii].data.get();
+        iov[ii].iov_len = blocks[ii].used;
+    }
+
+    size_t idx = 0;
+    while (idx < iov.size()) {
+        const int count = int(std::min(iov.size() - idx, size_t(IOV_MAX)));
+        ssize_t nw = writev(file, iov.data() + idx, count);
+        if (nw == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
             ret = false;
-            close_and_rotate_log();
-        } else if (!buffered) {
-            ret = flush();
+            break;
+        }
+
+        // Skip past the data written (we may get a partial write)
+        while (nw > 0) {
+            if (size_t(nw) >= iov[idx].iov_len) {
+                nw -= ssize_t(iov[idx].iov_len);
+                ++idx;
+            } else {
+                iov[idx].iov_base = static_cast<char*>(iov[idx].iov_base) + nw;
+                iov[idx].iov_len -= size_t(nw);
+                nw = 0;
+            }
         }
-        cJSON_Free(content);
-    } else {
-        log_error(AuditErrorCode::MEMORY_ALLOCATION_ERROR,
-                  "failed to convert audit event");
     }
+#endif
 
+    for (auto& block : blocks) {
+        spare_blocks.push_back(std::move(block.data));
+    }
+    blocks.clear();
     return ret;
 }
 
+bool AuditFile::sync(void) {
+#ifdef WIN32
+    const int ret = _commit(file);
+#elif defined(__APPLE__)
+    const int ret = fsync(file);
+#else
+    const int ret = fdatasync(file);
+#endif
+    if (ret != 0) {
+        return false;
+    }
+    unsynced_events = 0;
+    sync_requested = false;
+    last_sync = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool AuditFile::is_sync_due(void) const {
+    return get_milliseconds_to_sync() == 0;
+}
+
+uint32_t AuditFile::get_milliseconds_to_sync(void) const {
+    if (!is_open() || unsynced_events == 0) {
+        return UINT32_MAX;
+    }
+    if (sync_requested ||
+        (fsync_event_count != 0 && unsynced_events >= fsync_event_count)) {
+        return 0;
+    }
+    if (fsync_interval == 0) {
+        return UINT32_MAX;
+    }
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - last_sync).count();
+    if (elapsed >= fsync_interval) {
+        return 0;
+    }
+    return fsync_interval - uint32_t(elapsed);
+}
+
 
 void AuditFile::set_log_directory(const std::string &new_directory) {
     if (log_directory == new_directory) {
@@ -275,7 +412,7 @@ void AuditFile::set_log_directory(const std::string &new_directory) {
         return;
     }
 
-    if (file != NULL) {
+    if (is_open()) {
         close_and_rotate_log();
     }
 
@@ -296,11 +433,13 @@ void AuditFile::reconfigure(const AuditConfig &config) {
     set_log_directory(config.get_log_directory());
     max_log_size = config.get_rotate_size();
     buffered = config.is_buffered();
+    fsync_interval = config.get_fsync_interval();
+    fsync_event_count = config.get_fsync_event_count();
 }
 
 bool AuditFile::flush(void) {
     if (is_open()) {
-        if (fflush(file) != 0) {
+        if (!write_blocks() || (is_sync_due() && !sync())) {
             log_error(AuditErrorCode::WRITING_TO_DISK_ERROR,
                       strerror(errno));
             close_and_rotate_log();
@@ -17,24 +17,44 @@
 #ifndef AUDITFILE_H
 #define AUDITFILE_H
 
+#include <chrono>
 #include <cstdio>
 #include <inttypes.h>
+#include <memory>
 #include <string>
+#include <vector>
 #include <cJSON.h>
 #include <time.h>
 #include "auditconfig.h"
 #include "auditd.h"
 
+/**
+ * The AuditFile writes the audit trail to disk. The events are collected
+ * in a write-behind buffer (a list of large blocks) which is written with
+ * a single writev call when the audit thread runs out of events to
+ * process (or the buffer is full). The data is synced to disk (group
+ * commit) after writing a batch containing a sync event, and at the
+ * configured interval or number of events.
+ */
 class AuditFile {
 public:
+    /// The size of each of the blocks in the write-behind buffer
+    static const size_t BlockSize = 64 * 1024;
+
+    /// The number of blocks we may fill before we have to write them
+    static const size_t MaxBlocks = 16;
 
     AuditFile(void) :
-        file(NULL),
+        file(-1),
         open_time(0),
         current_size(0),
         max_log_size(20 * 1024 * 1024),
         rotate_interval(900),
-        buffered(true)
+        buffered(true),
+        fsync_interval(0),
+        fsync_event_count(0),
+        unsynced_events(0),
+        sync_requested(false)
     {
     }
 
@@ -97,6 +117,17 @@ public:
      */
     bool write_event_to_disk(cJSON *output);
 
+    /**
+     * Write a formatted event to the disk. The event is added to the
+     * write-behind buffer, and is written to the file the next time the
+     * buffer is flushed.
+     *
+     * @param event the JSON formatted event (including the newline)
+     * @param sync should the event be synced to disk when it is written
+     * @return true if success, false otherwise
+     */
+    bool write_event_to_disk(const std::string& event, bool sync = false);
+
     /**
      * Check for a file existence
      *
@@ -109,7 +140,7 @@ public:
      * Is the audit file open already?
      */
     bool is_open(void) const {
-        return file != NULL;
+        return file != -1;
     }
 
     /**
@@ -119,10 +150,18 @@ public:
     void reconfigure(const AuditConfig &config);
 
     /**
-     * Flush the buffers to the disk
+     * Write the buffered events to the file, and sync the file if a sync
+     * event was written or it is time for the periodic sync
      */
     bool flush(void);
 
+    /**
+     * Get the number of milliseconds until the periodic sync of the
+     * data written to the file is due (or UINT32_MAX if there isn't
+     * any data to sync)
+     */
+    uint32_t get_milliseconds_to_sync(void) const;
+
     /**
      * get the number of seconds for the next log rotation
      */
@@ -136,15 +175,23 @@ public:
     }
 
 private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t used;
+    };
+
     bool open(void);
     bool time_to_rotate_log(void) const;
     void close_and_rotate_log(void);
+    bool write_blocks(void);
+    bool sync(void);
+    bool is_sync_due(void) const;
     void set_log_directory(const std::string &new_directory);
     bool is_timestamp_format_correct(std::string& str);
 
     static time_t auditd_time();
 
-    FILE *file;
+    int file;
     std::string open_file_name;
     std::string log_directory;
     time_t open_time;
@@ -152,6 +199,19 @@ private:
     size_t max_log_size;
     uint32_t rotate_interval;
     bool buffered;
+    uint32_t fsync_interval;
+    uint32_t fsync_event_count;
+
+    /// The blocks waiting to be written to the file
+    std::vector<Block> blocks;
+    /// Blocks which have been written and may be reused
+    std::vector<std::unique_ptr<char[]>> spare_blocks;
+    /// The number of events written since the last sync
+    uint32_t unsynced_events;
+    /// Set when a sync event is written
+    bool sync_requested;
+    /// The time of the last sync
+    std::chrono::steady_clock::time_point last_sync;
 };
 
 #endif
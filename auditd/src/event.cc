@@ -18,9 +18,42 @@
 #include <sstream>
 #include <string>
 #include <cJSON.h>
+#include <cJSON_utils.h>
 #include <memcached/isotime.h>
 #include "event.h"
 #include "audit.h"
+#include "eventdescriptor.h"
+#include "eventrecord.h"
+
+bool Event::format(const EventDescriptor& descriptor, std::string& out) const {
+    if (is_record) {
+        format_audit_event_record(record, out);
+        out.pop_back();
+    } else {
+        // The payload comes from an external component, so we need to
+        // validate it (and add the timestamp if it is missing)
+        unique_cJSON_ptr json(cJSON_Parse(payload.c_str()));
+        if (!json || json->type != cJSON_Object) {
+            Audit::log_error(AuditErrorCode::JSON_PARSING_ERROR,
+                             payload.c_str());
+            return false;
+        }
+        if (cJSON_GetObjectItem(json.get(), "timestamp") == nullptr) {
+            std::string timestamp = ISOTime::generatetimestamp();
+            cJSON_AddStringToObject(json.get(), "timestamp",
+                                    timestamp.c_str());
+        }
+        out = to_string(json, false);
+        out.pop_back();
+    }
+
+    if (out.size() > 1) {
+        out.push_back(',');
+    }
+    out.append(descriptor.getFields());
+    out.append("}\n");
+    return true;
+}
 
 bool Event::process(Audit& audit) {
     // Audit is disabled
@@ -28,47 +61,34 @@ bool Event::process(Audit& audit) {
         return true;
     }
 
-    // convert the event.payload into JSON
-    cJSON *json_payload = cJSON_Parse(payload.c_str());
-    if (json_payload == NULL) {
-        Audit::log_error(AuditErrorCode::JSON_PARSING_ERROR, payload.c_str());
-        return false;
-    }
-    cJSON *timestamp_ptr = cJSON_GetObjectItem(json_payload, "timestamp");
-    if (timestamp_ptr == NULL) {
-        std::string timestamp;
-        timestamp = ISOTime::generatetimestamp();
-        cJSON_AddStringToObject(json_payload, "timestamp", timestamp.c_str());
-    }
     auto evt = audit.events.find(id);
     if (evt == audit.events.end()) {
         // it is an unknown event
         std::ostringstream convert;
         convert << id;
         Audit::log_error(AuditErrorCode::UNKNOWN_EVENT_ERROR, convert.str().c_str());
-        cJSON_Delete(json_payload);
         return false;
     }
     if (!evt->second->isEnabled()) {
         // the event is not enabled so ignore event
-        cJSON_Delete(json_payload);
         return true;
     }
+
+    // Format the event directly into the write buffer (which is reused
+    // for all of the events)
+    if (!format(*evt->second, audit.write_buffer)) {
+        return false;
+    }
+
     if (!audit.auditfile.ensure_open()) {
         Audit::log_error(AuditErrorCode::OPEN_AUDITFILE_ERROR, NULL);
-        cJSON_Delete(json_payload);
         return false;
     }
-    cJSON_AddNumberToObject(json_payload, "id", id);
-    cJSON_AddStringToObject(json_payload, "name", evt->second->getName().c_str());
-    cJSON_AddStringToObject(json_payload, "description", evt->second->getDescription().c_str());
-
-    bool success = audit.auditfile.write_event_to_disk(json_payload);
-
-    // Release allocated resources
-    cJSON_Delete(json_payload);
 
-    if (success) {
+    // Sync events are synced to disk together with the rest of the
+    // events in the batch
+    if (audit.auditfile.write_event_to_disk(audit.write_buffer,
+                                            evt->second->isSync())) {
         return true;
     } else {
         Audit::log_error(AuditErrorCode::WRITE_EVENT_TO_DISK_ERROR, NULL);
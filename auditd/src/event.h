@@ -17,29 +17,56 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include <memcached/audit_interface.h>
+#include <utilities/mpsc_queue.h>
 #include <inttypes.h>
 #include <string>
 
 class Audit;
+class EventDescriptor;
 
-class Event {
+class Event : public MpscQueueHook<Event> {
 public:
     const uint32_t id;
     const std::string payload;
 
+    /**
+     * The event generated by the memcached core (only used if is_record
+     * is set, in which case the payload is empty)
+     */
+    const AuditEventRecord record;
+    const bool is_record;
+
     // Constructor required for ConfigureEvent
     Event()
-        : id(0) {}
+        : id(0),
+          is_record(false) {}
 
     Event(const uint32_t event_id, const char* p,
           size_t length)
         : id(event_id),
-          payload(p,length) {}
+          payload(p,length),
+          is_record(false) {}
+
+    Event(const uint32_t event_id, AuditEventRecord r)
+        : id(event_id),
+          record(std::move(r)),
+          is_record(true) {}
 
     virtual bool process(Audit& audit);
 
     virtual ~Event() {}
 
+protected:
+    /**
+     * Format the event as it should be written to the audit trail
+     * (including the newline)
+     *
+     * @param descriptor the descriptor for the event
+     * @param out where to store the formatted event
+     * @return true if success, false if the payload isn't valid
+     */
+    bool format(const EventDescriptor& descriptor, std::string& out) const;
 };
 
 #endif
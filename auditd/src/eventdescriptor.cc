@@ -47,6 +47,14 @@ EventDescriptor::EventDescriptor(const cJSON* root)
             "EventDescriptor::EventDescriptor: Unknown elements specified");
 
     }
+
+    unique_cJSON_ptr json(cJSON_CreateObject());
+    cJSON_AddNumberToObject(json.get(), "id", id);
+    cJSON_AddStringToObject(json.get(), "name", name.c_str());
+    cJSON_AddStringToObject(json.get(), "description", description.c_str());
+    fields = to_string(json, false);
+    // Strip off the braces
+    fields = fields.substr(1, fields.size() - 2);
 }
 
 const cJSON* EventDescriptor::locate(const cJSON* root,
@@ -49,6 +49,16 @@ public:
         return description;
     }
 
+    /**
+     * Get the fields added to each event written to the audit trail
+     * (id, name and description) formatted as JSON members without the
+     * surrounding braces, so that they may be appended to the payload
+     * without building a JSON tree for each event.
+     */
+    const std::string& getFields() const {
+        return fields;
+    }
+
     const bool isSync() const {
         return sync;
     }
@@ -84,6 +94,7 @@ protected:
     const uint32_t id;
     const std::string name;
     const std::string description;
+    std::string fields;
     bool sync;
     bool enabled;
 };
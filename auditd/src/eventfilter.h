@@ -0,0 +1,75 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * The EventFilter keeps track of the events which are disabled so that
+ * the threads generating audit events may check if an event is enabled
+ * before they spend any time creating the payload. The filter is updated
+ * by the audit thread when it is (re)configured, and read without any
+ * locking.
+ *
+ * Events with an id above MaxEventId can't be filtered and are always
+ * reported as enabled (the audit thread drops them later on if they're
+ * disabled).
+ */
+class EventFilter {
+public:
+    static const uint32_t MaxEventId = 0xffff;
+
+    EventFilter() {
+        reset();
+    }
+
+    EventFilter(const EventFilter&) = delete;
+
+    /**
+     * Mark all events as enabled
+     */
+    void reset() {
+        for (auto& word : disabled) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void setEnabled(uint32_t id, bool enabled) {
+        if (id > MaxEventId) {
+            return;
+        }
+        const uint64_t mask = uint64_t(1) << (id % 64);
+        if (enabled) {
+            disabled[id / 64].fetch_and(~mask, std::memory_order_relaxed);
+        } else {
+            disabled[id / 64].fetch_or(mask, std::memory_order_relaxed);
+        }
+    }
+
+    bool isEnabled(uint32_t id) const {
+        if (id > MaxEventId) {
+            return true;
+        }
+        const uint64_t mask = uint64_t(1) << (id % 64);
+        return (disabled[id / 64].load(std::memory_order_relaxed) & mask) == 0;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, (MaxEventId + 1) / 64> disabled;
+};
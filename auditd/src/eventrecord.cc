@@ -0,0 +1,98 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "eventrecord.h"
+
+#include <memcached/isotime.h>
+#include <cstdio>
+
+/**
+ * Append the value as a JSON string (with the same escaping as cJSON)
+ */
+static void add_string(std::string& out, const char* value) {
+    out.push_back('"');
+    for (const char* ptr = value; *ptr != '\0'; ++ptr) {
+        const unsigned char ch = static_cast<unsigned char>(*ptr);
+        switch (ch) {
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\b':
+            out.append("\\b");
+            break;
+        case '\f':
+            out.append("\\f");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        case '\r':
+            out.append("\\r");
+            break;
+        case '\t':
+            out.append("\\t");
+            break;
+        default:
+            if (ch < 32) {
+                char buffer[8];
+                snprintf(buffer, sizeof(buffer), "\\u%04x", ch);
+                out.append(buffer);
+            } else {
+                out.push_back(char(ch));
+            }
+        }
+    }
+    out.push_back('"');
+}
+
+static void add_key(std::string& out, const char* key) {
+    if (out.size() > 1) {
+        out.push_back(',');
+    }
+    add_string(out, key);
+    out.push_back(':');
+}
+
+static void add(std::string& out, const char* key, const std::string& value) {
+    add_key(out, key);
+    add_string(out, value.c_str());
+}
+
+void format_audit_event_record(const AuditEventRecord& record,
+                               std::string& out) {
+    ISOTime::ISO8601String timestamp;
+    ISOTime::generatetimestamp(timestamp, record.time, record.usec);
+
+    out.assign("{");
+    add(out, "timestamp", timestamp.data());
+    add(out, "peername", record.peername);
+    add(out, "sockname", record.sockname);
+    if (!record.peer_credentials.empty()) {
+        add_key(out, "peer_credentials");
+        out.append(record.peer_credentials);
+    }
+    add_key(out, "real_userid");
+    out.append("{\"source\":\"memcached\",\"user\":");
+    add_string(out, record.user.c_str());
+    out.push_back('}');
+    for (const auto& field : record.fields) {
+        add(out, field.first, field.second);
+    }
+    out.push_back('}');
+}
@@ -0,0 +1,34 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/audit_interface.h>
+#include <string>
+
+/**
+ * Format an audit event record generated by the memcached core as a JSON
+ * object. The members are added in the same order (and escaped the same
+ * way) as when memcached built the event with cJSON: timestamp, peername,
+ * sockname, peer_credentials, real_userid and then the event specific
+ * members.
+ *
+ * @param record the event to format
+ * @param out where to store the formatted object (the current content
+ *            is replaced)
+ */
+void format_audit_event_record(const AuditEventRecord& record,
+                               std::string& out);
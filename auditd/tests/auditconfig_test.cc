@@ -256,6 +256,31 @@ TEST_F(AuditConfigTest, TestLegalBuffered) {
     EXPECT_NO_THROW(config.initialize_config(json));
 }
 
+// fsync_interval and fsync_event_count
+
+TEST_F(AuditConfigTest, TestNoFsync) {
+    // fsync is optional, and disabled unless explicitly specified
+    EXPECT_NO_THROW(config.initialize_config(json));
+    EXPECT_EQ(0u, config.get_fsync_interval());
+    EXPECT_EQ(0u, config.get_fsync_event_count());
+}
+
+TEST_F(AuditConfigTest, TestLegalFsync) {
+    cJSON_AddNumberToObject(json, "fsync_interval", 100);
+    cJSON_AddNumberToObject(json, "fsync_event_count", 1000);
+    EXPECT_NO_THROW(config.initialize_config(json));
+    EXPECT_EQ(100u, config.get_fsync_interval());
+    EXPECT_EQ(1000u, config.get_fsync_event_count());
+}
+
+TEST_F(AuditConfigTest, TestIllegalFsync) {
+    cJSON_AddStringToObject(json, "fsync_interval", "foobar");
+    EXPECT_THROW(config.initialize_config(json), std::string);
+    cJSON_DeleteItemFromObject(json, "fsync_interval");
+    cJSON_AddNumberToObject(json, "fsync_event_count", -1);
+    EXPECT_THROW(config.initialize_config(json), std::string);
+}
+
 // log_path
 TEST_F(AuditConfigTest, TestNoLogPath) {
     cJSON *obj = cJSON_DetachItemFromObject(json, "log_path");
@@ -21,6 +21,7 @@
 #include <map>
 #include <atomic>
 #include <cstring>
+#include <sys/stat.h>
 #include <time.h>
 #include <gtest/gtest.h>
 #include <platform/platform.h>
@@ -252,3 +253,105 @@ TEST_F(AuditFileTest, TestCrashRecoveryGarbeledDate) {
         EXPECT_EQ(1, files.size());
     }
 }
+
+/**
+ * Test that the events are kept in the write-behind buffer until the
+ * file is flushed (and that events larger than a block are written
+ * correctly)
+ */
+TEST_F(AuditFileTest, TestWriteBehind) {
+    config.set_rotate_interval(3600);
+    config.set_rotate_size(10 * 1024 * 1024);
+
+    AuditFile auditfile;
+    auditfile.reconfigure(config);
+    auditfile.ensure_open();
+
+    const std::string small = "{\"foo\":\"bar\"}\n";
+    const std::string large = "{\"foo\":\"" +
+                              std::string(AuditFile::BlockSize * 2, 'x') +
+                              "\"}\n";
+    EXPECT_TRUE(auditfile.write_event_to_disk(small));
+    EXPECT_TRUE(auditfile.write_event_to_disk(large));
+    EXPECT_TRUE(auditfile.write_event_to_disk(small));
+
+    const std::string filename = testdir + "/audit.log";
+    struct stat st;
+    ASSERT_EQ(0, stat(filename.c_str(), &st));
+    EXPECT_EQ(0, st.st_size);
+
+    EXPECT_TRUE(auditfile.flush());
+    ASSERT_EQ(0, stat(filename.c_str(), &st));
+    EXPECT_EQ(small.size() * 2 + large.size(), size_t(st.st_size));
+}
+
+/**
+ * Test that a sync event or the configured interval makes the data due
+ * for being synced to disk
+ */
+TEST_F(AuditFileTest, TestSync) {
+    config.set_rotate_interval(3600);
+    config.set_fsync_interval(1000);
+
+    AuditFile auditfile;
+    auditfile.reconfigure(config);
+    auditfile.ensure_open();
+    EXPECT_EQ(UINT32_MAX, auditfile.get_milliseconds_to_sync());
+
+    EXPECT_TRUE(auditfile.write_event_to_disk(event));
+    auto ms = auditfile.get_milliseconds_to_sync();
+    EXPECT_LT(0u, ms);
+    EXPECT_GE(1000u, ms);
+
+    EXPECT_TRUE(auditfile.write_event_to_disk("{}\n", true));
+    EXPECT_EQ(0u, auditfile.get_milliseconds_to_sync());
+
+    EXPECT_TRUE(auditfile.flush());
+    EXPECT_EQ(UINT32_MAX, auditfile.get_milliseconds_to_sync());
+}
+
+/**
+ * Test that the data is synced once we've written the configured
+ * number of events
+ */
+TEST_F(AuditFileTest, TestSyncEventCount) {
+    config.set_rotate_interval(3600);
+    config.set_fsync_event_count(3);
+
+    AuditFile auditfile;
+    auditfile.reconfigure(config);
+    auditfile.ensure_open();
+
+    EXPECT_TRUE(auditfile.write_event_to_disk(event));
+    EXPECT_TRUE(auditfile.write_event_to_disk(event));
+    EXPECT_EQ(UINT32_MAX, auditfile.get_milliseconds_to_sync());
+    EXPECT_TRUE(auditfile.write_event_to_disk(event));
+    EXPECT_EQ(UINT32_MAX, auditfile.get_milliseconds_to_sync())
+        << "The events should have been written and synced";
+}
+
+/**
+ * Test that the log directory may be changed (and set initially) while
+ * no file is open, and that an open file is rotated into the old
+ * directory before we start logging to the new one.
+ */
+TEST_F(AuditFileTest, TestReconfigureLogDirectory) {
+    AuditFile auditfile;
+    auditfile.reconfigure(config);
+    EXPECT_FALSE(auditfile.is_open());
+
+    const std::string newdir = testdir + "/new";
+    config.set_log_directory(newdir);
+    auditfile.reconfigure(config);
+    EXPECT_FALSE(auditfile.is_open());
+
+    auditfile.ensure_open();
+    EXPECT_TRUE(auditfile.write_event_to_disk(event));
+
+    config.set_log_directory(testdir);
+    auditfile.reconfigure(config);
+    EXPECT_FALSE(auditfile.is_open());
+
+    auto files = findFilesWithPrefix(newdir + "/testing");
+    EXPECT_EQ(1u, files.size());
+}
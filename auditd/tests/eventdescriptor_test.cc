@@ -49,6 +49,12 @@ TEST_F(EventDescriptorTest, VerifyGetters) {
     EXPECT_TRUE(ptr.isEnabled());
 }
 
+TEST_F(EventDescriptorTest, Fields) {
+    EventDescriptor ptr(json.get());
+    EXPECT_EQ("\"id\":1,\"name\":\"name\",\"description\":\"description\"",
+              ptr.getFields());
+}
+
 TEST_F(EventDescriptorTest, UnknownTag) {
     cJSON_AddStringToObject(json.get(), "foo", "foo");
     EXPECT_THROW(EventDescriptor ptr(json.get()),
@@ -0,0 +1,53 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <gtest/gtest.h>
+#include "eventfilter.h"
+
+TEST(EventFilterTest, EnabledByDefault) {
+    EventFilter filter;
+    EXPECT_TRUE(filter.isEnabled(0));
+    EXPECT_TRUE(filter.isEnabled(20480));
+    EXPECT_TRUE(filter.isEnabled(EventFilter::MaxEventId));
+}
+
+TEST(EventFilterTest, Disable) {
+    EventFilter filter;
+    filter.setEnabled(20480, false);
+    EXPECT_FALSE(filter.isEnabled(20480));
+    EXPECT_TRUE(filter.isEnabled(20481));
+    EXPECT_TRUE(filter.isEnabled(20479));
+
+    filter.setEnabled(20480, true);
+    EXPECT_TRUE(filter.isEnabled(20480));
+}
+
+TEST(EventFilterTest, Reset) {
+    EventFilter filter;
+    filter.setEnabled(1, false);
+    filter.setEnabled(EventFilter::MaxEventId, false);
+    EXPECT_FALSE(filter.isEnabled(EventFilter::MaxEventId));
+    filter.reset();
+    EXPECT_TRUE(filter.isEnabled(1));
+    EXPECT_TRUE(filter.isEnabled(EventFilter::MaxEventId));
+}
+
+TEST(EventFilterTest, OutOfRange) {
+    // Events we can't filter are always enabled
+    EventFilter filter;
+    filter.setEnabled(EventFilter::MaxEventId + 1, false);
+    EXPECT_TRUE(filter.isEnabled(EventFilter::MaxEventId + 1));
+}
@@ -0,0 +1,89 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <gtest/gtest.h>
+#include <cJSON_utils.h>
+#include <memcached/isotime.h>
+#include "eventrecord.h"
+
+static AuditEventRecord create_record() {
+    AuditEventRecord record;
+    record.time = 1426239360;
+    record.usec = 123456;
+    record.peername = "127.0.0.1:666";
+    record.sockname = "127.0.0.1:555";
+    record.user = "myuser";
+    return record;
+}
+
+TEST(EventRecordTest, Format) {
+    auto record = create_record();
+    record.fields.emplace_back("bucket", "default");
+
+    std::string out("garbage");
+    format_audit_event_record(record, out);
+
+    unique_cJSON_ptr json(cJSON_Parse(out.c_str()));
+    ASSERT_NE(nullptr, json.get()) << out;
+    EXPECT_EQ(to_string(json, false), out)
+        << "The event should be formatted the same way as by cJSON";
+
+    auto* timestamp = cJSON_GetObjectItem(json.get(), "timestamp");
+    ASSERT_NE(nullptr, timestamp);
+    EXPECT_EQ(ISOTime::generatetimestamp(1426239360, 123456),
+              timestamp->valuestring);
+    EXPECT_EQ(nullptr, cJSON_GetObjectItem(json.get(), "peer_credentials"));
+    auto* real_userid = cJSON_GetObjectItem(json.get(), "real_userid");
+    ASSERT_NE(nullptr, real_userid);
+    EXPECT_STREQ("memcached",
+                 cJSON_GetObjectItem(real_userid, "source")->valuestring);
+    EXPECT_STREQ("myuser",
+                 cJSON_GetObjectItem(real_userid, "user")->valuestring);
+    EXPECT_STREQ("default",
+                 cJSON_GetObjectItem(json.get(), "bucket")->valuestring);
+}
+
+TEST(EventRecordTest, PeerCredentials) {
+    auto record = create_record();
+    record.peer_credentials = "{\"uid\":1000,\"gid\":1000,\"pid\":42}";
+
+    std::string out;
+    format_audit_event_record(record, out);
+
+    unique_cJSON_ptr json(cJSON_Parse(out.c_str()));
+    ASSERT_NE(nullptr, json.get()) << out;
+    auto* creds = cJSON_GetObjectItem(json.get(), "peer_credentials");
+    ASSERT_NE(nullptr, creds);
+    EXPECT_EQ(42, cJSON_GetObjectItem(creds, "pid")->valueint);
+}
+
+TEST(EventRecordTest, Escaping) {
+    const std::string reason("\"quoted\"\\ \b\f\n\r\t\x01 \xc3\xa6");
+    auto record = create_record();
+    record.user = "user\"\n";
+    record.fields.emplace_back("reason", reason);
+
+    std::string out;
+    format_audit_event_record(record, out);
+
+    unique_cJSON_ptr json(cJSON_Parse(out.c_str()));
+    ASSERT_NE(nullptr, json.get()) << out;
+    EXPECT_EQ(to_string(json, false), out);
+    EXPECT_EQ(reason, cJSON_GetObjectItem(json.get(), "reason")->valuestring);
+    auto* real_userid = cJSON_GetObjectItem(json.get(), "real_userid");
+    EXPECT_STREQ("user\"\n",
+                 cJSON_GetObjectItem(real_userid, "user")->valuestring);
+}
@@ -26,6 +26,7 @@
 #include "cookie.h"
 #include "function_chain.h"
 #include "mcbp_validators.h"
+#include "rate_limiter.h"
 #include "timings.h"
 #include "topkeys.h"
 #include "task.h"
@@ -114,7 +115,9 @@ public:
     }
 
     /**
-     * Invoke the MCBP validator(s) for the given command
+     * Invoke the additional MCBP validator(s) the bucket use for the given
+     * command (the validator common for all buckets is run from the
+     * dispatch table before this method is called)
      */
     static protocol_binary_response_status validateMcbpCommand(
                                                 const Connection* c,
@@ -184,6 +187,12 @@ public:
      */
     TopKeys *topkeys;
 
+    /**
+     * The limits for the request rate from the clients (not copied by the
+     * copy constructor)
+     */
+    RateLimiter rateLimiter;
+
     /**
      * The validator chains to use for this bucket when receiving MCBP commands.
      */
@@ -0,0 +1,112 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <new>
+#include <platform/cb_malloc.h>
+
+static_assert((BufferPool::minSize << (BufferPool::numClasses - 1)) ==
+              BufferPool::maxSize,
+              "numClasses doesn't match minSize and maxSize");
+
+BufferPool::~BufferPool() {
+    for (auto& list : freelist) {
+        for (auto* buf : list) {
+            cb_free(buf);
+        }
+    }
+}
+
+int BufferPool::getClassIndex(size_t size) {
+    size_t classSize = minSize;
+    for (int ii = 0; ii < int(numClasses); ++ii, classSize <<= 1) {
+        if (size == classSize) {
+            return ii;
+        }
+    }
+    return -1;
+}
+
+size_t BufferPool::getClassSize(size_t size) {
+    size_t classSize = minSize;
+    while (classSize < size) {
+        classSize <<= 1;
+    }
+    return classSize <= maxSize ? classSize : 0;
+}
+
+size_t BufferPool::getHighWatermark(int index) {
+    return std::max(size_t(2), highWatermark / (minSize << index));
+}
+
+size_t BufferPool::getLowWatermark(int index) {
+    return std::max(size_t(1), lowWatermark / (minSize << index));
+}
+
+char* BufferPool::allocate(size_t& size, bool& hit) {
+    const size_t classSize = getClassSize(size);
+    if (classSize != 0) {
+        size = classSize;
+        auto& list = freelist[getClassIndex(classSize)];
+        if (!list.empty()) {
+            char* ret = list.back();
+            list.pop_back();
+            hit = true;
+            return ret;
+        }
+    }
+
+    hit = false;
+    return reinterpret_cast<char*>(cb_malloc(size));
+}
+
+void BufferPool::release(char* buf, size_t size) {
+    if (buf == nullptr) {
+        return;
+    }
+
+    const int index = getClassIndex(size);
+    if (index == -1) {
+        cb_free(buf);
+        return;
+    }
+
+    auto& list = freelist[index];
+    if (list.size() >= getHighWatermark(index)) {
+        const size_t low = getLowWatermark(index);
+        while (list.size() > low) {
+            cb_free(list.back());
+            list.pop_back();
+        }
+    }
+
+    try {
+        list.push_back(buf);
+    } catch (const std::bad_alloc&) {
+        cb_free(buf);
+    }
+}
+
+size_t BufferPool::getCachedBytes() const {
+    size_t ret = 0;
+    for (size_t ii = 0; ii < numClasses; ++ii) {
+        ret += freelist[ii].size() * (minSize << ii);
+    }
+    return ret;
+}
@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/**
+ * BufferPool is a cache of network buffers in a fixed set of size classes
+ * (powers of two from minSize to maxSize). Each worker thread owns a pool
+ * which is used when it lends read and write buffers to its connections,
+ * and when a connections read buffer needs to grow (or shrink). Reusing
+ * the buffers avoids the allocator churn of the malloc/realloc/free cycle
+ * for mid-size values.
+ *
+ * Every size class has a high and a low water mark. When a buffer is
+ * released to a size class which already holds highWatermark buffers,
+ * the class is trimmed down to the low water mark before the buffer is
+ * added. The hysteresis avoids freeing (and allocating) a buffer on every
+ * release when the number of buffers in use hovers around the high water
+ * mark.
+ *
+ * The buffers are allocated with cb_malloc so that a buffer may be
+ * released with cb_free if it's not returned to a pool (for instance
+ * when a connection is destroyed).
+ *
+ * The pool is not thread safe, and may only be used by the thread owning
+ * it.
+ */
+class BufferPool {
+public:
+    /** The size of the smallest size class */
+    static const size_t minSize = 2048;
+
+    /** The size of the largest size class */
+    static const size_t maxSize = 128 * 1024;
+
+    /** The number of size classes (minSize, 2 * minSize, ..., maxSize) */
+    static const size_t numClasses = 7;
+
+    /**
+     * The high and low water marks (in bytes) for each size class. The
+     * number of buffers kept is this divided by the size of the class
+     * (but we'll always allow at least two buffers in each class).
+     */
+    static const size_t highWatermark = 512 * 1024;
+    static const size_t lowWatermark = 128 * 1024;
+
+    BufferPool() = default;
+
+    BufferPool(const BufferPool&) = delete;
+
+    ~BufferPool();
+
+    /**
+     * Allocate a buffer
+     *
+     * @param size the minimum size for the buffer. Upon return it contains
+     *             the actual size of the buffer (the size of the class it
+     *             was allocated from).
+     * @param hit set to true if the buffer was served from the pool, false
+     *            if we had to allocate a new buffer
+     * @return the buffer or nullptr if memory allocation failed
+     */
+    char* allocate(size_t& size, bool& hit);
+
+    /**
+     * Release a buffer back to the pool. Buffers which don't match one of
+     * the size classes are freed.
+     *
+     * @param buf the buffer to release (may be nullptr)
+     * @param size the size of the buffer
+     */
+    void release(char* buf, size_t size);
+
+    /**
+     * Get the total number of bytes currently cached in the pool
+     */
+    size_t getCachedBytes() const;
+
+    /**
+     * Get the index for the size class with the given size, or -1 if
+     * it doesn't match one of the size classes.
+     */
+    static int getClassIndex(size_t size);
+
+    /**
+     * Get the size of the size class a buffer of the given size would be
+     * allocated from (0 if it's bigger than maxSize).
+     */
+    static size_t getClassSize(size_t size);
+
+private:
+    static size_t getHighWatermark(int index);
+    static size_t getLowWatermark(int index);
+
+    std::array<std::vector<char*>, numClasses> freelist;
+};
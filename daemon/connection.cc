@@ -19,6 +19,8 @@
 #include "runtime.h"
 #include "statemachine_mcbp.h"
 
+#include <cstddef>
+#include <cstring>
 #include <exception>
 #include <utilities/protocol2text.h>
 #include <platform/checked_snprintf.h>
@@ -63,17 +65,22 @@ Connection::Connection(SOCKET sfd, event_base* b)
       refcount(0),
       engine_storage(nullptr),
       next(nullptr),
+      pendingIo(false),
+      migrationPending(false),
+      scheduledEvents(0),
       thread(nullptr),
       parent_port(0),
       bucketEngine(nullptr),
       peername("unknown"),
       sockname("unknown"),
+      unixSocket(false),
       priority(Priority::Medium),
       clustermap_revno(-2),
       trace_enabled(false),
       xattr_support(false) {
     MEMCACHED_CONN_CREATE(this);
     bucketIndex.store(0);
+    updatePrivilegeContext();
 }
 
 Connection::Connection(SOCKET sock,
@@ -81,8 +88,11 @@ Connection::Connection(SOCKET sock,
                        const ListeningPort& interface)
     : Connection(sock, b) {
     parent_port = interface.port;
+    unixSocket = !interface.path.empty();
     resolveConnectionName(false);
-    setTcpNoDelay(interface.tcp_nodelay);
+    if (!unixSocket) {
+        setTcpNoDelay(interface.tcp_nodelay);
+    }
 }
 
 Connection::~Connection() {
@@ -105,6 +115,19 @@ Connection::~Connection() {
  */
 static std::string sockaddr_to_string(const struct sockaddr_storage* addr,
                                       socklen_t addr_len) {
+#ifndef WIN32
+    if (addr->ss_family == AF_UNIX) {
+        // The peer of a unix domain socket is typically unnamed
+        const auto* un = reinterpret_cast<const struct sockaddr_un*>(addr);
+        const auto offset = offsetof(struct sockaddr_un, sun_path);
+        if (addr_len <= offset || un->sun_path[0] == '\0') {
+            return "unix";
+        }
+        return "unix:" + std::string(un->sun_path,
+                                     strnlen(un->sun_path, addr_len - offset));
+    }
+#endif
+
     char host[50];
     char port[50];
 
@@ -125,6 +148,42 @@ static std::string sockaddr_to_string(const struct sockaddr_storage* addr,
     }
 }
 
+/**
+ * Get the credentials of the process connected to a unix domain socket
+ */
+static Connection::PeerCredentials get_peer_credentials(SOCKET sfd) {
+    Connection::PeerCredentials ret;
+#if defined(SO_PEERCRED)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(sfd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0) {
+        ret.pid = cred.pid;
+        ret.uid = cred.uid;
+        ret.gid = cred.gid;
+    }
+#elif !defined(WIN32)
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(sfd, &uid, &gid) == 0) {
+        ret.uid = uid;
+        ret.gid = gid;
+    }
+#endif
+    return ret;
+}
+
+unique_cJSON_ptr Connection::getPeerCredentialsJSON() const {
+    if (!unixSocket) {
+        return unique_cJSON_ptr();
+    }
+
+    unique_cJSON_ptr ret(cJSON_CreateObject());
+    cJSON_AddNumberToObject(ret.get(), "pid", double(peerCredentials.pid));
+    cJSON_AddNumberToObject(ret.get(), "uid", double(peerCredentials.uid));
+    cJSON_AddNumberToObject(ret.get(), "gid", double(peerCredentials.gid));
+    return ret;
+}
+
 void Connection::resolveConnectionName(bool listening) {
     int err;
     try {
@@ -141,6 +200,14 @@ void Connection::resolveConnectionName(bool listening) {
             } else {
                 peername = sockaddr_to_string(&peer, peer_len);
             }
+
+            if (unixSocket) {
+                peerCredentials = get_peer_credentials(socketDescriptor);
+                peername = "unix:pid=" +
+                           std::to_string(peerCredentials.pid) + ",uid=" +
+                           std::to_string(peerCredentials.uid) + ",gid=" +
+                           std::to_string(peerCredentials.gid);
+            }
         }
 
         struct sockaddr_storage sock;
@@ -161,6 +228,11 @@ void Connection::resolveConnectionName(bool listening) {
 }
 
 bool Connection::setTcpNoDelay(bool enable) {
+    if (unixSocket) {
+        // There is no Nagle algorithm on unix domain sockets
+        return true;
+    }
+
     int flags = enable ? 1 : 0;
 
 #if defined(WIN32)
@@ -245,6 +317,10 @@ cJSON* Connection::toJSON() const {
         cJSON_AddStringToObject(obj, "protocol", to_string(getProtocol()));
         cJSON_AddStringToObject(obj, "peername", getPeername().c_str());
         cJSON_AddStringToObject(obj, "sockname", getSockname().c_str());
+        if (unixSocket) {
+            cJSON_AddItemToObject(obj, "peer_credentials",
+                                  getPeerCredentialsJSON().release());
+        }
         cJSON_AddNumberToObject(obj, "parent_port", parent_port);
         cJSON_AddNumberToObject(obj, "bucket_index", getBucketIndex());
         json_add_bool_to_object(obj, "admin", isAdmin());
@@ -269,6 +345,8 @@ cJSON* Connection::toJSON() const {
         json_add_uintptr_to_object(obj, "engine_storage",
                                    (uintptr_t)engine_storage);
         json_add_uintptr_to_object(obj, "next", (uintptr_t)next);
+        json_add_bool_to_object(obj, "pending_io", pendingIo.load());
+        json_add_bool_to_object(obj, "migration_pending", migrationPending);
         json_add_uintptr_to_object(obj, "thread", (uintptr_t)thread.load(
             std::memory_order::memory_order_relaxed));
         cJSON_AddStringToObject(obj, "priority", to_string(priority));
@@ -296,6 +374,7 @@ void Connection::restartAuthentication() {
     admin = false;
     authenticated = false;
     username = "";
+    updatePrivilegeContext();
 }
 
 /**
@@ -307,13 +386,7 @@ void Connection::restartAuthentication() {
  * This function will be replaces when we get access to ns_servers
  * RBAC data.
  */
-PrivilegeAccess Connection::checkPrivilege(const Privilege& privilege) const {
-    static bool testing = getenv("MEMCACHED_UNIT_TESTS") != nullptr;
-
-    if (isAdmin() || testing) {
-        return PrivilegeAccess::Ok;
-    }
-
+static PrivilegeAccess getDefaultAccess(const Privilege& privilege) {
     switch (privilege) {
     case Privilege::Read:
         return PrivilegeAccess::Ok;
@@ -358,6 +431,51 @@ PrivilegeAccess Connection::checkPrivilege(const Privilege& privilege) const {
     throw std::logic_error("Unknown privilege requested");
 }
 
+/**
+ * The generation of the privilege database. It is incremented every time
+ * the privilege database change so that the connections know that they
+ * need to rebuild their privilege mask.
+ */
+static std::atomic<uint32_t> privilege_generation;
+
+uint32_t Connection::getPrivilegeGeneration() {
+    return privilege_generation.load(std::memory_order_acquire);
+}
+
+void Connection::invalidatePrivilegeContexts() {
+    privilege_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void Connection::updatePrivilegeContext() const {
+    static bool testing = getenv("MEMCACHED_UNIT_TESTS") != nullptr;
+    const auto generation = getPrivilegeGeneration();
+
+    PrivilegeMask mask = 0;
+    if (isAdmin() || testing) {
+        mask = ~PrivilegeMask(0);
+    } else {
+        for (int ii = 0; ii <= int(Privilege::CollectionManagement); ++ii) {
+            if (getDefaultAccess(Privilege(ii)) == PrivilegeAccess::Ok) {
+                mask |= privilegeToMask(Privilege(ii));
+            }
+        }
+    }
+
+    privilegeMask.store(mask, std::memory_order_relaxed);
+    privilegeGeneration.store(generation, std::memory_order_relaxed);
+}
+
+PrivilegeAccess Connection::checkPrivilege(const Privilege& privilege) const {
+    return checkPrivileges(privilegeToMask(privilege));
+}
+
+PrivilegeAccess Connection::checkPrivileges(PrivilegeMask privileges) const {
+    if ((getPrivilegeMask() & privileges) == privileges) {
+        return PrivilegeAccess::Ok;
+    }
+    return PrivilegeAccess::Fail;
+}
+
 Bucket& Connection::getBucket() const {
     return all_buckets[getBucketIndex()];
 }
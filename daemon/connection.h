@@ -23,6 +23,7 @@
 #include <cJSON.h>
 #include <cbsasl/cbsasl.h>
 #include <string>
+#include <utilities/mpsc_queue.h>
 
 struct LIBEVENT_THREAD;
 class ListeningPort;
@@ -30,8 +31,11 @@ class Bucket;
 
 /**
  * The structure representing a connection in memcached.
+ *
+ * The connection may be linked into the pending io queue of the thread
+ * serving the connection (see notify_io_complete())
  */
-class Connection {
+class Connection : public MpscQueueHook<Connection> {
 public:
     enum class Priority : uint8_t {
         High,
@@ -85,6 +89,33 @@ public:
         return sockname;
     }
 
+    /**
+     * The credentials of the process on the other end of a unix domain
+     * socket (a field is -1 if it isn't known)
+     */
+    struct PeerCredentials {
+        int64_t pid = -1;
+        int64_t uid = -1;
+        int64_t gid = -1;
+    };
+
+    /**
+     * Is the connection using a unix domain socket?
+     */
+    bool isUnixSocket() const {
+        return unixSocket;
+    }
+
+    const PeerCredentials& getPeerCredentials() const {
+        return peerCredentials;
+    }
+
+    /**
+     * Get a JSON representation of the peer credentials (or nullptr if
+     * this isn't a unix domain socket)
+     */
+    unique_cJSON_ptr getPeerCredentialsJSON() const;
+
     /**
      * Returns a descriptive name for the connection, of the form:
      *   "[peer_name - local_name ]"
@@ -128,6 +159,7 @@ public:
 
     void setAdmin(bool admin) {
         Connection::admin = admin;
+        updatePrivilegeContext();
     }
 
     bool isAuthenticated() const {
@@ -208,13 +240,58 @@ public:
         Connection::next = next;
     }
 
+    /**
+     * Flag that the connection has an io notification which hasn't been
+     * delivered yet.
+     */
+    void setPendingIo() {
+        pendingIo.store(true);
+    }
+
+    /**
+     * Clear the pending io notification.
+     *
+     * @return true if a notification was pending
+     */
+    bool clearPendingIo() {
+        return pendingIo.exchange(false);
+    }
+
+    /**
+     * Flag that the connection should be moved to one of the replication
+     * threads (it is moved by the thread serving it once it is idle)
+     */
+    void setMigrationPending(bool pending) {
+        migrationPending = pending;
+    }
+
+    bool isMigrationPending() const {
+        return migrationPending;
+    }
+
+    /**
+     * Get the libevent events the connection is scheduled to run with
+     * in the ConnectionScheduler of its thread (0 if it isn't scheduled)
+     */
+    short getScheduledEvents() const {
+        return scheduledEvents;
+    }
+
+    void setScheduledEvents(short which) {
+        scheduledEvents = which;
+    }
+
+    /**
+     * Get the thread serving the connection. The connection may be moved
+     * to another thread (see migrate_connection) while other threads
+     * notify it, so they must only read the owner once.
+     */
     LIBEVENT_THREAD* getThread() const {
-        return thread.load(std::memory_order_relaxed);
+        return thread.load(std::memory_order_acquire);
     }
 
     void setThread(LIBEVENT_THREAD* thread) {
-        Connection::thread.store(thread,
-                                 std::memory_order::memory_order_relaxed);
+        Connection::thread.store(thread, std::memory_order_release);
     }
 
     /**
@@ -264,12 +341,45 @@ public:
      */
     PrivilegeAccess checkPrivilege(const Privilege& privilege) const;
 
+    /**
+     * Check if this connection is in posession of all of the privileges
+     * in the requested set
+     *
+     * @param privileges the set of privileges to check for
+     * @return Ok - the connection holds all of the privileges (or the
+     *              set is empty)
+     *         Fail - the connection is missing one of the privileges
+     *         Stale - the authentication context is stale
+     */
+    PrivilegeAccess checkPrivileges(PrivilegeMask privileges) const;
+
+    /**
+     * Get the privileges the connection holds in its current context
+     * (the authenticated user and the selected bucket). The set is
+     * rebuilt if the privilege database changed since it was built.
+     */
+    PrivilegeMask getPrivilegeMask() const {
+        if (privilegeGeneration.load(std::memory_order_relaxed) !=
+            getPrivilegeGeneration()) {
+            updatePrivilegeContext();
+        }
+        return privilegeMask.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Invalidate the privilege context cached in all connections (the
+     * privilege database changed). Each connection rebuilds its context
+     * the next time it checks a privilege.
+     */
+    static void invalidatePrivilegeContexts();
+
     int getBucketIndex() const {
         return bucketIndex.load(std::memory_order_relaxed);
     }
 
     void setBucketIndex(int bucketIndex) {
         Connection::bucketIndex.store(bucketIndex, std::memory_order_relaxed);
+        updatePrivilegeContext();
     }
 
     Bucket& getBucket() const;
@@ -361,6 +471,21 @@ protected:
     /** The username authenticated as */
     std::string username;
 
+    /**
+     * Rebuild the privilege mask for the current context (must be called
+     * every time the user or the selected bucket changes)
+     */
+    void updatePrivilegeContext() const;
+
+    /** Get the current generation of the privilege database */
+    static uint32_t getPrivilegeGeneration();
+
+    /** The privileges held in the current context */
+    mutable std::atomic<PrivilegeMask> privilegeMask;
+
+    /** The generation of the privilege database privilegeMask was built from */
+    mutable std::atomic<uint32_t> privilegeGeneration;
+
 
     /** Is tcp nodelay enabled or not? */
     bool nodelay;
@@ -378,6 +503,25 @@ protected:
     /* Used for generating a list of Connection structures */
     Connection* next;
 
+    /**
+     * Set when someone notified the connection (notify_io_complete etc),
+     * and cleared by the worker thread when it runs the connection.
+     */
+    std::atomic_bool pendingIo;
+
+    /**
+     * Set when the connection should be moved to a replication thread
+     * (only accessed by the thread serving the connection)
+     */
+    bool migrationPending;
+
+    /**
+     * The events the connection is scheduled to run with in the thread's
+     * ConnectionScheduler (only accessed by the thread serving the
+     * connection)
+     */
+    short scheduledEvents;
+
     /** Pointer to the thread object serving this connection */
     std::atomic<LIBEVENT_THREAD*> thread;
 
@@ -400,6 +544,12 @@ protected:
     /** Name of the local socket if known */
     std::string sockname;
 
+    /** Is the socket a unix domain socket */
+    bool unixSocket;
+
+    /** The credentials of the peer (for unix domain sockets) */
+    PeerCredentials peerCredentials;
+
     /** The connections priority */
     Priority priority;
 
@@ -37,6 +37,7 @@ ListenConnection::ListenConnection(SOCKET sfd,
       ssl(!interf.ssl.cert.empty()),
       management(interf.management),
       protocol(interf.protocol),
+      path(interf.path),
       ev(event_new(b, sfd, EV_READ | EV_PERSIST, listen_event_handler,
                    reinterpret_cast<void*>(this))) {
 
@@ -53,7 +54,11 @@ ListenConnection::ListenConnection(SOCKET sfd,
 
 ListenConnection::~ListenConnection() {
     disable();
-
+#ifndef WIN32
+    if (!path.empty()) {
+        unlink(path.c_str());
+    }
+#endif
 }
 
 const Protocol ListenConnection::getProtocol() const {
@@ -130,8 +135,11 @@ unique_cJSON_ptr ListenConnection::getDetails() {
     cJSON_AddStringToObject(obj, "protocol", to_string(protocol));
     if (family == AF_INET) {
         cJSON_AddStringToObject(obj, "family", "AF_INET");
-    } else {
+    } else if (family == AF_INET6) {
         cJSON_AddStringToObject(obj, "family", "AF_INET6");
+    } else {
+        cJSON_AddStringToObject(obj, "family", "AF_UNIX");
+        cJSON_AddStringToObject(obj, "path", path.c_str());
     }
 
     cJSON_AddNumberToObject(obj, "port", parent_port);
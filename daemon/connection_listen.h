@@ -67,6 +67,8 @@ protected:
     const bool ssl;
     const bool management;
     const Protocol protocol;
+    /** The path of the unix domain socket (empty for TCP) */
+    const std::string path;
 
     struct EventDeleter {
         void operator()(struct event* ev) {
@@ -16,10 +16,12 @@
  */
 #include "config.h"
 #include "connections.h"
+#include "idle_connection_list.h"
 #include "memcached.h"
 #include "runtime.h"
 #include "statemachine_mcbp.h"
 #include "mc_time.h"
+#include "ktls.h"
 
 #include <exception>
 #include <utilities/protocol2text.h>
@@ -109,10 +111,55 @@ bool McbpConnection::registerEvent() {
     return true;
 }
 
+/**
+ * Callback used to retry a command delayed by the rate limiter
+ */
+static void rate_limit_retry_handler(evutil_socket_t, short, void* arg) {
+    auto* c = reinterpret_cast<McbpConnection*>(arg);
+    c->cancelRateLimitRetry();
+    notify_io_complete(&c->getCookieObject(), ENGINE_SUCCESS);
+}
+
+bool McbpConnection::scheduleRateLimitRetry(const struct timeval& tv) {
+    cancelRateLimitRetry();
+    if (evtimer_assign(&rateLimitEvent, base, rate_limit_retry_handler,
+                       reinterpret_cast<void*>(this)) == -1 ||
+        evtimer_add(&rateLimitEvent, &tv) == -1) {
+        return false;
+    }
+    rateLimitEventPending = true;
+    return true;
+}
+
+bool McbpConnection::cancelRateLimitRetry() {
+    if (!rateLimitEventPending) {
+        return false;
+    }
+    evtimer_del(&rateLimitEvent);
+    rateLimitEventPending = false;
+    return true;
+}
+
+bool McbpConnection::setEventBase(event_base* new_base) {
+    if (registered_in_libevent && !unregisterEvent()) {
+        return false;
+    }
+
+    base = new_base;
+    if (event_assign(&event, base, socketDescriptor, ev_flags, event_handler,
+                     reinterpret_cast<void*>(this)) == -1) {
+        LOG_WARNING(this, "Failed to move connection to new event base");
+        return false;
+    }
+
+    return true;
+}
+
 bool McbpConnection::updateEvent(const short new_flags) {
     struct event_base* base = event.ev_base;
 
-    if (ssl.isEnabled() && ssl.isConnected() && (new_flags & EV_READ)) {
+    if (ssl.isEnabled() && ssl.isConnected() && !ssl.isKtlsRx() &&
+        (new_flags & EV_READ)) {
         /*
          * If we want more data and we have SSL, that data might be inside
          * SSL's internal buffers rather than inside the socket buffer. In
@@ -205,23 +252,12 @@ bool McbpConnection::initializeEvent() {
 
 void McbpConnection::shrinkBuffers() {
     if (read.size > READ_BUFFER_HIGHWAT && read.bytes < DATA_BUFFER_SIZE) {
-        if (read.curr != read.buf) {
-            /* Pack the buffer */
-            memmove(read.buf, read.curr, (size_t)read.bytes);
-        }
-
-        void* ptr = cb_realloc(read.buf, DATA_BUFFER_SIZE);
-        char* newbuf = reinterpret_cast<char*>(ptr);
-        if (newbuf) {
-            read.buf = newbuf;
-            read.size = DATA_BUFFER_SIZE;
-        } else {
+        if (!resizeReadBuffer(DATA_BUFFER_SIZE)) {
             LOG_WARNING(this,
                         "%u: Failed to shrink read buffer down to %"
                             PRIu64
                             " bytes.", getId(), DATA_BUFFER_SIZE);
         }
-        read.curr = read.buf;
     }
 
     if (msglist.size() > MSG_LIST_HIGHWAT) {
@@ -257,10 +293,19 @@ void McbpConnection::shrinkBuffers() {
 
 
 int McbpConnection::sslPreConnection() {
+    // The BIO pair never blocks, so this is the CPU time spent on the
+    // handshake
+    const auto start = gethrtime();
     int r = ssl.accept();
+    stats.ssl_handshake_time += (gethrtime() - start) / 1000;
     if (r == 1) {
+        stats.ssl_handshakes++;
+        if (ssl.isSessionReused()) {
+            stats.ssl_handshakes_resumed++;
+        }
         ssl.drainBioSendPipe(socketDescriptor);
         ssl.setConnected();
+        ssl.enableKtls(socketDescriptor, getId());
     } else {
         if (ssl.getError(r) == SSL_ERROR_WANT_READ) {
             ssl.drainBioSendPipe(socketDescriptor);
@@ -293,7 +338,7 @@ int McbpConnection::sslPreConnection() {
 
 int McbpConnection::recv(char* dest, size_t nbytes) {
     int res;
-    if (ssl.isEnabled()) {
+    if (ssl.isEnabled() && !ssl.isKtlsRx()) {
         ssl.drainBioRecvPipe(socketDescriptor);
 
         if (ssl.hasError()) {
@@ -308,11 +353,18 @@ int McbpConnection::recv(char* dest, size_t nbytes) {
             }
         }
 
-        /* The SSL negotiation might be complete at this time */
-        if (ssl.isConnected()) {
+        /* The SSL negotiation might be complete at this time (and the
+         * kernel may have taken over the record layer) */
+        if (ssl.isKtlsRx()) {
+            res = (int)::recv(socketDescriptor, dest, nbytes, 0);
+            if (res > 0) {
+                totalRecv += res;
+            }
+        } else if (ssl.isConnected()) {
             res = sslRead(dest, nbytes);
         }
     } else {
+        // The kernel decrypts the data for kTLS connections
         res = (int)::recv(socketDescriptor, dest, nbytes, 0);
         if (res > 0) {
             totalRecv += res;
@@ -324,7 +376,7 @@ int McbpConnection::recv(char* dest, size_t nbytes) {
 
 int McbpConnection::sendmsg(struct msghdr* m) {
     int res = 0;
-    if (ssl.isEnabled()) {
+    if (ssl.isEnabled() && !ssl.isKtlsTx()) {
         for (int ii = 0; ii < int(m->msg_iovlen); ++ii) {
             int n = sslWrite(reinterpret_cast<char*>(m->msg_iov[ii].iov_base),
                              m->msg_iov[ii].iov_len);
@@ -341,6 +393,7 @@ int McbpConnection::sendmsg(struct msghdr* m) {
         ssl.drainBioSendPipe(socketDescriptor);
         return res;
     } else {
+        // The kernel encrypts the data for kTLS connections
         res = int(::sendmsg(socketDescriptor, m, 0));
         if (res > 0) {
             totalSend += res;
@@ -351,7 +404,7 @@ int McbpConnection::sendmsg(struct msghdr* m) {
 }
 
 McbpConnection::TransmitResult McbpConnection::transmit() {
-    if (ssl.isEnabled()) {
+    if (ssl.isEnabled() && !ssl.isKtlsTx()) {
         // We use OpenSSL to write data into a buffer before we send it
         // over the wire... Lets go ahead and drain that BIO pipe before
         // we may do anything else.
@@ -485,16 +538,12 @@ McbpConnection::TryReadResult McbpConnection::tryReadNetwork() {
                 return gotdata;
             }
             ++num_allocs;
-            char* new_rbuf = reinterpret_cast<char*>(cb_realloc(read.buf,
-                                                             read.size * 2));
-            if (!new_rbuf) {
+            if (!resizeReadBuffer(size_t(read.size) * 2)) {
                 LOG_WARNING(this, "Couldn't realloc input buffer");
                 read.bytes = 0; /* ignore what we read */
                 setState(conn_closing);
                 return TryReadResult::MemoryError;
             }
-            read.curr = read.buf = new_rbuf;
-            read.size *= 2;
         }
 
         avail = read.size - read.bytes;
@@ -658,6 +707,7 @@ bool SslContext::enable(const std::string& cert, const std::string& pkey) {
     }
 
     set_ssl_ctx_cipher_list(ctx);
+    set_ssl_ctx_session_resumption(ctx);
 
     enabled = true;
     error = false;
@@ -693,10 +743,21 @@ void SslContext::disable() {
     enabled = false;
 }
 
+void SslContext::compact() {
+    if (in.total == 0 && out.total == 0) {
+        std::vector<char>().swap(in.buffer);
+        std::vector<char>().swap(out.buffer);
+    }
+}
+
 void SslContext::drainBioRecvPipe(SOCKET sfd) {
     int n;
     bool stop = false;
 
+    if (in.buffer.empty()) {
+        in.buffer.resize(settings.getBioDrainBufferSize());
+    }
+
     do {
         if (in.current < in.total) {
             n = BIO_write(network, in.buffer.data() + in.current,
@@ -738,6 +799,10 @@ void SslContext::drainBioSendPipe(SOCKET sfd) {
     int n;
     bool stop = false;
 
+    if (out.buffer.empty()) {
+        out.buffer.resize(settings.getBioDrainBufferSize());
+    }
+
     do {
         if (out.current < out.total) {
             n = send(sfd, out.buffer.data() + out.current,
@@ -771,6 +836,49 @@ void SslContext::drainBioSendPipe(SOCKET sfd) {
     } while (!stop);
 }
 
+void SslContext::enableKtls(SOCKET sfd, uint32_t id) {
+    if (!settings.isSslKtls()) {
+        return;
+    }
+
+    // All of the handshake must be sent before the kernel starts
+    // encrypting the data
+    if (morePendingOutput()) {
+        LOG_DEBUG(nullptr, "%u: kTLS not enabled: pending output", id);
+        stats.ktls_fallback++;
+        return;
+    }
+
+    // The kernel can't decrypt the data we've already read off the socket,
+    // so if the client sent data right after the handshake we have to
+    // let OpenSSL decrypt the incoming data
+    const bool rx = in.total == 0 && BIO_ctrl_pending(application) == 0 &&
+                    SSL_pending(client) == 0;
+
+    const auto status = ktls_enable(sfd, client, rx);
+    ktlsTx = status.tx;
+    ktlsRx = status.rx;
+    if (ktlsTx) {
+        stats.ktls_tx_conns++;
+        // We don't need the buffers used to send data through OpenSSL
+        if (out.total == 0) {
+            std::vector<char>().swap(out.buffer);
+        }
+    } else {
+        stats.ktls_fallback++;
+    }
+    if (ktlsRx) {
+        stats.ktls_rx_conns++;
+        std::vector<char>().swap(in.buffer);
+    }
+
+    if (!status.reason.empty()) {
+        LOG_DEBUG(nullptr, "%u: kTLS %s: %s", id,
+                  ktlsTx ? "only enabled for send" : "not enabled",
+                  status.reason.c_str());
+    }
+}
+
 void SslContext::dumpCipherList(uint32_t id) const {
     LOG_DEBUG(NULL, "%u: Using SSL ciphers:", id);
     int ii = 0;
@@ -786,6 +894,8 @@ cJSON* SslContext::toJSON() const {
     if (enabled) {
         json_add_bool_to_object(obj, "connected", connected);
         json_add_bool_to_object(obj, "error", error);
+        json_add_bool_to_object(obj, "ktls_tx", ktlsTx);
+        json_add_bool_to_object(obj, "ktls_rx", ktlsRx);
         cJSON_AddNumberToObject(obj, "total_recv", totalRecv);
         cJSON_AddNumberToObject(obj, "total_send", totalSend);
         cJSON_AddNumberToObject(obj, "input_buff_total", in.total);
@@ -886,16 +996,28 @@ McbpConnection::McbpConnection(SOCKET sfd, event_base *b)
       noreply(false),
       supports_datatype(false),
       supports_mutation_extras(false),
+      unordered_execution(false),
+      deadline_support(false),
+      tracing_enabled(false),
+      framingExtlen(0),
       start(0),
+      rateLimitedSince(0),
+      rateLimitEventPending(false),
       cas(0),
       aiostat(ENGINE_SUCCESS),
       ewouldblock(false),
       commandContext(nullptr),
       totalRecv(0),
       totalSend(0),
+      lastCommandTime(mc_time_get_current_time()),
+      compacted(false),
+      idlePrev(nullptr),
+      idleNext(nullptr),
+      idleLinked(false),
       cookie(this) {
     memset(&binary_header, 0, sizeof(binary_header));
     memset(&event, 0, sizeof(event));
+    memset(&rateLimitEvent, 0, sizeof(rateLimitEvent));
     memset(&read, 0, sizeof(read));
     memset(&write, 0, sizeof(write));
     msglist.reserve(MSG_LIST_INITIAL);
@@ -931,13 +1053,24 @@ McbpConnection::McbpConnection(SOCKET sfd,
       noreply(false),
       supports_datatype(false),
       supports_mutation_extras(false),
+      unordered_execution(false),
+      deadline_support(false),
+      tracing_enabled(false),
+      framingExtlen(0),
       start(0),
+      rateLimitedSince(0),
+      rateLimitEventPending(false),
       cas(0),
       aiostat(ENGINE_SUCCESS),
       ewouldblock(false),
       commandContext(nullptr),
       totalRecv(0),
       totalSend(0),
+      lastCommandTime(mc_time_get_current_time()),
+      compacted(false),
+      idlePrev(nullptr),
+      idleNext(nullptr),
+      idleLinked(false),
       cookie(this) {
 
     if (ifc.protocol != Protocol::Memcached) {
@@ -945,6 +1078,7 @@ McbpConnection::McbpConnection(SOCKET sfd,
     }
     memset(&binary_header, 0, sizeof(binary_header));
     memset(&event, 0, sizeof(event));
+    memset(&rateLimitEvent, 0, sizeof(rateLimitEvent));
     memset(&read, 0, sizeof(read));
     memset(&write, 0, sizeof(write));
     msglist.reserve(MSG_LIST_INITIAL);
@@ -962,6 +1096,7 @@ McbpConnection::McbpConnection(SOCKET sfd,
 }
 
 McbpConnection::~McbpConnection() {
+    cancelRateLimitRetry();
     cb_free(read.buf);
     cb_free(write.buf);
 
@@ -1138,16 +1273,116 @@ cJSON* McbpConnection::toJSON() const {
 
         /* @todo we should decode the binary header */
         json_add_uintptr_to_object(obj, "cas", cas);
-        cJSON_AddNumberToObject(obj, "aiostat", aiostat);
+        cJSON_AddNumberToObject(obj, "aiostat", getAiostat());
         json_add_bool_to_object(obj, "ewouldblock", ewouldblock);
+        json_add_bool_to_object(obj, "unordered_execution",
+                                unordered_execution);
+        json_add_bool_to_object(obj, "deadline_support", deadline_support);
+        json_add_bool_to_object(obj, "tracing_enabled", tracing_enabled);
+        cJSON_AddNumberToObject(obj, "parked_commands",
+                                parkedCommands.size());
         cJSON_AddItemToObject(obj, "ssl", ssl.toJSON());
         cJSON_AddNumberToObject(obj, "total_recv", totalRecv);
         cJSON_AddNumberToObject(obj, "total_send", totalSend);
+        json_add_bool_to_object(obj, "compacted", compacted);
+        cJSON_AddNumberToObject(obj, "memory", getMemoryFootprint());
     }
 
     return obj;
 }
 
+void* McbpConnection::startParkableCommand(const char* packet, size_t size) {
+    if (spareParkedCommand) {
+        parkableCommand = std::move(spareParkedCommand);
+    } else {
+        parkableCommand.reset(new ParkedCommand(*this));
+    }
+    parkableCommand->prepare(packet, size);
+    parkableCommand->getCookie().deadline = cookie.deadline;
+    return parkableCommand->getPacket();
+}
+
+void McbpConnection::releaseParkableCommand() {
+    if (parkableCommand) {
+        parkableCommand->context.reset();
+        spareParkedCommand = std::move(parkableCommand);
+    }
+}
+
+void McbpConnection::parkCommand() {
+    if (!parkableCommand) {
+        throw std::logic_error(
+            "McbpConnection::parkCommand: no parkable command");
+    }
+
+    parkableCommand->header = binary_header;
+    parkableCommand->cmd = cmd;
+    parkableCommand->noreply = noreply;
+    parkableCommand->start = start;
+    parkableCommand->context = std::move(commandContext);
+    parkedCommands.push_back(std::move(parkableCommand));
+
+    // The engine will notify the parked command (not the connection)
+    setAiostat(ENGINE_SUCCESS);
+    setEwouldblock(false);
+    setStart(0);
+    setState(conn_new_cmd);
+}
+
+void* McbpConnection::resumeParkedCommand() {
+    for (auto iter = parkedCommands.begin(); iter != parkedCommands.end();
+         ++iter) {
+        if ((*iter)->isReady()) {
+            parkableCommand = std::move(*iter);
+            parkedCommands.erase(iter);
+
+            setAiostat(parkableCommand->consumeIoStatus());
+            binary_header = parkableCommand->header;
+            cmd = parkableCommand->cmd;
+            noreply = parkableCommand->noreply;
+            start = parkableCommand->start;
+            cookie.deadline = parkableCommand->getCookie().deadline;
+            commandContext = std::move(parkableCommand->context);
+            return parkableCommand->getPacket();
+        }
+    }
+
+    return nullptr;
+}
+
+bool McbpConnection::hasReadyParkedCommands() const {
+    for (const auto& parked : parkedCommands) {
+        if (parked->isReady()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void McbpConnection::releaseReadyParkedCommands() {
+    auto iter = parkedCommands.begin();
+    while (iter != parkedCommands.end()) {
+        if ((*iter)->isReady()) {
+            if ((*iter)->getEngineStorage() != nullptr &&
+                getBucketIndex() != -1) {
+                // The command won't be resumed, so let the engine release
+                // the data it stored for the cookie (the same way as it
+                // does for the connection's cookie when it disconnects)
+                perform_callbacks(ON_DISCONNECT, nullptr,
+                                  &(*iter)->getCookie());
+                (*iter)->setEngineStorage(nullptr);
+            }
+            // The command context may need the cookie to release its
+            // resources
+            parkableCommand = std::move(*iter);
+            iter = parkedCommands.erase(iter);
+            releaseParkableCommand();
+        } else {
+            ++iter;
+        }
+    }
+}
+
 const Protocol McbpConnection::getProtocol() const {
     return Protocol::Memcached;
 }
@@ -1269,6 +1504,79 @@ PipeConnection::~PipeConnection() {
     }
 }
 
+bool McbpConnection::resizeReadBuffer(size_t needed) {
+    size_t size = needed;
+    char* newbuf = conn_alloc_buffer(this, size);
+    if (newbuf == nullptr) {
+        return false;
+    }
+
+    if (read.bytes != 0) {
+        memcpy(newbuf, read.curr, read.bytes);
+    }
+    conn_release_buffer(this, read.buf, read.size);
+    read.buf = read.curr = newbuf;
+    read.size = uint32_t(size);
+    return true;
+}
+
+void McbpConnection::setLastCommandTime(rel_time_t time) {
+    lastCommandTime = time;
+    getThread()->idle_connections->touch(*this);
+}
+
+bool McbpConnection::compactIfIdle(rel_time_t idleSince) {
+    if (compacted || lastCommandTime > idleSince ||
+        getState() != conn_read || !registered_in_libevent || ewouldblock ||
+        read.bytes != 0 || read.buf != nullptr || write.buf != nullptr ||
+        item != nullptr || commandContext || parkableCommand ||
+        !parkedCommands.empty() ||
+        !reservedItems.empty() || !temp_alloc.empty() ||
+        msgcurr < msglist.size()) {
+        return false;
+    }
+
+    std::vector<iovec>().swap(iov);
+    iovused = 0;
+    std::vector<struct msghdr>().swap(msglist);
+    msgcurr = 0;
+    msgbytes = 0;
+    std::vector<void*>().swap(reservedItems);
+    std::vector<char*>().swap(temp_alloc);
+    spareParkedCommand.reset();
+    dynamicBuffer.clear();
+    ssl.compact();
+
+    compacted = true;
+    return true;
+}
+
+void McbpConnection::rehydrate() {
+    iov.resize(IOV_LIST_INITIAL);
+    msglist.reserve(MSG_LIST_INITIAL);
+    compacted = false;
+}
+
+size_t McbpConnection::getMemoryFootprint() const {
+    size_t ret = sizeof(*this);
+    ret += iov.capacity() * sizeof(iovec);
+    ret += msglist.capacity() * sizeof(struct msghdr);
+    ret += reservedItems.capacity() * sizeof(void*);
+    ret += temp_alloc.capacity() * sizeof(char*);
+    ret += read.size + write.size;
+    ret += dynamicBuffer.getSize();
+    ret += ssl.getBufferSize();
+    ret += parkedCommands.size() * sizeof(ParkedCommand);
+    if (parkableCommand) {
+        ret += sizeof(ParkedCommand);
+    }
+    if (spareParkedCommand) {
+        ret += sizeof(ParkedCommand);
+    }
+    ret += peername.capacity() + sockname.capacity() + username.capacity();
+    return ret;
+}
+
 bool McbpConnection::shouldDelete() {
     return getState() == conn_destroyed;
 }
@@ -1278,6 +1586,9 @@ void McbpConnection::runEventLoop(short which) {
     currentEvent = which;
     numEvents = max_reqs_per_event;
     try {
+        if (compacted) {
+            rehydrate();
+        }
         runStateMachinery();
     } catch (std::exception& e) {
         LOG_WARNING(this,
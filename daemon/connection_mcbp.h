@@ -27,9 +27,11 @@
 #include "settings.h"
 #include "statemachine_mcbp.h"
 
+#include <array>
 #include <cbsasl/cbsasl.h>
 #include <chrono>
 #include <cJSON.h>
+#include <list>
 #include <daemon/protocol/mcbp/command_context.h>
 #include <daemon/protocol/mcbp/steppable_command_context.h>
 #include <memcached/openssl.h>
@@ -40,6 +42,8 @@
 
 #include "connection.h"
 #include "cookie.h"
+#include "parked_command.h"
+#include "request_trace.h"
 #include "task.h"
 
 /**
@@ -56,6 +60,8 @@ public:
           network(nullptr),
           ctx(nullptr),
           client(nullptr),
+          ktlsTx(false),
+          ktlsRx(false),
           totalRecv(0),
           totalSend(0) {
         in.total = 0;
@@ -94,6 +100,32 @@ public:
         return error;
     }
 
+    /**
+     * Does the kernel encrypt the data we send (kTLS)? If so the data
+     * should be sent with the plain socket calls.
+     */
+    bool isKtlsTx() const {
+        return ktlsTx;
+    }
+
+    /**
+     * Does the kernel decrypt the data we receive (kTLS)? If so the data
+     * should be read with the plain socket calls.
+     */
+    bool isKtlsRx() const {
+        return ktlsRx;
+    }
+
+    /**
+     * Try to move the record layer to the kernel (kTLS) once the
+     * handshake is complete. Directions which can't be moved to the
+     * kernel keep using OpenSSL.
+     *
+     * @param sfd the socket used by the connection
+     * @param id the connection id (used for logging)
+     */
+    void enableKtls(SOCKET sfd, uint32_t id);
+
     /**
      * Enable SSL for this connection.
      *
@@ -143,6 +175,14 @@ public:
         return SSL_accept(client);
     }
 
+    /**
+     * Did the handshake resume a previous session (from the session
+     * cache or a session ticket)?
+     */
+    bool isSessionReused() const {
+        return SSL_session_reused(client) == 1;
+    }
+
     int getError(int errormask) const {
         return SSL_get_error(client, errormask);
     }
@@ -159,6 +199,21 @@ public:
         return SSL_peek(client, buf, num);
     }
 
+    /**
+     * Release the buffers used to move data between the socket and
+     * OpenSSL if they're empty. They're allocated again the next time
+     * we drain the BIO pipes.
+     */
+    void compact();
+
+    /**
+     * Get the number of bytes allocated for the buffers used to move
+     * data between the socket and OpenSSL
+     */
+    size_t getBufferSize() const {
+        return in.buffer.capacity() + out.buffer.capacity();
+    }
+
     /**
      * Get a JSON description of this object.. caller must call cJSON_Delete()
      */
@@ -172,6 +227,8 @@ protected:
     BIO* network;
     SSL_CTX* ctx;
     SSL* client;
+    bool ktlsTx;
+    bool ktlsRx;
     struct {
         // The data located in the buffer
         std::vector<char> buffer;
@@ -277,7 +334,8 @@ public:
      * @return the buffer to the key.
      */
     const_char_buffer getKey() const {
-        auto *pkt = reinterpret_cast<const char *>(getPacket(cookie));
+        auto *pkt = reinterpret_cast<const char *>(
+            getPacket(*reinterpret_cast<const Cookie*>(getCookie())));
         const_char_buffer ret;
         ret.len = binary_header.request.keylen;
         ret.buf = pkt + sizeof binary_header.bytes + binary_header.request.extlen;
@@ -346,6 +404,15 @@ public:
      */
     bool registerEvent();
 
+    /**
+     * Move the event structure to another event base. The event is
+     * removed from libevent, and must be registered again by the thread
+     * running the new event base.
+     *
+     * @return true if success, false otherwise
+     */
+    bool setEventBase(event_base* new_base);
+
     bool isRegisteredInLibevent() const {
         return registered_in_libevent;
     }
@@ -382,6 +449,53 @@ public:
      */
     void shrinkBuffers();
 
+    /**
+     * Replace the read buffer with a buffer of (at least) the requested size
+     * from the threads buffer pool. The unprocessed data (read.bytes
+     * starting at read.curr) is moved to the beginning of the new buffer.
+     *
+     * @param needed the minimum size of the new buffer
+     * @return true if success, false if memory allocation failed (the
+     *         read buffer is left untouched)
+     */
+    bool resizeReadBuffer(size_t needed);
+
+    /**
+     * Set the time the connection completed its last command (and move
+     * it to the tail of its thread's list of idle connections)
+     */
+    void setLastCommandTime(rel_time_t time);
+
+    rel_time_t getLastCommandTime() const {
+        return lastCommandTime;
+    }
+
+    /**
+     * Release the memory the connection only use while it is executing
+     * commands (the iovector, message list, parked command storage etc)
+     * if the connection has been waiting for the next command since
+     * <em>idleSince</em> (or longer). The memory is allocated again the
+     * next time the connection is scheduled to run.
+     *
+     * This should only be called by the thread owning the connection
+     * when the connection isn't running.
+     *
+     * @param idleSince the connection must not have completed a command
+     *                  after this time
+     * @return true if the connection was compacted
+     */
+    bool compactIfIdle(rel_time_t idleSince);
+
+    bool isCompacted() const {
+        return compacted;
+    }
+
+    /**
+     * Get the (approximate) number of bytes of memory used by this
+     * connection (the object itself and the buffers it owns)
+     */
+    size_t getMemoryFootprint() const;
+
     /**
      * Receive data from the socket
      *
@@ -568,6 +682,103 @@ public:
         McbpConnection::supports_mutation_extras = supports_mutation_extras;
     }
 
+    bool isUnorderedExecution() const {
+        return unordered_execution;
+    }
+
+    void setUnorderedExecution(bool unordered_execution) {
+        McbpConnection::unordered_execution = unordered_execution;
+    }
+
+    bool isDeadlineSupport() const {
+        return deadline_support;
+    }
+
+    void setDeadlineSupport(bool deadline_support) {
+        McbpConnection::deadline_support = deadline_support;
+    }
+
+    bool isTracingEnabled() const {
+        return tracing_enabled;
+    }
+
+    void setTracingEnabled(bool tracing_enabled) {
+        McbpConnection::tracing_enabled = tracing_enabled;
+        if (!tracing_enabled) {
+            requestSpans.clear();
+        }
+    }
+
+    RequestSpanLog& getRequestSpans() {
+        return requestSpans;
+    }
+
+    /**
+     * Get the buffer used for the framing extras of the response
+     * currently being built (see mcbp_add_header)
+     */
+    uint8_t* getResponseFramingBuffer() {
+        return responseFraming.data();
+    }
+
+    uint8_t getFramingExtlen() const {
+        return framingExtlen;
+    }
+
+    void setFramingExtlen(uint8_t framingExtlen) {
+        McbpConnection::framingExtlen = framingExtlen;
+    }
+
+    /**
+     * Start executing a command which may be parked (see ParkedCommand).
+     * The engine is passed the ParkedCommand's cookie until the command
+     * is parked or released.
+     *
+     * @param packet the packet for the command
+     * @param size the number of bytes in the packet
+     * @return the copy of the packet the command should use
+     */
+    void* startParkableCommand(const char* packet, size_t size);
+
+    /**
+     * Release the ParkedCommand used by the command just completed
+     * (must be called after the command context is released as it may
+     * need the cookie)
+     */
+    void releaseParkableCommand();
+
+    /**
+     * Park the current command (which returned EWOULDBLOCK) and move
+     * to conn_new_cmd so that we may start the next command.
+     */
+    void parkCommand();
+
+    /**
+     * Restore the state for the oldest parked command the engine has
+     * notified so that it may be resumed.
+     *
+     * @return the packet for the command, or nullptr if no parked
+     *         command is ready
+     */
+    void* resumeParkedCommand();
+
+    bool hasParkedCommands() const {
+        return !parkedCommands.empty();
+    }
+
+    /**
+     * Do we have parked commands the engine has notified?
+     */
+    bool hasReadyParkedCommands() const;
+
+    /**
+     * Release all of the parked commands the engine has notified without
+     * resuming them (used when the connection is closing). The ON_DISCONNECT
+     * callbacks are run for the cookie of a command which still has engine
+     * specific storage, so that the engine may release it.
+     */
+    void releaseReadyParkedCommands();
+
     /**
      * Clear the dynamic buffer
      */
@@ -594,6 +805,36 @@ public:
         McbpConnection::start = start;
     }
 
+    /**
+     * Get the time the current command was first delayed by the rate
+     * limiter of the bucket (0 if it hasn't been delayed)
+     */
+    hrtime_t getRateLimitedSince() const {
+        return rateLimitedSince;
+    }
+
+    void setRateLimitedSince(hrtime_t since) {
+        rateLimitedSince = since;
+    }
+
+    /**
+     * Schedule a retry of the command delayed by the rate limiter. The
+     * connection is notified (notify_io_complete) when the timer fires.
+     *
+     * @param tv the time to wait before the command is retried
+     * @return true if the timer was scheduled
+     */
+    bool scheduleRateLimitRetry(const struct timeval& tv);
+
+    /**
+     * Cancel a pending retry of a command delayed by the rate limiter
+     * (called when the connection is closed, as the connection may be
+     * released before the timer would fire)
+     *
+     * @return true if a retry was cancelled
+     */
+    bool cancelRateLimitRetry();
+
     uint64_t getCAS() const {
         return cas;
     }
@@ -603,12 +844,12 @@ public:
     }
 
 
-    const ENGINE_ERROR_CODE& getAiostat() const {
-        return aiostat;
+    ENGINE_ERROR_CODE getAiostat() const {
+        return aiostat.load(std::memory_order_relaxed);
     }
 
     void setAiostat(const ENGINE_ERROR_CODE& aiostat) {
-        McbpConnection::aiostat = aiostat;
+        McbpConnection::aiostat.store(aiostat, std::memory_order_relaxed);
     }
 
     bool isEwouldblock() const {
@@ -693,7 +934,7 @@ public:
     bool havePendingInputData() {
         int block = (read.bytes > 0);
 
-        if (!block && ssl.isEnabled()) {
+        if (!block && ssl.isEnabled() && !ssl.isKtlsRx()) {
             char dummy;
             block |= ssl.peek(&dummy, 1);
         }
@@ -713,6 +954,9 @@ public:
     struct net_buf write;
 
     const void* getCookie() const {
+        if (parkableCommand) {
+            return &parkableCommand->getCookie();
+        }
         return &cookie;
     }
 
@@ -720,17 +964,25 @@ public:
         return cookie;
     }
 
+    const Cookie& getCookieObject() const {
+        return cookie;
+    }
+
     /**
      * Obtain a pointer to the packet for the Cookie's connection
      */
     static void* getPacket(const Cookie& cookie) {
+        if (cookie.parked != nullptr) {
+            return cookie.parked->getPacket();
+        }
         auto c = static_cast<McbpConnection*>(cookie.connection);
         return (c->read.curr -
                (c->binary_header.request.bodylen + sizeof(c->binary_header)));
     }
 
     /**
-     *  Invoke the validator function(s) for the command
+     *  Invoke the additional validator function(s) the selected bucket
+     *  use for the command
      */
     protocol_binary_response_status validateCommand(protocol_binary_command command);
 
@@ -843,6 +1095,48 @@ protected:
      */
     bool supports_mutation_extras;
 
+    /**
+     * If the client enabled unordered execution retrieval commands blocked
+     * in the engine are parked while we execute the following commands
+     */
+    bool unordered_execution;
+
+    /**
+     * If the client enabled the deadline feature it may use the
+     * alternative request format (PROTOCOL_BINARY_AREQ) to specify
+     * a timeout for each request
+     */
+    bool deadline_support;
+
+    /**
+     * If the client enabled the tracing feature the responses use the
+     * alternative response format (PROTOCOL_BINARY_ARES) with the
+     * server duration in the framing extras, and the spans of the
+     * recent requests are kept in requestSpans
+     */
+    bool tracing_enabled;
+
+    RequestSpanLog requestSpans;
+
+    /** The framing extras for the response header in write.buf */
+    std::array<uint8_t, 8> responseFraming;
+
+    /**
+     * The number of bytes of framing extras in the packet currently being
+     * read (the framing extras are stripped off the packet before it is
+     * executed)
+     */
+    uint8_t framingExtlen;
+
+    /** The ParkedCommand used by the command currently executing */
+    std::unique_ptr<ParkedCommand> parkableCommand;
+
+    /** The commands currently parked (in the order they were parked) */
+    std::list<std::unique_ptr<ParkedCommand>> parkedCommands;
+
+    /** A released ParkedCommand kept around to avoid memory allocations */
+    std::unique_ptr<ParkedCommand> spareParkedCommand;
+
     /**
      * The dynamic buffer is used to format output packets to be sent on
      * the wire.
@@ -855,13 +1149,27 @@ protected:
      */
     hrtime_t start;
 
+    /**
+     * The time the current command was first delayed by the rate limiter
+     * (0 if it isn't delayed)
+     */
+    hrtime_t rateLimitedSince;
+
+    /** The timer used to retry the command delayed by the rate limiter */
+    struct event rateLimitEvent;
+
+    /** Is rateLimitEvent scheduled in libevent? */
+    bool rateLimitEventPending;
+
     /** the cas to return */
     uint64_t cas;
 
     /**
-     * The status for the async io operation
+     * The status for the async io operation. It is set by the thread
+     * calling notify_io_complete and read by the worker thread (the
+     * pending io queue orders the two).
      */
-    ENGINE_ERROR_CODE aiostat;
+    std::atomic<ENGINE_ERROR_CODE> aiostat;
 
     /**
      * Is this connection currently in an "ewouldblock" state?
@@ -915,11 +1223,30 @@ protected:
      */
     int sslPreConnection();
 
+    /**
+     * Allocate the memory released by compactIfIdle()
+     *
+     * @throws std::bad_alloc
+     */
+    void rehydrate();
+
     // Total number of bytes received on the network
     size_t totalRecv;
     // Total number of bytes sent to the network
     size_t totalSend;
 
+    /** The time the connection completed its last command */
+    rel_time_t lastCommandTime;
+
+    /** Is the per-command memory released (by compactIfIdle) */
+    bool compacted;
+
+    /** The links in the thread's IdleConnectionList */
+    McbpConnection* idlePrev;
+    McbpConnection* idleNext;
+    bool idleLinked;
+    friend class IdleConnectionList;
+
     Cookie cookie;
 };
 
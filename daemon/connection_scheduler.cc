@@ -0,0 +1,116 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "connection_scheduler.h"
+
+#include <stdexcept>
+#include <string>
+
+ConnectionScheduler::ConnectionScheduler() {
+}
+
+uint32_t ConnectionScheduler::getWeight(Connection::Priority priority) {
+    switch (priority) {
+    case Connection::Priority::High:
+        return 4;
+    case Connection::Priority::Medium:
+        return 2;
+    case Connection::Priority::Low:
+        return 1;
+    }
+    throw std::invalid_argument(
+        "ConnectionScheduler::getWeight: Invalid priority: " +
+        std::to_string(int(priority)));
+}
+
+bool ConnectionScheduler::schedule(Connection& c, short which, hrtime_t now) {
+    const auto scheduled = c.getScheduledEvents();
+    c.setScheduledEvents(scheduled | which);
+    if (scheduled != 0) {
+        return false;
+    }
+
+    classes[size_t(c.getPriority())].queue.push_back({&c, now});
+    return true;
+}
+
+void ConnectionScheduler::remove(Connection& c) {
+    if (c.getScheduledEvents() == 0) {
+        return;
+    }
+    c.setScheduledEvents(0);
+
+    // The priority may have changed since the connection was scheduled
+    for (auto& cls : classes) {
+        for (auto iter = cls.queue.begin(); iter != cls.queue.end(); ++iter) {
+            if (iter->connection == &c) {
+                cls.queue.erase(iter);
+                return;
+            }
+        }
+    }
+}
+
+bool ConnectionScheduler::empty() const {
+    for (const auto& cls : classes) {
+        if (!cls.queue.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ConnectionScheduler::runRound(Runner runner) {
+    bool more = false;
+
+    for (size_t ii = 0; ii < classes.size(); ++ii) {
+        auto& cls = classes[ii];
+        if (cls.queue.empty()) {
+            cls.deficit = 0;
+            continue;
+        }
+
+        cls.deficit += int64_t(getWeight(Connection::Priority(ii)) *
+                               baseQuantum);
+
+        // Connections scheduled while we're running the class has to
+        // wait for the next round
+        auto budget = cls.queue.size();
+        while (budget > 0 && cls.deficit > 0 && !cls.queue.empty()) {
+            --budget;
+            const auto entry = cls.queue.front();
+            cls.queue.pop_front();
+
+            auto* c = entry.connection;
+            const short which = c->getScheduledEvents();
+            c->setScheduledEvents(0);
+
+            const auto start = gethrtime();
+            cls.queueTimes.add(start - entry.scheduled);
+            runner(*c, which);
+            cls.deficit -= int64_t(gethrtime() - start);
+        }
+
+        if (cls.queue.empty()) {
+            cls.deficit = 0;
+        } else {
+            more = true;
+        }
+    }
+
+    return more;
+}
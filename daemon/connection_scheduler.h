@@ -0,0 +1,141 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <platform/platform.h>
+#include "connection.h"
+#include "timing_histogram.h"
+
+/**
+ * The ConnectionScheduler decides the order in which the ready
+ * connections bound to a worker thread get to run (a connection is ready
+ * when libevent reports an event for its socket, or when someone notified
+ * it through notify_io_complete).
+ *
+ * The ready connections are queued by their priority class (see
+ * Connection::Priority and cookie_set_priority), and the classes are
+ * served with deficit round robin. Every round each class with ready
+ * connections is granted its quantum (its weight times baseQuantum
+ * nanoseconds), and connections are run from the class until the deficit
+ * is spent. The time spent running a connection is measured and charged
+ * to its class, so that a class running expensive commands (bulk loads,
+ * DCP streams) can't starve the classes running cheap ones. A class which
+ * runs out of ready connections forfeits the rest of its deficit.
+ *
+ * The time a connection spends in the ready queue is recorded in a
+ * histogram per priority class.
+ *
+ * The scheduler is not thread safe, and may only be used by the thread
+ * owning it (with the thread locked).
+ */
+class ConnectionScheduler {
+public:
+    /** The number of priority classes */
+    static const size_t numClasses = 3;
+
+    /** The time (in ns) granted per weight unit every round */
+    static const hrtime_t baseQuantum = 50000;
+
+    /**
+     * The function used to run a connection with the given libevent
+     * events. It may delete the connection.
+     */
+    typedef std::function<void(Connection&, short)> Runner;
+
+    ConnectionScheduler();
+
+    ConnectionScheduler(const ConnectionScheduler&) = delete;
+
+    /**
+     * Add the connection to the ready queue of its priority class. If the
+     * connection is already scheduled it keeps its place in the queue,
+     * and the events are merged with the ones it is scheduled with.
+     *
+     * @param c the connection to schedule
+     * @param which the libevent events to run the connection with
+     * @param now the current time (as returned from gethrtime())
+     * @return true if the connection was added to a ready queue, false if
+     *         it was already scheduled
+     */
+    bool schedule(Connection& c, short which, hrtime_t now);
+
+    /**
+     * Remove the connection from the ready queue (if it is scheduled).
+     * Must be called before the connection is destroyed.
+     */
+    void remove(Connection& c);
+
+    /** Are there any ready connections? */
+    bool empty() const;
+
+    /**
+     * Run a single round of the deficit round robin. Each class is
+     * served at most once per round (and only the connections which was
+     * queued when we started serving the class are considered), so that
+     * the caller may let libevent serve other events between the rounds.
+     *
+     * @param runner the function used to run a connection
+     * @return true if there are ready connections left
+     */
+    bool runRound(Runner runner);
+
+    /**
+     * Get the histogram of the time connections in the given priority
+     * class spent in the ready queue.
+     */
+    const TimingHistogram& getQueueTimes(Connection::Priority priority) const {
+        return classes[size_t(priority)].queueTimes;
+    }
+
+    /** Get the current deficit (in ns) for the given priority class */
+    int64_t getDeficit(Connection::Priority priority) const {
+        return classes[size_t(priority)].deficit;
+    }
+
+    /** Get the number of ready connections in the given priority class */
+    size_t getQueueLength(Connection::Priority priority) const {
+        return classes[size_t(priority)].queue.size();
+    }
+
+    /** Get the weight for the given priority class */
+    static uint32_t getWeight(Connection::Priority priority);
+
+private:
+    struct Entry {
+        Connection* connection;
+        /** When the connection was scheduled */
+        hrtime_t scheduled;
+    };
+
+    struct PriorityClass {
+        PriorityClass()
+            : deficit(0) {
+        }
+
+        std::deque<Entry> queue;
+        /** The time (in ns) the class may spend before it has to yield */
+        int64_t deficit;
+        /** The time the connections spent in the queue before they ran */
+        TimingHistogram queueTimes;
+    };
+
+    std::array<PriorityClass, numClasses> classes;
+};
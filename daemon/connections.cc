@@ -16,6 +16,8 @@
  */
 
 #include "connections.h"
+#include "idle_connection_list.h"
+#include "mc_time.h"
 #include "runtime.h"
 #include "utilities/protocol2text.h"
 #include "settings.h"
@@ -46,9 +48,9 @@ enum class BufferLoan {
 
 /** Function prototypes ******************************************************/
 
-static BufferLoan conn_loan_single_buffer(McbpConnection *c, struct net_buf *thread_buf,
-                                             struct net_buf *conn_buf);
-static void conn_return_single_buffer(Connection *c, struct net_buf *thread_buf,
+static BufferLoan conn_loan_single_buffer(McbpConnection *c,
+                                          struct net_buf *conn_buf);
+static void conn_return_single_buffer(McbpConnection *c,
                                       struct net_buf *conn_buf);
 static void conn_destructor(Connection *c);
 static Connection *allocate_connection(SOCKET sfd,
@@ -86,6 +88,10 @@ int signal_idle_clients(LIBEVENT_THREAD *me, int bucket_idx, bool logging)
     return connected;
 }
 
+int compact_idle_clients(LIBEVENT_THREAD *me, rel_time_t idleSince) {
+    return me->idle_connections->compact(idleSince);
+}
+
 void assert_no_associations(int bucket_idx)
 {
     std::lock_guard<std::mutex> lock(connections.mutex);
@@ -154,6 +160,8 @@ void run_event_loop(Connection* c, short which) {
     c->runEventLoop(which);
     if (c->shouldDelete()) {
         release_connection(c);
+    } else if (c->isMigrationPending()) {
+        migrate_connection(c);
     }
 }
 
@@ -207,6 +215,10 @@ Connection* conn_new(const SOCKET sfd, in_port_t parent_port,
     associate_initial_bucket(c);
 
     c->setThread(thread);
+    auto* mcbp = dynamic_cast<McbpConnection*>(c);
+    if (mcbp != nullptr) {
+        mcbp->setLastCommandTime(mc_time_get_current_time());
+    }
     MEMCACHED_CONN_ALLOCATE(c->getId());
 
     if (settings.getVerbose() > 1) {
@@ -265,6 +277,9 @@ static void conn_cleanup(Connection *c) {
          */
         mcbpc->setTapIterator(nullptr);
         mcbpc->setDCP(false);
+        if (c->getThread() != nullptr) {
+            c->getThread()->idle_connections->remove(*mcbpc);
+        }
     }
     conn_return_buffers(c);
     if (mcbpc != nullptr) {
@@ -298,12 +313,13 @@ void conn_close(McbpConnection *c) {
     if (thread == nullptr) {
         throw std::logic_error("conn_close: unable to obtain non-NULL thread from connection");
     }
-    /* remove from pending-io list */
-    if (settings.getVerbose() > 1 && list_contains(thread->pending_io, c)) {
+    /* remove from pending-io queue */
+    if (settings.getVerbose() > 1 && c->isMpscLinked()) {
         LOG_WARNING(c,
-                    "Current connection was in the pending-io list.. Nuking it");
+                    "Current connection was in the pending-io queue.. Nuking it");
     }
-    thread->pending_io = list_remove(thread->pending_io, c);
+    remove_conn_from_pending_io_list(c);
+    unschedule_connection(c);
 
     conn_cleanup(c);
 
@@ -369,7 +385,7 @@ void conn_loan_buffers(Connection *connection) {
         return;
     }
 
-    auto res = conn_loan_single_buffer(c, &c->getThread()->read, &c->read);
+    auto res = conn_loan_single_buffer(c, &c->read);
     auto *ts = get_thread_stats(c);
     if (res == BufferLoan::Allocated) {
         ts->rbufs_allocated++;
@@ -379,7 +395,7 @@ void conn_loan_buffers(Connection *connection) {
         ts->rbufs_existing++;
     }
 
-    res = conn_loan_single_buffer(c, &c->getThread()->write, &c->write);
+    res = conn_loan_single_buffer(c, &c->write);
     if (res == BufferLoan::Allocated) {
         ts->wbufs_allocated++;
     } else if (res == BufferLoan::Loaned) {
@@ -409,8 +425,44 @@ void conn_return_buffers(Connection *connection) {
         return;
     }
 
-    conn_return_single_buffer(c, &thread->read, &c->read);
-    conn_return_single_buffer(c, &thread->write, &c->write);
+    conn_return_single_buffer(c, &c->read);
+    conn_return_single_buffer(c, &c->write);
+}
+
+/**
+ * Allocate a buffer from the threads buffer pool (see conn_alloc_buffer),
+ * and count the buffer pool hits and misses.
+ *
+ * @param hit set to true if the buffer was served from the pool
+ */
+static char* conn_alloc_buffer(McbpConnection* c, size_t& size, bool& hit) {
+    hit = false;
+    auto* pool = c->getThread()->buffer_pool;
+    if (pool == nullptr) {
+        return reinterpret_cast<char*>(cb_malloc(size));
+    }
+
+    char* ret = pool->allocate(size, hit);
+    if (hit) {
+        get_thread_stats(c)->bufpool_hits++;
+    } else {
+        get_thread_stats(c)->bufpool_misses++;
+    }
+    return ret;
+}
+
+char* conn_alloc_buffer(McbpConnection* c, size_t& size) {
+    bool hit;
+    return conn_alloc_buffer(c, size, hit);
+}
+
+void conn_release_buffer(McbpConnection* c, char* buf, size_t size) {
+    auto* pool = c->getThread()->buffer_pool;
+    if (pool == nullptr) {
+        cb_free(buf);
+    } else {
+        pool->release(buf, size);
+    }
 }
 
 /** Internal functions *******************************************************/
@@ -528,51 +580,46 @@ static void release_connection(Connection *c) {
 
 /**
  * If the connection doesn't already have a populated conn_buff, ensure that
- * it does by either loaning out the threads, or allocating a new one if
- * necessary.
+ * it does by getting one from the threads buffer pool (which allocates a
+ * new one if the pool is empty).
  */
-static BufferLoan conn_loan_single_buffer(McbpConnection *c, struct net_buf *thread_buf,
-                                    struct net_buf *conn_buf)
+static BufferLoan conn_loan_single_buffer(McbpConnection *c,
+                                          struct net_buf *conn_buf)
 {
     /* Already have a (partial) buffer - nothing to do. */
     if (conn_buf->buf != NULL) {
         return BufferLoan::Existing;
     }
 
-    if (thread_buf->buf != NULL) {
-        /* Loan thread's buffer to connection. */
-        *conn_buf = *thread_buf;
+    size_t size = DATA_BUFFER_SIZE;
+    bool hit;
+    conn_buf->buf = conn_alloc_buffer(c, size, hit);
 
-        thread_buf->buf = NULL;
-        thread_buf->size = 0;
-        return BufferLoan::Loaned;
-    } else {
-        /* Need to allocate a new buffer. */
-        conn_buf->buf = reinterpret_cast<char*>(cb_malloc(DATA_BUFFER_SIZE));
-        if (conn_buf->buf == NULL) {
-            /* Unable to alloc a buffer for the thread. Not much we can do here
-             * other than terminate the current connection.
-             */
-            if (settings.getVerbose()) {
-                LOG_WARNING(c,
-                            "%u: Failed to allocate new read buffer.. closing"
-                                " connection",
-                            c->getId());
-            }
-            c->setState(conn_closing);
-            return BufferLoan::Existing;
+    if (conn_buf->buf == NULL) {
+        /* Unable to alloc a buffer for the thread. Not much we can do here
+         * other than terminate the current connection.
+         */
+        if (settings.getVerbose()) {
+            LOG_WARNING(c,
+                        "%u: Failed to allocate new read buffer.. closing"
+                            " connection",
+                        c->getId());
         }
-        conn_buf->size = DATA_BUFFER_SIZE;
-        conn_buf->curr = conn_buf->buf;
-        conn_buf->bytes = 0;
-        return BufferLoan::Allocated;
+        c->setState(conn_closing);
+        return BufferLoan::Existing;
     }
+
+    conn_buf->size = uint32_t(size);
+    conn_buf->curr = conn_buf->buf;
+    conn_buf->bytes = 0;
+
+    return hit ? BufferLoan::Loaned : BufferLoan::Allocated;
 }
 
 /**
- * Return an empty read buffer back to the owning worker thread.
+ * Return an empty buffer back to the owning worker threads buffer pool.
  */
-static void conn_return_single_buffer(Connection *c, struct net_buf *thread_buf,
+static void conn_return_single_buffer(McbpConnection *c,
                                       struct net_buf *conn_buf) {
     if (conn_buf->buf == NULL) {
         /* No buffer - nothing to do. */
@@ -580,13 +627,8 @@ static void conn_return_single_buffer(Connection *c, struct net_buf *thread_buf,
     }
 
     if ((conn_buf->curr == conn_buf->buf) && (conn_buf->bytes == 0)) {
-        /* Buffer clean, dispose of it. */
-        if (thread_buf->buf == NULL) {
-            /* Give back to thread. */
-            *thread_buf = *conn_buf;
-        } else {
-            cb_free(conn_buf->buf);
-        }
+        /* Buffer clean, give it back to the thread */
+        conn_release_buffer(c, conn_buf->buf, conn_buf->size);
         conn_buf->buf = conn_buf->curr = NULL;
         conn_buf->size = 0;
     } else {
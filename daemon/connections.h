@@ -43,14 +43,14 @@ void run_event_loop(Connection* c, short which);
  * If the connection doesn't already have read/write buffers, ensure that it
  * does.
  *
- * In the common case, only one read/write buffer is created per worker thread,
- * and this buffer is loaned to the connection the worker is currently
- * handling. As long as the connection doesn't have a partial read/write (i.e.
- * the buffer is totally consumed) when it goes idle, the buffer is simply
- * returned back to the worker thread.
+ * The buffers are loaned from the worker threads buffer pool to the
+ * connection the worker is currently handling. As long as the connection
+ * doesn't have a partial read/write (i.e. the buffer is totally consumed)
+ * when it goes idle, the buffer is simply returned back to the pool.
  *
  * If there is a partial read/write, then the buffer is left loaned to that
- * connection and the worker thread will allocate a new one.
+ * connection and the pool will hand out another buffer (or allocate a new
+ * one if it's empty) to the next connection.
  */
 void conn_loan_buffers(Connection *c);
 
@@ -63,6 +63,22 @@ void conn_loan_buffers(Connection *c);
  */
 void conn_return_buffers(Connection *c);
 
+/**
+ * Get a buffer from the buffer pool of the connections worker thread.
+ *
+ * @param c the connection the buffer is used by
+ * @param size the minimum size of the buffer. Upon return it contains
+ *             the actual size of the buffer
+ * @return the buffer or nullptr if memory allocation failed
+ */
+char* conn_alloc_buffer(McbpConnection* c, size_t& size);
+
+/**
+ * Release a buffer (allocated with conn_alloc_buffer) back to the buffer
+ * pool of the connections worker thread.
+ */
+void conn_release_buffer(McbpConnection* c, char* buf, size_t size);
+
 /**
  * Cerate a new client connection
  *
@@ -136,6 +152,18 @@ void conn_cleanup_engine_allocations(McbpConnection * c);
  */
 int signal_idle_clients(LIBEVENT_THREAD *me, int bucket_idx, bool logging);
 
+/**
+ * Release the per-command memory for all of the clients bound to the
+ * thread represented by me which hasn't completed a command since
+ * idleSince (see McbpConnection::compactIfIdle). Only the connections
+ * at the head of the thread's IdleConnectionList are inspected.
+ *
+ * @param me the thread to inspect
+ * @param idleSince the time the connections must have been idle since
+ * @return the number of connections compacted
+ */
+int compact_idle_clients(LIBEVENT_THREAD *me, rel_time_t idleSince);
+
 /**
  * Assert that none of the connections is assciated with
  * the given bucket (debug function).
@@ -16,12 +16,17 @@
  */
 #pragma once
 
+#include <platform/platform.h>
 #include <stdexcept>
 
+#include "latency_breakdown.h"
+
 class Command;
 
 class Connection;
 
+class ParkedCommand;
+
 /**
  * The Cookie class represents the cookie passed from the memcached core
  * down through the engine interface to the engine.
@@ -39,12 +44,26 @@ public:
     Cookie(Command* cmd)
         : magic(0xdeadcafe),
           connection(nullptr),
-          command(cmd) { }
+          command(cmd),
+          parked(nullptr),
+          deadline(0),
+          ewouldblocks(0) { }
 
     Cookie(Connection* conn)
         : magic(0xdeadcafe),
           connection(conn),
-          command(nullptr) { }
+          command(nullptr),
+          parked(nullptr),
+          deadline(0),
+          ewouldblocks(0) { }
+
+    Cookie(Connection* conn, ParkedCommand* cmd)
+        : magic(0xdeadcafe),
+          connection(conn),
+          command(nullptr),
+          parked(cmd),
+          deadline(0),
+          ewouldblocks(0) { }
 
     void validate() const {
         if (magic != 0xdeadcafe) {
@@ -65,4 +84,29 @@ public:
     uint64_t magic;
     Connection* const connection;
     Command* const command;
+
+    /**
+     * Set if the cookie belongs to a command which may be parked on
+     * a connection using unordered execution (the connection member
+     * is set to the connection owning the command)
+     */
+    ParkedCommand* const parked;
+
+    /**
+     * The time (as returned from gethrtime()) the client gave up on the
+     * command it is currently executing, or 0 if the client didn't
+     * specify a deadline (see mcbp::Feature::DEADLINE).
+     */
+    hrtime_t deadline;
+
+    /**
+     * The number of times the current command returned EWOULDBLOCK
+     */
+    uint32_t ewouldblocks;
+
+    /**
+     * The time spent in each phase of the current command (only tracked
+     * when the latency_breakdown setting is enabled)
+     */
+    LatencyBreakdown latency;
 };
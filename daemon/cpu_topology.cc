@@ -0,0 +1,247 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "cpu_topology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * The maximum CPU number we accept (the size of a cpu_set_t on Linux)
+ */
+static const int max_cpu = 1024;
+
+static int parse_cpu(const std::string& list, const std::string& value) {
+    if (value.empty() ||
+        value.find_first_not_of("0123456789") != std::string::npos ||
+        value.size() > 4) {
+        throw std::invalid_argument("Invalid CPU list \"" + list + "\"");
+    }
+    const int cpu = std::stoi(value);
+    if (cpu >= max_cpu) {
+        throw std::invalid_argument("Invalid CPU list \"" + list +
+                                    "\": CPU numbers must be less than " +
+                                    std::to_string(max_cpu));
+    }
+    return cpu;
+}
+
+std::vector<int> cpu_list_parse(const std::string& list) {
+    std::vector<int> ret;
+    std::string::size_type start = 0;
+    while (start <= list.size()) {
+        auto end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string entry = list.substr(start, end - start);
+        // Allow (and ignore) the newline at the end of the sysfs files
+        entry.erase(std::remove_if(entry.begin(), entry.end(),
+                                   [](char c) { return isspace(c) != 0; }),
+                    entry.end());
+        if (entry.empty() && end == list.size() && start == 0) {
+            break;
+        }
+
+        const auto dash = entry.find('-');
+        if (dash == std::string::npos) {
+            ret.push_back(parse_cpu(list, entry));
+        } else {
+            const int first = parse_cpu(list, entry.substr(0, dash));
+            const int last = parse_cpu(list, entry.substr(dash + 1));
+            if (first > last) {
+                throw std::invalid_argument("Invalid CPU list \"" + list +
+                                            "\": invalid range");
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                ret.push_back(cpu);
+            }
+        }
+        start = end + 1;
+    }
+
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+    return ret;
+}
+
+std::string cpu_list_to_string(const std::vector<int>& cpus) {
+    std::string ret;
+    size_t ii = 0;
+    while (ii < cpus.size()) {
+        // Collapse consecutive CPUs into a range
+        size_t last = ii;
+        while (last + 1 < cpus.size() && cpus[last + 1] == cpus[last] + 1) {
+            ++last;
+        }
+        if (!ret.empty()) {
+            ret.push_back(',');
+        }
+        ret.append(std::to_string(cpus[ii]));
+        if (last != ii) {
+            ret.push_back('-');
+            ret.append(std::to_string(cpus[last]));
+        }
+        ii = last + 1;
+    }
+    return ret;
+}
+
+static std::vector<int> process_cpus;
+
+void cpu_affinity_capture_process() {
+    process_cpus = cpu_affinity_get_current_thread();
+}
+
+const std::vector<int>& cpu_affinity_get_process() {
+    return process_cpus;
+}
+
+std::vector<int> cpu_affinity_get_current_thread() {
+    std::vector<int> ret;
+#ifdef __linux__
+    cpu_set_t set;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                ret.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return ret;
+}
+
+int cpu_affinity_set_current_thread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    // The thread may have inherited the binding of the thread which
+    // created it, so an empty list restores the CPUs of the process
+    const auto& list = cpus.empty() ? process_cpus : cpus;
+    if (list.empty()) {
+        return EINVAL;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : list) {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    return ENOTSUP;
+#endif
+}
+
+/**
+ * Read a CPU list from the given file
+ *
+ * @return the list, or an empty list if the file can't be read (or parsed)
+ */
+static std::vector<int> read_cpu_list(const std::string& fname) {
+    std::ifstream file(fname);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line)) {
+        return {};
+    }
+
+    try {
+        return cpu_list_parse(line);
+    } catch (const std::invalid_argument&) {
+        return {};
+    }
+}
+
+static std::vector<CpuTopology::Node> read_topology() {
+    std::vector<CpuTopology::Node> nodes;
+#ifdef __linux__
+    const std::string root("/sys/devices/system/node/");
+    for (const auto id : read_cpu_list(root + "online")) {
+        auto cpus = read_cpu_list(root + "node" + std::to_string(id) +
+                                  "/cpulist");
+        if (!cpus.empty()) {
+            nodes.push_back({id, std::move(cpus)});
+        }
+    }
+#endif
+
+    if (nodes.empty()) {
+        // No NUMA information available; put all of the CPUs in node 0
+        std::vector<int> cpus;
+        const int count = std::max(1, int(std::thread::hardware_concurrency()));
+        for (int cpu = 0; cpu < count; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        nodes.push_back({0, std::move(cpus)});
+    }
+    return nodes;
+}
+
+const CpuTopology& CpuTopology::getInstance() {
+    static CpuTopology instance(read_topology());
+    return instance;
+}
+
+int CpuTopology::getNode(int cpu) const {
+    for (const auto& node : nodes) {
+        if (std::binary_search(node.cpus.begin(), node.cpus.end(), cpu)) {
+            return node.id;
+        }
+    }
+    return -1;
+}
+
+std::vector<int> CpuTopology::getThreadCpus(const std::vector<int>& cpus,
+                                            bool numa,
+                                            size_t index,
+                                            int& node) const {
+    node = -1;
+    if (!numa) {
+        return cpus;
+    }
+
+    std::vector<Node> groups;
+    for (const auto& n : nodes) {
+        Node group{n.id, {}};
+        for (const auto cpu : n.cpus) {
+            if (cpus.empty() ||
+                std::binary_search(cpus.begin(), cpus.end(), cpu)) {
+                group.cpus.push_back(cpu);
+            }
+        }
+        if (!group.cpus.empty()) {
+            groups.emplace_back(std::move(group));
+        }
+    }
+
+    if (groups.empty()) {
+        // None of the CPUs belong to a known node
+        return cpus;
+    }
+
+    auto& group = groups[index % groups.size()];
+    node = group.id;
+    return std::move(group.cpus);
+}
@@ -0,0 +1,129 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Parse a list of CPUs in the format used by Linux (for instance in
+ * /sys/devices/system/node/node0/cpulist), ex: "0-3,8,10-11".
+ *
+ * @param list the list to parse
+ * @return the CPUs in the list (sorted, without duplicates)
+ * @throws std::invalid_argument if the list can't be parsed
+ */
+std::vector<int> cpu_list_parse(const std::string& list);
+
+/**
+ * Format the CPUs as a list in the format accepted by cpu_list_parse
+ */
+std::string cpu_list_to_string(const std::vector<int>& cpus);
+
+/**
+ * Record the CPUs the process may run on. It must be called from the main
+ * thread before it binds itself (or any other thread) to the CPUs of a
+ * class of threads, as the threads without any configured CPUs are bound
+ * back to the CPUs recorded here.
+ */
+void cpu_affinity_capture_process();
+
+/**
+ * Get the CPUs recorded by cpu_affinity_capture_process
+ *
+ * @return the CPUs, or an empty list if they haven't been recorded (or
+ *         binding isn't supported on this platform)
+ */
+const std::vector<int>& cpu_affinity_get_process();
+
+/**
+ * Get the CPUs the calling thread may run on
+ *
+ * @return the CPUs, or an empty list if binding isn't supported on this
+ *         platform
+ */
+std::vector<int> cpu_affinity_get_current_thread();
+
+/**
+ * Bind the calling thread to the CPUs
+ *
+ * @param cpus the CPUs to bind the thread to. An empty list binds the
+ *             thread to the CPUs of the process
+ * @return 0 on success, an error code otherwise
+ */
+int cpu_affinity_set_current_thread(const std::vector<int>& cpus);
+
+/**
+ * The CpuTopology describes the NUMA nodes of the machine and the CPUs
+ * belonging to each of them. On platforms where we can't read the
+ * topology (and on machines without NUMA) all of the CPUs belong to
+ * node 0.
+ */
+class CpuTopology {
+public:
+    struct Node {
+        int id;
+        std::vector<int> cpus;
+    };
+
+    CpuTopology(std::vector<Node> nodes)
+        : nodes(std::move(nodes)) {
+    }
+
+    /**
+     * Get the topology of this machine (it is read the first time this
+     * method is called)
+     */
+    static const CpuTopology& getInstance();
+
+    const std::vector<Node>& getNodes() const {
+        return nodes;
+    }
+
+    /**
+     * Get the node the CPU belongs to
+     *
+     * @return the id of the node or -1 if the CPU isn't known
+     */
+    int getNode(int cpu) const;
+
+    /**
+     * Get the CPUs one of the threads in a pool of threads should be
+     * bound to.
+     *
+     * When the threads are bound to nodes the CPUs the pool may use are
+     * grouped by node, and thread n is bound to the CPUs in group
+     * (n % the number of groups). This spreads the threads evenly across
+     * the nodes, and all of the memory a thread use may be allocated
+     * from its own node.
+     *
+     * @param cpus the CPUs the pool may use (empty means all of them)
+     * @param numa should the threads be bound to nodes
+     * @param index the index of the thread in the pool
+     * @param node set to the node the thread is bound to (or -1)
+     * @return the CPUs the thread should be bound to (empty means that
+     *         the thread shouldn't be bound)
+     */
+    std::vector<int> getThreadCpus(const std::vector<int>& cpus,
+                                   bool numa,
+                                   size_t index,
+                                   int& node) const;
+
+private:
+    std::vector<Node> nodes;
+};
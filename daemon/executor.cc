@@ -16,19 +16,29 @@
  */
 
 #include "executor.h"
+#include "executorpool.h"
 #include "task.h"
 
 #include <iostream>
 
 Executor::~Executor() {
-    std::unique_lock<std::mutex> lock(mutex);
+    requestShutdown();
+    waitForShutdown();
+    waitForState(Couchbase::ThreadState::Zombie);
+}
+
+void Executor::requestShutdown() {
+    std::lock_guard<std::mutex> guard(mutex);
     shutdown = true;
     idlecond.notify_all();
+}
+
+void Executor::waitForShutdown() {
+    std::unique_lock<std::mutex> lock(mutex);
     // Wait until the thread stops
     while (running) {
         shutdowncond.wait(lock);
     }
-    waitForState(Couchbase::ThreadState::Zombie);
 }
 
 void Executor::run() {
@@ -38,24 +48,57 @@ void Executor::run() {
     setRunning();
 
     while (true) {
+        std::shared_ptr<Task> task;
         std::unique_lock<std::mutex> lock(mutex);
-        while (!shutdown && runq.empty()) {
-            idlecond.wait(lock);
+        while (!shutdown) {
+            moveExpiredTasks();
+            task = dequeue();
+            if (task) {
+                break;
+            }
+
+            // Nothing to do; try to help one of the other executors. Tasks
+            // scheduled after we read the generation wake us up (or make
+            // us retry) so we won't go to sleep with runnable tasks in the
+            // pool.
+            const auto generation = pool.getGeneration();
+            lock.unlock();
+            task = pool.steal(*this);
+            lock.lock();
+            if (task) {
+                break;
+            }
+
+            if (hasRunnableTasks()) {
+                // Someone scheduled a task while we tried to steal one
+                continue;
+            }
+
+            idle = true;
+            if (!shutdown && generation == pool.getGeneration()) {
+                if (timerq.empty()) {
+                    idlecond.wait(lock);
+                } else {
+                    idlecond.wait_until(lock, timerq.begin()->first);
+                }
+            }
+            idle = false;
         }
 
         if (shutdown) {
+            // Tasks left in the run queue are dropped (as are the ones we
+            // may have stolen while shutting down)
             break;
         }
 
-        auto task = runq.front();
-        runq.pop();
-
         // Release the lock so that others may schedule new events
         lock.unlock();
 
         // Lock the task so no one else can touch it and we won't
         // have any races..
         task->getMutex().lock();
+        task->setExecutor(this);
+        pool.taskStarted(*task);
         if (task->execute()) {
             // Unlock the mutex, we're not going to use this anymore
             // By not holding the mutex in notifyExecutionComplete
@@ -91,18 +134,60 @@ void Executor::run() {
     shutdowncond.notify_all();
 }
 
+void Executor::enqueue(const std::shared_ptr<Task>& task) {
+    pool.taskQueued(*task);
+    runq[size_t(task->getPriority())].push_back(task);
+}
+
+bool Executor::hasRunnableTasks() const {
+    for (const auto& queue : runq) {
+        if (!queue.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<Task> Executor::dequeue() {
+    for (auto& queue : runq) {
+        if (!queue.empty()) {
+            auto task = queue.front();
+            queue.pop_front();
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void Executor::moveExpiredTasks() {
+    const auto now = std::chrono::steady_clock::now();
+    while (!timerq.empty() && timerq.begin()->first <= now) {
+        enqueue(timerq.begin()->second);
+        timerq.erase(timerq.begin());
+    }
+}
+
 void Executor::schedule(const std::shared_ptr<Task>& task, bool runnable) {
     std::lock_guard<std::mutex> guard(mutex);
     task->setExecutor(this);
 
     if (runnable) {
-        runq.push(task);
+        enqueue(task);
         idlecond.notify_all();
     } else {
         waitq[task.get()] = task;
     }
 }
 
+void Executor::scheduleAt(const std::shared_ptr<Task>& task,
+                          std::chrono::steady_clock::time_point deadline) {
+    std::lock_guard<std::mutex> guard(mutex);
+    task->setExecutor(this);
+    timerq.emplace(deadline, task);
+    // Let the executor recalculate the time it may sleep
+    idlecond.notify_all();
+}
+
 void Executor::makeRunnable(Task* task) {
     if (task->getMutex().try_lock()) {
         task->getMutex().unlock();
@@ -110,18 +195,48 @@ void Executor::makeRunnable(Task* task) {
             "The mutex should be held when trying to reschedule a event");
     }
 
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto iter = waitq.find(task);
+        if (iter == waitq.end()) {
+            throw std::runtime_error(
+                "Internal error object is not in the waitq");
+        }
+        enqueue(iter->second);
+        waitq.erase(iter);
+        idlecond.notify_all();
+    }
+
+    // We might be busy running another task
+    pool.notifyRunnable();
+}
+
+std::shared_ptr<Task> Executor::steal() {
     std::lock_guard<std::mutex> guard(mutex);
-    auto iter = waitq.find(task);
-    if (iter == waitq.end()) {
-        throw std::runtime_error("Internal error object is not in the waitq");
+    if (shutdown) {
+        return nullptr;
     }
-    runq.push(iter->second);
-    waitq.erase(iter);
-    idlecond.notify_all();
+
+    // The owner may be busy running a task, so the delayed tasks may
+    // be stolen as well once they're due
+    moveExpiredTasks();
+    for (auto& queue : runq) {
+        if (!queue.empty()) {
+            auto task = queue.back();
+            queue.pop_back();
+            return task;
+        }
+    }
+    return nullptr;
 }
 
-std::unique_ptr<Executor> createWorker() {
-    auto *executor = new Executor;
-    executor->start();
-    return std::unique_ptr<Executor>(executor);
+bool Executor::wakeIfIdle() {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (!idle) {
+        return false;
+    }
+    // Clear the flag so that the next notification picks another executor
+    idle = false;
+    idlecond.notify_all();
+    return true;
 }
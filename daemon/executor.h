@@ -16,33 +16,47 @@
  */
 #pragma once
 
+#include "task.h"
+
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <map>
 #include <memory>
 #include <platform/platform.h>
 #include <platform/thread.h>
-#include <queue>
 #include <unordered_map>
 
 /**
- * Forward decl of the Task to avoid circular dependencies
+ * Forward decl of the ExecutorPool to avoid circular dependencies
  */
-class Task;
+class ExecutorPool;
 
 /**
  * The Executor class represents a single executor thread. It keeps
- * working on items in the runq and whenever a request can't be completed
- * it is put on the waitq until someone makes the object runnable by calling
- * makeRunnable (NOTE: you should hold the command's lock when calling that),
- * and it is NOT allowed to call it from any of the executors threads (that
- * may create deadlock)
+ * working on items in the runq (the tasks with the highest priority
+ * first) and whenever a request can't be completed it is put on the waitq
+ * until someone makes the object runnable by calling makeRunnable (NOTE:
+ * you should hold the command's lock when calling that), and it is NOT
+ * allowed to call it from any of the executors threads (that may create
+ * deadlock).
+ *
+ * When the executor runs out of tasks it tries to steal a runnable task
+ * from the other executors in the pool before it goes to sleep.
  */
 class Executor : public Couchbase::Thread {
 public:
     /**
      * Initialize the Executor object
+     *
+     * @param pool the pool the executor belongs to
      */
-    Executor() : Couchbase::Thread("mc:executor") {
+    Executor(ExecutorPool& pool)
+        : Couchbase::Thread("mc:executor"),
+          pool(pool),
+          idle(false) {
         shutdown.store(false);
         running.store(false);
     }
@@ -54,19 +68,83 @@ public:
      */
     virtual ~Executor();
 
+    /**
+     * Ask the executor thread to stop (once the tasks in the wait queue
+     * are completed)
+     */
+    void requestShutdown();
+
+    /**
+     * Wait for the executor thread to stop. Once it returns the thread
+     * won't touch any of the other executors in the pool.
+     */
+    void waitForShutdown();
+
     /**
      * Schedule a task for execution at some time
      */
     void schedule(const std::shared_ptr<Task>& command, bool runnable);
 
+    /**
+     * Schedule a task to be run once the deadline is passed
+     */
+    void scheduleAt(const std::shared_ptr<Task>& task,
+                    std::chrono::steady_clock::time_point deadline);
+
     /**
      * Make the task runnable
      */
     void makeRunnable(Task* task);
 
+    /**
+     * Remove a runnable task from the run queue so that another
+     * (idle) executor may run it. The task with the highest priority
+     * which was queued most recently is taken (it is the one with
+     * the least chance of being run by this executor soon).
+     *
+     * @return the task or nullptr if no task is runnable
+     */
+    std::shared_ptr<Task> steal();
+
+    /**
+     * Wake up the executor if it is idle (so that it may try to steal
+     * a task from the other executors)
+     *
+     * @return true if the executor was idle
+     */
+    bool wakeIfIdle();
+
 protected:
     virtual void run() override;
 
+    /**
+     * Put the task in the run queue. The mutex must be held.
+     */
+    void enqueue(const std::shared_ptr<Task>& task);
+
+    /**
+     * Get the next task to run from the run queue. The mutex must be held.
+     *
+     * @return the task or nullptr if no task is runnable
+     */
+    std::shared_ptr<Task> dequeue();
+
+    /**
+     * Check if there is any tasks in the run queue. The mutex must be held.
+     */
+    bool hasRunnableTasks() const;
+
+    /**
+     * Move the delayed tasks whose deadline is passed to the run queue.
+     * The mutex must be held.
+     */
+    void moveExpiredTasks();
+
+    /**
+     * The pool this executor belongs to
+     */
+    ExecutorPool& pool;
+
     /**
      * Is shutdown requested?
      */
@@ -85,9 +163,16 @@ protected:
     std::mutex mutex;
 
     /**
-     * The FIFO queue of commands ready to run
+     * The FIFO queues (one per priority) of commands ready to run
+     */
+    std::array<std::deque<std::shared_ptr<Task> >, 3> runq;
+
+    /**
+     * The tasks scheduled to run at a later time, ordered by their
+     * deadline
      */
-    std::queue<std::shared_ptr<Task> > runq;
+    std::multimap<std::chrono::steady_clock::time_point,
+                  std::shared_ptr<Task> > timerq;
 
     /**
      * When a task is being served by a backend thread it is put in
@@ -105,11 +190,15 @@ protected:
      */
     std::condition_variable idlecond;
 
+    /**
+     * Set while the executor is blocked on idlecond without anything to
+     * run (protected by the mutex)
+     */
+    bool idle;
+
     /**
      * The destructor blocks on this condition variable while waiting for the
      * thread to shut down.
      */
     std::condition_variable shutdowncond;
 };
-
-std::unique_ptr<Executor> createWorker();
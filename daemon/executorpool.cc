@@ -23,19 +23,103 @@
 #include <string>
 
 ExecutorPool::ExecutorPool(size_t sz) {
+    stolen.store(0);
+    generation.store(0);
     roundRobin.store(0);
     executors.reserve(sz);
     for (size_t ii = 0; ii < sz; ++ii) {
-        executors.emplace_back(createWorker());
+        executors.emplace_back(new Executor(*this));
+    }
+
+    // Don't start the threads before the list is complete as they'll
+    // start looking for tasks to steal right away
+    for (auto& executor : executors) {
+        executor->start();
     }
 }
 
-void ExecutorPool::schedule(std::shared_ptr<Task>& task, bool runnable) {
-    if (task->getMutex().try_lock()) {
-        task->getMutex().unlock();
+ExecutorPool::~ExecutorPool() {
+    // The executors may steal tasks from each other, so all of them
+    // must be stopped before we may delete any of them
+    for (auto& executor : executors) {
+        executor->requestShutdown();
+    }
+    for (auto& executor : executors) {
+        executor->waitForShutdown();
+    }
+    executors.clear();
+}
+
+void ExecutorPool::verifyLocked(Task& task) {
+    if (task.getMutex().try_lock()) {
+        task.getMutex().unlock();
         throw std::logic_error(
             "The mutex should be held when trying to schedule a event");
     }
+}
+
+void ExecutorPool::schedule(std::shared_ptr<Task>& task, bool runnable) {
+    verifyLocked(*task);
 
     executors[++roundRobin % executors.size()]->schedule(task, runnable);
+    if (runnable) {
+        notifyRunnable();
+    }
+}
+
+void ExecutorPool::scheduleAfter(std::shared_ptr<Task>& task,
+                                 std::chrono::steady_clock::duration delay) {
+    verifyLocked(*task);
+
+    executors[++roundRobin % executors.size()]->scheduleAt(
+        task, std::chrono::steady_clock::now() + delay);
+}
+
+std::shared_ptr<Task> ExecutorPool::steal(Executor& thief) {
+    // Start at a different executor every time so that we don't keep
+    // on hammering the first one
+    const size_t start = size_t(++roundRobin);
+    for (size_t ii = 0; ii < executors.size(); ++ii) {
+        auto& victim = executors[(start + ii) % executors.size()];
+        if (victim.get() == &thief) {
+            continue;
+        }
+        auto task = victim->steal();
+        if (task) {
+            ++stolen;
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void ExecutorPool::notifyRunnable() {
+    ++generation;
+    for (auto& executor : executors) {
+        if (executor->wakeIfIdle()) {
+            // One idle executor is enough to pick up the task
+            return;
+        }
+    }
+}
+
+void ExecutorPool::taskQueued(Task& task) {
+    task.queued = gethrtime();
+    std::lock_guard<std::mutex> guard(statsMutex);
+    auto& stats = taskStats[task.getName()];
+    ++stats.scheduled;
+    ++stats.queued;
+}
+
+void ExecutorPool::taskStarted(Task& task) {
+    const auto now = gethrtime();
+    std::lock_guard<std::mutex> guard(statsMutex);
+    auto& stats = taskStats[task.getName()];
+    --stats.queued;
+    stats.waitTimes.add(now - task.queued);
+}
+
+std::map<std::string, ExecutorPool::TaskStats> ExecutorPool::getTaskStats() {
+    std::lock_guard<std::mutex> guard(statsMutex);
+    return taskStats;
 }
@@ -17,18 +17,41 @@
 #pragma once
 
 #include "executor.h"
+#include "timing_histogram.h"
 
+#include <chrono>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 /**
  * As the name implies the ExecutorPool is pool of executors to execute
- * tasks. A task is pinned to a thread when it is being scheduled
- * (by using round robin) and never switch the thread.
+ * tasks. A task is assigned to a thread when it is being scheduled
+ * (by using round robin), but an executor which runs out of work steals
+ * the runnable tasks from the other executors so that a slow task
+ * doesn't hold back the tasks queued behind it.
  */
 class ExecutorPool {
 public:
+    /**
+     * The statistics kept for each type of task (see Task::getName())
+     */
+    struct TaskStats {
+        TaskStats()
+            : scheduled(0),
+              queued(0) {
+        }
+
+        /** The number of times a task was put in the run queue */
+        uint64_t scheduled;
+        /** The number of tasks currently waiting in the run queues */
+        uint64_t queued;
+        /** The time the tasks waited in the run queue */
+        TimingHistogram waitTimes;
+    };
+
     /**
      * Create an executor pool with a given number of worker threads
      */
@@ -36,6 +59,8 @@ public:
 
     ExecutorPool(const ExecutorPool &) = delete;
 
+    ~ExecutorPool();
+
     /**
      * Schedule a task for execution at some time. The tasks mutex
      * must be held while calling this method to avoid race conditions.
@@ -46,15 +71,100 @@ public:
      */
     void schedule(std::shared_ptr<Task>& task, bool runnable = true);
 
+    /**
+     * Schedule a task for execution once the delay has passed. The tasks
+     * mutex must be held while calling this method.
+     *
+     * @param task the task to execute
+     * @param delay the time to wait before the task is runnable
+     */
+    void scheduleAfter(std::shared_ptr<Task>& task,
+                       std::chrono::steady_clock::duration delay);
+
+    /**
+     * Get a snapshot of the statistics for each type of task
+     */
+    std::map<std::string, TaskStats> getTaskStats();
+
+    /**
+     * Get the number of tasks stolen by an idle executor
+     */
+    uint64_t getStolenTasks() const {
+        return stolen.load();
+    }
+
+    size_t size() const {
+        return executors.size();
+    }
+
+    /**
+     * Steal a runnable task from one of the other executors (called by
+     * an executor without any runnable tasks)
+     *
+     * @param thief the executor looking for work
+     * @return the task or nullptr if no task is runnable
+     */
+    std::shared_ptr<Task> steal(Executor& thief);
+
+    /**
+     * Wake up an idle executor (if any) as a task was made runnable.
+     */
+    void notifyRunnable();
+
+    /**
+     * Get the generation counter which is incremented every time a task
+     * is made runnable. An executor reads it before it looks for work
+     * and doesn't go to sleep if it changed.
+     */
+    uint64_t getGeneration() const {
+        return generation.load();
+    }
+
+    /**
+     * Update the statistics when the task is put in a run queue
+     */
+    void taskQueued(Task& task);
+
+    /**
+     * Update the statistics when an executor starts running the task
+     */
+    void taskStarted(Task& task);
+
 private:
     /**
-     * The actual list of executors
+     * Verify that the caller holds the tasks mutex
      */
-    std::vector< std::unique_ptr<Executor> > executors;
+    void verifyLocked(Task& task);
+
+    /**
+     * The mutex protecting the task statistics
+     */
+    std::mutex statsMutex;
+
+    /**
+     * The statistics per type of task
+     */
+    std::map<std::string, TaskStats> taskStats;
+
+    /**
+     * The number of tasks stolen by an idle executor
+     */
+    std::atomic<uint64_t> stolen;
+
+    /**
+     * Incremented every time a task is made runnable
+     */
+    std::atomic<uint64_t> generation;
 
     /**
      * We'll be using round robin to distribute the tasks to the
      * worker threads
      */
     std::atomic_int roundRobin;
+
+    /**
+     * The actual list of executors (declared last so that the executors
+     * are stopped before the rest of the pool is torn down)
+     */
+    std::vector< std::unique_ptr<Executor> > executors;
 };
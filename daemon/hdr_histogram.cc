@@ -0,0 +1,135 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "hdr_histogram.h"
+
+#include <cmath>
+
+HdrHistogram::HdrHistogram() {
+    reset();
+}
+
+HdrHistogram::HdrHistogram(const HdrHistogram& other) {
+    reset();
+    *this += other;
+}
+
+HdrHistogram& HdrHistogram::operator=(const HdrHistogram& other) {
+    if (this != &other) {
+        reset();
+        *this += other;
+    }
+    return *this;
+}
+
+HdrHistogram& HdrHistogram::operator+=(const HdrHistogram& other) {
+    for (size_t ii = 0; ii < NumBuckets; ++ii) {
+        const uint64_t count = other.counts[ii];
+        if (count != 0) {
+            counts[ii] += count;
+        }
+    }
+    total += other.total.load();
+    max.setIfGreater(other.max.load());
+    return *this;
+}
+
+void HdrHistogram::reset() {
+    for (auto& count : counts) {
+        count.reset();
+    }
+    total.reset();
+    max.reset();
+}
+
+/**
+ * Get the index of the most significant bit set in the value
+ */
+static unsigned int get_msb(uint64_t value) {
+    unsigned int ret = 0;
+    while (value >>= 1) {
+        ++ret;
+    }
+    return ret;
+}
+
+size_t HdrHistogram::getIndex(hrtime_t value) {
+    if (value < SubBucketCount) {
+        return size_t(value);
+    }
+
+    // Shift the value so that it fits in the upper half of the sub-buckets
+    // [SubBucketHalfCount, SubBucketCount), and use the shift to select
+    // the group of sub-buckets
+    const auto shift = get_msb(value) - (SubBucketBits - 1);
+    const auto index = shift * SubBucketHalfCount + (value >> shift);
+    if (index >= NumBuckets) {
+        return NumBuckets - 1;
+    }
+    return size_t(index);
+}
+
+hrtime_t HdrHistogram::getLowestValue(size_t index) {
+    if (index < SubBucketCount) {
+        return hrtime_t(index);
+    }
+    const auto shift = index / SubBucketHalfCount - 1;
+    const auto mantissa = index % SubBucketHalfCount + SubBucketHalfCount;
+    return hrtime_t(mantissa) << shift;
+}
+
+hrtime_t HdrHistogram::getHighestValue(size_t index) {
+    if (index < SubBucketCount) {
+        return hrtime_t(index);
+    }
+    const auto shift = index / SubBucketHalfCount - 1;
+    const auto mantissa = index % SubBucketHalfCount + SubBucketHalfCount;
+    return ((hrtime_t(mantissa) + 1) << shift) - 1;
+}
+
+hrtime_t HdrHistogram::getValueAtPercentile(double percentile) const {
+    const uint64_t samples = total;
+    if (samples == 0) {
+        return 0;
+    }
+
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    const auto wanted = std::max(
+            uint64_t(1),
+            uint64_t(std::ceil(percentile / 100.0 * double(samples))));
+
+    const hrtime_t highest = max;
+    uint64_t seen = 0;
+    for (size_t ii = 0; ii < NumBuckets; ++ii) {
+        seen += counts[ii];
+        if (seen >= wanted) {
+            return std::min(getHighestValue(ii), highest);
+        }
+    }
+
+    // The buckets may be updated while we look at them
+    return highest;
+}
+
+void HdrHistogram::forEachBucket(
+        std::function<void(hrtime_t, hrtime_t, uint64_t)> callback) const {
+    for (size_t ii = 0; ii < NumBuckets; ++ii) {
+        const uint64_t count = counts[ii];
+        if (count != 0) {
+            callback(getLowestValue(ii), getHighestValue(ii), count);
+        }
+    }
+}
@@ -0,0 +1,111 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/platform.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <relaxed_atomic.h>
+
+/**
+ * HdrHistogram is a log-linear histogram (in the spirit of the
+ * HdrHistogram by Gil Tene) used to record the time spent on operations
+ * with nanosecond resolution.
+ *
+ * The values are grouped by their most significant bit, and each group
+ * is split into 32 linear sub-buckets. The value reported for a bucket
+ * is therefore within ~3% of the recorded values across the entire
+ * range. Values above the range (~68 seconds) are counted in the last
+ * bucket (the exact max value is tracked separately).
+ *
+ * Recording a value is a couple of relaxed atomic increments, so an
+ * instance should only be updated by a single thread (or a few) to avoid
+ * cache line bouncing. Merge the instances with operator+= when reading
+ * them.
+ */
+class HdrHistogram {
+public:
+    /** The number of sub-buckets for the values below 2^SubBucketBits */
+    static const unsigned int SubBucketBits = 6;
+    static const uint64_t SubBucketCount = 1 << SubBucketBits;
+    static const uint64_t SubBucketHalfCount = SubBucketCount / 2;
+    /** The highest value tracked with full precision is 2^MaxValueBits-1 */
+    static const unsigned int MaxValueBits = 36;
+    static const size_t NumBuckets =
+            SubBucketCount + (MaxValueBits - SubBucketBits) *
+                                     SubBucketHalfCount;
+
+    HdrHistogram();
+    HdrHistogram(const HdrHistogram& other);
+    HdrHistogram& operator=(const HdrHistogram& other);
+
+    /**
+     * As with TimingHistogram the result isn't 100% consistent if the
+     * other histogram is updated while we merge it
+     */
+    HdrHistogram& operator+=(const HdrHistogram& other);
+
+    void reset();
+
+    void add(hrtime_t nsec) {
+        counts[getIndex(nsec)]++;
+        total++;
+        max.setIfGreater(nsec);
+    }
+
+    uint64_t getTotal() const {
+        return total;
+    }
+
+    hrtime_t getMax() const {
+        return max;
+    }
+
+    /**
+     * Get the value (in ns) at the given percentile, ie. the highest
+     * value in the bucket holding the sample at the percentile (but never
+     * higher than the max value recorded)
+     *
+     * @param percentile the percentile (0-100)
+     * @return the value or 0 if the histogram is empty
+     */
+    hrtime_t getValueAtPercentile(double percentile) const;
+
+    /**
+     * Call the callback for each bucket with a non-zero count
+     *
+     * @param callback called with the lowest and highest value in
+     *                 the bucket and the count
+     */
+    void forEachBucket(
+            std::function<void(hrtime_t, hrtime_t, uint64_t)> callback) const;
+
+    /** Get the index of the bucket the value belongs to */
+    static size_t getIndex(hrtime_t value);
+
+    /** Get the lowest value belonging to the bucket */
+    static hrtime_t getLowestValue(size_t index);
+
+    /** Get the highest value belonging to the bucket */
+    static hrtime_t getHighestValue(size_t index);
+
+private:
+    std::array<Couchbase::RelaxedAtomic<uint64_t>, NumBuckets> counts;
+    Couchbase::RelaxedAtomic<uint64_t> total;
+    Couchbase::RelaxedAtomic<hrtime_t> max;
+};
@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "connection_mcbp.h"
+
+/**
+ * The connections bound to a worker thread ordered by the time they
+ * completed their last command (the connection idle for the longest time
+ * first). The thread only needs to look at the head of the list to find
+ * the connections to compact, instead of walking all of the connections
+ * in the system.
+ *
+ * The list is intrusive (the links live in McbpConnection) so that
+ * moving a connection to the tail is O(1) and doesn't allocate memory.
+ * It may only be accessed by the worker thread owning it.
+ */
+class IdleConnectionList {
+public:
+    IdleConnectionList()
+        : head(nullptr),
+          tail(nullptr) {
+    }
+
+    /**
+     * Move the connection to the tail of the list (it just completed a
+     * command, or was just bound to the thread)
+     */
+    void touch(McbpConnection& c) {
+        remove(c);
+        c.idlePrev = tail;
+        c.idleNext = nullptr;
+        if (tail == nullptr) {
+            head = &c;
+        } else {
+            tail->idleNext = &c;
+        }
+        tail = &c;
+        c.idleLinked = true;
+    }
+
+    /**
+     * Remove the connection from the list (if present)
+     */
+    void remove(McbpConnection& c) {
+        if (!c.idleLinked) {
+            return;
+        }
+
+        if (c.idlePrev == nullptr) {
+            head = c.idleNext;
+        } else {
+            c.idlePrev->idleNext = c.idleNext;
+        }
+        if (c.idleNext == nullptr) {
+            tail = c.idlePrev;
+        } else {
+            c.idleNext->idlePrev = c.idlePrev;
+        }
+        c.idlePrev = c.idleNext = nullptr;
+        c.idleLinked = false;
+    }
+
+    /**
+     * Compact the connections which hasn't completed a command since
+     * idleSince. The connections are removed from the list as they're
+     * inspected (whether or not they could be compacted) and put back
+     * the next time they complete a command, so every connection is only
+     * inspected once per command.
+     *
+     * @return the number of connections compacted
+     */
+    int compact(rel_time_t idleSince) {
+        int compacted = 0;
+        while (head != nullptr && head->getLastCommandTime() <= idleSince) {
+            auto* c = head;
+            remove(*c);
+            if (c->compactIfIdle(idleSince)) {
+                ++compacted;
+            }
+        }
+        return compacted;
+    }
+
+private:
+    McbpConnection* head;
+    McbpConnection* tail;
+};
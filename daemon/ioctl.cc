@@ -19,10 +19,14 @@
 
 #include "config.h"
 #include "alloc_hooks.h"
+#include "buckets.h"
 #include "connections.h"
 #include "utilities/string_utilities.h"
 #include "tracing.h"
 
+#include <limits>
+#include <memcached/util.h>
+
 /*
  * Implement ioctl-style memcached commands (ioctl_get / ioctl_set).
  */
@@ -67,10 +71,111 @@ static ENGINE_ERROR_CODE setTraceConnection(Connection* c,
     return apply_connection_trace_mask(id->second, value);
 }
 
+/**
+ * Locate the bucket to operate on for the ratelimit.* properties. The
+ * bucket is specified with the "bucket" argument, and defaults to the
+ * bucket the connection is connected to.
+ *
+ * @return the bucket or nullptr if it doesn't exist
+ */
+static Bucket* getRateLimitedBucket(Connection* c,
+                                    const StrToStrMap& arguments) {
+    auto name = arguments.find("bucket");
+    if (name == arguments.end()) {
+        const auto index = c->getBucketIndex();
+        return index == 0 ? nullptr : &all_buckets[index];
+    }
+
+    for (size_t ii = 1; ii < all_buckets.size(); ++ii) {
+        auto& bucket = all_buckets[ii];
+        cb_mutex_enter(&bucket.mutex);
+        const bool found = bucket.state == BucketState::Ready &&
+                           name->second == bucket.name;
+        cb_mutex_exit(&bucket.mutex);
+        if (found) {
+            return &bucket;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Callback for getting the rate limits of a bucket (and the current
+ * state of the rate limiter)
+ */
+static ENGINE_ERROR_CODE getRateLimit(Connection* c,
+                                      const StrToStrMap& arguments,
+                                      std::string& value) {
+    auto* bucket = getRateLimitedBucket(c, arguments);
+    if (bucket == nullptr) {
+        return ENGINE_KEY_ENOENT;
+    }
+    value = to_string(bucket->rateLimiter.toJSON(), false);
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Callback for setting one of the rate limits (ops per second, bytes per
+ * second or the max delay in ms) of a bucket
+ */
+static ENGINE_ERROR_CODE setRateLimit(Connection* c,
+                                      const StrToStrMap& arguments,
+                                      const std::string& value,
+                                      const std::string& limit) {
+    auto* bucket = getRateLimitedBucket(c, arguments);
+    if (bucket == nullptr) {
+        return ENGINE_KEY_ENOENT;
+    }
+
+    uint64_t number;
+    if (!safe_strtoull(value.c_str(), &number)) {
+        return ENGINE_EINVAL;
+    }
+
+    auto& limiter = bucket->rateLimiter;
+    if (limit == "ops") {
+        limiter.setOpsLimit(number);
+    } else if (limit == "bytes") {
+        limiter.setBytesLimit(number);
+    } else if (number <= std::numeric_limits<uint32_t>::max()) {
+        limiter.setMaxDelay(uint32_t(number));
+    } else {
+        return ENGINE_EINVAL;
+    }
+
+    LOG_NOTICE(c, "%u: IOCTL_SET: ratelimit.%s for bucket [%s] set to %s",
+               c->getId(), limit.c_str(), bucket->name, value.c_str());
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Callback for getting the slow operation log as JSON. The operations may
+ * be limited to a single bucket with the "bucket" argument.
+ */
+static ENGINE_ERROR_CODE getSlowOperations(Connection* c,
+                                           const StrToStrMap& arguments,
+                                           std::string& value) {
+    if (!slowOperationLog) {
+        return ENGINE_KEY_ENOENT;
+    }
+
+    std::string bucket;
+    auto name = arguments.find("bucket");
+    if (name != arguments.end()) {
+        bucket = name->second;
+    }
+    value = to_string(slowOperationLog->toJSON(bucket), false);
+    return ENGINE_SUCCESS;
+}
+
 static const std::unordered_map<std::string, GetCallbackFunc> ioctl_get_map {
     {"trace.config", ioctlGetTracingConfig},
     {"trace.status", ioctlGetTracingStatus},
     {"trace.dump", ioctlGetTracingDump},
+    {"trace.dump.begin", ioctlGetTracingBeginDump},
+    {"trace.dump.chunk", ioctlGetTracingDumpChunk},
+    {"ratelimit", getRateLimit},
+    {"slow_ops", getSlowOperations},
 };
 
 ENGINE_ERROR_CODE ioctl_get_property(Connection* c,
@@ -99,6 +204,21 @@ static const std::unordered_map<std::string, SetCallbackFunc> ioctl_set_map {
     {"trace.config", ioctlSetTracingConfig},
     {"trace.start", ioctlSetTracingStart},
     {"trace.stop", ioctlSetTracingStop},
+    {"trace.dump.clear", ioctlSetTracingClearDump},
+    {"trace.dump.file", ioctlSetTracingDumpToFile},
+    {"trace.continuous", ioctlSetTracingContinuous},
+    {"ratelimit.ops",
+     [](Connection* c, const StrToStrMap& arguments, const std::string& value) {
+         return setRateLimit(c, arguments, value, "ops");
+     }},
+    {"ratelimit.bytes",
+     [](Connection* c, const StrToStrMap& arguments, const std::string& value) {
+         return setRateLimit(c, arguments, value, "bytes");
+     }},
+    {"ratelimit.max_delay",
+     [](Connection* c, const StrToStrMap& arguments, const std::string& value) {
+         return setRateLimit(c, arguments, value, "max_delay");
+     }},
 };
 
 ENGINE_ERROR_CODE ioctl_set_property(Connection* c,
@@ -0,0 +1,255 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "ktls.h"
+
+#include <algorithm>
+#include <cstring>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <platform/strerror.h>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+// We need OpenSSL 1.1 to get the master secret and the random values
+#if defined(TLS_TX) && OPENSSL_VERSION_NUMBER >= 0x10100000L
+#define HAVE_KTLS 1
+#endif
+#endif
+
+bool tls12_prf(const EVP_MD* md,
+               const uint8_t* secret,
+               size_t secretlen,
+               const std::string& label,
+               const uint8_t* seed,
+               size_t seedlen,
+               uint8_t* out,
+               size_t outlen) {
+    // P_hash(secret, label + seed) = HMAC_hash(secret, A(1) + label + seed) +
+    //                                HMAC_hash(secret, A(2) + label + seed) +
+    //                                ...
+    // where A(0) = label + seed and A(i) = HMAC_hash(secret, A(i-1))
+    std::vector<uint8_t> labelseed(label.begin(), label.end());
+    labelseed.insert(labelseed.end(), seed, seed + seedlen);
+
+    uint8_t a[EVP_MAX_MD_SIZE];
+    unsigned int alen;
+    if (HMAC(md, secret, int(secretlen), labelseed.data(), labelseed.size(),
+             a, &alen) == nullptr) {
+        return false;
+    }
+
+    std::vector<uint8_t> input;
+    size_t offset = 0;
+    while (offset < outlen) {
+        input.assign(a, a + alen);
+        input.insert(input.end(), labelseed.begin(), labelseed.end());
+
+        uint8_t block[EVP_MAX_MD_SIZE];
+        unsigned int blocklen;
+        if (HMAC(md, secret, int(secretlen), input.data(), input.size(),
+                 block, &blocklen) == nullptr) {
+            return false;
+        }
+        const size_t count = std::min(size_t(blocklen), outlen - offset);
+        memcpy(out + offset, block, count);
+        offset += count;
+
+        uint8_t next[EVP_MAX_MD_SIZE];
+        if (HMAC(md, secret, int(secretlen), a, alen, next, &alen) == nullptr) {
+            return false;
+        }
+        memcpy(a, next, alen);
+    }
+
+    OPENSSL_cleanse(a, sizeof(a));
+    return true;
+}
+
+#ifdef HAVE_KTLS
+/**
+ * Install the key for one direction of the connection in the kernel
+ *
+ * @param sfd the socket
+ * @param direction TLS_TX or TLS_RX
+ * @param type the cipher type (TLS_CIPHER_AES_GCM_xxx)
+ * @param key the write key of the sender
+ * @param salt the implicit part of the nonce (the write IV of the sender)
+ * @param seqno the sequence number of the next record
+ */
+template <typename T>
+static bool set_crypto_info(SOCKET sfd,
+                            int direction,
+                            uint16_t type,
+                            const uint8_t* key,
+                            const uint8_t* salt,
+                            uint64_t seqno) {
+    T info;
+    memset(&info, 0, sizeof(info));
+    info.info.version = TLS_1_2_VERSION;
+    info.info.cipher_type = type;
+    memcpy(info.key, key, sizeof(info.key));
+    memcpy(info.salt, salt, sizeof(info.salt));
+
+    // The sequence numbers are sent in network byte order, and we use
+    // the sequence number as the explicit part of the nonce
+    uint8_t seq[8];
+    for (int ii = 7; ii >= 0; --ii) {
+        seq[ii] = uint8_t(seqno & 0xff);
+        seqno >>= 8;
+    }
+    memcpy(info.iv, seq, sizeof(info.iv));
+    memcpy(info.rec_seq, seq, sizeof(info.rec_seq));
+
+    const bool ret = setsockopt(sfd, SOL_TLS, direction, &info,
+                                sizeof(info)) == 0;
+    OPENSSL_cleanse(&info, sizeof(info));
+    return ret;
+}
+
+static bool set_crypto_info(SOCKET sfd,
+                            int direction,
+                            int nid,
+                            const uint8_t* key,
+                            const uint8_t* salt,
+                            uint64_t seqno) {
+    switch (nid) {
+    case NID_aes_128_gcm:
+        return set_crypto_info<tls12_crypto_info_aes_gcm_128>(
+            sfd, direction, TLS_CIPHER_AES_GCM_128, key, salt, seqno);
+#ifdef TLS_CIPHER_AES_GCM_256
+    case NID_aes_256_gcm:
+        return set_crypto_info<tls12_crypto_info_aes_gcm_256>(
+            sfd, direction, TLS_CIPHER_AES_GCM_256, key, salt, seqno);
+#endif
+    }
+    return false;
+}
+#endif
+
+KtlsStatus ktls_enable(SOCKET sfd, SSL* ssl, bool rx) {
+    KtlsStatus status;
+#ifndef HAVE_KTLS
+    (void)sfd;
+    (void)ssl;
+    (void)rx;
+    status.reason = "kTLS is not supported on this platform";
+#else
+    if (SSL_version(ssl) != TLS1_2_VERSION) {
+        status.reason = std::string("unsupported protocol ") +
+                        SSL_get_version(ssl);
+        return status;
+    }
+
+    const SSL_CIPHER* cipher = SSL_get_current_cipher(ssl);
+    if (cipher == nullptr) {
+        status.reason = "no cipher negotiated";
+        return status;
+    }
+
+    // The key size and the hash function used by the PRF is given by
+    // the cipher suite (AES128-GCM-SHA256 and AES256-GCM-SHA384)
+    const int nid = SSL_CIPHER_get_cipher_nid(cipher);
+    size_t keylen;
+    const EVP_MD* md;
+    switch (nid) {
+    case NID_aes_128_gcm:
+        keylen = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+        md = EVP_sha256();
+        break;
+#ifdef TLS_CIPHER_AES_GCM_256
+    case NID_aes_256_gcm:
+        keylen = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+        md = EVP_sha384();
+        break;
+#endif
+    default:
+        status.reason = std::string("unsupported cipher ") +
+                        SSL_CIPHER_get_name(cipher);
+        return status;
+    }
+
+    // key_block = PRF(master_secret, "key expansion",
+    //                 server_random + client_random)
+    // AEAD ciphers don't use any MAC keys, so the key block contains the
+    // client write key, the server write key, the client write IV and
+    // the server write IV.
+    uint8_t master[SSL_MAX_MASTER_KEY_LENGTH];
+    const size_t masterlen = SSL_SESSION_get_master_key(
+        SSL_get_session(ssl), master, sizeof(master));
+    uint8_t seed[2 * SSL3_RANDOM_SIZE];
+    SSL_get_server_random(ssl, seed, SSL3_RANDOM_SIZE);
+    SSL_get_client_random(ssl, seed + SSL3_RANDOM_SIZE, SSL3_RANDOM_SIZE);
+
+    const size_t ivlen = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+    uint8_t keyblock[2 * 32 + 2 * TLS_CIPHER_AES_GCM_128_SALT_SIZE];
+    const bool derived = tls12_prf(md, master, masterlen, "key expansion",
+                                   seed, sizeof(seed), keyblock,
+                                   2 * keylen + 2 * ivlen);
+    OPENSSL_cleanse(master, sizeof(master));
+    if (!derived) {
+        status.reason = "failed to derive the keys";
+        return status;
+    }
+
+    const uint8_t* client_key = keyblock;
+    const uint8_t* server_key = keyblock + keylen;
+    const uint8_t* client_iv = keyblock + 2 * keylen;
+    const uint8_t* server_iv = client_iv + ivlen;
+
+    // The Finished message was the first (and only) record protected by
+    // the new keys in both directions
+    const uint64_t seqno = 1;
+
+    if (setsockopt(sfd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+        status.reason = std::string("failed to set TCP_ULP: ") +
+                        cb_strerror();
+    } else if (!set_crypto_info(sfd, TLS_TX, nid, server_key, server_iv,
+                                seqno)) {
+        status.reason = std::string("failed to set TLS_TX: ") +
+                        cb_strerror();
+    } else {
+        status.tx = true;
+        if (rx) {
+#ifdef TLS_RX
+            status.rx = set_crypto_info(sfd, TLS_RX, nid, client_key,
+                                        client_iv, seqno);
+            if (!status.rx) {
+                status.reason = std::string("failed to set TLS_RX: ") +
+                                cb_strerror();
+            }
+#else
+            status.reason = "kTLS receive is not supported";
+#endif
+        }
+    }
+
+    OPENSSL_cleanse(keyblock, sizeof(keyblock));
+#endif
+    return status;
+}
@@ -0,0 +1,89 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memcached/openssl.h>
+#include <string>
+
+/**
+ * Kernel TLS (kTLS) lets the kernel encrypt and decrypt the TLS records
+ * so that we may use the plain recv/sendmsg calls (and avoid copying
+ * the data through the BIO pair used by the SSL connections).
+ *
+ * Only TLS 1.2 with AES-GCM (128 and 256 bits) is supported (on Linux).
+ * For all other protocols and ciphers (and on the platforms without
+ * kTLS) the connection keeps using OpenSSL for the record layer.
+ */
+
+/**
+ * The result of trying to enable kTLS on a connection
+ */
+struct KtlsStatus {
+    KtlsStatus()
+        : tx(false),
+          rx(false) {
+    }
+
+    /** The kernel encrypts the data sent on the socket */
+    bool tx;
+    /** The kernel decrypts the data received on the socket */
+    bool rx;
+    /** Why kTLS couldn't be enabled (for logging) */
+    std::string reason;
+};
+
+/**
+ * Hand the keys negotiated for the SSL connection over to the kernel.
+ *
+ * The handshake must be complete, and all of the data OpenSSL produced
+ * must be written to the socket. The receive side is only moved to the
+ * kernel if the caller didn't read any data from the socket which
+ * OpenSSL hasn't consumed (the kernel would otherwise expect the wrong
+ * record sequence number).
+ *
+ * @param sfd the socket used by the connection
+ * @param ssl the SSL connection
+ * @param rx should we try to move the receive side to the kernel
+ * @return the directions moved to the kernel
+ */
+KtlsStatus ktls_enable(SOCKET sfd, SSL* ssl, bool rx);
+
+/**
+ * The TLS 1.2 pseudo random function (RFC 5246 section 5)
+ *
+ * @param md the hash function to use (the one specified by the cipher suite)
+ * @param secret the secret
+ * @param secretlen the number of bytes in the secret
+ * @param label the label
+ * @param seed the seed
+ * @param seedlen the number of bytes in the seed
+ * @param out where to store the output
+ * @param outlen the number of bytes to generate
+ * @return true on success
+ */
+bool tls12_prf(const EVP_MD* md,
+               const uint8_t* secret,
+               size_t secretlen,
+               const std::string& label,
+               const uint8_t* seed,
+               size_t seedlen,
+               uint8_t* out,
+               size_t outlen);
@@ -0,0 +1,179 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/platform.h>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * LatencyBreakdown tracks the timestamps (as returned from gethrtime())
+ * of the events in the life of a command, and accumulates the time spent
+ * in each of the following phases:
+ *
+ *  - Queue: the time from the packet was parsed until the executor was
+ *    entered, and from the engine notified us (notify_io_complete) until
+ *    the worker thread ran the command again.
+ *  - Engine: the time spent running the executor (and the engine).
+ *  - Ewouldblock: the time from the engine returned EWOULDBLOCK until it
+ *    called notify_io_complete.
+ *  - Send: the time from the executor returned the last time until the
+ *    last byte of the response was written to the socket.
+ *
+ * All of the methods except notify() are called by the worker thread
+ * owning the connection. notify() may be called by any thread.
+ */
+class LatencyBreakdown {
+public:
+    enum class Phase { Queue, Engine, Ewouldblock, Send };
+    static const size_t NumPhases = 4;
+
+    LatencyBreakdown() {
+        reset();
+    }
+
+    /**
+     * Stop tracking the current command
+     */
+    void reset() {
+        parsedAt = 0;
+        engineEnterAt = 0;
+        engineExitAt = 0;
+        notifiedAt.store(0, std::memory_order_relaxed);
+        for (auto& d : durations) {
+            d = 0;
+        }
+    }
+
+    /**
+     * Start tracking a new command (the packet was parsed)
+     */
+    void start(hrtime_t now) {
+        reset();
+        parsedAt = now;
+    }
+
+    /**
+     * Are we tracking the current command?
+     */
+    bool isActive() const {
+        return parsedAt != 0;
+    }
+
+    /**
+     * Has the command been passed to the executor (and the engine)?
+     */
+    bool isExecuted() const {
+        return engineExitAt != 0;
+    }
+
+    /**
+     * The executor is about to be called
+     */
+    void enterEngine(hrtime_t now) {
+        const hrtime_t notified =
+                notifiedAt.exchange(0, std::memory_order_relaxed);
+        if (engineExitAt == 0) {
+            add(Phase::Queue, parsedAt, now);
+        } else {
+            // The engine may call notify_io_complete before the
+            // executor returns EWOULDBLOCK
+            const hrtime_t resumed =
+                    notified > engineExitAt ? notified : engineExitAt;
+            add(Phase::Ewouldblock, engineExitAt, resumed);
+            add(Phase::Queue, resumed, now);
+        }
+        engineEnterAt = now;
+    }
+
+    /**
+     * The executor returned
+     */
+    void exitEngine(hrtime_t now) {
+        add(Phase::Engine, engineEnterAt, now);
+        engineExitAt = now;
+    }
+
+    /**
+     * The engine called notify_io_complete for the cookie
+     */
+    void notify(hrtime_t now) {
+        hrtime_t expected = 0;
+        notifiedAt.compare_exchange_strong(expected, now,
+                                           std::memory_order_relaxed);
+    }
+
+    /**
+     * The last byte of the response was written
+     */
+    void written(hrtime_t now) {
+        add(Phase::Send, engineExitAt, now);
+    }
+
+    /**
+     * Has the executor been entered for the command?
+     */
+    bool hasEnteredEngine() const {
+        return engineEnterAt != 0;
+    }
+
+    /**
+     * Get the time (in ns) spent in the engine so far (including the
+     * time spent in the current call if the executor is running)
+     */
+    hrtime_t getEngineDuration(hrtime_t now) const {
+        hrtime_t ret = durations[size_t(Phase::Engine)];
+        if (engineEnterAt > engineExitAt && now > engineEnterAt) {
+            ret += now - engineEnterAt;
+        }
+        return ret;
+    }
+
+    /**
+     * Get the time (in ns) spent in the phase
+     */
+    hrtime_t getDuration(Phase phase) const {
+        return durations[size_t(phase)];
+    }
+
+    static const char* to_string(Phase phase) {
+        switch (phase) {
+        case Phase::Queue:
+            return "queue";
+        case Phase::Engine:
+            return "engine";
+        case Phase::Ewouldblock:
+            return "ewouldblock";
+        case Phase::Send:
+            return "send";
+        }
+        return "unknown";
+    }
+
+private:
+    void add(Phase phase, hrtime_t from, hrtime_t to) {
+        if (to > from) {
+            durations[size_t(phase)] += to - from;
+        }
+    }
+
+    hrtime_t parsedAt;
+    hrtime_t engineEnterAt;
+    hrtime_t engineExitAt;
+    std::atomic<hrtime_t> notifiedAt;
+    hrtime_t durations[NumPhases];
+};
@@ -29,6 +29,9 @@
 #include "mc_time.h"
 
 #include <atomic>
+#include <cinttypes>
+#include <platform/timeutils.h>
+#include <utilities/protocol2text.h>
 
 extern std::atomic<bool> memcached_shutdown;
 
@@ -50,6 +53,12 @@ const time_t memcached_check_system_time = 60;
  */
 const time_t memcached_maximum_relative_time = 60*60*24*30;
 
+/*
+ * This constant defines the minimum number of seconds between the
+ * summaries of the slow operation log written to the log.
+ */
+const rel_time_t memcached_slow_op_summary_interval = 10;
+
 static std::atomic<rel_time_t> memcached_uptime(0);
 static volatile time_t memcached_epoch = 0;
 static volatile uint64_t memcached_monotonic_start = 0;
@@ -59,6 +68,7 @@ static void mc_time_clock_event_handler(evutil_socket_t fd, short which, void *a
 static void mc_time_clock_tick(void);
 static void mc_time_init_epoch(void);
 static void mc_gather_timing_samples(void);
+static void mc_log_slow_operations(void);
 
 /*
  * Init internal state and start the timer event callback.
@@ -176,6 +186,8 @@ static void mc_time_clock_tick(void) {
     /* Collect samples */
     mc_gather_timing_samples();
 
+    mc_log_slow_operations();
+
     /*
       every 'memcached_check_system_time' seconds, keep an eye on the
       system clock.
@@ -218,3 +230,43 @@ static void mc_gather_timing_samples(void) {
         return true;
     }, nullptr);
 }
+
+/*
+ * Write a summary of the operations added to the slow operation log
+ * since the previous summary (at most every
+ * memcached_slow_op_summary_interval seconds).
+ */
+static void mc_log_slow_operations(void) {
+    static rel_time_t next_summary = 0;
+
+    if (!slowOperationLog || memcached_uptime < next_summary) {
+        return;
+    }
+    next_summary = memcached_uptime + memcached_slow_op_summary_interval;
+
+    const auto summary = slowOperationLog->getSummary();
+    if (summary.count == 0) {
+        return;
+    }
+
+    if (summary.hasSlowest) {
+        const auto& op = summary.slowest;
+        const char* opcode = memcached_opcode_2_text(op.opcode);
+        LOG_WARNING(NULL,
+                    "%" PRIu64 " operations slower than %zu ms during the "
+                    "last %u seconds. The slowest was %s on connection %u "
+                    "in bucket [%s] (%s). Use IOCTL_GET slow_ops for the "
+                    "details",
+                    summary.count, settings.getSlowOpThreshold(),
+                    memcached_slow_op_summary_interval,
+                    opcode == nullptr ? "unknown" : opcode,
+                    op.connectionId, op.bucket.data(),
+                    Couchbase::hrtime2text(op.duration).c_str());
+    } else {
+        LOG_WARNING(NULL,
+                    "%" PRIu64 " operations slower than %zu ms during the "
+                    "last %u seconds. Use IOCTL_GET slow_ops for the details",
+                    summary.count, settings.getSlowOpThreshold(),
+                    memcached_slow_op_summary_interval);
+    }
+}
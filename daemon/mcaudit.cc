@@ -24,73 +24,92 @@
 
 #include <memcached/audit_interface.h>
 #include <cJSON.h>
-#include <memcached/isotime.h>
+#include <chrono>
 
 /**
- * Create the typical memcached audit object. It constists of a
- * timestamp, the socket endpoints and the creds. Then each audit event
- * may add event-specific content.
- *
- * @param c the connection object
- * @return the cJSON object containing the basic information
+ * Create the audit event record for the connection. The typical memcached
+ * audit object constists of a timestamp, the socket endpoints and the
+ * creds. Then each audit event may add event-specific content. We only
+ * copy the fields here; the audit daemon formats the event as JSON on its
+ * own thread.
  */
-static unique_cJSON_ptr create_memcached_audit_object(const Connection *c) {
-    cJSON *root = cJSON_CreateObject();
-
-    std::string timestamp = ISOTime::generatetimestamp();
-    cJSON_AddStringToObject(root, "timestamp", timestamp.c_str());
-
-    cJSON_AddStringToObject(root, "peername", c->getPeername().c_str());
-    cJSON_AddStringToObject(root, "sockname", c->getSockname().c_str());
-    cJSON *source = cJSON_CreateObject();
-    cJSON_AddStringToObject(source, "source", "memcached");
-    cJSON_AddStringToObject(source, "user", c->getUsername());
-    cJSON_AddItemToObject(root, "real_userid", source);
+static AuditEventRecord create_record(const Connection* c) {
+    using namespace std::chrono;
+    const auto now = system_clock::now().time_since_epoch();
+    const auto secs = duration_cast<seconds>(now);
+
+    AuditEventRecord record;
+    record.time = time_t(secs.count());
+    record.usec = uint32_t(duration_cast<microseconds>(now - secs).count());
+    record.peername = c->getPeername();
+    record.sockname = c->getSockname();
+    if (c->isUnixSocket()) {
+        record.peer_credentials = to_string(c->getPeerCredentialsJSON(),
+                                            false);
+    }
+    record.user = c->getUsername();
+    return record;
+}
 
-    return unique_cJSON_ptr(root);
+/**
+ * Is the audit event enabled? The check is cheap, and should be done
+ * before we spend any time formatting the event.
+ */
+static bool is_enabled(uint32_t id) {
+    return is_audit_event_enabled(get_audit_handle(), id);
 }
 
 /**
- * Convert the JSON object to text and send it to the audit framework
+ * Send the event to the audit framework
  *
  * @param c the connection object requesting the call
  * @param id the audit identifier
- * @param event the payload of the audit description
+ * @param record the audit event
  * @param warn what to log if we're failing to put the audit event
  */
 static void do_audit(const Connection* c,
                      uint32_t id,
-                     unique_cJSON_ptr& event,
+                     AuditEventRecord& record,
                      const char* warn) {
-    auto text = to_string(event, false);
-    auto status = put_audit_event(get_audit_handle(), id, text.data(),
-                                  text.length());
+    // The record is moved into the audit queue (so it isn't available
+    // for the log message if we fail to put the event)
+    auto status = put_audit_event_record(get_audit_handle(), id,
+                                         std::move(record));
 
     if (status != AUDIT_SUCCESS) {
-        LOG_WARNING(c, "%s: %s", warn, text.c_str());
+        LOG_WARNING(c, "%s", warn);
     }
 }
 
 void audit_auth_failure(const Connection *c, const char *reason) {
-    auto root = create_memcached_audit_object(c);
-    cJSON_AddStringToObject(root.get(), "reason", reason);
+    if (!is_enabled(MEMCACHED_AUDIT_AUTHENTICATION_FAILED)) {
+        return;
+    }
+    auto event = create_record(c);
+    event.fields.emplace_back("reason", reason);
 
-    do_audit(c, MEMCACHED_AUDIT_AUTHENTICATION_FAILED, root,
+    do_audit(c, MEMCACHED_AUDIT_AUTHENTICATION_FAILED, event,
              "Failed to send AUTH FAILED audit event");
 }
 
 void audit_auth_success(const Connection *c) {
-    auto root = create_memcached_audit_object(c);
-    do_audit(c, MEMCACHED_AUDIT_AUTHENTICATION_SUCCEEDED, root,
+    if (!is_enabled(MEMCACHED_AUDIT_AUTHENTICATION_SUCCEEDED)) {
+        return;
+    }
+    auto event = create_record(c);
+    do_audit(c, MEMCACHED_AUDIT_AUTHENTICATION_SUCCEEDED, event,
              "Failed to send AUTH SUCCESS audit event");
 }
 
 
 void audit_bucket_flush(const Connection *c, const char *bucket) {
-    auto root = create_memcached_audit_object(c);
-    cJSON_AddStringToObject(root.get(), "bucket", bucket);
+    if (!is_enabled(MEMCACHED_AUDIT_BUCKET_FLUSH)) {
+        return;
+    }
+    auto event = create_record(c);
+    event.fields.emplace_back("bucket", bucket);
 
-    do_audit(c, MEMCACHED_AUDIT_BUCKET_FLUSH, root,
+    do_audit(c, MEMCACHED_AUDIT_BUCKET_FLUSH, event,
              "Failed to send BUCKET_FLUSH audit event");
 }
 
@@ -98,18 +117,21 @@ void audit_bucket_flush(const Connection *c, const char *bucket) {
 void audit_dcp_open(const Connection *c) {
     if (c->isAdmin()) {
         LOG_INFO(c, "Open DCP stream with admin credentials");
-    } else {
-        auto root = create_memcached_audit_object(c);
-        cJSON_AddStringToObject(root.get(), "bucket", getBucketName(c));
+    } else if (is_enabled(MEMCACHED_AUDIT_OPENED_DCP_CONNECTION)) {
+        auto event = create_record(c);
+        event.fields.emplace_back("bucket", getBucketName(c));
 
-        do_audit(c, MEMCACHED_AUDIT_OPENED_DCP_CONNECTION, root,
+        do_audit(c, MEMCACHED_AUDIT_OPENED_DCP_CONNECTION, event,
                  "Failed to send DCP open connection "
                  "audit event to audit daemon");
     }
 }
 
 void audit_command_access_failed(const McbpConnection *c) {
-    auto root = create_memcached_audit_object(c);
+    if (!is_enabled(MEMCACHED_AUDIT_COMMAND_ACCESS_FAILURE)) {
+        return;
+    }
+    auto event = create_record(c);
     char buffer[256];
     memset(buffer, 0, sizeof(buffer));
     // Deliberately ignore failure of bytes_to_output_string
@@ -118,12 +140,15 @@ void audit_command_access_failed(const McbpConnection *c) {
                            "Access to command is not allowed:",
                            reinterpret_cast<const char*>(&c->getBinaryHeader()),
                            sizeof(protocol_binary_request_header));
-    cJSON_AddStringToObject(root.get(), "packet", buffer);
-    do_audit(c, MEMCACHED_AUDIT_COMMAND_ACCESS_FAILURE, root, buffer);
+    event.fields.emplace_back("packet", buffer);
+    do_audit(c, MEMCACHED_AUDIT_COMMAND_ACCESS_FAILURE, event, buffer);
 }
 
 void audit_invalid_packet(const McbpConnection *c) {
-    auto root = create_memcached_audit_object(c);
+    if (!is_enabled(MEMCACHED_AUDIT_INVALID_PACKET)) {
+        return;
+    }
+    auto event = create_record(c);
     char buffer[256];
     memset(buffer, 0, sizeof(buffer));
     // Deliberately ignore failure of bytes_to_output_string
@@ -132,8 +157,8 @@ void audit_invalid_packet(const McbpConnection *c) {
                            "Invalid Packet:",
                            reinterpret_cast<const char*>(&c->getBinaryHeader()),
                            sizeof(protocol_binary_request_header));
-    cJSON_AddStringToObject(root.get(), "packet", buffer);
-    do_audit(c, MEMCACHED_AUDIT_INVALID_PACKET, root, buffer);
+    event.fields.emplace_back("packet", buffer);
+    do_audit(c, MEMCACHED_AUDIT_INVALID_PACKET, event, buffer);
 }
 
 void initialize_audit() {
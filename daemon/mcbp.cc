@@ -107,6 +107,69 @@ static ENGINE_ERROR_CODE get_vb_map_cb(const void* void_cookie,
     return ENGINE_SUCCESS;
 }
 
+uint8_t mcbp_build_response_framing(McbpConnection* c,
+                                    uint16_t keylen,
+                                    uint8_t* dest) {
+    // The response to HELLO use the normal format so that the client
+    // doesn't need to know the outcome before it parse it
+    if (!c->isTracingEnabled() || keylen > 0xff || c->getStart() == 0 ||
+        c->binary_header.request.opcode == PROTOCOL_BINARY_CMD_HELLO) {
+        return 0;
+    }
+
+    const hrtime_t now = gethrtime();
+    uint8_t len = 0;
+    auto add_frame_info = [dest, &len](mcbp::ResponseFrameInfoId id,
+                                       hrtime_t duration) {
+        const uint16_t encoded = htons(encode_server_duration(duration));
+        dest[len++] = uint8_t((uint8_t(id) << 4) | sizeof(encoded));
+        memcpy(dest + len, &encoded, sizeof(encoded));
+        len += uint8_t(sizeof(encoded));
+    };
+
+    const hrtime_t start = c->getStart();
+    add_frame_info(mcbp::ResponseFrameInfoId::ServerDuration,
+                   now > start ? now - start : 0);
+
+    const auto& latency = c->getCookieObject().latency;
+    if (latency.isActive() && latency.hasEnteredEngine()) {
+        add_frame_info(mcbp::ResponseFrameInfoId::EngineDuration,
+                       latency.getEngineDuration(now));
+    }
+
+    return len;
+}
+
+void mcbp_build_response_header(McbpConnection* c,
+                                protocol_binary_response_header& header,
+                                uint8_t framing_len,
+                                uint16_t err,
+                                uint8_t ext_len,
+                                uint16_t key_len,
+                                uint32_t body_len,
+                                uint8_t datatype,
+                                uint64_t cas) {
+    if (framing_len == 0) {
+        header.response.magic = (uint8_t)PROTOCOL_BINARY_RES;
+        header.response.keylen = (uint16_t)htons(key_len);
+    } else {
+        // The alternative response format use the first byte of the key
+        // length for the length of the framing extras
+        header.response.magic = (uint8_t)PROTOCOL_BINARY_ARES;
+        header.bytes[2] = framing_len;
+        header.bytes[3] = uint8_t(key_len);
+    }
+    header.response.opcode = c->binary_header.request.opcode;
+
+    header.response.extlen = ext_len;
+    header.response.datatype = datatype;
+    header.response.status = (uint16_t)htons(err);
+
+    header.response.bodylen = htonl(body_len + framing_len);
+    header.response.opaque = c->getOpaque();
+    header.response.cas = htonll(cas);
+}
+
 void mcbp_write_response(McbpConnection* c,
                          const void* d,
                          int extlen,
@@ -205,17 +268,10 @@ void mcbp_add_header(McbpConnection* c,
     c->addMsgHdr(true);
     header = (protocol_binary_response_header*)c->write.buf;
 
-    header->response.magic = (uint8_t)PROTOCOL_BINARY_RES;
-    header->response.opcode = c->binary_header.request.opcode;
-    header->response.keylen = (uint16_t)htons(key_len);
-
-    header->response.extlen = ext_len;
-    header->response.datatype = datatype;
-    header->response.status = (uint16_t)htons(err);
-
-    header->response.bodylen = htonl(body_len);
-    header->response.opaque = c->getOpaque();
-    header->response.cas = htonll(c->getCAS());
+    const uint8_t framing = mcbp_build_response_framing(
+            c, key_len, c->getResponseFramingBuffer());
+    mcbp_build_response_header(c, *header, framing, err, ext_len, key_len,
+                               body_len, datatype, c->getCAS());
 
     if (settings.getVerbose() > 1) {
         char buffer[1024];
@@ -228,6 +284,9 @@ void mcbp_add_header(McbpConnection* c,
     }
 
     c->addIov(c->write.buf, sizeof(header->response));
+    if (framing > 0) {
+        c->addIov(c->getResponseFramingBuffer(), framing);
+    }
 }
 
 protocol_binary_response_status engine_error_2_mcbp_protocol_error(
@@ -317,7 +376,9 @@ bool mcbp_response_handler(const void* key, uint16_t keylen,
         datatype &= ~(PROTOCOL_BINARY_DATATYPE_XATTR);
     }
 
-    const size_t needed = payload.len + keylen + extlen +
+    uint8_t framing[8];
+    const uint8_t framinglen = mcbp_build_response_framing(c, keylen, framing);
+    const size_t needed = payload.len + keylen + extlen + framinglen +
                           sizeof(protocol_binary_response_header);
 
     auto &dbuf = c->getDynamicBuffer();
@@ -327,26 +388,25 @@ bool mcbp_response_handler(const void* key, uint16_t keylen,
         return false;
     }
 
-    protocol_binary_response_header header;
-    memset(&header, 0, sizeof(header));
-    header.response.magic = (uint8_t)PROTOCOL_BINARY_RES;
-    header.response.opcode = c->binary_header.request.opcode;
-    header.response.keylen = (uint16_t)htons(keylen);
-    header.response.extlen = extlen;
     if (!c->isSupportsDatatype()) {
-        header.response.datatype = PROTOCOL_BINARY_RAW_BYTES;
-    } else {
-        header.response.datatype = datatype;
+        datatype = PROTOCOL_BINARY_RAW_BYTES;
     }
-    header.response.status = (uint16_t)htons(status);
-    header.response.bodylen = htonl(needed - sizeof(protocol_binary_response_header));
-    header.response.opaque = c->getOpaque();
-    header.response.cas = htonll(cas);
+
+    protocol_binary_response_header header;
+    memset(&header, 0, sizeof(header));
+    mcbp_build_response_header(c, header, framinglen, status, extlen, keylen,
+                               uint32_t(payload.len + keylen + extlen),
+                               datatype, cas);
 
     char *buf = dbuf.getCurrent();
     memcpy(buf, header.bytes, sizeof(header.response));
     buf += sizeof(header.response);
 
+    if (framinglen > 0) {
+        memcpy(buf, framing, framinglen);
+        buf += framinglen;
+    }
+
     if (extlen > 0) {
         memcpy(buf, ext, extlen);
         buf += extlen;
@@ -365,11 +425,53 @@ bool mcbp_response_handler(const void* key, uint16_t keylen,
     return true;
 }
 
+/**
+ * Record the details of a command which took longer than the
+ * slow_op_threshold setting in the slow operation log
+ */
+static void record_slow_operation(const McbpConnection* c,
+                                  bucket_id_t bucketid,
+                                  hrtime_t elapsed_ns,
+                                  size_t thread) {
+    SlowOperation op;
+    struct timeval now;
+    cb_get_timeofday(&now);
+    op.seconds = uint64_t(now.tv_sec);
+    op.usec = uint32_t(now.tv_usec);
+    op.connectionId = c->getId();
+    op.opaque = c->getOpaque();
+    op.opcode = c->getCmd();
+    strncpy(op.bucket.data(), all_buckets[bucketid].name, op.bucket.size());
+    op.bucket.back() = '\0';
+
+    const auto key = c->getKey();
+    op.keyHash = SlowOperation::hashKey(key.buf, key.len);
+    op.keyLength = uint16_t(key.len);
+    const auto& header = c->binary_header.request;
+    op.valueSize = header.bodylen - header.keylen - header.extlen;
+    op.duration = elapsed_ns;
+
+    const auto& cookie = c->getCookieObject();
+    op.hasPhases = cookie.latency.isActive();
+    for (auto phase : {LatencyBreakdown::Phase::Queue,
+                       LatencyBreakdown::Phase::Engine,
+                       LatencyBreakdown::Phase::Ewouldblock,
+                       LatencyBreakdown::Phase::Send}) {
+        op.phases[size_t(phase)] = cookie.latency.getDuration(phase);
+    }
+    op.ewouldblocks = cookie.ewouldblocks;
+
+    slowOperationLog->add(thread, op);
+}
+
 void mcbp_collect_timings(const McbpConnection* c) {
     hrtime_t now = gethrtime();
     const hrtime_t elapsed_ns = now - c->getStart();
+    // Each worker thread use its own shard of the histograms
+    const auto* thread = c->getThread();
+    const size_t index = thread == nullptr ? 0 : size_t(thread->index);
     // aggregated timing for all buckets
-    all_buckets[0].timings.collect(c->getCmd(), elapsed_ns);
+    all_buckets[0].timings.collect(c->getCmd(), elapsed_ns, index);
 
     // timing for current bucket
     bucket_id_t bucketid = get_bucket_id(c->getCookie());
@@ -378,10 +480,69 @@ void mcbp_collect_timings(const McbpConnection* c) {
      * to delete the bucket you're associated with and your're idle.
      */
     if (bucketid != 0) {
-        all_buckets[bucketid].timings.collect(c->getCmd(), elapsed_ns);
+        all_buckets[bucketid].timings.collect(c->getCmd(), elapsed_ns, index);
     }
 
-    // Log operations taking longer than 0.5s
-    const hrtime_t elapsed_ms = elapsed_ns / (1000 * 1000);
-    c->maybeLogSlowCommand(std::chrono::milliseconds(elapsed_ms));
+    // Keep the details of operations taking longer than the threshold.
+    // The clock thread logs a summary of them, so each slow operation is
+    // only logged by itself when the slow operation log is disabled
+    const auto threshold = hrtime_t(settings.getSlowOpThreshold()) * 1000000;
+    if (threshold != 0 && slowOperationLog) {
+        if (elapsed_ns > threshold) {
+            record_slow_operation(c, bucketid, elapsed_ns, index);
+        }
+    } else {
+        // Log operations taking longer than 0.5s
+        const hrtime_t elapsed_ms = elapsed_ns / (1000 * 1000);
+        c->maybeLogSlowCommand(std::chrono::milliseconds(elapsed_ms));
+    }
+}
+
+void mcbp_collect_latency_breakdown(McbpConnection* c, bool sent) {
+    auto& latency = c->getCookieObject().latency;
+    if (!latency.isExecuted()) {
+        // The command failed before it reached the executor
+        latency.reset();
+        return;
+    }
+
+    if (sent) {
+        latency.written(gethrtime());
+    }
+
+    if (c->isTracingEnabled()) {
+        RequestSpan span;
+        span.opaque = c->getOpaque();
+        span.opcode = c->getCmd();
+        span.queue = latency.getDuration(LatencyBreakdown::Phase::Queue);
+        span.engine = latency.getDuration(LatencyBreakdown::Phase::Engine);
+        span.ewouldblock =
+                latency.getDuration(LatencyBreakdown::Phase::Ewouldblock);
+        span.send = latency.getDuration(LatencyBreakdown::Phase::Send);
+        span.total = span.queue + span.engine + span.ewouldblock + span.send;
+        c->getRequestSpans().add(span);
+    }
+
+    // The breakdown may be tracked for the spans only
+    if (settings.isLatencyBreakdown()) {
+        const auto* thread = c->getThread();
+        const size_t index = thread == nullptr ? 0 : size_t(thread->index);
+        const bucket_id_t bucketid = get_bucket_id(c->getCookie());
+
+        for (auto phase : {LatencyBreakdown::Phase::Queue,
+                           LatencyBreakdown::Phase::Engine,
+                           LatencyBreakdown::Phase::Ewouldblock,
+                           LatencyBreakdown::Phase::Send}) {
+            if (phase == LatencyBreakdown::Phase::Send && !sent) {
+                continue;
+            }
+            const auto duration = latency.getDuration(phase);
+            all_buckets[0].timings.collect_phase(phase, duration, index);
+            if (bucketid != 0) {
+                all_buckets[bucketid].timings.collect_phase(phase, duration,
+                                                            index);
+            }
+        }
+    }
+    latency.reset();
 }
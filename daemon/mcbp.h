@@ -43,6 +43,48 @@ void mcbp_add_header(McbpConnection* c,
                      uint32_t body_len,
                      uint8_t datatype);
 
+/**
+ * Build the framing extras for a response to a connection which enabled
+ * tracing: the server duration (and the engine duration if the command
+ * was passed to the executor).
+ *
+ * @param c the connection
+ * @param keylen the length of the key in the response (the alternative
+ *               response format only has room for a single byte)
+ * @param dest where to store the framing extras (at least 6 bytes)
+ * @return the number of bytes of framing extras (0 if the response
+ *         should use the normal format)
+ */
+uint8_t mcbp_build_response_framing(McbpConnection* c,
+                                    uint16_t keylen,
+                                    uint8_t* dest);
+
+/**
+ * Fill in a response header for the current command on the connection.
+ * The header use the alternative response format if the response carries
+ * framing extras (see mcbp_build_response_framing), which the caller must
+ * send right after the header.
+ *
+ * @param c the connection to build the header for
+ * @param header where to store the header
+ * @param framing_len the number of bytes of framing extras
+ * @param err The error code to use
+ * @param ext_len The length of the ext field
+ * @param key_len The length of the key field
+ * @param body_len The length of the body (not including the framing extras)
+ * @param datatype The datatype to inject into the header
+ * @param cas The cas value to inject into the header
+ */
+void mcbp_build_response_header(McbpConnection* c,
+                                protocol_binary_response_header& header,
+                                uint8_t framing_len,
+                                uint16_t err,
+                                uint8_t ext_len,
+                                uint16_t key_len,
+                                uint32_t body_len,
+                                uint8_t datatype,
+                                uint64_t cas);
+
 /* Form and send a response to a command over the binary protocol.
  * NOTE: Data from `d` is *not* immediately copied out (it's address is just
  *       added to an iovec), and thus must be live until transmit() is later
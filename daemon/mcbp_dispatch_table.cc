@@ -0,0 +1,37 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "mcbp_dispatch_table.h"
+#include "mcbp_privileges.h"
+#include "parked_command.h"
+
+McbpDispatchTable::McbpDispatchTable(
+    const std::array<mcbp_package_execute, 0x100>& executors) {
+    McbpValidatorChains validators;
+    McbpValidatorChains::initializeMcbpValidatorChains(validators);
+    McbpPrivilegeChains privileges;
+
+    for (size_t ii = 0; ii < descriptors.size(); ++ii) {
+        const auto opcode = uint8_t(ii);
+        auto& descriptor = descriptors[ii];
+        descriptor.executor = executors[ii];
+        descriptor.validator = validators.getValidator(opcode);
+        descriptor.privileges = privileges.getPrivileges(opcode);
+        descriptor.accessible = privileges.isDefined(opcode);
+        descriptor.reorderable = ParkedCommand::isReorderable(opcode);
+    }
+}
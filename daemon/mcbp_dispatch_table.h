@@ -0,0 +1,71 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <memcached/privileges.h>
+#include "mcbp_executors.h"
+#include "mcbp_validators.h"
+
+/**
+ * The McbpCommandDescriptor contains everything we need to know about
+ * an opcode in order to dispatch a packet: the privileges the connection
+ * must hold, the validator for the packet and the executor to run.
+ */
+struct McbpCommandDescriptor {
+    /** The executor (nullptr if the core doesn't implement the opcode) */
+    mcbp_package_execute executor;
+    /** The validator for the packet (nullptr if no validation is needed) */
+    McbpValidator validator;
+    /** The privileges the connection must hold to run the command */
+    PrivilegeMask privileges;
+    /** Set if a privilege rule exists for the opcode (if not the command
+     *  is rejected) */
+    bool accessible;
+    /** Set if the command may be reordered on connections using unordered
+     *  execution (see ParkedCommand::isReorderable) */
+    bool reorderable;
+};
+
+/**
+ * The McbpDispatchTable holds a McbpCommandDescriptor for each of the
+ * 256 opcodes. It is built once (from the executors, the validator chains
+ * and the privilege chains), so that process_bin_packet may look up
+ * everything it needs for a packet with a single array lookup instead of
+ * walking the function chains for the validators and the privileges.
+ *
+ * The chains are still used for the validators which may be plugged in
+ * per bucket (see Bucket::validateMcbpCommand).
+ */
+class McbpDispatchTable {
+public:
+    /**
+     * Build the dispatch table
+     *
+     * @param executors the executors to use for the opcodes
+     */
+    McbpDispatchTable(const std::array<mcbp_package_execute, 0x100>& executors);
+
+    McbpDispatchTable(const McbpDispatchTable&) = delete;
+
+    const McbpCommandDescriptor& operator[](uint8_t opcode) const {
+        return descriptors[opcode];
+    }
+
+private:
+    std::array<McbpCommandDescriptor, 0x100> descriptors;
+};
@@ -22,6 +22,7 @@
 #include "session_cas.h"
 #include "buckets.h"
 #include "config_parse.h"
+#include "cpu_topology.h"
 #include "ioctl.h"
 #include "runtime.h"
 #include "debug_helpers.h"
@@ -34,10 +35,13 @@
 #include "enginemap.h"
 #include "mcbpdestroybuckettask.h"
 #include "sasl_tasks.h"
-#include "mcbp_privileges.h"
+#include "ssl_session_cache.h"
+#include "mcbp_dispatch_table.h"
+#include "offload_task.h"
 #include "protocol/mcbp/appendprepend_context.h"
 #include "protocol/mcbp/arithmetic_context.h"
 #include "protocol/mcbp/get_context.h"
+#include "protocol/mcbp/get_multi_context.h"
 #include "protocol/mcbp/dcp_mutation.h"
 #include "protocol/mcbp/steppable_command_context.h"
 #include "protocol/mcbp/utilities.h"
@@ -48,6 +52,7 @@
 #include <platform/compress.h>
 #include <snappy-c.h>
 #include <utilities/protocol2text.h>
+#include <algorithm>
 
 /**
  * Tap stats (these are only used by the tap thread, so they don't need
@@ -131,23 +136,17 @@ static void bin_read_chunk(McbpConnection* c, uint32_t chunk) {
         }
 
         if (nsize != c->read.size) {
-            char* newm;
             LOG_DEBUG(c, "%u: Need to grow buffer from %lu to %lu",
                       c->getId(), (unsigned long)c->read.size,
                       (unsigned long)nsize);
-            newm = reinterpret_cast<char*>(cb_realloc(c->read.buf, nsize));
-            if (newm == NULL) {
+            // The new buffer comes from the threads buffer pool, and the
+            // data is moved to the beginning of the buffer
+            if (!c->resizeReadBuffer(nsize)) {
                 LOG_WARNING(c, "%u: Failed to grow buffer.. closing connection",
                             c->getId());
                 c->setState(conn_closing);
                 return;
             }
-
-            c->read.buf = newm;
-            /* rcurr should point to the same offset in the packet */
-            c->read.curr =
-                c->read.buf + offset - sizeof(protocol_binary_request_header);
-            c->read.size = (int)nsize;
         }
         if (c->read.buf != c->read.curr) {
             memmove(c->read.buf, c->read.curr, c->read.bytes);
@@ -171,15 +170,22 @@ static void handle_binary_protocol_error(McbpConnection* c) {
 
 /**
  * Triggers topkeys_update (i.e., increments topkeys stats) if called by a
- * valid operation.
+ * valid operation. The bytes written is the size of the value in the
+ * request.
  */
-void update_topkeys(const DocKey& key, McbpConnection* c) {
+void update_topkeys(const DocKey& key, McbpConnection* c, size_t nread) {
 
     if (topkey_commands[c->binary_header.request.opcode]) {
-        if (all_buckets[c->getBucketIndex()].topkeys != nullptr) {
-            all_buckets[c->getBucketIndex()].topkeys->updateKey(key.data(),
-                                                                key.size(),
-                                                                mc_time_get_current_time());
+        auto* topkeys = all_buckets[c->getBucketIndex()].topkeys;
+        if (topkeys != nullptr) {
+            const auto& request = c->binary_header.request;
+            const size_t nwritten = request.bodylen - request.keylen -
+                                    request.extlen;
+            const auto* thread = c->getThread();
+            topkeys->updateKey(key.data(), key.size(),
+                               mc_time_get_current_time(),
+                               thread == nullptr ? 0 : size_t(thread->index),
+                               nread, nwritten);
         }
     }
 }
@@ -271,7 +277,7 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
 
     struct thread_stats thread_stats;
     thread_stats.aggregate(all_buckets[c->getBucketIndex()].stats,
-                           settings.getNumWorkerThreads());
+                           settings.getNumTotalWorkerThreads());
 
     auto* cookie = c->getCookie();
 
@@ -351,6 +357,32 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
         add_stat(cookie, add_stat_callback, "listen_disabled_num",
                  get_listen_disabled_num());
         add_stat(cookie, add_stat_callback, "rejected_conns", stats.rejected_conns);
+        add_stat(cookie, add_stat_callback, "replication_conns",
+                 stats.replication_conns);
+        add_stat(cookie, add_stat_callback, "ktls_tx_conns",
+                 stats.ktls_tx_conns);
+        add_stat(cookie, add_stat_callback, "ktls_rx_conns",
+                 stats.ktls_rx_conns);
+        add_stat(cookie, add_stat_callback, "ktls_fallback",
+                 stats.ktls_fallback);
+        add_stat(cookie, add_stat_callback, "ssl_handshakes",
+                 stats.ssl_handshakes);
+        add_stat(cookie, add_stat_callback, "ssl_handshakes_resumed",
+                 stats.ssl_handshakes_resumed);
+        add_stat(cookie, add_stat_callback, "ssl_handshake_time",
+                 stats.ssl_handshake_time);
+        add_stat(cookie, add_stat_callback, "ssl_session_cache_hits",
+                 stats.ssl_session_cache_hits);
+        add_stat(cookie, add_stat_callback, "ssl_session_cache_misses",
+                 stats.ssl_session_cache_misses);
+        add_stat(cookie, add_stat_callback, "ssl_session_cache_items",
+                 get_ssl_session_cache().size());
+        add_stat(cookie, add_stat_callback, "ssl_session_cache_evictions",
+                 get_ssl_session_cache().getEvictions());
+        add_stat(cookie, add_stat_callback, "ssl_ticket_hits",
+                 stats.ssl_ticket_hits);
+        add_stat(cookie, add_stat_callback, "ssl_ticket_misses",
+                 stats.ssl_ticket_misses);
         add_stat(cookie, add_stat_callback, "threads", settings.getNumWorkerThreads());
         add_stat(cookie, add_stat_callback, "conn_yields", thread_stats.conn_yields);
         add_stat(cookie, add_stat_callback, "rbufs_allocated",
@@ -363,6 +395,24 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
                  thread_stats.wbufs_allocated);
         add_stat(cookie, add_stat_callback, "wbufs_loaned",
                  thread_stats.wbufs_loaned);
+        add_stat(cookie, add_stat_callback, "bufpool_hits",
+                 thread_stats.bufpool_hits);
+        add_stat(cookie, add_stat_callback, "bufpool_misses",
+                 thread_stats.bufpool_misses);
+        add_stat(cookie, add_stat_callback, "io_notifications",
+                 thread_stats.io_notifications);
+        add_stat(cookie, add_stat_callback, "io_wakeups_coalesced",
+                 thread_stats.io_wakeups_coalesced);
+        add_stat(cookie, add_stat_callback, "cmd_parked",
+                 thread_stats.cmd_parked);
+        add_stat(cookie, add_stat_callback, "cmd_rate_limited",
+                 thread_stats.cmd_rate_limited);
+        add_stat(cookie, add_stat_callback, "cmd_rate_delayed",
+                 thread_stats.cmd_rate_delayed);
+        add_stat(cookie, add_stat_callback, "rate_delay_us",
+                 thread_stats.rate_delay_ns / 1000);
+        add_stat(cookie, add_stat_callback, "cmd_deadline_exceeded",
+                 thread_stats.cmd_deadline_exceeded);
         add_stat(cookie, add_stat_callback, "iovused_high_watermark",
                  thread_stats.iovused_high_watermark);
         add_stat(cookie, add_stat_callback, "msgused_high_watermark",
@@ -500,6 +550,14 @@ static void process_stat_settings(ADD_STAT add_stat_callback,
                              "-management");
             add_stat(cookie, add_stat_callback, interface, ifce.management);
 
+            if (!ifce.path.empty()) {
+                checked_snprintf(interface + offset,
+                                 sizeof(interface) - offset,
+                                 "-path");
+                add_stat(cookie, add_stat_callback, interface,
+                         ifce.path.c_str());
+            }
+
             if (ifce.ssl.enabled) {
                 checked_snprintf(interface + offset, sizeof(interface) - offset,
                                  "-ssl-pkey");
@@ -520,6 +578,8 @@ static void process_stat_settings(ADD_STAT add_stat_callback,
 
     add_stat(cookie, add_stat_callback, "verbosity", settings.getVerbose());
     add_stat(cookie, add_stat_callback, "num_threads", settings.getNumWorkerThreads());
+    add_stat(cookie, add_stat_callback, "num_replication_threads",
+             settings.getNumReplicationThreads());
     add_stat(cookie, add_stat_callback, "reqs_per_event_high_priority",
              settings.getRequestsPerEventNotification(EventPriority::High));
     add_stat(cookie, add_stat_callback, "reqs_per_event_med_priority",
@@ -560,12 +620,28 @@ static void process_stat_settings(ADD_STAT add_stat_callback,
 
     add_stat(cookie, add_stat_callback, "connection_idle_time",
              std::to_string(settings.getConnectionIdleTime()).c_str());
+    add_stat(cookie, add_stat_callback, "connection_compact_time",
+             std::to_string(settings.getConnectionCompactTime()).c_str());
     add_stat(cookie, add_stat_callback, "datatype",
             settings.isDatatypeSupport() ? "true" : "false");
     add_stat(cookie, add_stat_callback, "dedupe_nmvb_maps",
             settings.isDedupeNmvbMaps() ? "true" : "false");
     add_stat(cookie, add_stat_callback, "max_packet_size",
              std::to_string(settings.getMaxPacketSize()).c_str());
+    add_stat(cookie, add_stat_callback, "ssl_ktls",
+             settings.isSslKtls() ? "true" : "false");
+    add_stat(cookie, add_stat_callback, "ssl_session_cache_size",
+             std::to_string(settings.getSslSessionCacheSize()).c_str());
+    add_stat(cookie, add_stat_callback, "ssl_session_timeout",
+             std::to_string(settings.getSslSessionTimeout()).c_str());
+    add_stat(cookie, add_stat_callback, "ssl_session_tickets",
+             settings.isSslSessionTickets() ? "true" : "false");
+    add_stat(cookie, add_stat_callback, "offload_threshold",
+             std::to_string(settings.getOffloadThreshold()).c_str());
+    add_stat(cookie, add_stat_callback, "latency_breakdown",
+             settings.isLatencyBreakdown() ? "true" : "false");
+    add_stat(cookie, add_stat_callback, "slow_op_threshold",
+             std::to_string(settings.getSlowOpThreshold()).c_str());
 }
 
 static void process_bin_get(McbpConnection* c, void* packet) {
@@ -1094,6 +1170,7 @@ static void process_bin_tap_connect(McbpConnection* c) {
         c->setTapIterator(iterator);
         c->setCurrentEvent(EV_WRITE);
         c->setState(conn_ship_log);
+        c->setMigrationPending(true);
     }
 }
 
@@ -1858,6 +1935,7 @@ static void dcp_open_executor(McbpConnection* c, void* packet) {
         case ENGINE_SUCCESS:
             audit_dcp_open(c);
             mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_SUCCESS);
+            c->setMigrationPending(true);
             break;
 
         case ENGINE_DISCONNECT:
@@ -2458,6 +2536,45 @@ static void dcp_control_executor(McbpConnection* c, void* packet) {
     }
 }
 
+/**
+ * The command context used by the mutations while the value is being
+ * validated as JSON by the executor pool
+ */
+class JsonValidationContext : public CommandContext {
+public:
+    JsonValidationContext()
+        : json(false) {
+    }
+
+    std::shared_ptr<Task> task;
+
+    /** Set by the task if the value is JSON */
+    bool json;
+};
+
+/**
+ * Validate a large value as JSON on the executor pool instead of blocking
+ * all of the other connections served by this thread. The connection is
+ * notified when the validation is done, and the mutation is resumed (the
+ * item is kept in the connection).
+ */
+static void offload_json_validation(McbpConnection* c, const iovec& value) {
+    auto* context = new JsonValidationContext;
+    c->setCommandContext(context);
+
+    const auto* ptr = reinterpret_cast<const uint8_t*>(value.iov_base);
+    const auto len = value.iov_len;
+    context->task = std::make_shared<OffloadTask>(
+        c->getCookie(), "json_validate", [context, ptr, len]() {
+            JSON_checker::Validator validator;
+            context->json = validator.validate(ptr, len);
+            return ENGINE_SUCCESS;
+        });
+
+    c->setEwouldblock(true);
+    schedule_offload_task(context->task);
+}
+
 static void add_set_replace_executor(McbpConnection* c, void* packet,
                                      ENGINE_STORE_OPERATION store_op) {
     auto* req = reinterpret_cast<protocol_binary_request_add*>(packet);
@@ -2530,6 +2647,11 @@ static void add_set_replace_executor(McbpConnection* c, void* packet,
             auto* validator = c->getThread()->validator;
 
             try {
+                if (should_offload(vlen)) {
+                    offload_json_validation(c, info.info.value[0]);
+                    return;
+                }
+
                 auto* ptr = reinterpret_cast<uint8_t*>(info.info.value[0].iov_base);
                 if (validator->validate(ptr, info.info.value[0].iov_len)) {
                     info.info.datatype = PROTOCOL_BINARY_DATATYPE_JSON;
@@ -2548,6 +2670,23 @@ static void add_set_replace_executor(McbpConnection* c, void* packet,
         }
     }
 
+    auto* validation =
+        dynamic_cast<JsonValidationContext*>(c->getCommandContext());
+    if (validation != nullptr) {
+        if (ret == ENGINE_SUCCESS && validation->json) {
+            if (!bucket_get_item_info(c, c->getItem(), &info.info)) {
+                LOG_WARNING(c, "%u: Failed to get item info", c->getId());
+            } else {
+                info.info.datatype = PROTOCOL_BINARY_DATATYPE_JSON;
+                if (!bucket_set_item_info(c, c->getItem(), &info.info)) {
+                    LOG_WARNING(c, "%u: Failed to set item info",
+                                c->getId());
+                }
+            }
+        }
+        c->resetCommandContext();
+    }
+
     if (ret == ENGINE_SUCCESS) {
         uint64_t cas = c->getCAS();
         ret = bucket_store(c, c->getItem(), &cas, store_op);
@@ -2709,6 +2848,15 @@ static void get_executor(McbpConnection* c, void* packet) {
     process_bin_get(c, packet);
 }
 
+static void get_multi_executor(McbpConnection* c, void* packet) {
+    if (c->getCommandContext() == nullptr) {
+        auto* req = reinterpret_cast<protocol_binary_request_get_multi*>(packet);
+        c->setCommandContext(new GetMultiCommandContext(*c, req));
+    }
+
+    c->getSteppableCommandContext().drive();
+}
+
 /**
  * This is a very slow thing that you shouldn't use in production ;-)
  *
@@ -2953,6 +3101,212 @@ static ENGINE_ERROR_CODE stat_subdoc_execute_executor(const std::string& arg,
     }
 }
 
+/**
+ * Handler for the <code>stats scheduler</code> command used to retrieve
+ * the time the connections in each priority class spent in the ready
+ * queues of the worker threads before they got to run.
+ *
+ * @param arg - should be empty
+ * @param connection the connection that requested the operation
+ */
+static ENGINE_ERROR_CODE stat_scheduler_executor(const std::string& arg,
+                                                 McbpConnection& connection) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    const std::vector<std::pair<Connection::Priority, std::string>> classes = {
+        {Connection::Priority::High, "queue_time_high"},
+        {Connection::Priority::Medium, "queue_time_medium"},
+        {Connection::Priority::Low, "queue_time_low"}
+    };
+
+    for (const auto& cls : classes) {
+        TimingHistogram aggregated;
+        threads_aggregate_queue_times(cls.first, aggregated);
+        const auto json_str = aggregated.to_string();
+        append_stats(cls.second.data(), uint16_t(cls.second.size()),
+                     json_str.data(), uint32_t(json_str.size()),
+                     connection.getCookie());
+    }
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats executor</code> command used to retrieve
+ * the number of tasks in the run queues of the executor pool, and the
+ * time they waited for an executor, per type of task.
+ *
+ * @param arg - should be empty
+ * @param connection the connection that requested the operation
+ */
+static ENGINE_ERROR_CODE stat_executor_executor(const std::string& arg,
+                                                McbpConnection& connection) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    const auto* cookie = connection.getCookie();
+    add_stat(cookie, append_stats, "threads", uint64_t(executorPool->size()));
+    add_stat(cookie, append_stats, "stolen", executorPool->getStolenTasks());
+
+    for (auto& entry : executorPool->getTaskStats()) {
+        const auto& name = entry.first;
+        auto& stats = entry.second;
+        add_stat(cookie, append_stats, (name + "_scheduled").c_str(),
+                 stats.scheduled);
+        add_stat(cookie, append_stats, (name + "_queued").c_str(),
+                 stats.queued);
+        add_stat(cookie, append_stats, (name + "_wait_time").c_str(),
+                 stats.waitTimes.to_string());
+    }
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats topology</code> command used to retrieve
+ * the NUMA nodes (and their CPUs) of the machine, and the CPUs each class
+ * of threads is bound to.
+ *
+ * @param arg - should be empty
+ * @param connection the connection that requested the operation
+ */
+static ENGINE_ERROR_CODE stat_topology_executor(const std::string& arg,
+                                                McbpConnection& connection) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    const auto* cookie = connection.getCookie();
+    const auto& topology = CpuTopology::getInstance();
+    const auto& affinity = settings.getCpuAffinity();
+    char key[64];
+
+    add_stat(cookie, append_stats, "nodes",
+             uint32_t(topology.getNodes().size()));
+    for (const auto& node : topology.getNodes()) {
+        snprintf(key, sizeof(key), "node_%d_cpus", node.id);
+        add_stat(cookie, append_stats, key,
+                 cpu_list_to_string(node.cpus));
+    }
+    add_stat(cookie, append_stats, "numa_binding", affinity.isNumaBinding());
+
+    for (auto tc : {ThreadClass::Dispatcher, ThreadClass::Executors,
+                    ThreadClass::Background}) {
+        const auto& cpus = affinity.getCpus(tc);
+        snprintf(key, sizeof(key), "%s_cpus", to_string(tc));
+        add_stat(cookie, append_stats, key,
+                 cpus.empty() ? std::string("all") : cpu_list_to_string(cpus));
+    }
+
+    for (int ii = 0; ii < settings.getNumTotalWorkerThreads(); ++ii) {
+        int node;
+        const auto cpus = topology.getThreadCpus(
+            affinity.getCpus(ThreadClass::Workers), affinity.isNumaBinding(),
+            size_t(ii), node);
+        snprintf(key, sizeof(key), "worker_%d_cpus", ii);
+        add_stat(cookie, append_stats, key,
+                 cpus.empty() ? std::string("all") : cpu_list_to_string(cpus));
+        snprintf(key, sizeof(key), "worker_%d_node", ii);
+        add_stat(cookie, append_stats, key, int32_t(node));
+    }
+
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats latency</code> command used to retrieve
+ * the percentiles of the time spent on each command (in ns) for the
+ * bucket the connection is connected to. Connections not connected to
+ * a bucket (and authenticated as admin) get the timings aggregated for
+ * all of the buckets.
+ *
+ * @param arg - should be empty
+ * @param connection the connection that requested the operation
+ */
+static ENGINE_ERROR_CODE stat_latency_executor(const std::string& arg,
+                                               McbpConnection& connection) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    const auto* cookie = connection.getCookie();
+    const int index = connection.getBucketIndex();
+    if (index == 0 && !cookie_is_admin(cookie)) {
+        // Don't leak the global stats
+        return ENGINE_EACCESS;
+    }
+
+    const std::vector<std::pair<std::string, double>> percentiles = {
+        {"p50", 50.0}, {"p90", 90.0}, {"p99", 99.0}, {"p99.9", 99.9}
+    };
+
+    for (int opcode = 0; opcode < MAX_NUM_OPCODES; ++opcode) {
+        const auto histogram =
+            all_buckets[index].timings.get_histogram(uint8_t(opcode));
+        if (histogram.getTotal() == 0) {
+            continue;
+        }
+
+        const char* name = memcached_opcode_2_text(uint8_t(opcode));
+        std::string prefix;
+        if (name == nullptr) {
+            prefix = std::to_string(opcode);
+        } else {
+            prefix.assign(name);
+            std::transform(prefix.begin(), prefix.end(), prefix.begin(),
+                           ::tolower);
+        }
+
+        add_stat(cookie, append_stats, (prefix + "_count").c_str(),
+                 histogram.getTotal());
+        for (const auto& p : percentiles) {
+            add_stat(cookie, append_stats, (prefix + "_" + p.first).c_str(),
+                     uint64_t(histogram.getValueAtPercentile(p.second)));
+        }
+        add_stat(cookie, append_stats, (prefix + "_max").c_str(),
+                 uint64_t(histogram.getMax()));
+    }
+
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats latency_breakdown</code> command used to
+ * retrieve the histograms of the time the commands spent in each phase
+ * (see LatencyBreakdown) for the bucket the connection is connected to.
+ * The histograms are only recorded when the latency_breakdown setting is
+ * enabled.
+ *
+ * @param arg - the name of a phase, or empty for all of them
+ * @param connection the connection that requested the operation
+ */
+static ENGINE_ERROR_CODE stat_latency_breakdown_executor(
+        const std::string& arg, McbpConnection& connection) {
+    const auto* cookie = connection.getCookie();
+    const int index = connection.getBucketIndex();
+    if (index == 0 && !cookie_is_admin(cookie)) {
+        // Don't leak the global stats
+        return ENGINE_EACCESS;
+    }
+
+    bool found = false;
+    for (auto phase : {LatencyBreakdown::Phase::Queue,
+                       LatencyBreakdown::Phase::Engine,
+                       LatencyBreakdown::Phase::Ewouldblock,
+                       LatencyBreakdown::Phase::Send}) {
+        const char* name = LatencyBreakdown::to_string(phase);
+        if (arg.empty() || arg == name) {
+            const auto json_str =
+                all_buckets[index].timings.generate_phase(phase);
+            add_stat(cookie, append_stats, name, json_str);
+            found = true;
+        }
+    }
+
+    return found ? ENGINE_SUCCESS : ENGINE_EINVAL;
+}
+
 static void stat_executor(McbpConnection* c, void*) {
     struct stat_handler {
         /**
@@ -2979,7 +3333,12 @@ static void stat_executor(McbpConnection* c, void*) {
         {"connections", {false, stat_connections_executor}},
         {"topkeys", {false, stat_topkeys_executor}},
         {"topkeys_json", {false, stat_topkeys_json_executor}},
-        {"subdoc_execute", {false, stat_subdoc_execute_executor}}
+        {"subdoc_execute", {false, stat_subdoc_execute_executor}},
+        {"scheduler", {false, stat_scheduler_executor}},
+        {"executor", {false, stat_executor_executor}},
+        {"topology", {false, stat_topology_executor}},
+        {"latency", {false, stat_latency_executor}},
+        {"latency_breakdown", {false, stat_latency_breakdown_executor}}
     };
 
     // The raw representing the key
@@ -3152,6 +3511,9 @@ static void process_hello_packet_executor(McbpConnection* c, void* packet) {
     c->setSupportsDatatype(false);
     c->setSupportsMutationExtras(false);
     c->setXattrSupport(false);
+    c->setUnorderedExecution(false);
+    c->setDeadlineSupport(false);
+    c->setTracingEnabled(false);
 
     if (klen) {
         if (klen > 256) {
@@ -3206,6 +3568,25 @@ static void process_hello_packet_executor(McbpConnection* c, void* packet) {
                 c->setXattrSupport(true);
                 added = true;
             }
+            break;
+        case mcbp::Feature::UNORDERED_EXECUTION:
+            if (!c->isUnorderedExecution()) {
+                c->setUnorderedExecution(true);
+                added = true;
+            }
+            break;
+        case mcbp::Feature::DEADLINE:
+            if (!c->isDeadlineSupport()) {
+                c->setDeadlineSupport(true);
+                added = true;
+            }
+            break;
+        case mcbp::Feature::TRACING:
+            if (!c->isTracingEnabled()) {
+                c->setTracingEnabled(true);
+                added = true;
+            }
+            break;
         }
 
         if (added) {
@@ -3559,6 +3940,52 @@ static void ioctl_get_executor(McbpConnection* c, void* packet) {
     }
 }
 
+/**
+ * Get the spans of the recent requests on the connection (or the span
+ * of the request with the opaque in the extras)
+ */
+static void get_trace_spans_executor(McbpConnection* c, void* packet) {
+    auto* req = reinterpret_cast<protocol_binary_request_get_trace_spans*>(
+            packet);
+
+    if (!c->isTracingEnabled()) {
+        mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_NOT_SUPPORTED);
+        return;
+    }
+
+    std::string value;
+    try {
+        const auto& spans = c->getRequestSpans();
+        if (req->message.header.request.extlen == sizeof(uint32_t)) {
+            uint32_t opaque;
+            memcpy(&opaque, req->bytes + sizeof(req->bytes), sizeof(opaque));
+            const auto* span = spans.find(opaque);
+            if (span == nullptr) {
+                mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_KEY_ENOENT);
+                return;
+            }
+            value = to_string(span->toJSON(), false);
+        } else {
+            value = to_string(spans.toJSON(), false);
+        }
+    } catch (const std::bad_alloc&) {
+        mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_ENOMEM);
+        return;
+    }
+
+    const auto datatype = c->isSupportsDatatype() ?
+                          PROTOCOL_BINARY_DATATYPE_JSON :
+                          PROTOCOL_BINARY_RAW_BYTES;
+    if (mcbp_response_handler(NULL, 0, NULL, 0, value.data(),
+                              uint32_t(value.size()), datatype,
+                              PROTOCOL_BINARY_RESPONSE_SUCCESS, 0,
+                              c->getCookie())) {
+        mcbp_write_and_free(c, &c->getDynamicBuffer());
+    } else {
+        mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_ENOMEM);
+    }
+}
+
 static void ioctl_set_executor(McbpConnection* c, void* packet) {
     auto* req = reinterpret_cast<protocol_binary_request_ioctl_set*>(packet);
 
@@ -3687,7 +4114,9 @@ public:
                          const BucketType& type_,
                          McbpConnection& connection_)
         : thread(name_, config_, type_, connection_, this),
-          mcbpconnection(connection_) { }
+          mcbpconnection(connection_) {
+        setPriority(Priority::Low);
+    }
 
     // start the bucket deletion
     // May throw std::bad_alloc if we're failing to start the thread
@@ -3703,6 +4132,10 @@ public:
         notify_io_complete(mcbpconnection.getCookie(), thread.getResult());
     }
 
+    virtual const char* getName() const override {
+        return "create_bucket";
+    }
+
     CreateBucketThread thread;
     McbpConnection& mcbpconnection;
 };
@@ -3952,6 +4385,8 @@ std::array<mcbp_package_execute, 0x100>& get_mcbp_executors(void) {
     executors[PROTOCOL_BINARY_CMD_GET] = get_executor;
     executors[PROTOCOL_BINARY_CMD_GETQ] = get_executor;
     executors[PROTOCOL_BINARY_CMD_GETK] = get_executor;
+    executors[PROTOCOL_BINARY_CMD_GET_MULTI] = get_multi_executor;
+    executors[PROTOCOL_BINARY_CMD_GET_TRACE_SPANS] = get_trace_spans_executor;
     executors[PROTOCOL_BINARY_CMD_GETKQ] = get_executor;
     executors[PROTOCOL_BINARY_CMD_DELETE] = delete_executor;
     executors[PROTOCOL_BINARY_CMD_DELETEQ] = delete_executor;
@@ -4088,17 +4523,246 @@ static protocol_binary_response_status validate_bin_header(McbpConnection* c) {
     }
 }
 
+/**
+ * Shed the command if the deadline the client specified for it has
+ * passed (the client has most likely given up on it already). The
+ * command is answered with PROTOCOL_BINARY_RESPONSE_DEADLINE_EXCEEDED
+ * without being passed to the engine.
+ *
+ * A command blocked in the engine which keeps state in the engine
+ * specific storage is left alone so that the engine gets the chance to
+ * release it.
+ *
+ * @return true if the command was shed
+ */
+static bool shed_expired_command(McbpConnection* c) {
+    const auto deadline = c->getCookieObject().deadline;
+    if (deadline == 0 || gethrtime() < deadline ||
+        c->getEngineStorage() != nullptr) {
+        return false;
+    }
+
+    get_thread_stats(c)->cmd_deadline_exceeded++;
+    c->setAiostat(ENGINE_SUCCESS);
+    c->setRateLimitedSince(0);
+    mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_DEADLINE_EXCEEDED);
+    return true;
+}
+
+/**
+ * Execute a command which may be reordered on a connection using unordered
+ * execution. The command runs with its own copy of the packet and its own
+ * cookie so that it may be parked if the engine would block.
+ */
+static void execute_parkable_command(McbpConnection* c,
+                                     mcbp_package_execute executor,
+                                     const char* packet) {
+    auto* copy = c->startParkableCommand(packet,
+                                         sizeof(c->binary_header) +
+                                         c->binary_header.request.bodylen);
+    executor(c, copy);
+    if (c->isEwouldblock()) {
+        c->parkCommand();
+        get_thread_stats(c)->cmd_parked++;
+    }
+}
+
+bool mcbp_resume_parked_command(McbpConnection* c) {
+    if (!c->hasParkedCommands()) {
+        return false;
+    }
+
+    auto* packet = c->resumeParkedCommand();
+    if (packet == nullptr) {
+        return false;
+    }
+
+    c->addMsgHdr(true);
+    if (shed_expired_command(c)) {
+        return true;
+    }
+    executors[c->getCmd()](c, packet);
+    if (c->isEwouldblock()) {
+        c->parkCommand();
+    }
+
+    return true;
+}
+
+bool mcbp_is_parked_barrier(McbpConnection* c) {
+    if (c->read.bytes < sizeof(protocol_binary_request_header)) {
+        // We don't know the next command yet
+        return false;
+    }
+
+    auto* req = reinterpret_cast<protocol_binary_request_header*>(c->read.curr);
+    // The alternative request magic is only valid on connections which
+    // negotiated deadlines; on other connections it is as unknown as any
+    // other magic
+    const bool request = req->request.magic == PROTOCOL_BINARY_REQ ||
+                         (req->request.magic == PROTOCOL_BINARY_AREQ &&
+                          c->isDeadlineSupport());
+    return !request || !ParkedCommand::isReorderable(req->request.opcode);
+}
+
+/**
+ * Is the command subject to the rate limits of the bucket? The commands
+ * used to set up the connection (and the ones which doesn't touch the
+ * bucket) are always allowed so that a rate limited client may still
+ * authenticate and switch bucket.
+ */
+static bool is_rate_limited_command(protocol_binary_command opcode) {
+    switch (opcode) {
+    case PROTOCOL_BINARY_CMD_HELLO:
+    case PROTOCOL_BINARY_CMD_SASL_LIST_MECHS:
+    case PROTOCOL_BINARY_CMD_SASL_AUTH:
+    case PROTOCOL_BINARY_CMD_SASL_STEP:
+    case PROTOCOL_BINARY_CMD_SELECT_BUCKET:
+    case PROTOCOL_BINARY_CMD_LIST_BUCKETS:
+    case PROTOCOL_BINARY_CMD_NOOP:
+    case PROTOCOL_BINARY_CMD_VERSION:
+    case PROTOCOL_BINARY_CMD_QUIT:
+    case PROTOCOL_BINARY_CMD_QUITQ:
+    case PROTOCOL_BINARY_CMD_GET_TRACE_SPANS:
+        return false;
+    default:
+        return true;
+    }
+}
+
+/**
+ * Check the command against the rate limits of the connected bucket.
+ *
+ * If the limits are exceeded the command is either delayed (the
+ * connection blocks, and the command is retried when the rate limiter
+ * expects it to be admitted) or rejected with
+ * PROTOCOL_BINARY_RESPONSE_RATE_LIMITED if it would be delayed for
+ * longer than the max delay configured for the bucket.
+ *
+ * @return true if the command may be executed
+ */
+static bool admit_command(McbpConnection* c, protocol_binary_command opcode) {
+    auto& limiter = all_buckets[c->getBucketIndex()].rateLimiter;
+    if (!limiter.isEnabled() || c->isAdmin() || c->isDCP() || c->isTAP() ||
+        !is_rate_limited_command(opcode)) {
+        return true;
+    }
+
+    const auto now = gethrtime();
+    const size_t size = sizeof(c->binary_header) +
+                        c->binary_header.request.bodylen;
+    const auto wait = limiter.admit(size, now);
+    auto* thread_stats = get_thread_stats(c);
+    auto since = c->getRateLimitedSince();
+
+    if (wait == 0) {
+        if (since != 0) {
+            limiter.addDelay(now - since);
+            thread_stats->rate_delay_ns += now - since;
+            c->setRateLimitedSince(0);
+        }
+        return true;
+    }
+
+    if (since == 0) {
+        since = now;
+    }
+    const hrtime_t max_delay = hrtime_t(limiter.getMaxDelay()) * 1000000;
+    if ((now - since) + wait <= max_delay) {
+        const uint64_t usec = wait / 1000 + 1;
+        struct timeval tv;
+        tv.tv_sec = long(usec / 1000000);
+        tv.tv_usec = long(usec % 1000000);
+        if (c->scheduleRateLimitRetry(tv)) {
+            if (c->getRateLimitedSince() == 0) {
+                thread_stats->cmd_rate_delayed++;
+                c->setRateLimitedSince(since);
+            }
+            c->setEwouldblock(true);
+            return false;
+        }
+        LOG_WARNING(c, "%u: Failed to schedule retry of rate limited command",
+                    c->getId());
+    }
+
+    if (c->getRateLimitedSince() != 0) {
+        thread_stats->rate_delay_ns += now - since;
+        c->setRateLimitedSince(0);
+    }
+    thread_stats->cmd_rate_limited++;
+    mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_RATE_LIMITED);
+    return false;
+}
+
+/**
+ * Decode the framing extras of a packet using the alternative request
+ * format, and strip them off the packet (the header is moved up to the
+ * start of the extras) so that the rest of the core sees a normal
+ * request.
+ *
+ * @return false if the framing extras are invalid
+ */
+static bool decode_framing_extras(McbpConnection* c) {
+    const uint8_t framing = c->getFramingExtlen();
+    auto& header = c->binary_header.request;
+    if (uint32_t(framing) + header.keylen + header.extlen > header.bodylen) {
+        return false;
+    }
+
+    char* packet = c->read.curr - (header.bodylen + sizeof(c->binary_header));
+    const auto* info = reinterpret_cast<const uint8_t*>(packet) +
+                       sizeof(c->binary_header);
+    size_t offset = 0;
+    while (offset < framing) {
+        const auto id = mcbp::FrameInfoId(info[offset] >> 4);
+        const size_t length = info[offset] & 0x0f;
+        ++offset;
+        if (offset + length > framing) {
+            return false;
+        }
+
+        switch (id) {
+        case mcbp::FrameInfoId::Timeout: {
+            if (length != sizeof(uint32_t)) {
+                return false;
+            }
+            uint32_t timeout;
+            memcpy(&timeout, info + offset, sizeof(timeout));
+            c->getCookieObject().deadline = c->getStart() +
+                                            hrtime_t(ntohl(timeout)) * 1000;
+            break;
+        }
+        default:
+            return false;
+        }
+        offset += length;
+    }
+
+    auto* req = reinterpret_cast<protocol_binary_request_header*>(packet +
+                                                                  framing);
+    memmove(req, packet, sizeof(*req));
+    header.magic = PROTOCOL_BINARY_REQ;
+    header.bodylen -= framing;
+    req->request.magic = PROTOCOL_BINARY_REQ;
+    req->request.keylen = htons(header.keylen);
+    req->request.bodylen = htonl(header.bodylen);
+    c->setFramingExtlen(0);
+    return true;
+}
+
 static void process_bin_packet(McbpConnection* c) {
-    static McbpPrivilegeChains privilegeChains;
+    static McbpDispatchTable dispatchTable(executors);
     protocol_binary_response_status result;
 
     char* packet = (c->read.curr - (c->binary_header.request.bodylen +
                                     sizeof(c->binary_header)));
 
     auto opcode = static_cast<protocol_binary_command>(c->binary_header.request.opcode);
-    auto executor = executors[opcode];
+    const auto& descriptor = dispatchTable[opcode];
 
-    auto res = privilegeChains.invoke(opcode, c->getCookieObject());
+    auto res = descriptor.accessible ?
+               c->checkPrivileges(descriptor.privileges) :
+               PrivilegeAccess::Fail;
     switch (res) {
     case PrivilegeAccess::Fail:
         LOG_WARNING(c,
@@ -4110,6 +4774,10 @@ static void process_bin_packet(McbpConnection* c) {
         return;
     case PrivilegeAccess::Ok:
         result = validate_bin_header(c);
+        if (result == PROTOCOL_BINARY_RESPONSE_SUCCESS &&
+            descriptor.validator != nullptr) {
+            result = descriptor.validator(c->getCookieObject());
+        }
         if (result == PROTOCOL_BINARY_RESPONSE_SUCCESS) {
             result = c->validateCommand(opcode);
         }
@@ -4125,8 +4793,29 @@ static void process_bin_packet(McbpConnection* c) {
             return;
         }
 
-        if (executor != NULL) {
-            executor(c, packet);
+        if (shed_expired_command(c)) {
+            return;
+        }
+
+        if (!admit_command(c, opcode)) {
+            return;
+        }
+
+        if (descriptor.executor != NULL) {
+            if (descriptor.reorderable && c->isUnorderedExecution() &&
+                !c->isDCP() && !c->isTAP()) {
+                execute_parkable_command(c, descriptor.executor, packet);
+            } else {
+                auto& latency = c->getCookieObject().latency;
+                const bool breakdown = latency.isActive();
+                if (breakdown) {
+                    latency.enterEngine(gethrtime());
+                }
+                descriptor.executor(c, packet);
+                if (breakdown) {
+                    latency.exitEngine(gethrtime());
+                }
+            }
         } else {
             process_bin_unknown_packet(c);
         }
@@ -4224,6 +4913,15 @@ void mcbp_complete_nread(McbpConnection* c) {
             c->setState(conn_closing);
         }
     } else {
+        if (c->getFramingExtlen() != 0 && !decode_framing_extras(c)) {
+            LOG_NOTICE(c, "%u: Invalid framing extras for %s - closing "
+                           "connection", c->getId(),
+                       memcached_opcode_2_text(c->binary_header.request.opcode));
+            audit_invalid_packet(c);
+            mcbp_write_packet(c, PROTOCOL_BINARY_RESPONSE_EINVAL);
+            c->setWriteAndGo(conn_closing);
+            return;
+        }
         process_bin_packet(c);
     }
 }
@@ -4269,10 +4967,26 @@ int try_read_mcbp_command(McbpConnection* c) {
         c->binary_header.request.bodylen = ntohl(req->request.bodylen);
         c->binary_header.request.vbucket = ntohs(req->request.vbucket);
         c->binary_header.request.cas = ntohll(req->request.cas);
+        c->setFramingExtlen(0);
+        auto& cookie = c->getCookieObject();
+        cookie.deadline = 0;
+        cookie.ewouldblocks = 0;
+        if (settings.isLatencyBreakdown() || c->isTracingEnabled()) {
+            cookie.latency.start(gethrtime());
+        } else if (cookie.latency.isActive()) {
+            cookie.latency.reset();
+        }
 
-        if (c->binary_header.request.magic != PROTOCOL_BINARY_REQ &&
-            !(c->binary_header.request.magic == PROTOCOL_BINARY_RES &&
-              response_handlers[c->binary_header.request.opcode])) {
+        if (c->binary_header.request.magic == PROTOCOL_BINARY_AREQ &&
+            c->isDeadlineSupport()) {
+            // The alternative request format use the first byte of the
+            // key length for the length of the framing extras (which
+            // are stripped off before the command is executed)
+            c->setFramingExtlen(req->bytes[2]);
+            c->binary_header.request.keylen = req->bytes[3];
+        } else if (c->binary_header.request.magic != PROTOCOL_BINARY_REQ &&
+                   !(c->binary_header.request.magic == PROTOCOL_BINARY_RES &&
+                     response_handlers[c->binary_header.request.opcode])) {
             if (c->binary_header.request.magic != PROTOCOL_BINARY_RES) {
                 LOG_WARNING(c, "%u: Invalid magic: %x, closing connection",
                             c->getId(), c->binary_header.request.magic);
@@ -39,6 +39,25 @@ void mcbp_complete_nread(McbpConnection *c);
 
 int try_read_mcbp_command(McbpConnection *c);
 
+/**
+ * Resume the oldest parked command the engine has notified (if any) on
+ * a connection using unordered execution.
+ *
+ * @param c the connection between two commands
+ * @return true if a command was resumed (and the state of the connection
+ *         updated), false otherwise
+ */
+bool mcbp_resume_parked_command(McbpConnection* c);
+
+/**
+ * Check if the next command in the input buffer has to wait for the
+ * parked commands on the connection to complete before it may start.
+ *
+ * @param c the connection to check
+ * @return true if the next command is a barrier
+ */
+bool mcbp_is_parked_barrier(McbpConnection* c);
+
 void initialize_mbcp_lookup_map(void);
 
 void ship_mcbp_tap_log(McbpConnection* c);
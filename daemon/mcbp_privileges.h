@@ -21,15 +21,18 @@
 #include <memcached/protocol_binary.h>
 #include <memcached/privileges.h>
 #include "cookie.h"
-#include "function_chain.h"
 
 /**
  * The MCBP privilege chains.
  *
- * This class contains the privilege chains for each of the specified
+ * This class contains the privileges required for each of the specified
  * opcodes to allow for a first defence to deny connections access to
  * certain commands. The implementation of certain commands may perform
  * additional checks.
+ *
+ * All of the rules is a set of privileges the connection must hold, so
+ * they're stored as a PrivilegeMask per opcode rather than a chain of
+ * functions (which would cost us an indirect call per privilege).
  */
 class McbpPrivilegeChains {
 public:
@@ -48,28 +51,38 @@ public:
      *         Stale - the authentication context is out of date
      */
     PrivilegeAccess invoke(protocol_binary_command command,
-                           const Cookie& cookie) {
-        auto& chain = commandChains[command];
-        if (chain.empty()) {
-            return PrivilegeAccess::Fail;
-        } else {
-            return chain.invoke(cookie);
-        }
+                           const Cookie& cookie) const;
+
+    /**
+     * Is there a rule set up for the command?
+     */
+    bool isDefined(uint8_t command) const {
+        return defined[command];
+    }
+
+    /**
+     * Get the privileges the connection must hold to run the command
+     */
+    PrivilegeMask getPrivileges(uint8_t command) const {
+        return privileges[command];
     }
 
 protected:
     /*
-     * Silently ignores any attempt to push the same function onto the chain.
+     * Require the privilege for the command
      */
-    void setup(protocol_binary_command command,
-              PrivilegeAccess(* f)(const Cookie&)) {
-        commandChains[command].push_unique(makeFunction<PrivilegeAccess,
-            PrivilegeAccess::Ok,
-            const Cookie&>(f));
+    void setup(protocol_binary_command command, Privilege privilege) {
+        defined[command] = true;
+        privileges[command] |= privilegeToMask(privilege);
     }
 
+    /*
+     * Allow everyone to run the command
+     */
+    void setup(protocol_binary_command command) {
+        defined[command] = true;
+    }
 
-    std::array<FunctionChain<PrivilegeAccess,
-        PrivilegeAccess::Ok,
-        const Cookie&>, 0x100> commandChains;
-};
\ No newline at end of file
+    std::array<bool, 0x100> defined;
+    std::array<PrivilegeMask, 0x100> privileges;
+};
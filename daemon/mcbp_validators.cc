@@ -481,6 +481,57 @@ static protocol_binary_response_status get_validator(const Cookie& cookie)
     return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
+static protocol_binary_response_status get_multi_validator(const Cookie& cookie)
+{
+    auto req = static_cast<protocol_binary_request_get_multi*>(McbpConnection::getPacket(cookie));
+    uint32_t blen = ntohl(req->message.header.request.bodylen);
+
+    if (req->message.header.request.magic != PROTOCOL_BINARY_REQ ||
+        req->message.header.request.extlen != 0 ||
+        req->message.header.request.keylen != 0 || blen == 0 ||
+        req->message.header.request.datatype != PROTOCOL_BINARY_RAW_BYTES ||
+        req->message.header.request.cas != 0) {
+        return PROTOCOL_BINARY_RESPONSE_EINVAL;
+    }
+
+    // Verify that the list of keys exactly covers the body
+    const uint8_t* ptr = req->bytes + sizeof(req->bytes);
+    uint32_t offset = 0;
+    while (offset < blen) {
+        protocol_binary_get_multi_entry entry;
+        if (blen - offset < sizeof(entry)) {
+            return PROTOCOL_BINARY_RESPONSE_EINVAL;
+        }
+        memcpy(&entry, ptr + offset, sizeof(entry));
+        offset += sizeof(entry);
+
+        uint16_t klen = ntohs(entry.keylen);
+        if (klen == 0 || blen - offset < klen) {
+            return PROTOCOL_BINARY_RESPONSE_EINVAL;
+        }
+        offset += klen;
+    }
+
+    return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+}
+
+static protocol_binary_response_status get_trace_spans_validator(const Cookie& cookie)
+{
+    auto req = static_cast<protocol_binary_request_get_trace_spans*>(McbpConnection::getPacket(cookie));
+    const uint8_t extlen = req->message.header.request.extlen;
+
+    if (req->message.header.request.magic != PROTOCOL_BINARY_REQ ||
+        (extlen != 0 && extlen != sizeof(uint32_t)) ||
+        req->message.header.request.keylen != 0 ||
+        ntohl(req->message.header.request.bodylen) != extlen ||
+        req->message.header.request.datatype != PROTOCOL_BINARY_RAW_BYTES ||
+        req->message.header.request.cas != 0) {
+        return PROTOCOL_BINARY_RESPONSE_EINVAL;
+    }
+
+    return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+}
+
 static protocol_binary_response_status delete_validator(const Cookie& cookie)
 {
     auto req = static_cast<protocol_binary_request_no_extras*>(McbpConnection::getPacket(cookie));
@@ -873,6 +924,8 @@ void McbpValidatorChains::initializeMcbpValidatorChains(McbpValidatorChains& cha
     chains.push_unique(PROTOCOL_BINARY_CMD_GETQ, get_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_GETK, get_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_GETKQ, get_validator);
+    chains.push_unique(PROTOCOL_BINARY_CMD_GET_MULTI, get_multi_validator);
+    chains.push_unique(PROTOCOL_BINARY_CMD_GET_TRACE_SPANS, get_trace_spans_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_DELETE, delete_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_DELETEQ, delete_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_STAT, stat_validator);
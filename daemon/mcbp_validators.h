@@ -25,32 +25,77 @@
 #include "cookie.h"
 #include "function_chain.h"
 
+/**
+ * A validator for a memcached binary protocol packet
+ */
+typedef protocol_binary_response_status (*McbpValidator)(const Cookie&);
+
 /*
  * The MCBP validator chains.
  *
- * Class stores a chain per opcode allowing a sequence of command validators to be
- * configured, stored and invoked.
+ * Class stores a validator per opcode, and a chain of additional validators
+ * for the opcodes needing pluggable checks (for instance the collection
+ * validators added for the K/V commands when collections is enabled for
+ * a bucket). Most of the opcodes only have a single validator, so we
+ * don't want to pay for walking a chain of std::function objects for them.
  *
  */
 class McbpValidatorChains {
 public:
+    McbpValidatorChains() {
+        validators.fill(nullptr);
+    }
 
     /*
-     * Invoke the chain for the command
+     * Invoke the validator and the chain for the command
      */
     protocol_binary_response_status invoke(protocol_binary_command command,
-                                           const Cookie& cookie) {
-        return commandChains[command].invoke(cookie);
+                                           const Cookie& cookie) const {
+        const auto validator = validators[command];
+        if (validator != nullptr) {
+            const auto ret = validator(cookie);
+            if (ret != PROTOCOL_BINARY_RESPONSE_SUCCESS) {
+                return ret;
+            }
+        }
+        return invokeChain(command, cookie);
+    }
+
+    /*
+     * Invoke the chain of additional validators for the command (but not
+     * the validator returned by getValidator())
+     */
+    protocol_binary_response_status invokeChain(protocol_binary_command command,
+                                                const Cookie& cookie) const {
+        const auto& chain = commandChains[command];
+        if (chain.empty()) {
+            return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+        }
+        return chain.invoke(cookie);
     }
 
     /*
+     * Get the (first) validator for the command
+     */
+    McbpValidator getValidator(uint8_t command) const {
+        return validators[command];
+    }
+
+    /*
+     * The first function pushed for a command is its validator, the
+     * following ones are added to the commands chain.
+     *
      * Silently ignores any attempt to push the same function onto the chain.
      */
-    void push_unique(protocol_binary_command command,
-                     protocol_binary_response_status(*f)(const Cookie&)) {
-        commandChains[command].push_unique(makeFunction<protocol_binary_response_status,
-                                           PROTOCOL_BINARY_RESPONSE_SUCCESS,
-                                           const Cookie&>(f));
+    void push_unique(protocol_binary_command command, McbpValidator f) {
+        if (validators[command] == nullptr) {
+            validators[command] = f;
+        } else if (validators[command] != f) {
+            commandChains[command].push_unique(
+                makeFunction<protocol_binary_response_status,
+                             PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                             const Cookie&>(f));
+        }
     }
 
     /*
@@ -66,7 +111,9 @@ public:
 
 private:
 
+    std::array<McbpValidator, 0x100> validators;
+
     std::array<FunctionChain<protocol_binary_response_status,
                              PROTOCOL_BINARY_RESPONSE_SUCCESS,
                              const Cookie&>, 0x100> commandChains;
-};
\ No newline at end of file
+};
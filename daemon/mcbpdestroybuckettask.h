@@ -31,6 +31,7 @@ public:
                           bool force_,
                           Connection* connection_)
     : thread(name_, force_, connection_, this) {
+        setPriority(Priority::Low);
     }
 
     // start the bucket deletion
@@ -43,6 +44,10 @@ public:
         return true;
     }
 
+    virtual const char* getName() const override {
+        return "delete_bucket";
+    }
+
     virtual void notifyExecutionComplete() override {
         if (thread.getConnection() != nullptr) {
             // @todo i need to fix this for greenstack
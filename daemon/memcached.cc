@@ -16,6 +16,7 @@
 #include "config.h"
 #include "config_parse.h"
 #include "debug_helpers.h"
+#include "cpu_topology.h"
 #include "memcached.h"
 #include "memcached/extension_loggers.h"
 #include "memcached/audit_interface.h"
@@ -84,6 +85,11 @@
 #include <numa.h>
 #endif
 
+#ifndef WIN32
+#include <grp.h>
+#include <pwd.h>
+#endif
+
 static EXTENSION_LOG_LEVEL get_log_level(void);
 
 /**
@@ -122,7 +128,8 @@ protocol_binary_response_status Bucket::validateMcbpCommand(
                                                 const Connection* c,
                                                 protocol_binary_command command,
                                                 Cookie& cookie) {
-    return all_buckets[c->getBucketIndex()].validatorChains.invoke(command, cookie);
+    return all_buckets[c->getBucketIndex()].validatorChains.invokeChain(command,
+                                                                      cookie);
 }
 
 std::atomic<bool> memcached_shutdown;
@@ -132,6 +139,7 @@ std::atomic<bool> service_online;
 static std::atomic<bool> enable_common_ports;
 
 std::unique_ptr<ExecutorPool> executorPool;
+std::unique_ptr<SlowOperationLog> slowOperationLog;
 
 /* Mutex for global stats */
 std::mutex stats_mutex;
@@ -406,12 +414,23 @@ static void stats_init(void) {
     stats.total_conns.reset();
     stats.daemon_conns.reset();
     stats.rejected_conns.reset();
+    stats.replication_conns.reset();
+    stats.ktls_tx_conns.reset();
+    stats.ktls_rx_conns.reset();
+    stats.ktls_fallback.reset();
+    stats.ssl_handshakes.reset();
+    stats.ssl_handshakes_resumed.reset();
+    stats.ssl_handshake_time.reset();
+    stats.ssl_session_cache_hits.reset();
+    stats.ssl_session_cache_misses.reset();
+    stats.ssl_ticket_hits.reset();
+    stats.ssl_ticket_misses.reset();
     stats.curr_conns.store(0, std::memory_order_relaxed);
 }
 
 struct thread_stats *get_thread_stats(Connection *c) {
     struct thread_stats *independent_stats;
-    cb_assert(c->getThread()->index < (settings.getNumWorkerThreads() + 1));
+    cb_assert(c->getThread()->index < (settings.getNumTotalWorkerThreads() + 1));
     independent_stats = all_buckets[c->getBucketIndex()].stats;
     return &independent_stats[c->getThread()->index];
 }
@@ -432,6 +451,17 @@ void stats_reset(const void *void_cookie) {
     }
     stats.total_conns.reset();
     stats.rejected_conns.reset();
+    stats.replication_conns.reset();
+    stats.ktls_tx_conns.reset();
+    stats.ktls_rx_conns.reset();
+    stats.ktls_fallback.reset();
+    stats.ssl_handshakes.reset();
+    stats.ssl_handshakes_resumed.reset();
+    stats.ssl_handshake_time.reset();
+    stats.ssl_session_cache_hits.reset();
+    stats.ssl_session_cache_misses.reset();
+    stats.ssl_ticket_hits.reset();
+    stats.ssl_ticket_misses.reset();
     threadlocal_stats_reset(all_buckets[conn->getBucketIndex()].stats);
     bucket_reset_stats(conn);
 }
@@ -470,6 +500,11 @@ static void ssl_cipher_list_changed_listener(const std::string&, Settings &s) {
     set_ssl_cipher_list(s.getSslCipherList());
 }
 
+static void ssl_session_cache_size_changed_listener(const std::string&,
+                                                   Settings& s) {
+    set_ssl_session_cache_size(s.getSslSessionCacheSize());
+}
+
 static void verbosity_changed_listener(const std::string&, Settings &s) {
     perform_callbacks(ON_LOG_LEVEL, NULL, NULL);
 }
@@ -502,6 +537,8 @@ static void settings_init(void) {
                                ssl_minimum_protocol_changed_listener);
     settings.addChangeListener("ssl_cipher_list",
                                ssl_cipher_list_changed_listener);
+    settings.addChangeListener("ssl_session_cache_size",
+                               ssl_session_cache_size_changed_listener);
     settings.addChangeListener("verbosity", verbosity_changed_listener);
     settings.addChangeListener("interfaces", interfaces_changed_listener);
 
@@ -512,6 +549,7 @@ static void settings_init(void) {
 
     settings.setVerbose(0);
     settings.setConnectionIdleTime(0); // Connection idle time disabled
+    settings.setConnectionCompactTime(30);
     settings.setNumWorkerThreads(get_number_of_worker_threads());
     settings.setRequireSasl(false);
     settings.extensions.logger = get_stderr_logger();
@@ -532,6 +570,18 @@ static void settings_init(void) {
     settings.setAdmin("_admin");
     settings.setDedupeNmvbMaps(false);
 
+    // Let the kernel encrypt and decrypt the TLS records when it can
+    settings.setSslKtls(true);
+    settings.setSslSessionCacheSize(32768);
+    settings.setSslSessionTimeout(3600);
+    settings.setSslSessionTickets(true);
+
+    // Inflating and validating documents bigger than 1MB would stall all
+    // of the other connections served by the same thread
+    settings.setOffloadThreshold(1024 * 1024);
+    settings.setLatencyBreakdown(false);
+    settings.setSlowOpThreshold(100);
+
     char *tmp = getenv("MEMCACHED_TOP_KEYS");
     settings.setTopkeysSize(20);
     if (tmp != NULL) {
@@ -687,6 +737,8 @@ static void cbsasl_refresh_main(void *c)
     }
 
     if (rv == CBSASL_OK) {
+        // The connections need to rebuild their privilege context
+        Connection::invalidatePrivilegeContexts();
         notify_io_complete(c, ENGINE_SUCCESS);
     } else {
         notify_io_complete(c, ENGINE_EINVAL);
@@ -926,11 +978,12 @@ void event_handler(evutil_socket_t fd, short which, void *arg) {
     }
 
     /*
-     * Remove the list from the list of pending io's (in case the
-     * object was scheduled to run in the dispatcher before the
-     * callback for the worker thread is executed.
+     * Consume any pending io notification (in case the object was
+     * scheduled to run from the pending io queue before the callback
+     * for the worker thread is executed). The connection stays in the
+     * queue, but won't be run from there unless it is notified again.
      */
-    thr->pending_io = list_remove(thr->pending_io, c);
+    c->clearPendingIo();
 
     /* sanity */
     cb_assert(fd == c->getSocketDescriptor());
@@ -960,7 +1013,14 @@ void event_handler(evutil_socket_t fd, short which, void *arg) {
         }
     }
 
-    run_event_loop(c, which);
+    if (memcached_shutdown) {
+        // Run the connection right away so that it may be torn down
+        unschedule_connection(c);
+        run_event_loop(c, which);
+    } else {
+        // Let the scheduler decide when the connection gets to run
+        schedule_connection(c, which);
+    }
 
     if (memcached_shutdown) {
         // Someone requested memcached to shut down. If we don't have
@@ -1187,6 +1247,8 @@ static void add_listening_port(const struct interface *interf, in_port_t port, s
         } else if (family == AF_INET6) {
             newport.ipv4 = false;
             newport.ipv6 = true;
+        } else {
+            newport.path = interf->path;
         }
 
         stats.listening_ports.push_back(newport);
@@ -1200,6 +1262,129 @@ static void add_listening_port(const struct interface *interf, in_port_t port, s
     }
 }
 
+#ifndef WIN32
+/**
+ * Set the permissions and the owner of the unix domain socket
+ *
+ * @param interf the interface description
+ * @return true on success
+ */
+static bool set_unix_socket_permissions(const struct interface* interf) {
+    const char* path = interf->path.c_str();
+    if (chmod(path, mode_t(interf->permissions)) == -1) {
+        LOG_WARNING(nullptr, "Failed to set permissions %o on %s: %s",
+                    interf->permissions, path, strerror(errno));
+        return false;
+    }
+
+    if (interf->owner.empty() && interf->group.empty()) {
+        return true;
+    }
+
+    uid_t uid = uid_t(-1);
+    gid_t gid = gid_t(-1);
+    if (!interf->owner.empty()) {
+        auto* pw = getpwnam(interf->owner.c_str());
+        if (pw == nullptr) {
+            LOG_WARNING(nullptr, "Unknown user \"%s\" specified for %s",
+                        interf->owner.c_str(), path);
+            return false;
+        }
+        uid = pw->pw_uid;
+    }
+
+    if (!interf->group.empty()) {
+        auto* gr = getgrnam(interf->group.c_str());
+        if (gr == nullptr) {
+            LOG_WARNING(nullptr, "Unknown group \"%s\" specified for %s",
+                        interf->group.c_str(), path);
+            return false;
+        }
+        gid = gr->gr_gid;
+    }
+
+    if (chown(path, uid, gid) == -1) {
+        LOG_WARNING(nullptr, "Failed to change the owner of %s: %s",
+                    path, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Create a unix domain socket and bind it to the path specified in the
+ * interface. The connections accepted on the socket use the same path
+ * as the TCP connections (the port number in the interface identifies
+ * the listening port).
+ *
+ * @param interf the interface to bind to
+ * @return 0 on success, 1 otherwise
+ */
+static int server_unix_socket(const struct interface* interf) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (interf->path.size() >= sizeof(addr.sun_path)) {
+        LOG_WARNING(nullptr, "The path %s is too long", interf->path.c_str());
+        return 1;
+    }
+    memcpy(addr.sun_path, interf->path.data(), interf->path.size());
+
+    // Remove the socket left behind by a previous instance (but
+    // don't remove anything else)
+    struct stat st;
+    if (lstat(interf->path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            LOG_WARNING(nullptr, "%s exists and is not a socket",
+                        interf->path.c_str());
+            return 1;
+        }
+        unlink(interf->path.c_str());
+    }
+
+    SOCKET sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sfd == INVALID_SOCKET) {
+        log_socket_error(EXTENSION_LOG_WARNING, nullptr,
+                         "Failed to create unix domain socket: %s");
+        return 1;
+    }
+
+    if (evutil_make_socket_nonblocking(sfd) == -1) {
+        safe_close(sfd);
+        return 1;
+    }
+
+    if (bind(sfd, reinterpret_cast<struct sockaddr*>(&addr),
+             socklen_t(sizeof(addr))) == SOCKET_ERROR) {
+        LOG_WARNING(nullptr, "Failed to bind to %s: %s",
+                    interf->path.c_str(), strerror(errno));
+        safe_close(sfd);
+        return 1;
+    }
+
+    if (!set_unix_socket_permissions(interf)) {
+        safe_close(sfd);
+        unlink(interf->path.c_str());
+        return 1;
+    }
+
+    auto* lconn = conn_new_server(sfd, interf->port, AF_UNIX, *interf,
+                                  main_base);
+    if (lconn == nullptr) {
+        FATAL_ERROR(EXIT_FAILURE, "Failed to create listening connection");
+    }
+
+    lconn->setNext(listen_conn);
+    listen_conn = lconn;
+
+    stats.daemon_conns++;
+    stats.curr_conns.fetch_add(1, std::memory_order_relaxed);
+    add_listening_port(interf, interf->port, AF_UNIX);
+    return 0;
+}
+#endif
+
 /**
  * Create a socket and bind it to a specific port number
  * @param interface the interface to bind to
@@ -1211,6 +1396,12 @@ static int server_socket(const struct interface *interf) {
     int success = 0;
     const char *host = NULL;
 
+#ifndef WIN32
+    if (interf->isUnixSocket()) {
+        return server_unix_socket(interf);
+    }
+#endif
+
     memset(&hints, 0, sizeof(hints));
     hints.ai_flags = AI_PASSIVE;
     hints.ai_protocol = IPPROTO_TCP;
@@ -1479,7 +1670,11 @@ static void store_engine_specific(const void *void_cookie,
     if (cookie->connection == nullptr) {
         throw std::runtime_error("store_engine_specific: cookie must represent connection");
     }
-    cookie->connection->setEngineStorage(engine_data);
+    if (cookie->parked != nullptr) {
+        cookie->parked->setEngineStorage(engine_data);
+    } else {
+        cookie->connection->setEngineStorage(engine_data);
+    }
 }
 
 static void *get_engine_specific(const void *void_cookie) {
@@ -1489,6 +1684,9 @@ static void *get_engine_specific(const void *void_cookie) {
     if (cookie->connection == nullptr) {
         throw std::runtime_error("get_engine_specific: cookie must represent connection");
     }
+    if (cookie->parked != nullptr) {
+        return cookie->parked->getEngineStorage();
+    }
     return cookie->connection->getEngineStorage();
 }
 
@@ -1561,12 +1759,20 @@ static ENGINE_ERROR_CODE release_cookie(const void *void_cookie) {
     }
 
     Connection *c = cookie->connection;
-    int notify;
     LIBEVENT_THREAD *thr;
 
-    thr = c->getThread();
-    cb_assert(thr);
-    LOCK_THREAD(thr);
+    // The connection is only moved to another thread while its current
+    // owner holds the thread lock, so retry until we hold the lock of
+    // the thread which still owns the connection
+    for (;;) {
+        thr = c->getThread();
+        cb_assert(thr);
+        LOCK_THREAD(thr);
+        if (c->getThread() == thr) {
+            break;
+        }
+        UNLOCK_THREAD(thr);
+    }
     c->decrementRefcount();
 
     /* Releasing the refererence to the object may cause it to change
@@ -1575,12 +1781,12 @@ static ENGINE_ERROR_CODE release_cookie(const void *void_cookie) {
      * pending IO and have the system retry the operation for the
      * connection
      */
-    notify = add_conn_to_pending_io_list(c);
+    auto* target = add_conn_to_pending_io_list(c);
     UNLOCK_THREAD(thr);
 
     /* kick the thread in the butt */
-    if (notify) {
-        notify_thread(thr);
+    if (target != nullptr) {
+        notify_thread(target);
     }
 
     return ENGINE_SUCCESS;
@@ -1973,7 +2179,9 @@ void CreateBucketThread::create() {
         all_buckets[ii].type = type;
         strcpy(all_buckets[ii].name, name.c_str());
         try {
-            all_buckets[ii].topkeys = new TopKeys(settings.getTopkeysSize());
+            all_buckets[ii].topkeys = new TopKeys(
+                    settings.getTopkeysSize(),
+                    size_t(settings.getNumTotalWorkerThreads() + 1));
         } catch (const std::bad_alloc &) {
             result = ENGINE_ENOMEM;
             LOG_WARNING(&connection,
@@ -2182,7 +2390,7 @@ void DestroyBucketThread::destroy() {
 
     /* Clean up the stats... */
     delete[]all_buckets[idx].stats;
-    int numthread = settings.getNumWorkerThreads() + 1;
+    int numthread = settings.getNumTotalWorkerThreads() + 1;
     all_buckets[idx].stats = new thread_stats[numthread];
 
     // Clear any registered event handlers
@@ -2199,6 +2407,7 @@ void DestroyBucketThread::destroy() {
     cb_mutex_exit(&all_buckets[idx].mutex);
     // don't need lock because all timing data uses atomics
     all_buckets[idx].timings.reset();
+    all_buckets[idx].rateLimiter.reset();
 
     LOG_NOTICE(connection, "%s Delete bucket [%s] complete",
                connection_id.c_str(), name.c_str());
@@ -2215,7 +2424,7 @@ void DestroyBucketThread::run() {
 static void initialize_buckets(void) {
     cb_mutex_initialize(&buckets_lock);
 
-    int numthread = settings.getNumWorkerThreads() + 1;
+    int numthread = settings.getNumTotalWorkerThreads() + 1;
     for (auto &b : all_buckets) {
         b.stats = new thread_stats[numthread];
     }
@@ -2286,7 +2495,7 @@ void delete_all_buckets() {
         DestroyBucketTask(const std::string& name_)
             : thread(name_, false, nullptr, this)
         {
-            // empty
+            setPriority(Priority::Low);
         }
 
         // start the bucket deletion
@@ -2299,6 +2508,10 @@ void delete_all_buckets() {
             return true;
         }
 
+        virtual const char* getName() const override {
+            return "delete_bucket";
+        }
+
         DestroyBucketThread thread;
     };
 
@@ -2437,7 +2650,7 @@ void log_errcode_error(EXTENSION_LOG_LEVEL severity,
 
 static void set_max_filehandles(void) {
     const uint64_t maxfiles = settings.getMaxconns() +
-                            (3 * (settings.getNumWorkerThreads() + 2)) +
+                            (3 * (settings.getNumTotalWorkerThreads() + 2)) +
                             1024;
 
     auto limit = cb::io::maximizeFileDescriptors(maxfiles);
@@ -2455,7 +2668,7 @@ static void set_max_filehandles(void) {
                     "threads is %u. Finally the backed database needs to "
                     "open files to persist data.", int(maxfiles), int(limit),
                     settings.getMaxconns(),
-                    (3 * (settings.getNumWorkerThreads() + 2)));
+                    (3 * (settings.getNumTotalWorkerThreads() + 2)));
 
     }
 }
@@ -2610,6 +2823,16 @@ extern "C" int memcached_main(int argc, char **argv) {
     /* Initialize breakpad crash catcher with our just-parsed settings. */
     initialize_breakpad(settings.getBreakpadSettings());
 
+    /*
+     * The threads started by the extensions and the audit daemon inherit
+     * the CPU binding of the main thread, so bind it to the CPUs for the
+     * background threads until we've started them. Record the CPUs the
+     * process was started with first, as the threads without any
+     * configured CPUs are bound back to them.
+     */
+    cpu_affinity_capture_process();
+    bind_current_thread(ThreadClass::Background, 0);
+
     /* load extensions specified in the settings */
     load_extensions();
 
@@ -2682,10 +2905,17 @@ extern "C" int memcached_main(int argc, char **argv) {
     }
 #endif
 
+    slowOperationLog.reset(
+        new SlowOperationLog(size_t(settings.getNumTotalWorkerThreads())));
+
     /* start up worker threads if MT mode */
-    thread_init(settings.getNumWorkerThreads(), main_base, dispatch_event_handler);
+    thread_init(settings.getNumWorkerThreads(),
+                settings.getNumReplicationThreads(),
+                main_base, dispatch_event_handler);
 
+    bind_current_thread(ThreadClass::Executors, 0);
     executorPool.reset(new ExecutorPool(size_t(settings.getNumWorkerThreads())));
+    bind_current_thread(ThreadClass::Dispatcher, 0);
 
     /*
      * MB-20034.
@@ -21,11 +21,13 @@
 #include <memcached/extension.h>
 #include <JSON_checker.h>
 
+#include "buffer_pool.h"
 #include "dynamic_buffer.h"
 #include "executorpool.h"
 #include "log_macros.h"
 #include "net_buf.h"
 #include "settings.h"
+#include "slow_op_log.h"
 
 /** Maximum length of a key. */
 #define KEY_MAX_LENGTH 250
@@ -69,23 +71,31 @@ enum class ThreadType {
 
 class Connection;
 class ConnectionQueue;
+class ConnectionScheduler;
+class IdleConnectionList;
+class TimingHistogram;
+class PendingIoQueue;
 
 struct LIBEVENT_THREAD {
     cb_thread_t thread_id;      /* unique ID of this thread */
     struct event_base *base;    /* libevent handle this thread uses */
     struct event notify_event;  /* listen event for notify pipe */
+    struct event compact_event; /* timer used to compact idle connections */
+    struct event schedule_event; /* timer used to run the ready connections */
     SOCKET notify[2];           /* notification pipes */
+    bool notify_eventfd;        /* notify[0] and notify[1] is an eventfd */
     ConnectionQueue *new_conn_queue; /* queue of new connections to handle */
-    cb_mutex_t mutex;      /* Mutex to lock protect access to the pending_io */
+    cb_mutex_t mutex;      /* Mutex to lock protect the thread's connections */
     bool is_locked;
-    Connection *pending_io;    /* List of connection with pending async io ops */
+    PendingIoQueue *pending_io; /* Queue of connections with pending async io ops */
+    ConnectionScheduler *scheduler; /* Ready connections waiting to run */
+    IdleConnectionList *idle_connections; /* Connections ordered by idle time */
     int index;                  /* index of this thread in the threads array */
     ThreadType type;      /* Type of IO this thread processes */
 
     rel_time_t last_checked;
 
-    struct net_buf read; /** Shared read buffer for all connections serviced by this thread. */
-    struct net_buf write; /** Shared write buffer for all connections serviced by this thread. */
+    BufferPool* buffer_pool; /** Pool of read and write buffers lent to the connections serviced by this thread. */
 
     subdoc_OPERATION* subdoc_op; /** Shared sub-document operation for all
                                      connections serviced by this thread. */
@@ -153,7 +163,8 @@ void associate_initial_bucket(Connection *c);
  * also #define-d to directly call the underlying code in singlethreaded mode.
  */
 
-void thread_init(int nthreads, struct event_base *main_base,
+void thread_init(int nthreads, int nreplication_threads,
+                 struct event_base *main_base,
                  void (*dispatcher_callback)(evutil_socket_t, short, void *));
 void threads_shutdown(void);
 void threads_cleanup(void);
@@ -171,13 +182,54 @@ void notify_io_complete(const void *cookie, ENGINE_ERROR_CODE status);
 void safe_close(SOCKET sfd);
 
 
-/* Number of times this connection is in the given pending list */
-bool list_contains(Connection *h, Connection *n);
-Connection *list_remove(Connection *h, Connection *n);
-
 bool load_extension(const char *soname, const char *config);
 
-int add_conn_to_pending_io_list(Connection *c);
+/**
+ * Schedule the connection to be run by its worker thread.
+ *
+ * The connection may be moved to another thread at any time (see
+ * migrate_connection), so the caller must notify the thread returned
+ * from this function and not the one it looked up itself.
+ *
+ * @return the thread the connection was queued on if the caller needs to
+ *         notify it (by calling notify_thread()), or nullptr if a wakeup
+ *         is already pending
+ */
+LIBEVENT_THREAD* add_conn_to_pending_io_list(Connection *c);
+
+/**
+ * Remove the connection from the pending io queue of its thread (if
+ * present). Must be called from the worker thread owning the connection
+ * before the connection may be released.
+ */
+void remove_conn_from_pending_io_list(Connection *c);
+
+/**
+ * Queue the connection in the ConnectionScheduler of its thread so that
+ * it is run with the given libevent events when its priority class gets
+ * its turn. Must be called from the worker thread owning the connection
+ * (with the thread locked).
+ */
+void schedule_connection(Connection *c, short which);
+
+/**
+ * Remove the connection from the ConnectionScheduler of its thread (if
+ * it is scheduled). Must be called from the worker thread owning the
+ * connection before the connection may be released.
+ */
+void unschedule_connection(Connection *c);
+
+/**
+ * Move a connection flagged with setMigrationPending() to one of the
+ * replication threads. Must be called from the worker thread owning the
+ * connection (with the thread locked) after the connection was run. The
+ * connection is left on its current thread if it is busy (and we'll try
+ * again the next time it is run), and the caller must not touch the
+ * connection after it was moved.
+ *
+ * @return true if the connection was moved to another thread
+ */
+bool migrate_connection(Connection *c);
 
 /* connection state machine */
 bool conn_listening(ListenConnection *c);
@@ -187,6 +239,16 @@ void listen_event_handler(evutil_socket_t, short, void *);
 
 void mcbp_collect_timings(const McbpConnection* c);
 
+/**
+ * Record the time the current command spent in each phase (see
+ * LatencyBreakdown) and stop tracking it
+ *
+ * @param c the connection running the command
+ * @param sent true if the response was sent (false if the command didn't
+ *             send a response)
+ */
+void mcbp_collect_latency_breakdown(McbpConnection* c, bool sent);
+
 void log_socket_error(EXTENSION_LOG_LEVEL severity,
                       const void* client_cookie,
                       const char* prefix);
@@ -214,8 +276,9 @@ const char* get_server_version(void);
  * Connection-related functions
  */
 
-/* Increments topkeys count for a key when called by a valid operation. */
-void update_topkeys(const DocKey& key, McbpConnection *c);
+/* Increments topkeys count for a key when called by a valid operation
+ * (nread is the number of bytes of the value returned to the client). */
+void update_topkeys(const DocKey& key, McbpConnection *c, size_t nread = 0);
 
 
 void notify_thread_bucket_deletion(LIBEVENT_THREAD *me);
@@ -224,6 +287,25 @@ void threads_notify_bucket_deletion(void);
 void threads_complete_bucket_deletion(void);
 void threads_initiate_bucket_deletion(void);
 
+/**
+ * Aggregate the time connections in the given priority class spent in
+ * the ready queues of the worker threads.
+ */
+void threads_aggregate_queue_times(Connection::Priority priority,
+                                   TimingHistogram& histogram);
+
+/**
+ * Bind the calling thread to the CPUs configured for its class of
+ * threads (see CpuAffinitySettings). Threads created by the calling
+ * thread inherit the binding. A thread without any configured CPUs is
+ * bound to the CPUs recorded by cpu_affinity_capture_process().
+ *
+ * @param threadClass the class the thread belongs to
+ * @param index the index of the thread in its pool of threads
+ * @return the NUMA node the thread is bound to, or -1
+ */
+int bind_current_thread(ThreadClass threadClass, size_t index);
+
 // This should probably go in a network-helper file..
 #ifdef WIN32
 #define GetLastNetworkError() WSAGetLastError()
@@ -352,6 +434,28 @@ static inline ENGINE_ERROR_CODE bucket_get(McbpConnection* c,
                                      item_, key, vbucket);
 }
 
+static inline ENGINE_ERROR_CODE bucket_get_multi(McbpConnection* c,
+                                                 const DocKey* keys,
+                                                 const uint16_t* vbuckets,
+                                                 size_t nkeys,
+                                                 item** items,
+                                                 ENGINE_ERROR_CODE* status) {
+    auto* engine = c->getBucketEngine();
+    if (engine->get_multi != nullptr) {
+        return engine->get_multi(c->getBucketEngineAsV0(), c->getCookie(),
+                                 keys, vbuckets, nkeys, items, status);
+    }
+
+    // The engine don't support batched lookups; fall back to one
+    // lookup per key
+    for (size_t ii = 0; ii < nkeys; ++ii) {
+        items[ii] = nullptr;
+        status[ii] = engine->get(c->getBucketEngineAsV0(), c->getCookie(),
+                                 &items[ii], keys[ii], vbuckets[ii]);
+    }
+    return ENGINE_SUCCESS;
+}
+
 static inline void bucket_release_item(McbpConnection* c, item* it) {
     c->getBucketEngine()->release(c->getBucketEngineAsV0(),
                                   c->getCookie(), it);
@@ -377,4 +481,10 @@ static inline ENGINE_ERROR_CODE bucket_allocate(McbpConnection* c,
  */
 extern std::unique_ptr<ExecutorPool> executorPool;
 
+/**
+ * The most recent commands which took longer than the slow_op_threshold
+ * setting (one ring buffer per worker thread)
+ */
+extern std::unique_ptr<SlowOperationLog> slowOperationLog;
+
 #endif
@@ -0,0 +1,56 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "offload_task.h"
+#include "executorpool.h"
+#include "memcached.h"
+
+OffloadTask::OffloadTask(const void* cookie_,
+                         const char* name_,
+                         std::function<ENGINE_ERROR_CODE()> function_)
+    : cookie(cookie_),
+      name(name_),
+      function(std::move(function_)),
+      status(ENGINE_FAILED) {
+    // The connection is blocked until the task completes
+    setPriority(Priority::High);
+}
+
+bool OffloadTask::execute() {
+    try {
+        status = function();
+    } catch (const std::bad_alloc&) {
+        status = ENGINE_ENOMEM;
+    } catch (const std::exception&) {
+        status = ENGINE_FAILED;
+    }
+    return true;
+}
+
+void OffloadTask::notifyExecutionComplete() {
+    notify_io_complete(cookie, status);
+}
+
+bool should_offload(size_t size) {
+    const auto threshold = settings.getOffloadThreshold();
+    return threshold != 0 && size >= threshold;
+}
+
+void schedule_offload_task(std::shared_ptr<Task>& task) {
+    std::lock_guard<std::mutex> guard(task->getMutex());
+    executorPool->schedule(task, true);
+}
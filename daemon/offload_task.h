@@ -0,0 +1,79 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "task.h"
+
+#include <functional>
+#include <memcached/types.h>
+#include <memory>
+
+/**
+ * The OffloadTask runs the CPU intensive part of a command (like inflating
+ * or validating a large document) on the executor pool, so that a few
+ * operations on large documents don't stall all of the other connections
+ * served by the same front end thread.
+ *
+ * The command returns EWOULDBLOCK after scheduling the task, and the
+ * cookie is notified with the status returned by the function once it
+ * completed. The function runs on another thread and must not touch the
+ * connection. Everything it uses must be kept alive by the command (ex:
+ * in the command context) until the cookie is notified.
+ */
+class OffloadTask : public Task {
+public:
+    OffloadTask() = delete;
+
+    OffloadTask(const OffloadTask&) = delete;
+
+    /**
+     * @param cookie_ the cookie to notify when the function completed
+     * @param name_ the name of the task (used in the executor stats)
+     * @param function_ the function to run
+     */
+    OffloadTask(const void* cookie_,
+                const char* name_,
+                std::function<ENGINE_ERROR_CODE()> function_);
+
+    virtual bool execute() override;
+
+    virtual void notifyExecutionComplete() override;
+
+    virtual const char* getName() const override {
+        return name;
+    }
+
+protected:
+    const void* cookie;
+    const char* name;
+    std::function<ENGINE_ERROR_CODE()> function;
+    ENGINE_ERROR_CODE status;
+};
+
+/**
+ * Should the expensive operations on a document of the given size be
+ * offloaded to the executor pool (see the offload_threshold setting)?
+ */
+bool should_offload(size_t size);
+
+/**
+ * Schedule an offload task on the executor pool. The caller must keep
+ * a reference to the task until the cookie is notified.
+ *
+ * @param task the task to schedule
+ */
+void schedule_offload_task(std::shared_ptr<Task>& task);
@@ -0,0 +1,58 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "parked_command.h"
+
+#include <cstring>
+
+ParkedCommand::ParkedCommand(Connection& connection)
+    : cmd(PROTOCOL_BINARY_CMD_INVALID),
+      noreply(false),
+      start(0),
+      cookie(&connection, this),
+      aiostat(ENGINE_SUCCESS),
+      ready(false),
+      engineStorage(nullptr) {
+    memset(&header, 0, sizeof(header));
+}
+
+bool ParkedCommand::isReorderable(uint8_t opcode) {
+    // Only the retrieval commands may be reordered. They don't modify
+    // the document or the state of the connection, so the only visible
+    // effect of reordering them is the order of the responses (which
+    // the client matches by using the opaque field). All mutations
+    // are barriers so a get will never observe a mutation sent after it,
+    // and a mutation will never be passed by a get sent after it.
+    switch (opcode) {
+    case PROTOCOL_BINARY_CMD_GET:
+    case PROTOCOL_BINARY_CMD_GETQ:
+    case PROTOCOL_BINARY_CMD_GETK:
+    case PROTOCOL_BINARY_CMD_GETKQ:
+    case PROTOCOL_BINARY_CMD_GET_MULTI:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void ParkedCommand::prepare(const char* pkt, size_t size) {
+    packet.assign(pkt, pkt + size);
+    context.reset();
+    aiostat.store(ENGINE_SUCCESS);
+    ready.store(false);
+    engineStorage = nullptr;
+}
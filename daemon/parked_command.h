@@ -0,0 +1,133 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <memcached/protocol_binary.h>
+#include <memcached/types.h>
+#include <memory>
+#include <platform/platform.h>
+#include <vector>
+
+#include "cookie.h"
+#include "protocol/mcbp/command_context.h"
+
+class Connection;
+
+/**
+ * A ParkedCommand holds the state for a command executed on a connection
+ * which enabled unordered execution (see HELLO).
+ *
+ * Commands which may be reordered are executed in a ParkedCommand with
+ * its own copy of the packet and its own cookie passed down to the engine.
+ * If the engine returns EWOULDBLOCK the per-command state is moved from
+ * the connection into the ParkedCommand (the command is "parked") and
+ * the connection starts executing the next command. When the engine
+ * calls notify_io_complete with the parked commands cookie the command
+ * is marked as ready, and the worker thread resumes the command the next
+ * time the connection is between two commands.
+ */
+class ParkedCommand {
+public:
+    ParkedCommand(Connection& connection);
+
+    ParkedCommand(const ParkedCommand&) = delete;
+
+    /**
+     * Can the command with the given opcode be reordered with respect
+     * to the other commands on the connection? All other commands act
+     * as a barrier and won't start before all of the parked commands
+     * have completed.
+     */
+    static bool isReorderable(uint8_t opcode);
+
+    /**
+     * Prepare the object to execute a new command
+     *
+     * @param pkt the packet (header and body in network byte order)
+     * @param size the number of bytes in the packet
+     */
+    void prepare(const char* pkt, size_t size);
+
+    void* getPacket() {
+        return packet.data();
+    }
+
+    Cookie& getCookie() {
+        return cookie;
+    }
+
+    /**
+     * Called from notify_io_complete (from any thread) when the engine
+     * completed the operation the command blocked on.
+     */
+    void notifyIoComplete(ENGINE_ERROR_CODE status) {
+        aiostat.store(status);
+        ready.store(true);
+    }
+
+    /**
+     * Has the engine notified the command?
+     */
+    bool isReady() const {
+        return ready.load();
+    }
+
+    /**
+     * Consume the notification from the engine before resuming the
+     * command.
+     *
+     * @return the status passed to notify_io_complete
+     */
+    ENGINE_ERROR_CODE consumeIoStatus() {
+        ready.store(false);
+        return aiostat.load();
+    }
+
+    void* getEngineStorage() const {
+        return engineStorage;
+    }
+
+    void setEngineStorage(void* engine_storage) {
+        engineStorage = engine_storage;
+    }
+
+    /*
+     * The per-command state saved from the connection while the command
+     * is parked (restored when the command is resumed).
+     */
+    protocol_binary_request_header header;
+    uint8_t cmd;
+    bool noreply;
+    hrtime_t start;
+    std::unique_ptr<CommandContext> context;
+
+private:
+    Cookie cookie;
+
+    /** A copy of the packet (the read buffer is reused for the next commands) */
+    std::vector<char> packet;
+
+    /** The status passed to notify_io_complete */
+    std::atomic<ENGINE_ERROR_CODE> aiostat;
+
+    /** Set when the engine notifies the cookie */
+    std::atomic_bool ready;
+
+    /** The engine specific data stored for this cookie */
+    void* engineStorage;
+};
@@ -0,0 +1,107 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "connection.h"
+
+/*
+ * The queue of connections with pending io notifications for a worker
+ * thread. Any thread may schedule a connection (notify_io_complete etc),
+ * but only the worker thread may remove them. The worker thread is
+ * woken up through its notification channel, and multiple notifications
+ * are coalesced into a single wakeup until the worker starts draining the
+ * queue.
+ */
+class PendingIoQueue {
+public:
+    PendingIoQueue()
+        : wakeupPending(false) {
+    }
+
+    /**
+     * Add the connection to the queue (unless it is already queued).
+     *
+     * @return true if the caller needs to wake up the worker thread
+     */
+    bool push(Connection* c) {
+        queue.push(c);
+        return arm();
+    }
+
+    /**
+     * Flag that a wakeup of the worker thread is pending.
+     *
+     * @return true if the caller needs to wake up the worker thread
+     */
+    bool arm() {
+        return !wakeupPending.exchange(true);
+    }
+
+    /**
+     * Called by the worker thread before it starts draining the queue so
+     * that anyone scheduling a connection from now on will wake it up
+     * again. (This is an exchange (not a store) so that we'll see all
+     * of the connections pushed by the producers who saw the pending
+     * wakeup)
+     */
+    void disarm() {
+        wakeupPending.exchange(false);
+    }
+
+    Connection* pop() {
+        return queue.pop();
+    }
+
+    /**
+     * Remove the connection from the queue if it is present. May only be
+     * called by the worker thread.
+     *
+     * @return true if other connections was moved around in the queue
+     *         (and the worker thread needs to be notified)
+     */
+    bool remove(Connection* c) {
+        if (!c->isMpscLinked()) {
+            return false;
+        }
+
+        std::vector<Connection*> others;
+        Connection* next;
+        while ((next = queue.pop()) != c) {
+            if (next != nullptr) {
+                others.push_back(next);
+            } else if (!c->isMpscLinked()) {
+                break;
+            } else {
+                // someone is in the middle of pushing the connection
+                std::this_thread::yield();
+            }
+        }
+
+        for (auto* o : others) {
+            queue.push(o);
+        }
+
+        return !others.empty();
+    }
+
+private:
+    IntrusiveMpscQueue<Connection> queue;
+    std::atomic_bool wakeupPending;
+};
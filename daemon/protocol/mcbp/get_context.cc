@@ -18,6 +18,7 @@
 
 #include <daemon/debug_helpers.h>
 #include <daemon/mcbp.h>
+#include <daemon/offload_task.h>
 #include <daemon/xattr_utils.h>
 
 GetCommandContext::~GetCommandContext() {
@@ -74,11 +75,20 @@ ENGINE_ERROR_CODE GetCommandContext::getItem() {
 }
 
 ENGINE_ERROR_CODE GetCommandContext::inflateItem() {
+    state = State::SendResponse;
+    const auto id = connection.getId();
+    if (should_offload(payload.len)) {
+        return offload("inflate",
+                       [this, id]() { return inflatePayload(id); });
+    }
+    return inflatePayload(id);
+}
+
+ENGINE_ERROR_CODE GetCommandContext::inflatePayload(uint32_t id) {
     try {
         if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
                                       payload.buf, payload.len, buffer)) {
-            LOG_WARNING(&connection, "%u: Failed to inflate item",
-                        connection.getId());
+            LOG_WARNING(nullptr, "%u: Failed to inflate item", id);
             return ENGINE_FAILED;
         }
         payload.buf = buffer.data.get();
@@ -87,7 +97,6 @@ ENGINE_ERROR_CODE GetCommandContext::inflateItem() {
         return ENGINE_ENOMEM;
     }
 
-    state = State::SendResponse;
     return ENGINE_SUCCESS;
 }
 
@@ -132,7 +141,7 @@ ENGINE_ERROR_CODE GetCommandContext::sendResponse() {
     connection.setState(conn_mwrite);
 
     STATS_HIT(&connection, get, key.buf, key.len);
-    update_topkeys(key, &connection);
+    update_topkeys(key, &connection, payload.len);
 
     state = State::Done;
     return ENGINE_SUCCESS;
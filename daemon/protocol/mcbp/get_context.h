@@ -114,14 +114,27 @@ protected:
     ENGINE_ERROR_CODE noSuchItem();
 
     /**
-     * Inflate the document before progressing to State::SendResponse
+     * Inflate the document before progressing to State::SendResponse.
+     * Large documents are inflated by the executor pool so that we don't
+     * block the other connections served by this thread.
      *
      * @return ENGINE_FAILED if inflate failed
      *         ENGINE_ENOMEM if we're out of memory
+     *         ENGINE_EWOULDBLOCK if the document is inflated by the
+     *                            executor pool
      *         ENGINE_SUCCESS to go to the next state
      */
     ENGINE_ERROR_CODE inflateItem();
 
+    /**
+     * Inflate the payload into the buffer (and update the payload to
+     * point to the inflated data). This method may be called from
+     * another thread and must not touch the connection.
+     *
+     * @param id the id of the connection (used for logging)
+     */
+    ENGINE_ERROR_CODE inflatePayload(uint32_t id);
+
     /**
      * Craft up the response message and send it to the client. Given that
      * the command context object lives until we start the next command
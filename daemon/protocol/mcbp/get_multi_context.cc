@@ -0,0 +1,318 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "get_multi_context.h"
+
+#include <daemon/mcbp.h>
+#include <daemon/offload_task.h>
+#include <daemon/xattr_utils.h>
+
+GetMultiCommandContext::GetMultiCommandContext(
+    McbpConnection& c, protocol_binary_request_get_multi* req)
+    : SteppableCommandContext(c),
+      payload(reinterpret_cast<const char*>(req->bytes + sizeof(req->bytes)),
+              ntohl(req->message.header.request.bodylen)),
+      framingLength(0),
+      state(State::Initialize) {
+}
+
+GetMultiCommandContext::~GetMultiCommandContext() {
+    for (auto* it : items) {
+        if (it != nullptr) {
+            bucket_release_item(&connection, it);
+        }
+    }
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::initialize() {
+    size_t offset = 0;
+    while (offset < payload.len) {
+        protocol_binary_get_multi_entry entry;
+        memcpy(&entry, payload.buf + offset, sizeof(entry));
+        offset += sizeof(entry);
+
+        const uint16_t keylen = ntohs(entry.keylen);
+        keys.emplace_back(
+            reinterpret_cast<const uint8_t*>(payload.buf + offset), keylen,
+            DocNamespace::DefaultCollection);
+        vbuckets.push_back(ntohs(entry.vbucket));
+        offset += keylen;
+    }
+
+    // Size all of the arrays up front so that the pointers we hand
+    // out to the engine (and the iovector) stay valid
+    items.resize(keys.size(), nullptr);
+    status.resize(keys.size(), ENGINE_EWOULDBLOCK);
+    info.resize(keys.size());
+    values.resize(keys.size());
+    responses.resize(keys.size() + 1);
+
+    if (settings.getVerbose() > 1) {
+        LOG_DEBUG(&connection, "%u: GET_MULTI with %u keys",
+                  connection.getId(), uint32_t(keys.size()));
+    }
+
+    state = State::GetItems;
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::getItems() {
+    // Collect the keys we don't have a result for. The first time
+    // around this is all of the keys.
+    std::vector<size_t> pending;
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        if (status[ii] == ENGINE_EWOULDBLOCK) {
+            pending.push_back(ii);
+        }
+    }
+
+    ENGINE_ERROR_CODE ret;
+    if (pending.size() == keys.size()) {
+        ret = bucket_get_multi(&connection, keys.data(), vbuckets.data(),
+                               keys.size(), items.data(), status.data());
+    } else {
+        std::vector<DocKey> k;
+        std::vector<uint16_t> v;
+        std::vector<item*> it(pending.size(), nullptr);
+        std::vector<ENGINE_ERROR_CODE> s(pending.size(), ENGINE_EWOULDBLOCK);
+        for (auto idx : pending) {
+            k.push_back(keys[idx]);
+            v.push_back(vbuckets[idx]);
+        }
+        ret = bucket_get_multi(&connection, k.data(), v.data(), k.size(),
+                               it.data(), s.data());
+        if (ret == ENGINE_SUCCESS) {
+            for (size_t ii = 0; ii < pending.size(); ++ii) {
+                items[pending[ii]] = it[ii];
+                status[pending[ii]] = s[ii];
+            }
+        }
+    }
+
+    if (ret != ENGINE_SUCCESS) {
+        return ret;
+    }
+
+    bool need_inflate = false;
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        switch (status[ii]) {
+        case ENGINE_EWOULDBLOCK:
+            // We'll be notified when the engine is done with the key
+            return ENGINE_EWOULDBLOCK;
+        case ENGINE_DISCONNECT:
+            return ENGINE_DISCONNECT;
+        default:
+            break;
+        }
+
+        if (status[ii] != ENGINE_SUCCESS || values[ii].buf != nullptr) {
+            continue;
+        }
+
+        info[ii].nvalue = 1;
+        if (!bucket_get_item_info(&connection, items[ii], &info[ii])) {
+            LOG_WARNING(&connection, "%u: Failed to get item info",
+                        connection.getId());
+            return ENGINE_FAILED;
+        }
+
+        values[ii] = {static_cast<const char*>(info[ii].value[0].iov_base),
+                      info[ii].value[0].iov_len};
+
+        if (mcbp::datatype::is_compressed(info[ii].datatype) &&
+            (mcbp::datatype::is_xattr(info[ii].datatype) ||
+             !connection.isSupportsDatatype())) {
+            need_inflate = true;
+        }
+    }
+
+    if (need_inflate) {
+        state = State::InflateItems;
+    } else {
+        state = State::SendResponse;
+    }
+    return ENGINE_SUCCESS;
+}
+
+bool GetMultiCommandContext::needInflate(size_t index,
+                                         bool supportsDatatype) const {
+    return status[index] == ENGINE_SUCCESS &&
+           mcbp::datatype::is_compressed(info[index].datatype) &&
+           (mcbp::datatype::is_xattr(info[index].datatype) ||
+            !supportsDatatype);
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::inflateItems() {
+    state = State::SendResponse;
+
+    const auto id = connection.getId();
+    const bool supportsDatatype = connection.isSupportsDatatype();
+    size_t total = 0;
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        if (needInflate(ii, supportsDatatype)) {
+            total += values[ii].len;
+        }
+    }
+
+    if (should_offload(total)) {
+        return offload("inflate", [this, id, supportsDatatype]() {
+            return inflateValues(id, supportsDatatype);
+        });
+    }
+    return inflateValues(id, supportsDatatype);
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::inflateValues(
+        uint32_t id, bool supportsDatatype) {
+    try {
+        for (size_t ii = 0; ii < keys.size(); ++ii) {
+            if (!needInflate(ii, supportsDatatype)) {
+                continue;
+            }
+
+            std::unique_ptr<cb::compression::Buffer> buffer(
+                new cb::compression::Buffer);
+            if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                                          values[ii].buf, values[ii].len,
+                                          *buffer)) {
+                LOG_WARNING(nullptr, "%u: Failed to inflate item", id);
+                return ENGINE_FAILED;
+            }
+            values[ii] = {buffer->data.get(), buffer->len};
+            // The datatype now describes what's in values
+            info[ii].datatype &= ~PROTOCOL_BINARY_DATATYPE_COMPRESSED;
+            inflated.emplace_back(std::move(buffer));
+        }
+    } catch (const std::bad_alloc&) {
+        return ENGINE_ENOMEM;
+    }
+
+    return ENGINE_SUCCESS;
+}
+
+void GetMultiCommandContext::addResponseHeader(
+    protocol_binary_response_get& rsp,
+    uint16_t err,
+    uint8_t extlen,
+    uint16_t keylen,
+    uint32_t bodylen,
+    uint8_t datatype,
+    uint64_t cas) {
+    auto& header = rsp.message.header;
+    memset(&header, 0, sizeof(header));
+    mcbp_build_response_header(&connection, header, framingLength, err,
+                               extlen, keylen, bodylen, datatype, cas);
+
+    if (framingLength == 0) {
+        connection.addIov(rsp.bytes, sizeof(header.response) + extlen);
+    } else {
+        // The framing extras goes between the header and the extras
+        connection.addIov(rsp.bytes, sizeof(header.response));
+        connection.addIov(framing.data(), framingLength);
+        if (extlen > 0) {
+            connection.addIov(rsp.bytes + sizeof(header.response), extlen);
+        }
+    }
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::sendResponse() {
+    // All of the responses goes into the same message list so that
+    // they're sent with as few system calls as possible.
+    connection.addMsgHdr(true);
+
+    // The responses are created at the same time, so they all share the
+    // same framing extras (the keys can't be longer than 255 bytes)
+    framingLength = mcbp_build_response_framing(&connection, 0,
+                                                framing.data());
+
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        const auto& key = keys[ii];
+        auto& rsp = responses[ii];
+
+        if (status[ii] == ENGINE_KEY_ENOENT) {
+            STATS_MISS(&connection, get, key.buf, key.len);
+            MEMCACHED_COMMAND_GET(connection.getId(),
+                                  reinterpret_cast<const char*>(key.data()),
+                                  int(key.size()), -1, 0);
+            continue;
+        }
+
+        if (status[ii] != ENGINE_SUCCESS) {
+            addResponseHeader(rsp,
+                              engine_error_2_mcbp_protocol_error(status[ii]),
+                              0, uint16_t(key.len), uint32_t(key.len),
+                              PROTOCOL_BINARY_RAW_BYTES, 0);
+            connection.addIov(key.buf, key.len);
+            continue;
+        }
+
+        auto value = values[ii];
+        protocol_binary_datatype_t datatype = info[ii].datatype;
+        if (mcbp::datatype::is_xattr(datatype)) {
+            value = cb::xattr::get_body(value);
+            datatype &= ~(PROTOCOL_BINARY_DATATYPE_XATTR);
+            datatype &= ~(PROTOCOL_BINARY_DATATYPE_COMPRESSED);
+        }
+
+        if (!connection.isSupportsDatatype()) {
+            datatype = PROTOCOL_BINARY_RAW_BYTES;
+        }
+
+        rsp.message.body.flags = info[ii].flags;
+        addResponseHeader(rsp, PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                          sizeof(rsp.message.body), uint16_t(key.len),
+                          uint32_t(sizeof(rsp.message.body) + key.len +
+                                   value.len),
+                          datatype, info[ii].cas);
+        connection.addIov(key.buf, key.len);
+        connection.addIov(value.buf, value.len);
+
+        STATS_HIT(&connection, get, key.buf, key.len);
+        update_topkeys(key, &connection, value.len);
+    }
+
+    // Terminate the sequence
+    addResponseHeader(responses.back(), PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                      0, 0, 0, PROTOCOL_BINARY_RAW_BYTES, 0);
+
+    connection.setState(conn_mwrite);
+    state = State::Done;
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::step() {
+    ENGINE_ERROR_CODE ret;
+    do {
+        switch (state) {
+        case State::Initialize:
+            ret = initialize();
+            break;
+        case State::GetItems:
+            ret = getItems();
+            break;
+        case State::InflateItems:
+            ret = inflateItems();
+            break;
+        case State::SendResponse:
+            ret = sendResponse();
+            break;
+        case State::Done:
+            return ENGINE_SUCCESS;
+        }
+    } while (ret == ENGINE_SUCCESS);
+
+    return ret;
+}
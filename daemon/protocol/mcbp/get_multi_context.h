@@ -0,0 +1,163 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <memory>
+#include <platform/compress.h>
+#include <vector>
+#include "../../memcached.h"
+#include "steppable_command_context.h"
+
+/**
+ * The GetMultiCommandContext is a state machine used by the memcached
+ * core to implement the GetMulti operation (look up a batch of keys
+ * with a single call to the engine and send all of the responses in
+ * a single write).
+ */
+class GetMultiCommandContext : public SteppableCommandContext {
+public:
+    // The internal states. Look at the function headers below to
+    // for the functions with the same name to figure out what each
+    // state does
+    enum class State : uint8_t {
+        Initialize,
+        GetItems,
+        InflateItems,
+        SendResponse,
+        Done
+    };
+
+    GetMultiCommandContext(McbpConnection& c,
+                           protocol_binary_request_get_multi* req);
+
+    ~GetMultiCommandContext() override;
+
+protected:
+    /**
+     * Keep running the state machine.
+     *
+     * @return A standard engine error code (if SUCCESS we've changed the
+     *         the connections state to one of the appropriate states (send
+     *         data, or start processing the next command)
+     */
+    ENGINE_ERROR_CODE step() override;
+
+    /**
+     * Parse the list of keys in the payload (the validator have already
+     * checked that the list is well formed).
+     *
+     * @return ENGINE_SUCCESS (always)
+     */
+    ENGINE_ERROR_CODE initialize();
+
+    /**
+     * Look up all of the keys which don't have a status yet (initially
+     * all of the keys, and after the engine notified us only the ones
+     * which returned ENGINE_EWOULDBLOCK).
+     *
+     * @return ENGINE_EWOULDBLOCK if one or more of the keys need to block
+     *         ENGINE_SUCCESS if we want to continue to run the state diagram
+     *         a standard engine error code if something goes wrong
+     */
+    ENGINE_ERROR_CODE getItems();
+
+    /**
+     * Inflate the compressed documents the client can't receive compressed
+     * (or which contains xattrs we need to strip off).
+     *
+     * If the total size of the documents to inflate exceeds the offload
+     * threshold they're inflated by the executor pool.
+     *
+     * @return ENGINE_FAILED if inflate failed
+     *         ENGINE_ENOMEM if we're out of memory
+     *         ENGINE_EWOULDBLOCK if the documents are inflated by the
+     *                            executor pool
+     *         ENGINE_SUCCESS to go to the next state
+     */
+    ENGINE_ERROR_CODE inflateItems();
+
+    /**
+     * Should the value for the key at the given index be inflated?
+     */
+    bool needInflate(size_t index, bool supportsDatatype) const;
+
+    /**
+     * Inflate the values which needs to be inflated. This method may be
+     * called from another thread and must not touch the connection.
+     *
+     * @param id the id of the connection (used for logging)
+     * @param supportsDatatype does the client support compressed documents
+     */
+    ENGINE_ERROR_CODE inflateValues(uint32_t id, bool supportsDatatype);
+
+    /**
+     * Craft up the response messages for all of the keys and add them
+     * to the connections iovector. The headers live in the context, and
+     * the values point directly into the items (or the inflated buffers)
+     * so none of the documents are copied.
+     *
+     * @return ENGINE_SUCCESS
+     */
+    ENGINE_ERROR_CODE sendResponse();
+
+private:
+    /**
+     * Add a response header for the request to the iovector.
+     */
+    void addResponseHeader(protocol_binary_response_get& rsp,
+                           uint16_t err,
+                           uint8_t extlen,
+                           uint16_t keylen,
+                           uint32_t bodylen,
+                           uint8_t datatype,
+                           uint64_t cas);
+
+    const cb::const_char_buffer payload;
+
+    /*
+     * The keys to look up and the result of the lookup for each key.
+     * The arrays are laid out the way get_multi in the engine API wants
+     * them.
+     */
+    std::vector<DocKey> keys;
+    std::vector<uint16_t> vbuckets;
+    std::vector<item*> items;
+    std::vector<ENGINE_ERROR_CODE> status;
+
+    /** The item info and the value to send for each of the items found */
+    std::vector<item_info> info;
+    std::vector<cb::const_char_buffer> values;
+
+    /** The buffers holding the inflated documents */
+    std::vector<std::unique_ptr<cb::compression::Buffer>> inflated;
+
+    /**
+     * The response headers (with room for the flags). One entry per
+     * key plus the terminating response
+     */
+    std::vector<protocol_binary_response_get> responses;
+
+    /**
+     * The framing extras shared by all of the responses (if the client
+     * enabled tracing)
+     */
+    std::array<uint8_t, 8> framing;
+    uint8_t framingLength;
+
+    State state;
+};
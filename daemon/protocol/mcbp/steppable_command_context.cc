@@ -16,6 +16,7 @@
  */
 #include "steppable_command_context.h"
 #include <daemon/mcbp.h>
+#include <daemon/offload_task.h>
 
 void SteppableCommandContext::drive() {
     ENGINE_ERROR_CODE ret = connection.getAiostat();
@@ -32,6 +33,10 @@ void SteppableCommandContext::drive() {
     case ENGINE_EWOULDBLOCK:
         connection.setAiostat(ENGINE_EWOULDBLOCK);
         connection.setEwouldblock(true);
+        if (offloadPending) {
+            offloadPending = false;
+            schedule_offload_task(offloadTask);
+        }
         return;
     case ENGINE_DISCONNECT:
         connection.setState(conn_closing);
@@ -41,3 +46,11 @@ void SteppableCommandContext::drive() {
         return;
     }
 }
+
+ENGINE_ERROR_CODE SteppableCommandContext::offload(
+        const char* name, std::function<ENGINE_ERROR_CODE()> function) {
+    offloadTask = std::make_shared<OffloadTask>(connection.getCookie(), name,
+                                                std::move(function));
+    offloadPending = true;
+    return ENGINE_EWOULDBLOCK;
+}
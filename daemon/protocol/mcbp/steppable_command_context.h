@@ -16,11 +16,14 @@
  */
 #pragma once
 
+#include <functional>
 #include <memcached/types.h>
+#include <memory>
 #include "command_context.h"
 
 // Forward declaration
 class McbpConnection;
+class Task;
 
 /**
  * The steppable command context is an iterface to a command context
@@ -31,7 +34,9 @@ class McbpConnection;
  */
 class SteppableCommandContext : public CommandContext {
 public:
-    SteppableCommandContext(McbpConnection& c) : connection(c) {
+    SteppableCommandContext(McbpConnection& c)
+        : connection(c),
+          offloadPending(false) {
     }
 
     virtual ~SteppableCommandContext() {
@@ -53,9 +58,34 @@ protected:
      */
     virtual ENGINE_ERROR_CODE step() = 0;
 
+    /**
+     * Run the function on the executor pool (see OffloadTask). The state
+     * machine should move to the state to continue in once the function
+     * completed, and return the value returned by this method.
+     *
+     * The task isn't scheduled until drive() marked the connection as
+     * blocked (so that we can't lose the notification).
+     *
+     * @param name the name of the task (used in the executor stats)
+     * @param function the function to run (it must not touch the connection)
+     * @return ENGINE_EWOULDBLOCK
+     */
+    ENGINE_ERROR_CODE offload(const char* name,
+                              std::function<ENGINE_ERROR_CODE()> function);
+
     /**
      * The connection this command context is bound to (it is used to send
      * response / set ewouldblock etc
      */
     McbpConnection& connection;
+
+private:
+    /**
+     * The task running the offloaded function. It is kept until the
+     * context is destroyed as it refers to the members of the context.
+     */
+    std::shared_ptr<Task> offloadTask;
+
+    /** Set when the offloadTask should be scheduled by drive() */
+    bool offloadPending;
 };
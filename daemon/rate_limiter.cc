@@ -0,0 +1,116 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const double ns_per_second = 1000000000.0;
+
+void TokenBucket::setRate(uint64_t rate, hrtime_t now) {
+    TokenBucket::rate = rate;
+    tokens = double(rate);
+    lastRefill = now;
+}
+
+void TokenBucket::refill(hrtime_t now) {
+    if (now > lastRefill) {
+        const double elapsed = double(now - lastRefill) / ns_per_second;
+        tokens = std::min(double(rate), tokens + elapsed * double(rate));
+    }
+    lastRefill = now;
+}
+
+hrtime_t TokenBucket::getWaitTime(uint64_t count, hrtime_t now) {
+    if (rate == 0) {
+        return 0;
+    }
+
+    refill(now);
+    // Requests larger than the burst size only needs a full bucket
+    const double needed = double(std::min(count, rate));
+    if (tokens >= needed) {
+        return 0;
+    }
+
+    const double wait = std::ceil((needed - tokens) * ns_per_second /
+                                  double(rate));
+    return std::max(hrtime_t(wait), hrtime_t(1));
+}
+
+void RateLimiter::setOpsLimit(uint64_t limit) {
+    std::lock_guard<std::mutex> guard(mutex);
+    ops.setRate(limit, gethrtime());
+    enabled.store(ops.getRate() != 0 || bytes.getRate() != 0);
+}
+
+void RateLimiter::setBytesLimit(uint64_t limit) {
+    std::lock_guard<std::mutex> guard(mutex);
+    bytes.setRate(limit, gethrtime());
+    enabled.store(ops.getRate() != 0 || bytes.getRate() != 0);
+}
+
+uint64_t RateLimiter::getOpsLimit() {
+    std::lock_guard<std::mutex> guard(mutex);
+    return ops.getRate();
+}
+
+uint64_t RateLimiter::getBytesLimit() {
+    std::lock_guard<std::mutex> guard(mutex);
+    return bytes.getRate();
+}
+
+hrtime_t RateLimiter::admit(size_t size, hrtime_t now) {
+    std::lock_guard<std::mutex> guard(mutex);
+    const auto wait = std::max(ops.getWaitTime(1, now),
+                               bytes.getWaitTime(size, now));
+    if (wait == 0) {
+        ops.consume(1);
+        bytes.consume(size);
+    }
+    return wait;
+}
+
+void RateLimiter::reset() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        ops.setRate(0, 0);
+        bytes.setRate(0, 0);
+        enabled.store(false);
+    }
+    maxDelay.store(0);
+    delays.reset();
+}
+
+unique_cJSON_ptr RateLimiter::toJSON() {
+    unique_cJSON_ptr ret(cJSON_CreateObject());
+    auto* root = ret.get();
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        const auto now = gethrtime();
+        cJSON_AddNumberToObject(root, "ops", ops.getRate());
+        cJSON_AddNumberToObject(root, "bytes", bytes.getRate());
+        cJSON_AddNumberToObject(root, "ops_available", ops.getTokens(now));
+        cJSON_AddNumberToObject(root, "bytes_available", bytes.getTokens(now));
+    }
+    cJSON_AddNumberToObject(root, "max_delay", maxDelay.load());
+    cJSON_AddItemToObject(root, "delays",
+                          cJSON_Parse(delays.to_string().c_str()));
+    return ret;
+}
@@ -0,0 +1,167 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cJSON_utils.h>
+#include <cstdint>
+#include <mutex>
+#include <platform/platform.h>
+#include "timing_histogram.h"
+
+/**
+ * A TokenBucket is refilled with tokens at a fixed rate (tokens per
+ * second), and holds at most one second worth of tokens (the burst size).
+ *
+ * A request for more tokens than the burst size is granted when the
+ * bucket is full, and leaves the bucket in debt (so that the following
+ * requests has to wait until the debt is paid back). Otherwise a large
+ * request could never be granted.
+ *
+ * The TokenBucket is not thread safe.
+ */
+class TokenBucket {
+public:
+    TokenBucket()
+        : rate(0),
+          tokens(0),
+          lastRefill(0) {
+    }
+
+    /**
+     * Set the rate of the bucket (0 means unlimited). The bucket starts
+     * off full.
+     */
+    void setRate(uint64_t rate, hrtime_t now);
+
+    uint64_t getRate() const {
+        return rate;
+    }
+
+    /**
+     * Get the time until the given number of tokens is available.
+     *
+     * @param count the number of tokens needed
+     * @param now the current time (as returned from gethrtime())
+     * @return 0 if the tokens are available, otherwise the time (in ns)
+     *         until they are
+     */
+    hrtime_t getWaitTime(uint64_t count, hrtime_t now);
+
+    /**
+     * Consume the given number of tokens (call getWaitTime first to
+     * check that they are available)
+     */
+    void consume(uint64_t count) {
+        if (rate != 0) {
+            tokens -= double(count);
+        }
+    }
+
+    /** Get the number of tokens currently in the bucket */
+    double getTokens(hrtime_t now) {
+        refill(now);
+        return tokens;
+    }
+
+private:
+    void refill(hrtime_t now);
+
+    uint64_t rate;
+    double tokens;
+    hrtime_t lastRefill;
+};
+
+/**
+ * The RateLimiter enforces the limits on the number of operations and
+ * the number of bytes per second the clients may send to a bucket.
+ *
+ * A command which exceeds the limits may be delayed for up to
+ * maxDelay milliseconds (until the tokens are available). If it would
+ * have to wait longer it is rejected with
+ * PROTOCOL_BINARY_RESPONSE_RATE_LIMITED (which the client may retry).
+ *
+ * The limits are disabled by default, and checking if they're enabled
+ * doesn't acquire any locks.
+ */
+class RateLimiter {
+public:
+    RateLimiter()
+        : enabled(false),
+          maxDelay(0) {
+    }
+
+    RateLimiter(const RateLimiter&) = delete;
+
+    /** Set the number of operations per second (0 means unlimited) */
+    void setOpsLimit(uint64_t limit);
+
+    /** Set the number of bytes per second (0 means unlimited) */
+    void setBytesLimit(uint64_t limit);
+
+    /**
+     * Set the maximum number of milliseconds a command may be delayed
+     * before it is rejected (0 means it is rejected right away)
+     */
+    void setMaxDelay(uint32_t ms) {
+        maxDelay.store(ms);
+    }
+
+    uint64_t getOpsLimit();
+
+    uint64_t getBytesLimit();
+
+    uint32_t getMaxDelay() const {
+        return maxDelay.load();
+    }
+
+    /** Are any limits set? */
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Try to admit a command.
+     *
+     * @param bytes the size of the command (in bytes)
+     * @param now the current time (as returned from gethrtime())
+     * @return 0 if the command may run, otherwise the time (in ns) until
+     *         it may be retried
+     */
+    hrtime_t admit(size_t bytes, hrtime_t now);
+
+    /** Record the time a command was delayed before it was admitted */
+    void addDelay(hrtime_t delay) {
+        delays.add(delay);
+    }
+
+    /** Remove all limits and clear the delay histogram */
+    void reset();
+
+    /** Get a JSON representation of the limits and the current state */
+    unique_cJSON_ptr toJSON();
+
+private:
+    std::mutex mutex;
+    TokenBucket ops;
+    TokenBucket bytes;
+    std::atomic_bool enabled;
+    std::atomic<uint32_t> maxDelay;
+
+    /** The time the admitted commands was delayed */
+    TimingHistogram delays;
+};
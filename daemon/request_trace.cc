@@ -0,0 +1,84 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "request_trace.h"
+
+#include <memcached/protocol_binary.h>
+#include <utilities/protocol2text.h>
+#include <algorithm>
+#include <cmath>
+
+const size_t RequestSpanLog::Capacity;
+
+uint16_t encode_server_duration(hrtime_t duration) {
+    const double micros = double(duration) / 1000.0;
+    const double encoded = std::round(std::pow(micros * 2, 1.0 / 1.74));
+    if (encoded >= 65535.0) {
+        return 0xffff;
+    }
+    return uint16_t(encoded);
+}
+
+double decode_server_duration(uint16_t encoded) {
+    return std::pow(double(encoded), 1.74) / 2;
+}
+
+unique_cJSON_ptr RequestSpan::toJSON() const {
+    unique_cJSON_ptr ret(cJSON_CreateObject());
+    auto* root = ret.get();
+
+    cJSON_AddNumberToObject(root, "opaque", ntohl(opaque));
+    const char* name = memcached_opcode_2_text(opcode);
+    if (name == nullptr) {
+        cJSON_AddNumberToObject(root, "opcode", opcode);
+    } else {
+        cJSON_AddStringToObject(root, "opcode", name);
+    }
+    // The durations are reported in microseconds
+    cJSON_AddNumberToObject(root, "total", total / 1000);
+    cJSON_AddNumberToObject(root, "queue", queue / 1000);
+    cJSON_AddNumberToObject(root, "engine", engine / 1000);
+    cJSON_AddNumberToObject(root, "ewouldblock", ewouldblock / 1000);
+    cJSON_AddNumberToObject(root, "send", send / 1000);
+    return ret;
+}
+
+void RequestSpanLog::add(const RequestSpan& span) {
+    spans[added % Capacity] = span;
+    ++added;
+}
+
+const RequestSpan* RequestSpanLog::find(uint32_t opaque) const {
+    const size_t count = std::min(added, Capacity);
+    for (size_t ii = 1; ii <= count; ++ii) {
+        const auto& span = spans[(added - ii) % Capacity];
+        if (span.opaque == opaque) {
+            return &span;
+        }
+    }
+    return nullptr;
+}
+
+unique_cJSON_ptr RequestSpanLog::toJSON() const {
+    unique_cJSON_ptr ret(cJSON_CreateArray());
+    const size_t begin = added > Capacity ? added - Capacity : 0;
+    for (size_t ii = begin; ii < added; ++ii) {
+        cJSON_AddItemToArray(ret.get(),
+                             spans[ii % Capacity].toJSON().release());
+    }
+    return ret;
+}
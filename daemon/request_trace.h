@@ -0,0 +1,93 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/platform.h>
+#include <array>
+#include <cJSON_utils.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Encode a duration (in ns) in the 16 bit format used by the server
+ * duration frame info in the framing extras of the responses. The value
+ * is encoded as (micros * 2) ^ (1 / 1.74) (rounded) which covers up to ~2 minutes
+ * with a precision which decrease as the duration increase (durations
+ * above the maximum are encoded as 0xffff).
+ */
+uint16_t encode_server_duration(hrtime_t duration);
+
+/**
+ * Decode a duration encoded with encode_server_duration
+ *
+ * @return the duration in microseconds
+ */
+double decode_server_duration(uint16_t encoded);
+
+/**
+ * The RequestSpan holds the time spent by the server on a single request
+ * (all durations are in ns)
+ */
+struct RequestSpan {
+    /** The opaque from the request (as found in the packet) */
+    uint32_t opaque;
+    uint8_t opcode;
+    /** From the request was parsed until the response was sent */
+    hrtime_t total;
+    hrtime_t queue;
+    hrtime_t engine;
+    hrtime_t ewouldblock;
+    hrtime_t send;
+
+    unique_cJSON_ptr toJSON() const;
+};
+
+/**
+ * The RequestSpanLog holds the spans of the most recent requests on a
+ * connection which enabled tracing. It is only used by the thread
+ * serving the connection.
+ */
+class RequestSpanLog {
+public:
+    static const size_t Capacity = 32;
+
+    RequestSpanLog()
+        : added(0) {
+    }
+
+    void add(const RequestSpan& span);
+
+    /**
+     * Get the most recent span for the opaque
+     *
+     * @return the span or nullptr if it isn't in the log
+     */
+    const RequestSpan* find(uint32_t opaque) const;
+
+    /**
+     * Get a JSON array of the spans in the log (oldest first)
+     */
+    unique_cJSON_ptr toJSON() const;
+
+    void clear() {
+        added = 0;
+    }
+
+private:
+    std::array<RequestSpan, Capacity> spans;
+    size_t added;
+};
@@ -19,13 +19,22 @@
 #include "runtime.h"
 #include "memcached.h"
 #include "settings.h"
+#include "ssl_session_cache.h"
 #include "ssl_utils.h"
 
 #include <atomic>
+#include <cstring>
 #include <string>
 #include <mutex>
 
 #include <memcached/openssl.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#else
+#include <openssl/hmac.h>
+#endif
 
 
 static std::atomic<bool> server_initialized;
@@ -86,6 +95,210 @@ void set_ssl_ctx_protocol_mask(SSL_CTX* ctx) {
     SSL_CTX_set_options(ctx, ssl_protocol_mask.load(std::memory_order_acquire));
 }
 
+static SslSessionCache sslSessionCache(0);
+static SslTicketKeys sslTicketKeys;
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+typedef unsigned char* ssl_session_id_t;
+#else
+typedef const unsigned char* ssl_session_id_t;
+#endif
+
+void set_ssl_session_cache_size(size_t size) {
+    sslSessionCache.setCapacity(size);
+}
+
+SslSessionCache& get_ssl_session_cache() {
+    return sslSessionCache;
+}
+
+static std::string get_ssl_session_id(SSL_SESSION* session) {
+    unsigned int length;
+    const auto* id = SSL_SESSION_get_id(session, &length);
+    return std::string(reinterpret_cast<const char*>(id), length);
+}
+
+/**
+ * Called by OpenSSL when a new session is established. Store the session
+ * in the shared cache so that it may be resumed by other connections
+ */
+static int ssl_new_session_callback(SSL*, SSL_SESSION* session) {
+    const int size = i2d_SSL_SESSION(session, nullptr);
+    if (size <= 0) {
+        return 0;
+    }
+
+    try {
+        std::string data(size_t(size), '\0');
+        auto* ptr = reinterpret_cast<unsigned char*>(&data[0]);
+        i2d_SSL_SESSION(session, &ptr);
+        const auto expiry = SslSessionCache::Clock::now() +
+                std::chrono::seconds(SSL_SESSION_get_timeout(session));
+        sslSessionCache.insert(get_ssl_session_id(session), std::move(data),
+                               expiry);
+    } catch (const std::bad_alloc&) {
+        // The client needs to do a full handshake the next time
+    }
+
+    // We don't keep a reference to the session
+    return 0;
+}
+
+/**
+ * Called by OpenSSL when a client tries to resume a session which isn't
+ * in the internal cache of the SSL_CTX
+ */
+static SSL_SESSION* ssl_get_session_callback(SSL*,
+                                             ssl_session_id_t id,
+                                             int length,
+                                             int* copy) {
+    // The session we return is owned by the caller
+    *copy = 0;
+
+    std::string data;
+    try {
+        if (!sslSessionCache.lookup(
+                std::string(reinterpret_cast<const char*>(id), length),
+                data, SslSessionCache::Clock::now())) {
+            stats.ssl_session_cache_misses++;
+            return nullptr;
+        }
+    } catch (const std::bad_alloc&) {
+        stats.ssl_session_cache_misses++;
+        return nullptr;
+    }
+
+    const auto* ptr = reinterpret_cast<const unsigned char*>(data.data());
+    auto* session = d2i_SSL_SESSION(nullptr, &ptr, long(data.size()));
+    OPENSSL_cleanse(&data[0], data.size());
+    if (session == nullptr) {
+        stats.ssl_session_cache_misses++;
+    } else {
+        stats.ssl_session_cache_hits++;
+    }
+    return session;
+}
+
+static void ssl_remove_session_callback(SSL_CTX*, SSL_SESSION* session) {
+    sslSessionCache.remove(get_ssl_session_id(session));
+}
+
+/**
+ * Get the key for a session ticket and initialize the cipher with it.
+ * Called by OpenSSL to encrypt (enc == 1) or decrypt (enc == 0) a session
+ * ticket (see SSL_CTX_set_tlsext_ticket_key_cb(3))
+ *
+ * @param key where to store the key (only set if the return value is
+ *            positive, and the caller must cleanse it)
+ * @return the value the callback should return to OpenSSL
+ */
+static int ssl_ticket_key_init(unsigned char* key_name,
+                               unsigned char* iv,
+                               EVP_CIPHER_CTX* cipher,
+                               int enc,
+                               SslTicketKeys::Key& key) {
+    const auto now = SslTicketKeys::Clock::now();
+    const std::chrono::seconds interval(settings.getSslSessionTimeout());
+
+    try {
+        if (enc) {
+            key = sslTicketKeys.getEncryptionKey(now, interval);
+            if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+                OPENSSL_cleanse(&key, sizeof(key));
+                return -1;
+            }
+            memcpy(key_name, key.name, sizeof(key.name));
+            EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes,
+                               iv);
+            return 1;
+        }
+
+        bool renew;
+        if (!sslTicketKeys.getDecryptionKey(key_name, key, renew, now,
+                                            interval)) {
+            // Unknown (or expired) key; do a full handshake
+            stats.ssl_ticket_misses++;
+            return 0;
+        }
+        stats.ssl_ticket_hits++;
+        EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes, iv);
+        return renew ? 2 : 1;
+    } catch (const std::exception& e) {
+        LOG_WARNING(nullptr, "Failed to get the session ticket key: %s",
+                    e.what());
+        return -1;
+    }
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int ssl_ticket_key_callback(SSL*,
+                                   unsigned char* key_name,
+                                   unsigned char* iv,
+                                   EVP_CIPHER_CTX* cipher,
+                                   EVP_MAC_CTX* mac,
+                                   int enc) {
+    SslTicketKeys::Key key;
+    int ret = ssl_ticket_key_init(key_name, iv, cipher, enc, key);
+    if (ret > 0) {
+        char digest[] = "SHA256";
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac,
+                                              sizeof(key.hmac)),
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest,
+                                             0),
+            OSSL_PARAM_construct_end()};
+        if (EVP_MAC_CTX_set_params(mac, params) != 1) {
+            ret = -1;
+        }
+        OPENSSL_cleanse(&key, sizeof(key));
+    }
+    return ret;
+}
+#else
+static int ssl_ticket_key_callback(SSL*,
+                                   unsigned char* key_name,
+                                   unsigned char* iv,
+                                   EVP_CIPHER_CTX* cipher,
+                                   HMAC_CTX* hmac,
+                                   int enc) {
+    SslTicketKeys::Key key;
+    int ret = ssl_ticket_key_init(key_name, iv, cipher, enc, key);
+    if (ret > 0) {
+        HMAC_Init_ex(hmac, key.hmac, sizeof(key.hmac), EVP_sha256(), nullptr);
+        OPENSSL_cleanse(&key, sizeof(key));
+    }
+    return ret;
+}
+#endif
+
+void set_ssl_ctx_session_resumption(SSL_CTX* ctx) {
+    static const unsigned char context[] = "memcached";
+    SSL_CTX_set_session_id_context(ctx, context, sizeof(context) - 1);
+    SSL_CTX_set_timeout(ctx, long(settings.getSslSessionTimeout()));
+
+    if (settings.getSslSessionCacheSize() == 0) {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    } else {
+        // Each connection use its own SSL_CTX so the internal cache
+        // would never be used to resume a session
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER |
+                                            SSL_SESS_CACHE_NO_INTERNAL);
+        SSL_CTX_sess_set_new_cb(ctx, ssl_new_session_callback);
+        SSL_CTX_sess_set_get_cb(ctx, ssl_get_session_callback);
+        SSL_CTX_sess_set_remove_cb(ctx, ssl_remove_session_callback);
+    }
+
+    if (settings.isSslSessionTickets()) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ssl_ticket_key_callback);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(ctx, ssl_ticket_key_callback);
+#endif
+    } else {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    }
+}
+
 static std::atomic<Audit*> auditHandle { nullptr };
 
 void set_audit_handle(Audit* handle) {
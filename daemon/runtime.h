@@ -37,6 +37,22 @@ void set_ssl_protocol_mask(const std::string& mask);
 
 void set_ssl_ctx_protocol_mask(SSL_CTX* ctx);
 
+/**
+ * Set the maximum number of sessions in the TLS session cache shared
+ * by all connections
+ */
+void set_ssl_session_cache_size(size_t size);
+
+/**
+ * Enable session resumption (by using the shared session cache and
+ * session tickets as specified in the settings) for the SSL_CTX
+ */
+void set_ssl_ctx_session_resumption(SSL_CTX* ctx);
+
+class SslSessionCache;
+
+SslSessionCache& get_ssl_session_cache();
+
 class Audit;
 
 void set_audit_handle(Audit*);
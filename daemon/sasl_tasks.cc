@@ -65,7 +65,9 @@ SaslAuthTask::SaslAuthTask(Cookie& cookie_,
       error(CBSASL_FAIL),
       response(nullptr),
       response_length(0) {
-    // no more init needed
+    // The client is waiting for the response (and there is no
+    // backend thread involved)
+    setPriority(Priority::High);
 }
 
 void SaslAuthTask::notifyExecutionComplete() {
@@ -41,6 +41,9 @@ public:
 
     virtual void notifyExecutionComplete() override;
 
+    virtual const char* getName() const override {
+        return "sasl_auth";
+    }
 
     cbsasl_error_t getError() const {
         return error;
@@ -18,6 +18,7 @@
 
 #include <cstring>
 #include <platform/dirutils.h>
+#include "cpu_topology.h"
 #include "settings.h"
 #include "ssl_utils.h"
 
@@ -31,6 +32,7 @@ Settings settings;
  */
 Settings::Settings()
     : num_threads(0),
+      num_replication_threads(0),
       require_sasl(false),
       bio_drain_buffer_sz(0),
       datatype(false),
@@ -47,7 +49,15 @@ Settings::Settings()
 
     verbose.store(0);
     connection_idle_time.reset();
+    connection_compact_time.reset();
     dedupe_nmvb_maps.store(false);
+    ssl_ktls.store(false);
+    ssl_session_cache_size.store(0);
+    ssl_session_timeout.store(0);
+    ssl_session_tickets.store(false);
+    offload_threshold.store(0);
+    latency_breakdown.store(false);
+    slow_op_threshold.store(0);
 
     memset(&has, 0, sizeof(has));
     memset(&extensions, 0, sizeof(extensions));
@@ -124,6 +134,27 @@ static void handle_threads(Settings& s, cJSON* obj) {
     s.setNumWorkerThreads(obj->valueint);
 }
 
+/**
+ * Handle the "replication_threads" tag in the settings
+ *
+ *  The value must be a non-negative integer value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_replication_threads(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"replication_threads\" must be an integer");
+    }
+    if (obj->valueint < 0) {
+        throw std::invalid_argument(
+            "\"replication_threads\" must be a non-negative integer");
+    }
+
+    s.setNumReplicationThreads(obj->valueint);
+}
+
 /**
  * Handle the "require_init" tag in the settings
  *
@@ -226,6 +257,22 @@ static void handle_connection_idle_time(Settings& s, cJSON* obj) {
     s.setConnectionIdleTime(obj->valueint);
 }
 
+/**
+ * Handle the "connection_compact_time" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_connection_compact_time(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"connection_compact_time\" must be an integer");
+    }
+    s.setConnectionCompactTime(obj->valueint);
+}
+
 /**
  * Handle the "bio_drain_buffer_sz" tag in the settings
  *
@@ -320,6 +367,84 @@ static void handle_ssl_minimum_protocol(Settings& s, cJSON* obj) {
     s.setSslMinimumProtocol(obj->valuestring);
 }
 
+/**
+ * Handle the "ssl_ktls" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_ssl_ktls(Settings& s, cJSON* obj) {
+    if (obj->type == cJSON_True) {
+        s.setSslKtls(true);
+    } else if (obj->type == cJSON_False) {
+        s.setSslKtls(false);
+    } else {
+        throw std::invalid_argument(
+            "\"ssl_ktls\" must be a boolean value");
+    }
+}
+
+/**
+ * Handle the "ssl_session_cache_size" tag in the settings
+ *
+ *  The value must be a non-negative integer
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_ssl_session_cache_size(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"ssl_session_cache_size\" must be an integer");
+    }
+    if (obj->valueint < 0) {
+        throw std::invalid_argument(
+            "\"ssl_session_cache_size\" must be a non-negative integer");
+    }
+    s.setSslSessionCacheSize(size_t(obj->valueint));
+}
+
+/**
+ * Handle the "ssl_session_timeout" tag in the settings
+ *
+ *  The value must be a positive integer
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_ssl_session_timeout(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"ssl_session_timeout\" must be an integer");
+    }
+    if (obj->valueint <= 0) {
+        throw std::invalid_argument(
+            "\"ssl_session_timeout\" must be a positive integer");
+    }
+    s.setSslSessionTimeout(size_t(obj->valueint));
+}
+
+/**
+ * Handle the "ssl_session_tickets" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_ssl_session_tickets(Settings& s, cJSON* obj) {
+    if (obj->type == cJSON_True) {
+        s.setSslSessionTickets(true);
+    } else if (obj->type == cJSON_False) {
+        s.setSslSessionTickets(false);
+    } else {
+        throw std::invalid_argument(
+            "\"ssl_session_tickets\" must be a boolean value");
+    }
+}
+
 /**
  * Handle the "get_max_packet_size" tag in the settings
  *
@@ -408,6 +533,65 @@ static void handle_dedupe_nmvb_maps(Settings& s, cJSON* obj) {
     }
 }
 
+/**
+ * Handle the "offload_threshold" tag in the settings
+ *
+ *  The value must be a non-negative integer
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_offload_threshold(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"offload_threshold\" must be an integer");
+    }
+    if (obj->valueint < 0) {
+        throw std::invalid_argument(
+            "\"offload_threshold\" must be a non-negative integer");
+    }
+    s.setOffloadThreshold(size_t(obj->valueint));
+}
+
+/**
+ * Handle the "latency_breakdown" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_latency_breakdown(Settings& s, cJSON* obj) {
+    if (obj->type == cJSON_True) {
+        s.setLatencyBreakdown(true);
+    } else if (obj->type == cJSON_False) {
+        s.setLatencyBreakdown(false);
+    } else {
+        throw std::invalid_argument(
+            "\"latency_breakdown\" must be a boolean value");
+    }
+}
+
+/**
+ * Handle the "slow_op_threshold" tag in the settings
+ *
+ *  The value must be a non-negative integer
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_slow_op_threshold(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"slow_op_threshold\" must be an integer");
+    }
+    if (obj->valueint < 0) {
+        throw std::invalid_argument(
+            "\"slow_op_threshold\" must be a non-negative integer");
+    }
+    s.setSlowOpThreshold(size_t(obj->valueint));
+}
+
 /**
  * Handle the "extensions" tag in the settings
  *
@@ -450,6 +634,26 @@ static void handle_interfaces(Settings& s, cJSON* obj) {
                 "Elements in the \"interfaces\" array myst be objects");
         }
         interface ifc(child);
+        // The port identifies unix domain socket interfaces, so it can't
+        // be shared with any other interface. A TCP interface with port 0
+        // gets its port from the operating system, which could pick the
+        // port of the unix domain socket, so it can't be combined with
+        // unix domain sockets.
+        for (const auto& other : s.getInterfaces()) {
+            if (!ifc.isUnixSocket() && !other.isUnixSocket()) {
+                continue;
+            }
+            if (other.port == ifc.port) {
+                throw std::invalid_argument(
+                    "\"port\" " + std::to_string(ifc.port) +
+                    " of the unix domain socket is used by another interface");
+            }
+            if (ifc.port == 0 || other.port == 0) {
+                throw std::invalid_argument(
+                    "\"port\" 0 can't be used together with unix domain "
+                    "sockets");
+            }
+        }
         s.addInterface(ifc);
     }
 }
@@ -463,6 +667,15 @@ static void handle_breakpad(Settings& s, cJSON* obj) {
     s.setBreakpadSettings(breakpad);
 }
 
+static void handle_cpu_affinity(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Object) {
+        throw std::invalid_argument("\"cpu_affinity\" must be an object");
+    }
+
+    CpuAffinitySettings cpu_affinity(obj);
+    s.setCpuAffinity(cpu_affinity);
+}
+
 void Settings::reconfigure(const unique_cJSON_ptr& json) {
     // Nuke the default interface added to the system in settings_init and
     // use the ones in the configuration file.. (this is a bit messy)
@@ -490,6 +703,7 @@ void Settings::reconfigure(const unique_cJSON_ptr& json) {
         {"admin",                        handle_admin},
         {"audit_file",                   handle_audit_file},
         {"threads",                      handle_threads},
+        {"replication_threads",          handle_replication_threads},
         {"interfaces",                   handle_interfaces},
         {"extensions",                   handle_extensions},
         {"require_init",                 handle_require_init},
@@ -500,17 +714,26 @@ void Settings::reconfigure(const unique_cJSON_ptr& json) {
         {"reqs_per_event_low_priority",  handle_reqs_event},
         {"verbosity",                    handle_verbosity},
         {"connection_idle_time",         handle_connection_idle_time},
+        {"connection_compact_time",      handle_connection_compact_time},
         {"bio_drain_buffer_sz",          handle_bio_drain_buffer_sz},
         {"datatype_support",             handle_datatype_support},
         {"root",                         handle_root},
         {"ssl_cipher_list",              handle_ssl_cipher_list},
         {"ssl_minimum_protocol",         handle_ssl_minimum_protocol},
+        {"ssl_ktls",                     handle_ssl_ktls},
+        {"ssl_session_cache_size",       handle_ssl_session_cache_size},
+        {"ssl_session_timeout",          handle_ssl_session_timeout},
+        {"ssl_session_tickets",          handle_ssl_session_tickets},
         {"breakpad",                     handle_breakpad},
+        {"cpu_affinity",                 handle_cpu_affinity},
         {"max_packet_size",              handle_max_packet_size},
         {"stdin_listen",                 handle_stdin_listen},
         {"exit_on_connection_close",     handle_exit_on_connection_close},
         {"sasl_mechanisms",              handle_sasl_mechanisms},
-        {"dedupe_nmvb_maps",             handle_dedupe_nmvb_maps}
+        {"dedupe_nmvb_maps",             handle_dedupe_nmvb_maps},
+        {"offload_threshold",            handle_offload_threshold},
+        {"latency_breakdown",            handle_latency_breakdown},
+        {"slow_op_threshold",            handle_slow_op_threshold}
     };
 
     cJSON* obj = json->child;
@@ -638,6 +861,58 @@ static void handle_interface_ssl(struct interface& ifc, cJSON* obj) {
     ifc.ssl.cert.assign(cert->valuestring);
 }
 
+static void handle_interface_path(struct interface& ifc, cJSON* obj) {
+    if (obj->type != cJSON_String) {
+        throw std::invalid_argument("\"path\" must be a string");
+    }
+
+#ifdef WIN32
+    throw std::invalid_argument(
+        "\"path\": unix domain sockets are not supported on this platform");
+#else
+    std::string path(obj->valuestring);
+    if (path.empty()) {
+        throw std::invalid_argument("\"path\" can't be empty");
+    }
+    if (path.size() >= sizeof(sockaddr_un::sun_path)) {
+        throw std::invalid_argument("\"path\" is too long");
+    }
+    ifc.path = path;
+#endif
+}
+
+static void handle_interface_permissions(struct interface& ifc, cJSON* obj) {
+    if (obj->type != cJSON_String) {
+        throw std::invalid_argument(
+            "\"permissions\" must be a string with an octal number");
+    }
+
+    const std::string permissions(obj->valuestring);
+    if (permissions.empty() || permissions.size() > 4 ||
+        permissions.find_first_not_of("01234567") != std::string::npos) {
+        throw std::invalid_argument(
+            "\"permissions\" must be a string with an octal number");
+    }
+
+    ifc.permissions = int(std::stoul(permissions, nullptr, 8));
+}
+
+static void handle_interface_owner(struct interface& ifc, cJSON* obj) {
+    if (obj->type != cJSON_String) {
+        throw std::invalid_argument("\"owner\" must be a string");
+    }
+
+    ifc.owner.assign(obj->valuestring);
+}
+
+static void handle_interface_group(struct interface& ifc, cJSON* obj) {
+    if (obj->type != cJSON_String) {
+        throw std::invalid_argument("\"group\" must be a string");
+    }
+
+    ifc.group.assign(obj->valuestring);
+}
+
 static void handle_interface_protocol(struct interface& ifc, cJSON* obj) {
     if (obj->type != cJSON_String) {
         throw std::invalid_argument("\"protocol\" must be a string");
@@ -688,8 +963,16 @@ interface::interface(const cJSON* json)
         {"ssl",         handle_interface_ssl},
         {"management",  handle_interface_management},
         {"protocol",    handle_interface_protocol},
+        {"path",        handle_interface_path},
+        {"permissions", handle_interface_permissions},
+        {"owner",       handle_interface_owner},
+        {"group",       handle_interface_group},
     };
 
+    // The port identifies unix domain socket interfaces, so it can't be
+    // left to the default value (or picked by the operating system)
+    bool port = false;
+
     cJSON* obj = json->child;
     while (obj != nullptr) {
         std::string key(obj->string);
@@ -706,10 +989,17 @@ interface::interface(const cJSON* json)
             Settings::logit(EXTENSION_LOG_NOTICE,
                             "Unknown token \"%s\" in config ignored.\n",
                             obj->string);
+        } else if (key == "port") {
+            port = true;
         }
 
         obj = obj->next;
     }
+
+    if (isUnixSocket() && (!port || this->port == 0)) {
+        throw std::invalid_argument(
+            "\"port\" must be set to a non-zero value for \"path\"");
+    }
 }
 
 void Settings::updateSettings(const Settings& other, bool apply) {
@@ -726,6 +1016,20 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         }
     }
 
+    if (other.has.replication_threads) {
+        if (other.num_replication_threads != num_replication_threads) {
+            throw std::invalid_argument(
+                "replication_threads can't be changed dynamically");
+        }
+    }
+
+    if (other.has.cpu_affinity) {
+        if (other.cpu_affinity != cpu_affinity) {
+            throw std::invalid_argument(
+                "cpu_affinity can't be changed dynamically");
+        }
+    }
+
     if (other.has.audit) {
         if (other.audit_file != audit_file) {
             throw std::invalid_argument("audit can't be changed dynamically");
@@ -804,6 +1108,7 @@ void Settings::updateSettings(const Settings& other, bool apply) {
 
             // the following fields can't change
             if ((i1.host != i2.host) || (i1.port != i2.port) ||
+                (i1.path != i2.path) ||
                 (i1.ipv4 != i2.ipv4) || (i1.ipv6 != i2.ipv6) ||
                 (i1.protocol != i2.protocol) ||
                 (i1.management != i2.management)) {
@@ -900,6 +1205,15 @@ void Settings::updateSettings(const Settings& other, bool apply) {
             setConnectionIdleTime(other.connection_idle_time);
         }
     }
+    if (other.has.connection_compact_time) {
+        if (other.connection_compact_time != connection_compact_time) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "Change connection compact time from %u to %u",
+                  connection_compact_time.load(),
+                  other.connection_compact_time.load());
+            setConnectionCompactTime(other.connection_compact_time);
+        }
+    }
     if (other.has.max_packet_size) {
         if (other.max_packet_size != max_packet_size) {
             logit(EXTENSION_LOG_NOTICE,
@@ -930,6 +1244,40 @@ void Settings::updateSettings(const Settings& other, bool apply) {
             setSslMinimumProtocol(other.ssl_minimum_protocol);
         }
     }
+    if (other.has.ssl_ktls) {
+        if (other.ssl_ktls != ssl_ktls) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "%s kTLS",
+                  other.ssl_ktls.load() ? "Enable" : "Disable");
+            setSslKtls(other.ssl_ktls.load());
+        }
+    }
+    if (other.has.ssl_session_cache_size) {
+        if (other.ssl_session_cache_size != ssl_session_cache_size) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "Change SSL session cache size from %zu to %zu",
+                  ssl_session_cache_size.load(),
+                  other.ssl_session_cache_size.load());
+            setSslSessionCacheSize(other.ssl_session_cache_size.load());
+        }
+    }
+    if (other.has.ssl_session_timeout) {
+        if (other.ssl_session_timeout != ssl_session_timeout) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "Change SSL session timeout from %zu to %zu",
+                  ssl_session_timeout.load(),
+                  other.ssl_session_timeout.load());
+            setSslSessionTimeout(other.ssl_session_timeout.load());
+        }
+    }
+    if (other.has.ssl_session_tickets) {
+        if (other.ssl_session_tickets != ssl_session_tickets) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "%s SSL session tickets",
+                  other.ssl_session_tickets.load() ? "Enable" : "Disable");
+            setSslSessionTickets(other.ssl_session_tickets.load());
+        }
+    }
     if (other.has.dedupe_nmvb_maps) {
         if (other.dedupe_nmvb_maps != dedupe_nmvb_maps) {
             logit(EXTENSION_LOG_NOTICE,
@@ -938,6 +1286,32 @@ void Settings::updateSettings(const Settings& other, bool apply) {
             setDedupeNmvbMaps(other.dedupe_nmvb_maps.load());
         }
     }
+    if (other.has.offload_threshold) {
+        if (other.offload_threshold != offload_threshold) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "Change offload threshold from %zu to %zu",
+                  offload_threshold.load(),
+                  other.offload_threshold.load());
+            setOffloadThreshold(other.offload_threshold.load());
+        }
+    }
+    if (other.has.latency_breakdown) {
+        if (other.latency_breakdown != latency_breakdown) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "%s latency breakdown",
+                  other.latency_breakdown.load() ? "Enable" : "Disable");
+            setLatencyBreakdown(other.latency_breakdown.load());
+        }
+    }
+    if (other.has.slow_op_threshold) {
+        if (other.slow_op_threshold != slow_op_threshold) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "Change slow operation threshold from %zu to %zu ms",
+                  slow_op_threshold.load(),
+                  other.slow_op_threshold.load());
+            setSlowOpThreshold(other.slow_op_threshold.load());
+        }
+    }
 
     if (other.has.interfaces) {
         // validate that we haven't changed stuff in the entries
@@ -1111,3 +1485,48 @@ BreakpadSettings::BreakpadSettings(const cJSON* json) {
         content = BreakpadContent::Default;
     }
 }
+
+const char* to_string(ThreadClass threadClass) {
+    switch (threadClass) {
+    case ThreadClass::Dispatcher:
+        return "dispatcher";
+    case ThreadClass::Workers:
+        return "workers";
+    case ThreadClass::Executors:
+        return "executors";
+    case ThreadClass::Background:
+        return "background";
+    }
+    throw std::invalid_argument("to_string: unknown thread class: " +
+                                std::to_string(int(threadClass)));
+}
+
+CpuAffinitySettings::CpuAffinitySettings(const cJSON* json)
+    : CpuAffinitySettings() {
+    for (auto tc : {ThreadClass::Dispatcher, ThreadClass::Workers,
+                    ThreadClass::Executors, ThreadClass::Background}) {
+        auto* obj = cJSON_GetObjectItem(const_cast<cJSON*>(json),
+                                        to_string(tc));
+        if (obj == nullptr) {
+            continue;
+        }
+        if (obj->type != cJSON_String) {
+            throw std::invalid_argument(std::string("\"cpu_affinity:") +
+                                        to_string(tc) +
+                                        "\" settings must be a string");
+        }
+        setCpus(tc, cpu_list_parse(obj->valuestring));
+    }
+
+    auto* obj = cJSON_GetObjectItem(const_cast<cJSON*>(json), "numa_binding");
+    if (obj != nullptr) {
+        if (obj->type == cJSON_True) {
+            numa_binding = true;
+        } else if (obj->type == cJSON_False) {
+            numa_binding = false;
+        } else {
+            throw std::invalid_argument(
+                "\"cpu_affinity:numa_binding\" settings must be a boolean value");
+        }
+    }
+}
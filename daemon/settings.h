@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include <array>
 #include <atomic>
 #include <cJSON_utils.h>
 #include <cstdarg>
@@ -53,11 +54,19 @@ struct interface {
           ipv4(true),
           tcp_nodelay(true),
           management(false),
-          protocol(Protocol::Memcached) {
+          protocol(Protocol::Memcached),
+          permissions(0660) {
     }
 
     interface(const cJSON* json);
 
+    /**
+     * Is this interface an AF_UNIX (unix domain socket) interface
+     */
+    bool isUnixSocket() const {
+        return !path.empty();
+    }
+
     std::string host;
     struct {
         std::string key;
@@ -71,6 +80,20 @@ struct interface {
     bool tcp_nodelay;
     bool management;
     Protocol protocol;
+
+    /**
+     * The path of the unix domain socket to listen on (empty for TCP
+     * interfaces). For unix domain sockets the port isn't used for the
+     * connection, but identifies the interface (in stats, the port
+     * number file and when the interfaces are updated)
+     */
+    std::string path;
+    /** The permissions of the unix domain socket */
+    int permissions;
+    /** The user owning the unix domain socket (empty for no change) */
+    std::string owner;
+    /** The group owning the unix domain socket (empty for no change) */
+    std::string group;
 };
 
 /* pair of shared object name and config for an extension to be loaded. */
@@ -167,6 +190,94 @@ protected:
     BreakpadContent content;
 };
 
+/**
+ * The classes of threads which may be bound to a set of CPUs
+ */
+enum class ThreadClass {
+    /** The thread accepting new connections */
+    Dispatcher,
+    /** The worker threads serving the connections */
+    Workers,
+    /** The threads in the executor pool */
+    Executors,
+    /** All other threads (the logger, the audit daemon etc) */
+    Background
+};
+
+/**
+ * Get the name used for the thread class in the configuration
+ */
+const char* to_string(ThreadClass threadClass);
+
+/**
+ * Settings for how the threads are bound to CPUs and NUMA nodes.
+ */
+class CpuAffinitySettings {
+public:
+    /**
+     * Default constructor initialize the object so that none of the
+     * threads are bound
+     */
+    CpuAffinitySettings()
+        : numa_binding(false) {
+    }
+
+    /**
+     * Initialize the CpuAffinitySettings object from the specified JSON
+     * structure which looks like:
+     *
+     *     {
+     *         "dispatcher" : "0",
+     *         "workers" : "2-15",
+     *         "executors" : "16-19",
+     *         "background" : "1",
+     *         "numa_binding" : true
+     *     }
+     *
+     * All of the attributes are optional.
+     *
+     * @param json The json to parse
+     * @throws std::invalid_argument if the json dosn't look as expected
+     */
+    CpuAffinitySettings(const cJSON* json);
+
+    /**
+     * Get the CPUs the threads in the given class may run on (empty
+     * means that the threads aren't bound)
+     */
+    const std::vector<int>& getCpus(ThreadClass threadClass) const {
+        return cpus[int(threadClass)];
+    }
+
+    void setCpus(ThreadClass threadClass, std::vector<int> cpus) {
+        CpuAffinitySettings::cpus[int(threadClass)] = std::move(cpus);
+    }
+
+    /**
+     * Should each of the worker threads be bound to a single NUMA node
+     * (and allocate its memory from that node)?
+     */
+    bool isNumaBinding() const {
+        return numa_binding;
+    }
+
+    void setNumaBinding(bool numa_binding) {
+        CpuAffinitySettings::numa_binding = numa_binding;
+    }
+
+    bool operator==(const CpuAffinitySettings& other) const {
+        return cpus == other.cpus && numa_binding == other.numa_binding;
+    }
+
+    bool operator!=(const CpuAffinitySettings& other) const {
+        return !(*this == other);
+    }
+
+protected:
+    std::array<std::vector<int>, 4> cpus;
+    bool numa_binding;
+};
+
 enum class EventPriority {
     High,
     Medium,
@@ -263,6 +374,37 @@ public:
         notify_changed("threads");
     }
 
+    /**
+     * Get the number of worker threads serving the replication (DCP and
+     * TAP) connections
+     *
+     * @return the configured amount of replication threads (0 means that
+     *         the replication connections are served by the frontend
+     *         worker threads)
+     */
+    int getNumReplicationThreads() const {
+        return num_replication_threads;
+    }
+
+    /**
+     * Set the number of worker threads serving the replication connections
+     *
+     * @param num_threads the new number of threads
+     */
+    void setNumReplicationThreads(int num_threads) {
+        has.replication_threads = true;
+        Settings::num_replication_threads = num_threads;
+        notify_changed("replication_threads");
+    }
+
+    /**
+     * Get the total number of worker threads (the frontend threads and
+     * the replication threads)
+     */
+    int getNumTotalWorkerThreads() const {
+        return num_threads + num_replication_threads;
+    }
+
     /**
      * Add a new interface definition to the list of interfaces provided
      * by the server.
@@ -391,6 +533,28 @@ public:
         notify_changed("connection_idle_time");
     }
 
+    /**
+     * Get the number of seconds a connection may be idle before we release
+     * the memory it only use while executing commands (0 means never).
+     *
+     * @return the compact time in seconds
+     */
+    const size_t getConnectionCompactTime() const {
+        return connection_compact_time;
+    }
+
+    /**
+     * Set the connection compact time
+     *
+     * @param value the number of seconds a connection should stay idle
+     *              before it is compacted
+     */
+    void setConnectionCompactTime(size_t value) {
+        Settings::connection_compact_time = value;
+        has.connection_compact_time = true;
+        notify_changed("connection_compact_time");
+    }
+
     /**
      * Get the root directory of the couchbase installation
      *
@@ -616,6 +780,89 @@ public:
         notify_changed("ssl_minimum_protocol");
     }
 
+    /**
+     * Should the TLS record layer be moved to the kernel (kTLS) once
+     * the handshake is complete (when the kernel supports the cipher)?
+     *
+     * @return true if kTLS should be used
+     */
+    bool isSslKtls() const {
+        return ssl_ktls.load();
+    }
+
+    /**
+     * Set if the TLS record layer should be moved to the kernel (kTLS).
+     * It only affects the connections completing the handshake after
+     * the change.
+     *
+     * @param enable true if kTLS should be used
+     */
+    void setSslKtls(bool enable) {
+        Settings::ssl_ktls.store(enable);
+        has.ssl_ktls = true;
+        notify_changed("ssl_ktls");
+    }
+
+    /**
+     * Get the maximum number of TLS sessions to keep in the session cache
+     * shared by all connections (0 disables the session cache)
+     */
+    size_t getSslSessionCacheSize() const {
+        return ssl_session_cache_size.load();
+    }
+
+    /**
+     * Set the maximum number of TLS sessions to keep in the session cache
+     *
+     * @param size the number of sessions (0 disables the cache)
+     */
+    void setSslSessionCacheSize(size_t size) {
+        Settings::ssl_session_cache_size.store(size);
+        has.ssl_session_cache_size = true;
+        notify_changed("ssl_session_cache_size");
+    }
+
+    /**
+     * Get the number of seconds a TLS session may be resumed. The keys
+     * used to encrypt the session tickets are rotated with the same
+     * interval.
+     */
+    size_t getSslSessionTimeout() const {
+        return ssl_session_timeout.load();
+    }
+
+    /**
+     * Set the number of seconds a TLS session may be resumed (and the
+     * interval the session ticket keys are rotated)
+     *
+     * @param timeout the number of seconds
+     */
+    void setSslSessionTimeout(size_t timeout) {
+        Settings::ssl_session_timeout.store(timeout);
+        has.ssl_session_timeout = true;
+        notify_changed("ssl_session_timeout");
+    }
+
+    /**
+     * Should the server hand out stateless session tickets (RFC 5077)
+     * to the clients?
+     */
+    bool isSslSessionTickets() const {
+        return ssl_session_tickets.load();
+    }
+
+    /**
+     * Set if the server should hand out session tickets. It only affects
+     * the connections created after the change.
+     *
+     * @param enable true if session tickets should be used
+     */
+    void setSslSessionTickets(bool enable) {
+        Settings::ssl_session_tickets.store(enable);
+        has.ssl_session_tickets = true;
+        notify_changed("ssl_session_tickets");
+    }
+
     /**
      * Get the number of topkeys to track
      *
@@ -721,6 +968,73 @@ public:
         notify_changed("dedupe_nmvb_maps");
     }
 
+    /**
+     * Get the size (in bytes) of the documents where the expensive
+     * operations on the document (inflating it, validating it as JSON)
+     * should be moved off the front end threads and run by the executor
+     * pool.
+     *
+     * @return the threshold in bytes (0 means never)
+     */
+    size_t getOffloadThreshold() const {
+        return offload_threshold.load();
+    }
+
+    /**
+     * Set the size (in bytes) of the documents where the expensive
+     * operations on the document should be run by the executor pool
+     *
+     * @param threshold the threshold in bytes (0 disables offloading)
+     */
+    void setOffloadThreshold(size_t threshold) {
+        Settings::offload_threshold.store(threshold);
+        has.offload_threshold = true;
+        notify_changed("offload_threshold");
+    }
+
+    /**
+     * Should the time spent on each command be broken down in phases
+     * (waiting for the worker thread, running in the engine, waiting for
+     * the engine to notify us, sending the response)?
+     */
+    bool isLatencyBreakdown() const {
+        return latency_breakdown.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Set if the time spent on each command should be broken down in
+     * phases. It only affects the commands started after the change.
+     *
+     * @param enable true to record the time spent in each phase
+     */
+    void setLatencyBreakdown(bool enable) {
+        Settings::latency_breakdown.store(enable);
+        has.latency_breakdown = true;
+        notify_changed("latency_breakdown");
+    }
+
+    /**
+     * Get the number of milliseconds a command may take before its details
+     * are recorded in the slow operation log
+     *
+     * @return the threshold in ms (0 means never)
+     */
+    size_t getSlowOpThreshold() const {
+        return slow_op_threshold.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Set the number of milliseconds a command may take before its details
+     * are recorded in the slow operation log
+     *
+     * @param threshold the threshold in ms (0 disables the log)
+     */
+    void setSlowOpThreshold(size_t threshold) {
+        Settings::slow_op_threshold.store(threshold);
+        has.slow_op_threshold = true;
+        notify_changed("slow_op_threshold");
+    }
+
     /**
      * Get the breakpad settings
      *
@@ -741,6 +1055,23 @@ public:
         notify_changed("breakpad");
     }
 
+    /**
+     * Get the settings used to bind the threads to CPUs
+     */
+    const CpuAffinitySettings& getCpuAffinity() const {
+        return cpu_affinity;
+    }
+
+    /**
+     * Update the settings used to bind the threads to CPUs (only used
+     * when the threads are started)
+     */
+    void setCpuAffinity(const CpuAffinitySettings& cpu_affinity) {
+        Settings::cpu_affinity = cpu_affinity;
+        has.cpu_affinity = true;
+        notify_changed("cpu_affinity");
+    }
+
     /**
      * Update this settings object with the properties explicitly set in
      * the other object
@@ -780,6 +1111,11 @@ protected:
      * */
     int num_threads;
 
+    /**
+     * Number of libevent threads serving the replication connections
+     */
+    int num_replication_threads;
+
     /**
      * Array of interface settings we are listening on
      */
@@ -810,6 +1146,12 @@ protected:
      */
     Couchbase::RelaxedAtomic<size_t> connection_idle_time;
 
+    /**
+     * The number of seconds a client may be idle before we release the
+     * memory it only use while executing commands
+     */
+    Couchbase::RelaxedAtomic<size_t> connection_compact_time;
+
     /**
      * The root directory of the installation
      */
@@ -839,6 +1181,11 @@ protected:
      */
     BreakpadSettings breakpad;
 
+    /**
+     * The CPUs (and NUMA nodes) the threads are bound to
+     */
+    CpuAffinitySettings cpu_affinity;
+
     /**
      * To prevent us from reading (and allocating) an insane amount of
      * data off the network we'll ignore (and disconnect clients) that
@@ -862,6 +1209,26 @@ protected:
      */
     std::string ssl_minimum_protocol;
 
+    /**
+     * Should we move the TLS record layer to the kernel (kTLS)
+     */
+    std::atomic_bool ssl_ktls;
+
+    /**
+     * The maximum number of TLS sessions in the session cache
+     */
+    std::atomic<size_t> ssl_session_cache_size;
+
+    /**
+     * The number of seconds a TLS session may be resumed
+     */
+    std::atomic<size_t> ssl_session_timeout;
+
+    /**
+     * Should we hand out TLS session tickets
+     */
+    std::atomic_bool ssl_session_tickets;
+
     /**
      * The number of topkeys to track
      */
@@ -888,6 +1255,23 @@ protected:
      */
     std::atomic_bool dedupe_nmvb_maps;
 
+    /**
+     * The size of the documents where inflating and validating the document
+     * is run by the executor pool instead of the front end threads
+     */
+    std::atomic<size_t> offload_threshold;
+
+    /**
+     * Should we record the time spent on each phase of a command
+     */
+    std::atomic_bool latency_breakdown;
+
+    /**
+     * The number of ms a command may take before it is recorded in the
+     * slow operation log
+     */
+    std::atomic<size_t> slow_op_threshold;
+
 public:
     /**
      * Flags for each of the above config options, indicating if they were
@@ -898,6 +1282,7 @@ public:
     struct {
         bool admin;
         bool threads;
+        bool replication_threads;
         bool interfaces;
         bool extensions;
         bool audit;
@@ -908,19 +1293,28 @@ public:
         bool default_reqs_per_event;
         bool verbose;
         bool connection_idle_time;
+        bool connection_compact_time;
         bool bio_drain_buffer_sz;
         bool datatype;
         bool root;
         bool breakpad;
+        bool cpu_affinity;
         bool max_packet_size;
         bool require_init;
         bool ssl_cipher_list;
         bool ssl_minimum_protocol;
+        bool ssl_ktls;
+        bool ssl_session_cache_size;
+        bool ssl_session_timeout;
+        bool ssl_session_tickets;
         bool topkeys_size;
         bool stdin_listen;
         bool exit_on_connection_close;
         bool sasl_mechanisms;
         bool dedupe_nmvb_maps;
+        bool offload_threshold;
+        bool latency_breakdown;
+        bool slow_op_threshold;
     } has;
 
 protected:
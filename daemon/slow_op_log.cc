@@ -0,0 +1,184 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "slow_op_log.h"
+
+#include <memcached/isotime.h>
+#include <memcached/protocol_binary.h>
+#include <utilities/protocol2text.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+uint64_t SlowOperation::hashKey(const char* key, size_t nkey) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t ii = 0; ii < nkey; ++ii) {
+        hash ^= uint8_t(key[ii]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+unique_cJSON_ptr SlowOperation::toJSON() const {
+    unique_cJSON_ptr ret(cJSON_CreateObject());
+    auto* root = ret.get();
+
+    ISOTime::ISO8601String timestamp;
+    ISOTime::generatetimestamp(timestamp, time_t(seconds), usec);
+    cJSON_AddStringToObject(root, "timestamp", timestamp.data());
+    cJSON_AddNumberToObject(root, "connection", connectionId);
+    cJSON_AddStringToObject(root, "bucket", bucket.data());
+
+    const char* name = memcached_opcode_2_text(opcode);
+    char buffer[32];
+    if (name == nullptr) {
+        snprintf(buffer, sizeof(buffer), "0x%02x", opcode);
+        name = buffer;
+    }
+    cJSON_AddStringToObject(root, "opcode", name);
+    snprintf(buffer, sizeof(buffer), "0x%08x", opaque);
+    cJSON_AddStringToObject(root, "opaque", buffer);
+    snprintf(buffer, sizeof(buffer), "%016" PRIx64, keyHash);
+    cJSON_AddStringToObject(root, "key_hash", buffer);
+    cJSON_AddNumberToObject(root, "key_length", keyLength);
+    cJSON_AddNumberToObject(root, "value_size", valueSize);
+    cJSON_AddNumberToObject(root, "duration", duration);
+    cJSON_AddNumberToObject(root, "ewouldblock", ewouldblocks);
+
+    if (hasPhases) {
+        // The operation is recorded when the response is queued, so we
+        // don't know the time spent sending it
+        cJSON* obj = cJSON_CreateObject();
+        for (auto phase : {LatencyBreakdown::Phase::Queue,
+                           LatencyBreakdown::Phase::Engine,
+                           LatencyBreakdown::Phase::Ewouldblock}) {
+            cJSON_AddNumberToObject(obj, LatencyBreakdown::to_string(phase),
+                                    phases[size_t(phase)]);
+        }
+        cJSON_AddItemToObject(root, "phases", obj);
+    }
+
+    return ret;
+}
+
+const size_t SlowOperationRing::Capacity;
+
+SlowOperationRing::SlowOperationRing() {
+    for (auto& slot : slots) {
+        slot.sequence.store(0);
+    }
+    added.store(0);
+}
+
+void SlowOperationRing::add(const SlowOperation& op) {
+    // We're the only writer, so we don't need to worry about other
+    // threads updating added or the sequence numbers
+    const auto index = added.load(std::memory_order_relaxed);
+    auto& slot = slots[index % Capacity];
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.op = op;
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    added.store(index + 1, std::memory_order_release);
+}
+
+std::vector<SlowOperation> SlowOperationRing::getEntries(uint64_t from) const {
+    std::vector<SlowOperation> ret;
+    const auto end = added.load(std::memory_order_acquire);
+    auto begin = end > Capacity ? end - Capacity : 0;
+    begin = std::max(begin, from);
+
+    for (auto ii = begin; ii < end; ++ii) {
+        const auto& slot = slots[ii % Capacity];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) != 0) {
+            // Being updated
+            continue;
+        }
+        SlowOperation op = slot.op;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            // Overwritten while we copied it
+            continue;
+        }
+        ret.push_back(op);
+    }
+
+    return ret;
+}
+
+SlowOperationLog::SlowOperationLog(size_t threads)
+    : reported(std::max(threads, size_t(1)), 0) {
+    for (size_t ii = 0; ii < reported.size(); ++ii) {
+        rings.emplace_back(new SlowOperationRing);
+    }
+}
+
+void SlowOperationLog::add(size_t thread, const SlowOperation& op) {
+    rings[thread % rings.size()]->add(op);
+}
+
+unique_cJSON_ptr SlowOperationLog::toJSON(const std::string& bucket) const {
+    std::vector<SlowOperation> entries;
+    for (const auto& ring : rings) {
+        for (const auto& op : ring->getEntries()) {
+            if (bucket.empty() || bucket == op.bucket.data()) {
+                entries.push_back(op);
+            }
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const SlowOperation& a, const SlowOperation& b) {
+                  if (a.seconds != b.seconds) {
+                      return a.seconds < b.seconds;
+                  }
+                  return a.usec < b.usec;
+              });
+
+    unique_cJSON_ptr ret(cJSON_CreateArray());
+    for (const auto& op : entries) {
+        cJSON_AddItemToArray(ret.get(), op.toJSON().release());
+    }
+    return ret;
+}
+
+SlowOperationLog::Summary SlowOperationLog::getSummary() {
+    std::lock_guard<std::mutex> guard(mutex);
+    Summary summary;
+    summary.count = 0;
+    summary.hasSlowest = false;
+
+    for (size_t ii = 0; ii < rings.size(); ++ii) {
+        const auto added = rings[ii]->getAdded();
+        if (added == reported[ii]) {
+            continue;
+        }
+        summary.count += added - reported[ii];
+        for (const auto& op : rings[ii]->getEntries(reported[ii])) {
+            if (!summary.hasSlowest || op.duration > summary.slowest.duration) {
+                summary.slowest = op;
+                summary.hasSlowest = true;
+            }
+        }
+        reported[ii] = added;
+    }
+
+    return summary;
+}
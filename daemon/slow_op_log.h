@@ -0,0 +1,156 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/platform.h>
+#include <array>
+#include <atomic>
+#include <cJSON_utils.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "latency_breakdown.h"
+
+/**
+ * A SlowOperation holds the details of a command which took longer than
+ * the slow_op_threshold setting. The key is never stored, only a hash of
+ * it (so that the same key may be recognized across entries).
+ */
+struct SlowOperation {
+    /** The time the command completed (seconds and usec since epoch) */
+    uint64_t seconds;
+    uint32_t usec;
+    uint32_t connectionId;
+    uint32_t opaque;
+    uint8_t opcode;
+    /** The name of the bucket the command ran in ('\0' terminated) */
+    std::array<char, 101> bucket;
+    /** The hash of the key (see hashKey) */
+    uint64_t keyHash;
+    uint16_t keyLength;
+    /** The size of the value in the request */
+    uint32_t valueSize;
+    /** The total time spent on the command (in ns) */
+    hrtime_t duration;
+    /**
+     * The time spent in each phase (in ns), only recorded when the
+     * latency_breakdown setting is enabled
+     */
+    std::array<hrtime_t, LatencyBreakdown::NumPhases> phases;
+    bool hasPhases;
+    /** The number of times the command returned EWOULDBLOCK */
+    uint32_t ewouldblocks;
+
+    /**
+     * Hash the key (FNV-1a, 64 bit)
+     */
+    static uint64_t hashKey(const char* key, size_t nkey);
+
+    unique_cJSON_ptr toJSON() const;
+};
+
+/**
+ * The SlowOperationRing holds the most recent slow operations executed by
+ * a single worker thread. Only the worker thread adds entries, but any
+ * thread may read them without blocking the worker thread.
+ *
+ * Each slot is protected by a sequence number (a seqlock). The writer
+ * makes the sequence odd while it updates the slot, and the readers skip
+ * the slot if the sequence was odd or changed while they copied it.
+ */
+class SlowOperationRing {
+public:
+    static const size_t Capacity = 256;
+
+    SlowOperationRing();
+
+    void add(const SlowOperation& op);
+
+    /**
+     * Get the number of entries added to the ring (including the ones
+     * overwritten)
+     */
+    uint64_t getAdded() const {
+        return added.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Get a copy of the entries in the ring
+     *
+     * @param from only return the entries with a sequence number (the
+     *             value of getAdded() when they were added) >= from
+     */
+    std::vector<SlowOperation> getEntries(uint64_t from = 0) const;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        SlowOperation op;
+    };
+
+    std::array<Slot, Capacity> slots;
+    std::atomic<uint64_t> added;
+};
+
+/**
+ * The SlowOperationLog holds one SlowOperationRing per worker thread.
+ */
+class SlowOperationLog {
+public:
+    explicit SlowOperationLog(size_t threads);
+
+    /**
+     * Add a slow operation
+     *
+     * @param thread the index of the worker thread which ran the command
+     * @param op the details of the command
+     */
+    void add(size_t thread, const SlowOperation& op);
+
+    /**
+     * Get a JSON array of the slow operations from all of the threads
+     * (sorted by the time they completed)
+     *
+     * @param bucket only include the operations run in this bucket
+     *               (empty means all buckets)
+     */
+    unique_cJSON_ptr toJSON(const std::string& bucket = "") const;
+
+    struct Summary {
+        /** The number of slow operations since the last summary */
+        uint64_t count;
+        /** The slowest of them (if it is still in the ring) */
+        SlowOperation slowest;
+        bool hasSlowest;
+    };
+
+    /**
+     * Get a summary of the slow operations added since the previous call
+     */
+    Summary getSummary();
+
+private:
+    std::vector<std::unique_ptr<SlowOperationRing>> rings;
+
+    /** Serialize getSummary and protects reported */
+    std::mutex mutex;
+    /** The value of getAdded() for each ring in the previous summary */
+    std::vector<uint64_t> reported;
+};
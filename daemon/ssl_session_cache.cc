@@ -0,0 +1,187 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "ssl_session_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#include <stdexcept>
+
+SslSessionCache::SslSessionCache(size_t capacity, size_t shards)
+    : numShards(std::max(shards, size_t(1))),
+      shards(new Shard[numShards]),
+      capacity(capacity),
+      evictions(0) {
+}
+
+void SslSessionCache::setCapacity(size_t capacity) {
+    SslSessionCache::capacity.store(capacity);
+}
+
+SslSessionCache::Shard& SslSessionCache::getShard(const std::string& id) {
+    return shards[std::hash<std::string>()(id) % numShards];
+}
+
+size_t SslSessionCache::getShardCapacity() const {
+    const auto total = capacity.load();
+    return (total + numShards - 1) / numShards;
+}
+
+void SslSessionCache::insert(const std::string& id,
+                             std::string session,
+                             Clock::time_point expiry) {
+    const auto limit = getShardCapacity();
+    if (limit == 0) {
+        return;
+    }
+
+    auto& shard = getShard(id);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto iter = shard.index.find(id);
+    if (iter != shard.index.end()) {
+        shard.lru.erase(iter->second);
+        shard.index.erase(iter);
+    }
+
+    while (shard.lru.size() >= limit) {
+        shard.index.erase(shard.lru.back().id);
+        shard.lru.pop_back();
+        evictions++;
+    }
+
+    shard.lru.push_front(Entry{id, std::move(session), expiry});
+    shard.index[id] = shard.lru.begin();
+}
+
+bool SslSessionCache::lookup(const std::string& id,
+                             std::string& session,
+                             Clock::time_point now) {
+    auto& shard = getShard(id);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto iter = shard.index.find(id);
+    if (iter == shard.index.end()) {
+        return false;
+    }
+
+    if (iter->second->expiry <= now) {
+        shard.lru.erase(iter->second);
+        shard.index.erase(iter);
+        return false;
+    }
+
+    // Move the session to the front of the LRU
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+    session = iter->second->session;
+    return true;
+}
+
+void SslSessionCache::remove(const std::string& id) {
+    auto& shard = getShard(id);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto iter = shard.index.find(id);
+    if (iter != shard.index.end()) {
+        shard.lru.erase(iter->second);
+        shard.index.erase(iter);
+    }
+}
+
+size_t SslSessionCache::size() const {
+    size_t ret = 0;
+    for (size_t ii = 0; ii < numShards; ++ii) {
+        std::lock_guard<std::mutex> guard(shards[ii].mutex);
+        ret += shards[ii].lru.size();
+    }
+    return ret;
+}
+
+SslTicketKeys::SslTicketKeys()
+    : havePrevious(false),
+      initialized(false),
+      rotations(0) {
+}
+
+static void generate_ticket_key(SslTicketKeys::Key& key) {
+    if (RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+        RAND_bytes(key.aes, sizeof(key.aes)) != 1 ||
+        RAND_bytes(key.hmac, sizeof(key.hmac)) != 1) {
+        throw std::runtime_error(
+            "SslTicketKeys: Failed to generate a new ticket key");
+    }
+}
+
+void SslTicketKeys::rotate(Clock::time_point now) {
+    Key key;
+    generate_ticket_key(key);
+    key.created = now;
+
+    if (initialized) {
+        OPENSSL_cleanse(&previous, sizeof(previous));
+        previous = current;
+        havePrevious = true;
+    }
+    current = key;
+    OPENSSL_cleanse(&key, sizeof(key));
+    initialized = true;
+    rotations++;
+}
+
+void SslTicketKeys::maybeRotate(Clock::time_point now,
+                                std::chrono::seconds interval) {
+    if (!initialized || current.created + interval <= now) {
+        rotate(now);
+    }
+
+    // The previous key may only be used until it is two intervals old
+    if (havePrevious && previous.created + 2 * interval <= now) {
+        OPENSSL_cleanse(&previous, sizeof(previous));
+        havePrevious = false;
+    }
+}
+
+SslTicketKeys::Key SslTicketKeys::getEncryptionKey(
+        Clock::time_point now, std::chrono::seconds interval) {
+    std::lock_guard<std::mutex> guard(mutex);
+    maybeRotate(now, interval);
+    return current;
+}
+
+bool SslTicketKeys::getDecryptionKey(const uint8_t* name,
+                                     Key& key,
+                                     bool& renew,
+                                     Clock::time_point now,
+                                     std::chrono::seconds interval) {
+    std::lock_guard<std::mutex> guard(mutex);
+    maybeRotate(now, interval);
+
+    if (memcmp(name, current.name, sizeof(current.name)) == 0) {
+        key = current;
+        renew = false;
+        return true;
+    }
+
+    if (havePrevious &&
+        memcmp(name, previous.name, sizeof(previous.name)) == 0) {
+        key = previous;
+        renew = true;
+        return true;
+    }
+
+    return false;
+}
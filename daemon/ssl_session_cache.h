@@ -0,0 +1,200 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * The SslSessionCache is the server side TLS session cache shared by all
+ * of the worker threads (each connection use its own SSL_CTX, so the
+ * cache built into OpenSSL can't be used to resume a session created by
+ * another connection).
+ *
+ * The sessions are stored in their serialized (DER) form keyed by the
+ * session id. To reduce the contention during reconnect storms the cache
+ * is split into a number of shards (selected by the hash of the session
+ * id) each with its own lock, and each shard evicts the least recently
+ * used session when it holds more than its share of the capacity.
+ */
+class SslSessionCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Create a new session cache
+     *
+     * @param capacity the maximum number of sessions to keep
+     * @param shards the number of shards to split the cache into
+     */
+    SslSessionCache(size_t capacity, size_t shards = 16);
+
+    /**
+     * Set the maximum number of sessions to keep. Setting a lower value
+     * evicts the sessions above the new limit the next time a session is
+     * stored in the shard.
+     */
+    void setCapacity(size_t capacity);
+
+    size_t getCapacity() const {
+        return capacity.load();
+    }
+
+    /**
+     * Store a session in the cache (replacing any existing session with
+     * the same id)
+     *
+     * @param id the session id
+     * @param session the serialized session
+     * @param expiry the time when the session should no longer be resumed
+     */
+    void insert(const std::string& id,
+                std::string session,
+                Clock::time_point expiry);
+
+    /**
+     * Look up a session in the cache
+     *
+     * @param id the session id
+     * @param session set to the serialized session if found
+     * @param now the current time (expired sessions are removed)
+     * @return true if the session was found
+     */
+    bool lookup(const std::string& id,
+                std::string& session,
+                Clock::time_point now);
+
+    /**
+     * Remove a session from the cache
+     */
+    void remove(const std::string& id);
+
+    /**
+     * Get the number of sessions currently stored in the cache
+     */
+    size_t size() const;
+
+    /**
+     * Get the number of sessions evicted to make room for new sessions
+     */
+    uint64_t getEvictions() const {
+        return evictions.load();
+    }
+
+protected:
+    struct Entry {
+        std::string id;
+        std::string session;
+        Clock::time_point expiry;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // The most recently used session first
+        std::list<Entry> lru;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    Shard& getShard(const std::string& id);
+
+    size_t getShardCapacity() const;
+
+    const size_t numShards;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<size_t> capacity;
+    std::atomic<uint64_t> evictions;
+};
+
+/**
+ * The SslTicketKeys holds the keys used to encrypt and authenticate the
+ * stateless session tickets (RFC 5077) handed out to the clients.
+ *
+ * A new key is generated once the current key is older than the rotation
+ * interval. The previous key is kept for another interval so that the
+ * tickets it encrypted may still be used (the client receives a ticket
+ * encrypted with the current key when it resumes the session).
+ */
+class SslTicketKeys {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Key {
+        uint8_t name[16];
+        uint8_t aes[32];
+        uint8_t hmac[32];
+        Clock::time_point created;
+    };
+
+    SslTicketKeys();
+
+    /**
+     * Get the key used to encrypt new tickets (rotating the keys if the
+     * current key is older than the interval)
+     *
+     * @throws std::runtime_error if we failed to generate a new key
+     */
+    Key getEncryptionKey(Clock::time_point now, std::chrono::seconds interval);
+
+    /**
+     * Look up the key used to encrypt a ticket
+     *
+     * @param name the name of the key (from the ticket)
+     * @param key set to the key if found
+     * @param renew set to true if the ticket was encrypted with the
+     *              previous key and should be replaced
+     * @param now the current time
+     * @param interval the rotation interval
+     * @return true if the key is known (and not expired)
+     * @throws std::runtime_error if we failed to generate a new key
+     */
+    bool getDecryptionKey(const uint8_t* name,
+                          Key& key,
+                          bool& renew,
+                          Clock::time_point now,
+                          std::chrono::seconds interval);
+
+    /**
+     * Replace the current key with a new one (the current key becomes the
+     * previous key)
+     *
+     * @throws std::runtime_error if we failed to generate a new key
+     */
+    void rotate(Clock::time_point now);
+
+    /**
+     * Get the number of times the keys have been rotated
+     */
+    uint64_t getRotations() const {
+        return rotations.load();
+    }
+
+protected:
+    void maybeRotate(Clock::time_point now, std::chrono::seconds interval);
+
+    std::mutex mutex;
+    Key current;
+    Key previous;
+    bool havePrevious;
+    bool initialized;
+    std::atomic<uint64_t> rotations;
+};
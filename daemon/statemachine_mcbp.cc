@@ -24,6 +24,7 @@
 #include "sasl_tasks.h"
 #include "runtime.h"
 #include "mcaudit.h"
+#include "mc_time.h"
 
 void McbpStateMachine::setCurrentTask(McbpConnection& connection, TaskFunction task) {
     // Moving to the same state is legal
@@ -124,6 +125,7 @@ static void reset_cmd_handler(McbpConnection *c) {
     }
 
     c->resetCommandContext();
+    c->releaseParkableCommand();
 
     if (c->read.bytes == 0) {
         /* Make the whole read buffer available. */
@@ -131,6 +133,11 @@ static void reset_cmd_handler(McbpConnection *c) {
     }
 
     c->shrinkBuffers();
+    c->setLastCommandTime(mc_time_get_current_time());
+    if (mcbp_resume_parked_command(c)) {
+        return;
+    }
+
     if (c->read.bytes > 0) {
         c->setState(conn_parse_cmd);
     } else {
@@ -210,6 +217,12 @@ bool conn_waiting(McbpConnection *c) {
         return true;
     }
 
+    if (c->hasReadyParkedCommands()) {
+        // Resume the parked commands before we wait for more data
+        c->setState(conn_new_cmd);
+        return true;
+    }
+
     if (!c->updateEvent(EV_READ | EV_PERSIST)) {
         c->setState(conn_closing);
         return true;
@@ -247,6 +260,21 @@ bool conn_read(McbpConnection *c) {
 }
 
 bool conn_parse_cmd(McbpConnection *c) {
+    if (c->hasParkedCommands() && mcbp_is_parked_barrier(c)) {
+        if (c->hasReadyParkedCommands()) {
+            c->setState(conn_new_cmd);
+            return true;
+        }
+
+        // The next command can't start before the parked commands
+        // completes. Stop listening for input until the engine notifies
+        // one of them.
+        if (c->isRegisteredInLibevent()) {
+            c->unregisterEvent();
+        }
+        return false;
+    }
+
     if (try_read_mcbp_command(c) == 0) {
         /* wee need more data! */
         c->setState(conn_waiting);
@@ -262,6 +290,12 @@ bool conn_new_cmd(McbpConnection *c) {
 
     c->setStart(0);
 
+    // Commands which don't send a response (the quiet commands) ends up
+    // here without writing anything
+    if (c->getCookieObject().latency.isActive()) {
+        mcbp_collect_latency_breakdown(c, false);
+    }
+
     /*
      * In order to ensure that all clients will be served each
      * connection will only process a certain number of operations
@@ -313,6 +347,7 @@ bool conn_nread(McbpConnection *c) {
         bool block = false;
         mcbp_complete_nread(c);
         if (c->isEwouldblock()) {
+            c->getCookieObject().ewouldblocks++;
             c->unregisterEvent();
             block = true;
         }
@@ -390,6 +425,9 @@ bool conn_mwrite(McbpConnection *c) {
 
     switch (c->transmit()) {
     case McbpConnection::TransmitResult::Complete:
+        if (c->getCookieObject().latency.isActive()) {
+            mcbp_collect_latency_breakdown(c, true);
+        }
 
         c->releaseTempAlloc();
         if (c->getState() == conn_mwrite) {
@@ -427,6 +465,7 @@ bool conn_pending_close(McbpConnection *c) {
     if (!c->isSocketClosed()) {
         throw std::logic_error("conn_pending_close: socketDescriptor must be closed");
     }
+    c->releaseReadyParkedCommands();
     LOG_DEBUG(c,
               "Awaiting clients to release the cookie (pending close for %p)",
               (void*)c);
@@ -436,7 +475,7 @@ bool conn_pending_close(McbpConnection *c) {
      */
     perform_callbacks(ON_DISCONNECT, NULL, c->getCookie());
 
-    if (c->getRefcount() > 1) {
+    if (c->getRefcount() > 1 || c->hasParkedCommands()) {
         return false;
     }
 
@@ -472,6 +511,13 @@ bool conn_immediate_close(McbpConnection *c) {
 bool conn_closing(McbpConnection *c) {
     // Delete any attached command context
     c->resetCommandContext();
+    c->releaseParkableCommand();
+    c->releaseReadyParkedCommands();
+    if (c->cancelRateLimitRetry()) {
+        // The retry would have been the notification of the blocked command
+        c->setEwouldblock(false);
+        c->setRateLimitedSince(0);
+    }
 
     /* We don't want any network notifications anymore.. */
     c->unregisterEvent();
@@ -481,7 +527,8 @@ bool conn_closing(McbpConnection *c) {
     /* engine::release any allocated state */
     conn_cleanup_engine_allocations(c);
 
-    if (c->getRefcount() > 1 || c->isEwouldblock()) {
+    if (c->getRefcount() > 1 || c->isEwouldblock() ||
+        c->hasParkedCommands()) {
         c->setState(conn_pending_close);
     } else {
         c->setState(conn_immediate_close);
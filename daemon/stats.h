@@ -63,6 +63,16 @@ struct thread_stats {
         rbufs_existing = 0;
         wbufs_allocated = 0;
         wbufs_loaned = 0;
+        bufpool_hits = 0;
+        bufpool_misses = 0;
+
+        io_notifications = 0;
+        io_wakeups_coalesced = 0;
+        cmd_parked = 0;
+        cmd_rate_limited = 0;
+        cmd_rate_delayed = 0;
+        rate_delay_ns = 0;
+        cmd_deadline_exceeded = 0;
 
         iovused_high_watermark = 0;
         msgused_high_watermark = 0;
@@ -101,6 +111,16 @@ struct thread_stats {
         rbufs_existing += other.rbufs_existing;
         wbufs_allocated += other.wbufs_allocated;
         wbufs_loaned += other.wbufs_loaned;
+        bufpool_hits += other.bufpool_hits;
+        bufpool_misses += other.bufpool_misses;
+
+        io_notifications += other.io_notifications;
+        io_wakeups_coalesced += other.io_wakeups_coalesced;
+        cmd_parked += other.cmd_parked;
+        cmd_rate_limited += other.cmd_rate_limited;
+        cmd_rate_delayed += other.cmd_rate_delayed;
+        rate_delay_ns += other.rate_delay_ns;
+        cmd_deadline_exceeded += other.cmd_deadline_exceeded;
 
         iovused_high_watermark.setIfGreater(other.iovused_high_watermark);
         msgused_high_watermark.setIfGreater(other.msgused_high_watermark);
@@ -163,6 +183,29 @@ struct thread_stats {
     Couchbase::RelaxedAtomic<uint64_t> wbufs_allocated;
     /* # of write buffers which could be loaned (and hence didn't need to be allocated). */
     Couchbase::RelaxedAtomic<uint64_t> wbufs_loaned;
+    /* # of network buffers (lent or resized read buffers) served from the
+       threads buffer pool. */
+    Couchbase::RelaxedAtomic<uint64_t> bufpool_hits;
+    /* # of network buffers which had to be allocated because the buffer
+       pool didn't have a buffer of the requested size. */
+    Couchbase::RelaxedAtomic<uint64_t> bufpool_misses;
+
+    /* # of times a connection was scheduled through the pending io queue
+       (notify_io_complete etc). */
+    Couchbase::RelaxedAtomic<uint64_t> io_notifications;
+    /* # of io notifications which didn't need to wake up the worker thread
+       as a wakeup was already pending. */
+    Couchbase::RelaxedAtomic<uint64_t> io_wakeups_coalesced;
+    /* # of commands parked on connections using unordered execution. */
+    Couchbase::RelaxedAtomic<uint64_t> cmd_parked;
+    /* # of commands rejected by the rate limiter of the bucket. */
+    Couchbase::RelaxedAtomic<uint64_t> cmd_rate_limited;
+    /* # of commands delayed by the rate limiter of the bucket. */
+    Couchbase::RelaxedAtomic<uint64_t> cmd_rate_delayed;
+    /* Total time (in ns) commands was delayed by the rate limiter. */
+    Couchbase::RelaxedAtomic<uint64_t> rate_delay_ns;
+    /* # of commands shed as their deadline passed before they was executed. */
+    Couchbase::RelaxedAtomic<uint64_t> cmd_deadline_exceeded;
 
     // Right now we're protecting both the "high watermark" variables
     // between the same mutex
@@ -244,6 +287,8 @@ public:
     bool ipv4;
     /** Should TCP_NODELAY be enabled or not */
     bool tcp_nodelay;
+    /** The path of the unix domain socket (empty for TCP ports) */
+    std::string path;
     // You can't change the purpose of a port dynamically (It is only
     // used during startup
     const bool management;
@@ -270,6 +315,39 @@ struct stats {
     /** The number of times I reject a client */
     Couchbase::RelaxedAtomic<uint64_t> rejected_conns;
 
+    /** The number of connections moved to the replication threads */
+    Couchbase::RelaxedAtomic<uint64_t> replication_conns;
+
+    /** The number of TLS connections where the kernel encrypts the data */
+    Couchbase::RelaxedAtomic<uint64_t> ktls_tx_conns;
+
+    /** The number of TLS connections where the kernel decrypts the data */
+    Couchbase::RelaxedAtomic<uint64_t> ktls_rx_conns;
+
+    /** The number of TLS connections which couldn't use kTLS */
+    Couchbase::RelaxedAtomic<uint64_t> ktls_fallback;
+
+    /** The number of completed TLS handshakes */
+    Couchbase::RelaxedAtomic<uint64_t> ssl_handshakes;
+
+    /** The number of TLS handshakes which resumed a previous session */
+    Couchbase::RelaxedAtomic<uint64_t> ssl_handshakes_resumed;
+
+    /** The time (in usec) spent in SSL_accept */
+    Couchbase::RelaxedAtomic<uint64_t> ssl_handshake_time;
+
+    /** The number of sessions found in the TLS session cache */
+    Couchbase::RelaxedAtomic<uint64_t> ssl_session_cache_hits;
+
+    /** The number of sessions not found in the TLS session cache */
+    Couchbase::RelaxedAtomic<uint64_t> ssl_session_cache_misses;
+
+    /** The number of session tickets we could decrypt */
+    Couchbase::RelaxedAtomic<uint64_t> ssl_ticket_hits;
+
+    /** The number of session tickets encrypted with an unknown key */
+    Couchbase::RelaxedAtomic<uint64_t> ssl_ticket_misses;
+
     std::vector<ListeningPort> listening_ports;
 };
 
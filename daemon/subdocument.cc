@@ -384,7 +384,9 @@ static void subdoc_executor(McbpConnection *c, const void *packet,
             STATS_HIT(c, get, key, nkey);
         }
         update_topkeys(DocKey(reinterpret_cast<const uint8_t*>(key),
-                              keylen, DocNamespace::DefaultCollection), c);
+                              keylen, DocNamespace::DefaultCollection), c,
+                       context->traits.is_mutator ?
+                               0 : context->response_val_len);
 
         return;
     } while (auto_retry && attempts < MAXIMUM_ATTEMPTS);
@@ -16,11 +16,13 @@
  */
 #pragma once
 
-// Forward decl of the Executor class (used as a friend class)
+// Forward decl of the Executor classes (used as friend classes)
 class Executor;
+class ExecutorPool;
 
 #include <memcached/types.h>
 #include <mutex>
+#include <platform/platform.h>
 #include <stdexcept>
 /**
  * The Task class represents a Task that needs to be performed by the
@@ -29,7 +31,20 @@ class Executor;
  */
 class Task {
 public:
-    Task() : executor(nullptr) {
+    /**
+     * The executors always run the runnable task with the highest
+     * priority first
+     */
+    enum class Priority {
+        High,
+        Medium,
+        Low
+    };
+
+    Task()
+        : executor(nullptr),
+          priority(Priority::Medium),
+          queued(0) {
         // empty
     }
 
@@ -55,6 +70,26 @@ public:
     virtual void notifyExecutionComplete() {
     }
 
+    /**
+     * Get the name of the type of task (the executor pool keeps its
+     * statistics per type of task)
+     */
+    virtual const char* getName() const {
+        return "task";
+    }
+
+    Priority getPriority() const {
+        return priority;
+    }
+
+    /**
+     * Set the priority of the task. It is used the next time the task
+     * is put in the run queue.
+     */
+    void setPriority(Priority priority) {
+        Task::priority = priority;
+    }
+
     /**
      * Get the mutex used to protect the task and to ensure that we don't
      * have any race conditions. It should be held when:
@@ -85,17 +120,17 @@ private:
      * which property it should be allowed to touch)
      */
     friend class Executor;
+    friend class ExecutorPool;
 
     /**
-     * Set the executor that is supposed to handle this task. Once the
-     * task is pinned to an executor it cannot be moved.
+     * Set the executor that is supposed to handle this task. The task
+     * may only move to another executor (when an idle executor steals
+     * it) while it is runnable, and the executor running the task holds
+     * the task's mutex when it installs itself.
      *
      * @param executor_ the executor used to run the task
      */
     void setExecutor(Executor *executor_) {
-        if (executor != nullptr && executor != executor_) {
-            throw std::logic_error("The task can't switch executor");
-        }
         executor = executor_;
     }
 
@@ -104,6 +139,17 @@ private:
      */
     Executor* executor;
 
+    /**
+     * The priority of the task
+     */
+    Priority priority;
+
+    /**
+     * The time the task was put in the run queue (used to track the time
+     * the tasks wait for an executor)
+     */
+    hrtime_t queued;
+
     /**
      * The mutex used to ensure that different threads don't race trying
      * to set the tasks internal state
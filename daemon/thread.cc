@@ -5,7 +5,13 @@
 #include "config.h"
 #include "memcached.h"
 #include "connections.h"
+#include "connection_scheduler.h"
+#include "cpu_topology.h"
+#include "idle_connection_list.h"
+#include "mc_time.h"
+#include "pending_io_queue.h"
 
+#include <algorithm>
 #include <atomic>
 #include <stdio.h>
 #include <errno.h>
@@ -20,6 +26,15 @@
 #include <platform/strerror.h>
 #include <queue>
 #include <memory>
+#include <thread>
+
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
 
 #define ITEMS_PER_ALLOC 64
 
@@ -67,6 +82,13 @@ private:
     std::queue< std::unique_ptr<ConnectionQueueItem> > connections;
 };
 
+/*
+ * The maximum number of connections to run from the pending io queue
+ * every time the worker thread is notified before we'll give libevent
+ * the chance to serve other events.
+ */
+static const int max_pending_io_per_wakeup = 512;
+
 
 /* Connection lock around accepting new connections */
 cb_mutex_t conn_lock;
@@ -78,6 +100,7 @@ static LIBEVENT_THREAD dispatcher_thread;
  * can use to signal that they've put a new connection on its queue.
  */
 static int nthreads;
+static int nreplication_threads;
 static LIBEVENT_THREAD *threads;
 static cb_thread_t *thread_ids;
 
@@ -89,6 +112,10 @@ static cb_mutex_t init_lock;
 static cb_cond_t init_cond;
 
 static void thread_libevent_process(evutil_socket_t fd, short which, void *arg);
+static void run_scheduled_connections(evutil_socket_t fd, short which,
+                                      void *arg);
+static void compact_idle_connections(evutil_socket_t fd, short which,
+                                     void *arg);
 
 /*
  * Creates a worker thread.
@@ -144,6 +171,27 @@ bool create_notification_pipe(LIBEVENT_THREAD *me)
     return true;
 }
 
+/*
+ * Create the channel used to wake up a worker thread. We use an eventfd
+ * if the platform supports it (a single counter instead of a socketpair
+ * with a buffer we need to drain), and fall back to a notification pipe.
+ */
+static bool create_notification_channel(LIBEVENT_THREAD *me) {
+#ifdef HAVE_EVENTFD
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd != -1) {
+        me->notify[0] = me->notify[1] = fd;
+        me->notify_eventfd = true;
+        return true;
+    }
+
+    log_system_error(EXTENSION_LOG_WARNING, NULL,
+                     "Can't create notify eventfd: %s");
+#endif
+    me->notify_eventfd = false;
+    return create_notification_pipe(me);
+}
+
 static void setup_dispatcher(struct event_base *main_base,
                              void (*dispatcher_callback)(evutil_socket_t, short, void *))
 {
@@ -167,6 +215,90 @@ static void setup_dispatcher(struct event_base *main_base,
     }
 }
 
+/*
+ * Schedule the next run of compact_idle_connections. We run twice per
+ * compact time so that a connection is compacted no later than 1.5 times
+ * the compact time after it completed its last command.
+ */
+static void schedule_compact_idle_connections(LIBEVENT_THREAD *me) {
+    const auto compact_time = settings.getConnectionCompactTime();
+    struct timeval tv;
+    tv.tv_usec = 0;
+    if (compact_time == 0) {
+        // Disabled; check again later in case the setting is changed
+        tv.tv_sec = 10;
+    } else {
+        tv.tv_sec = std::max(long(compact_time / 2), 1L);
+    }
+
+    if (evtimer_add(&me->compact_event, &tv) == -1) {
+        LOG_WARNING(nullptr,
+                    "Failed to schedule compaction of idle connections "
+                    "for worker thread %u", me->index);
+    }
+}
+
+/*
+ * Release the per-command memory for the connections bound to the
+ * thread which hasn't completed a command within the compact time.
+ */
+static void compact_idle_connections(evutil_socket_t, short, void *arg) {
+    auto* me = reinterpret_cast<LIBEVENT_THREAD*>(arg);
+    const auto compact_time = settings.getConnectionCompactTime();
+    const rel_time_t now = mc_time_get_current_time();
+
+    if (compact_time != 0 && !memcached_shutdown && now > compact_time) {
+        LOCK_THREAD(me);
+        compact_idle_clients(me, rel_time_t(now - compact_time));
+        UNLOCK_THREAD(me);
+    }
+
+    schedule_compact_idle_connections(me);
+}
+
+/*
+ * Schedule the next round of the thread's ConnectionScheduler. We use a
+ * timer (with a zero timeout) so that libevent polls for new events
+ * (and runs their callbacks) between the rounds.
+ */
+static void schedule_run_connections(LIBEVENT_THREAD *me) {
+    if (evtimer_pending(&me->schedule_event, nullptr)) {
+        return;
+    }
+
+    struct timeval tv = {0, 0};
+    if (evtimer_add(&me->schedule_event, &tv) == -1) {
+        LOG_WARNING(nullptr,
+                    "Failed to schedule the ready connections for worker "
+                    "thread %u", me->index);
+    }
+}
+
+/*
+ * Run a round of the ready connections in the thread's ConnectionScheduler
+ */
+static void run_scheduled_connections(evutil_socket_t, short, void *arg) {
+    auto* me = reinterpret_cast<LIBEVENT_THREAD*>(arg);
+
+    LOCK_THREAD(me);
+    if (me->scheduler->runRound([](Connection& c, short which) {
+            run_event_loop(&c, which);
+        })) {
+        schedule_run_connections(me);
+    }
+
+    if (memcached_shutdown) {
+        // Someone requested memcached to shut down. If we don't have
+        // any connections bound to this thread we can just shut down
+        int connected = signal_idle_clients(me, -1, true);
+        if (connected == 0) {
+            LOG_NOTICE(NULL, "Stopping worker thread %u", me->index);
+            event_base_loopbreak(me->base);
+        }
+    }
+    UNLOCK_THREAD(me);
+}
+
 /*
  * Set up a thread's information.
  */
@@ -196,13 +328,55 @@ static void setup_thread(LIBEVENT_THREAD *me) {
         FATAL_ERROR(EXIT_FAILURE, "Can't monitor libevent notify pipe");
     }
 
+    if (evtimer_assign(&me->compact_event, me->base,
+                       compact_idle_connections, me) == -1) {
+        FATAL_ERROR(EXIT_FAILURE, "Can't set up idle connection timer");
+    }
+    schedule_compact_idle_connections(me);
+
+    if (evtimer_assign(&me->schedule_event, me->base,
+                       run_scheduled_connections, me) == -1) {
+        FATAL_ERROR(EXIT_FAILURE, "Can't set up connection scheduler timer");
+    }
+
     try {
         me->new_conn_queue = new ConnectionQueue;
     } catch (std::bad_alloc&) {
         FATAL_ERROR(EXIT_FAILURE, "Failed to allocate memory for connection queue");
     }
 
+    try {
+        me->pending_io = new PendingIoQueue;
+    } catch (std::bad_alloc&) {
+        FATAL_ERROR(EXIT_FAILURE, "Failed to allocate memory for pending io queue");
+    }
+
+    try {
+        me->scheduler = new ConnectionScheduler;
+    } catch (std::bad_alloc&) {
+        FATAL_ERROR(EXIT_FAILURE, "Failed to allocate memory for connection scheduler");
+    }
+
+    try {
+        me->idle_connections = new IdleConnectionList;
+    } catch (std::bad_alloc&) {
+        FATAL_ERROR(EXIT_FAILURE, "Failed to allocate memory for idle connection list");
+    }
+
     cb_mutex_initialize(&me->mutex);
+}
+
+/*
+ * Allocate the buffers and parsers used by the connections serviced by the
+ * thread. This is done by the worker thread itself (after it is bound to
+ * its CPUs) so that the memory is allocated from the thread's NUMA node.
+ */
+static void setup_thread_buffers(LIBEVENT_THREAD *me) {
+    try {
+        me->buffer_pool = new BufferPool;
+    } catch (std::bad_alloc&) {
+        FATAL_ERROR(EXIT_FAILURE, "Failed to allocate memory for buffer pool");
+    }
 
     // Initialize threads' sub-document parser / handler
     me->subdoc_op = subdoc_op_alloc();
@@ -214,6 +388,42 @@ static void setup_thread(LIBEVENT_THREAD *me) {
     }
 }
 
+int bind_current_thread(ThreadClass threadClass, size_t index) {
+    const auto& affinity = settings.getCpuAffinity();
+    const bool numa = affinity.isNumaBinding() &&
+                      threadClass == ThreadClass::Workers;
+    int node;
+    const auto cpus = CpuTopology::getInstance().getThreadCpus(
+        affinity.getCpus(threadClass), numa, index, node);
+
+#ifdef __linux__
+    const int err = cpu_affinity_set_current_thread(cpus);
+    if (err != 0) {
+        const auto& list = cpus.empty() ? cpu_affinity_get_process() : cpus;
+        LOG_WARNING(nullptr, "Failed to bind %s thread to CPUs %s: %s",
+                    to_string(threadClass), cpu_list_to_string(list).c_str(),
+                    cb_strerror(err).c_str());
+        return -1;
+    }
+
+#ifdef HAVE_LIBNUMA
+    if (node != -1 && numa_available() == 0) {
+        // Allocate the thread's memory from its own node instead of
+        // interleaving it across all of the nodes
+        numa_set_localalloc();
+    }
+#endif
+    return node;
+#else
+    if (!cpus.empty()) {
+        LOG_WARNING(nullptr,
+                    "Binding threads to CPUs is not supported on this "
+                    "platform");
+    }
+    return -1;
+#endif
+}
+
 /*
  * Worker thread: main event loop
  */
@@ -223,6 +433,8 @@ static void worker_libevent(void *arg) {
     /* Any per-thread setup can happen here; thread_init() will block until
      * all threads have finished initializing.
      */
+    bind_current_thread(ThreadClass::Workers, size_t(me->index));
+    setup_thread_buffers(me);
 
     cb_mutex_enter(&init_lock);
     init_count++;
@@ -235,18 +447,20 @@ static void worker_libevent(void *arg) {
     ERR_remove_state(0);
 }
 
-static int number_of_pending(Connection *c, Connection *list) {
-    int rv = 0;
-    for (; list; list = list->getNext()) {
-        if (list == c) {
-            rv ++;
+static void drain_notification_channel(LIBEVENT_THREAD* me, evutil_socket_t fd)
+{
+#ifdef HAVE_EVENTFD
+    if (me->notify_eventfd) {
+        uint64_t value;
+        if (read(fd, &value, sizeof(value)) == -1 &&
+            !is_blocking(GetLastError())) {
+            log_system_error(EXTENSION_LOG_WARNING, NULL,
+                             "Can't read from notify eventfd: %s");
         }
+        return;
     }
-    return rv;
-}
+#endif
 
-static void drain_notification_channel(evutil_socket_t fd)
-{
     int nread;
     while ((nread = recv(fd, devnull, sizeof(devnull), 0)) == (int)sizeof(devnull)) {
         /* empty */
@@ -282,13 +496,13 @@ void dispatch_new_connections(LIBEVENT_THREAD* me) {
 static void thread_libevent_process(evutil_socket_t fd, short which, void *arg) {
     LIBEVENT_THREAD* me = reinterpret_cast<LIBEVENT_THREAD*>(arg);
 
-    cb_assert(me->type == ThreadType::GENERAL);
+    cb_assert(me->type == ThreadType::GENERAL || me->type == ThreadType::TAP);
     // Start by draining the notification channel before doing any work.
     // By doing so we know that we'll be notified again if someone
     // tries to notify us while we're doing the work below (so we don't have
     // to care about race conditions for stuff people try to notify us
     // about.
-    drain_notification_channel(fd);
+    drain_notification_channel(me, fd);
 
     if (memcached_shutdown) {
         // Someone requested memcached to shut down. The listen thread should
@@ -309,13 +523,25 @@ static void thread_libevent_process(evutil_socket_t fd, short which, void *arg)
     dispatch_new_connections(me);
 
     LOCK_THREAD(me);
-    Connection* pending = me->pending_io;
-    me->pending_io = NULL;
-    while (pending != NULL) {
-        Connection *c = pending;
-        cb_assert(me == c->getThread());
-        pending = pending->getNext();
-        c->setNext(nullptr);
+    me->pending_io->disarm();
+    Connection* c;
+    int budget = max_pending_io_per_wakeup;
+    while (budget > 0 && (c = me->pending_io->pop()) != nullptr) {
+        auto* owner = c->getThread();
+        if (owner != me) {
+            // The connection was moved to another thread after it was
+            // queued; forward the notification to its new owner
+            auto* target = add_conn_to_pending_io_list(c);
+            if (target != nullptr) {
+                notify_thread(target);
+            }
+            continue;
+        }
+        if (!c->clearPendingIo()) {
+            // The notification was already consumed by event_handler
+            continue;
+        }
+        --budget;
 
         auto *mcbp = dynamic_cast<McbpConnection*>(c);
         if (mcbp != nullptr) {
@@ -333,7 +559,19 @@ static void thread_libevent_process(evutil_socket_t fd, short which, void *arg)
              */
             mcbp->setNumEvents(1);
         }
-        run_event_loop(c, EV_READ|EV_WRITE);
+
+        if (memcached_shutdown) {
+            unschedule_connection(c);
+            run_event_loop(c, EV_READ|EV_WRITE);
+        } else {
+            schedule_connection(c, EV_READ|EV_WRITE);
+        }
+    }
+
+    if (budget == 0 && me->pending_io->arm()) {
+        // There may be more connections in the queue; let libevent serve
+        // the other events before we continue
+        notify_thread(me);
     }
 
     /*
@@ -363,59 +601,6 @@ static void thread_libevent_process(evutil_socket_t fd, short which, void *arg)
 
 extern volatile rel_time_t current_time;
 
-static bool has_cycle(Connection *c) {
-    Connection *slowNode, *fastNode1, *fastNode2;
-
-    if (!c) {
-        return false;
-    }
-
-    slowNode = fastNode1 = fastNode2 = c;
-    while (slowNode && (fastNode1 = fastNode2->getNext()) && (fastNode2 = fastNode1->getNext())) {
-        if (slowNode == fastNode1 || slowNode == fastNode2) {
-            return true;
-        }
-        slowNode = slowNode->getNext();
-    }
-    return false;
-}
-
-bool list_contains(Connection *haystack, Connection *needle) {
-    for (; haystack; haystack = haystack->getNext()) {
-        if (needle == haystack) {
-            return true;
-        }
-    }
-    return false;
-}
-
-Connection * list_remove(Connection *haystack, Connection *needle) {
-    if (!haystack) {
-        return NULL;
-    }
-
-    if (haystack == needle) {
-        Connection *rv = needle->getNext();
-        needle->setNext(nullptr);
-        return rv;
-    }
-
-    haystack->setNext(list_remove(haystack->getNext(), needle));
-
-    return haystack;
-}
-
-static void enlist_conn(Connection *c, Connection **list) {
-    LIBEVENT_THREAD *thr = c->getThread();
-    cb_assert(list == &thr->pending_io);
-    cb_assert(!list_contains(thr->pending_io, c));
-    cb_assert(c->getNext() == nullptr);
-    c->setNext(*list);
-    *list = c;
-    cb_assert(list_contains(*list, c));
-    cb_assert(!has_cycle(*list));
-}
-
 void notify_io_complete(const void *void_cookie, ENGINE_ERROR_CODE status)
 {
     if (void_cookie == nullptr) {
@@ -434,24 +619,27 @@ void notify_io_complete(const void *void_cookie, ENGINE_ERROR_CODE status)
                     "connection set to null");
         }
 
-        LIBEVENT_THREAD* thr = connection->getThread();
-        if (thr == nullptr) {
+        if (connection->getThread() == nullptr) {
             throw std::runtime_error(
                 "notify_io_complete: connection should be bound to a thread");
         }
 
-        int notify;
-
         LOG_DEBUG(NULL, "Got notify from %u, status 0x%x",
                   connection->getId(), status);
 
-        LOCK_THREAD(thr);
-        reinterpret_cast<McbpConnection*>(connection)->setAiostat(status);
-        notify = add_conn_to_pending_io_list(connection);
-        UNLOCK_THREAD(thr);
-
-        /* kick the thread in the butt */
-        if (notify) {
+        if (cookie->parked != nullptr) {
+            cookie->parked->notifyIoComplete(status);
+        } else {
+            auto* mcbp = reinterpret_cast<McbpConnection*>(connection);
+            if (settings.isLatencyBreakdown() || mcbp->isTracingEnabled()) {
+                mcbp->getCookieObject().latency.notify(gethrtime());
+            }
+            mcbp->setAiostat(status);
+        }
+        // The connection may be migrated to another thread while we're
+        // here, so kick the thread it was actually queued on
+        auto* thr = add_conn_to_pending_io_list(connection);
+        if (thr != nullptr) {
             notify_thread(thr);
         }
     } else {
@@ -501,21 +689,76 @@ void notify_dispatcher(void) {
 /******************************* GLOBAL STATS ******************************/
 
 void threadlocal_stats_reset(struct thread_stats *thread_stats) {
-    for (int ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
+    for (int ii = 0; ii < settings.getNumTotalWorkerThreads(); ++ii) {
         thread_stats[ii].reset();
     }
 }
 
+/* Which replication thread we moved a connection to most recently. */
+static std::atomic<unsigned int> last_replication_thread;
+
+bool migrate_connection(Connection *c) {
+    auto* mcbp = dynamic_cast<McbpConnection*>(c);
+    if (mcbp == nullptr || nreplication_threads == 0 || memcached_shutdown ||
+        c->getThread()->type == ThreadType::TAP) {
+        c->setMigrationPending(false);
+        return false;
+    }
+
+    // Only move the connection between commands (and not while it is
+    // waiting for the engine or in the middle of a packet)
+    const auto state = mcbp->getState();
+    if (mcbp->isEwouldblock() || mcbp->hasParkedCommands() ||
+        !(state == conn_new_cmd || state == conn_waiting ||
+          state == conn_read || state == conn_ship_log)) {
+        return false;
+    }
+
+    const auto index = last_replication_thread++ % nreplication_threads;
+    LIBEVENT_THREAD* target = threads + nthreads - nreplication_threads + index;
+
+    // Detach the connection from this thread. Any notification queued
+    // for it is delivered to the new thread once it is moved
+    c->setMigrationPending(false);
+    unschedule_connection(c);
+    auto* thread = c->getThread();
+    thread->idle_connections->remove(*mcbp);
+    if (thread->pending_io->remove(c) && thread->pending_io->arm()) {
+        notify_thread(thread);
+    }
+    if (!mcbp->setEventBase(target->base)) {
+        c->initiateShutdown();
+        schedule_connection(c, EV_READ | EV_WRITE);
+        return false;
+    }
+
+    LOG_INFO(c, "%u: Moving replication connection to worker thread %u",
+             c->getId(), target->index);
+    stats.replication_conns++;
+
+    // From here on the connection belongs to the new thread, which
+    // registers it in libevent and runs it when it pops it from its
+    // pending io queue
+    c->setThread(target);
+    auto* owner = add_conn_to_pending_io_list(c);
+    if (owner != nullptr) {
+        notify_thread(owner);
+    }
+    return true;
+}
+
 /*
  * Initializes the thread subsystem, creating various worker threads.
  *
- * nthreads  Number of worker event handler threads to spawn
- * main_base Event base for main thread
+ * nthr         Number of worker event handler threads to spawn
+ * nreplication Number of replication event handler threads to spawn
+ * main_base    Event base for main thread
  */
-void thread_init(int nthr, struct event_base *main_base,
+void thread_init(int nthr, int nreplication, struct event_base *main_base,
                  void (*dispatcher_callback)(evutil_socket_t, short, void *)) {
     int i;
-    nthreads = nthr;
+    nthreads = nthr + nreplication;
+    nreplication_threads = nreplication;
 
     cb_mutex_initialize(&conn_lock);
     cb_mutex_initialize(&init_lock);
@@ -534,17 +777,25 @@ void thread_init(int nthr, struct event_base *main_base,
     setup_dispatcher(main_base, dispatcher_callback);
 
     for (i = 0; i < nthreads; i++) {
-        if (!create_notification_pipe(&threads[i])) {
+        if (!create_notification_channel(&threads[i])) {
             FATAL_ERROR(EXIT_FAILURE, "Cannot create notification pipe");
         }
         threads[i].index = i;
 
         setup_thread(&threads[i]);
+        if (i >= nthr) {
+            threads[i].type = ThreadType::TAP;
+        }
     }
 
     /* Create threads after we've done all the libevent setup. */
     for (i = 0; i < nthreads; i++) {
-        std::string name = "mc:worker_" + std::to_string(i);
+        std::string name;
+        if (threads[i].type == ThreadType::TAP) {
+            name = "mc:replication_" + std::to_string(i - nthr);
+        } else {
+            name = "mc:worker_" + std::to_string(i);
+        }
         create_worker(worker_libevent, &threads[i], &thread_ids[i],
                       name.c_str());
         threads[i].thread_id = thread_ids[i];
@@ -572,20 +823,31 @@ void threads_cleanup(void)
     int ii;
     for (ii = 0; ii < nthreads; ++ii) {
         safe_close(threads[ii].notify[0]);
-        safe_close(threads[ii].notify[1]);
+        if (!threads[ii].notify_eventfd) {
+            safe_close(threads[ii].notify[1]);
+        }
         event_base_free(threads[ii].base);
 
-        cb_free(threads[ii].read.buf);
-        cb_free(threads[ii].write.buf);
+        delete threads[ii].buffer_pool;
+        delete threads[ii].scheduler;
+        delete threads[ii].idle_connections;
         subdoc_op_free(threads[ii].subdoc_op);
         delete threads[ii].validator;
         delete threads[ii].new_conn_queue;
+        delete threads[ii].pending_io;
     }
 
     cb_free(thread_ids);
     cb_free(threads);
 }
 
+void threads_aggregate_queue_times(Connection::Priority priority,
+                                   TimingHistogram& histogram) {
+    for (int ii = 0; ii < nthreads; ++ii) {
+        histogram += threads[ii].scheduler->getQueueTimes(priority);
+    }
+}
+
 void threads_notify_bucket_deletion(void)
 {
     for (int ii = 0; ii < nthreads; ++ii) {
@@ -615,6 +877,18 @@ void threads_initiate_bucket_deletion(void)
 }
 
 void notify_thread(LIBEVENT_THREAD *thread) {
+#ifdef HAVE_EVENTFD
+    if (thread->notify_eventfd) {
+        uint64_t value = 1;
+        if (write(thread->notify[1], &value, sizeof(value)) == -1 &&
+            !is_blocking(GetLastError())) {
+            log_system_error(EXTENSION_LOG_WARNING, NULL,
+                             "Failed to notify thread: %s");
+        }
+        return;
+    }
+#endif
+
     if (send(thread->notify[1], "", 1, 0) != 1 &&
             !is_blocking(GetLastNetworkError())) {
         log_socket_error(EXTENSION_LOG_WARNING, NULL,
@@ -622,15 +896,41 @@ void notify_thread(LIBEVENT_THREAD *thread) {
     }
 }
 
-int add_conn_to_pending_io_list(Connection *c) {
-    int notify = 0;
+LIBEVENT_THREAD* add_conn_to_pending_io_list(Connection *c) {
+    // Read the owner once; everything below must use the same thread
+    auto* thread = c->getThread();
+    auto* thread_stats =
+        &all_buckets[c->getBucketIndex()].stats[thread->index];
+
+    // Flag the notification before pushing the connection so that the
+    // worker thread sees it when it pops the connection
+    c->setPendingIo();
+    bool notify = thread->pending_io->push(c);
+
+    thread_stats->io_notifications++;
+    if (!notify) {
+        thread_stats->io_wakeups_coalesced++;
+        return nullptr;
+    }
+
+    return thread;
+}
+
+void remove_conn_from_pending_io_list(Connection *c) {
     auto thread = c->getThread();
-    if (number_of_pending(c, thread->pending_io) == 0) {
-        if (thread->pending_io == NULL) {
-            notify = 1;
-        }
-        enlist_conn(c, &thread->pending_io);
+    c->clearPendingIo();
+    if (thread->pending_io->remove(c) && thread->pending_io->arm()) {
+        notify_thread(thread);
     }
+}
+
+void schedule_connection(Connection *c, short which) {
+    auto thread = c->getThread();
+    if (thread->scheduler->schedule(*c, which, gethrtime())) {
+        schedule_run_connections(thread);
+    }
+}
 
-    return notify;
+void unschedule_connection(Connection *c) {
+    c->getThread()->scheduler->remove(*c);
 }
@@ -18,6 +18,7 @@
 
 #include <platform/platform.h>
 #include <array>
+#include <cJSON_utils.h>
 #include <relaxed_atomic.h>
 #include <string>
 
@@ -40,7 +41,8 @@ public:
     TimingHistogram& operator+=(const TimingHistogram& other);
 
     void reset(void);
-    void add(const hrtime_t nsec);
+    void add(const hrtime_t nsec, const uint32_t count = 1);
+    unique_cJSON_ptr to_json(void);
     std::string to_string(void);
     uint32_t get_ns();
     uint32_t get_usec(const uint8_t index);
@@ -17,22 +17,56 @@
 #include "timings.h"
 #include <memcached/protocol_binary.h>
 #include <platform/platform.h>
+#include <cJSON.h>
+#include <memory>
 #include "timing_histogram.h"
 
 Timings::Timings() {
+    for (auto& opcode : timings) {
+        opcode.store(nullptr);
+    }
     reset();
 }
 
+Timings::~Timings() {
+    for (auto& opcode : timings) {
+        auto* shards = opcode.load();
+        if (shards != nullptr) {
+            for (auto& shard : *shards) {
+                delete shard.load();
+            }
+            delete shards;
+        }
+    }
+}
+
 Timings& Timings::operator=(const Timings& other) {
-    timings = other.timings;
+    reset();
+    for (size_t ii = 0; ii < NumHistograms; ++ii) {
+        const auto histogram = other.merge_shards(ii);
+        if (histogram.getTotal() != 0) {
+            // Keep all of the values in a single shard
+            get_shard(ii, 0) = histogram;
+        }
+    }
     interval_latency_lookups = other.interval_latency_lookups;
     interval_latency_mutations = other.interval_latency_mutations;
     return *this;
 }
 
 void Timings::reset(void) {
-    for (int ii = 0; ii < MAX_NUM_OPCODES; ++ii) {
-        timings[ii].reset();
+    // The histograms aren't released as the worker threads may be
+    // updating them while we reset them
+    for (auto& opcode : timings) {
+        auto* shards = opcode.load();
+        if (shards != nullptr) {
+            for (auto& shard : *shards) {
+                auto* histogram = shard.load();
+                if (histogram != nullptr) {
+                    histogram->reset();
+                }
+            }
+        }
     }
 
     {
@@ -42,15 +76,114 @@ void Timings::reset(void) {
     }
 }
 
-void Timings::collect(const uint8_t opcode, const hrtime_t nsec) {
-    timings[opcode].add(nsec);
+HdrHistogram& Timings::get_shard(const size_t index, const size_t thread) {
+    auto* shards = timings[index].load();
+    if (shards == nullptr) {
+        std::unique_ptr<OpcodeTimings> created(new OpcodeTimings);
+        for (auto& shard : *created) {
+            shard.store(nullptr);
+        }
+        if (timings[index].compare_exchange_strong(shards, created.get())) {
+            shards = created.release();
+        }
+    }
+
+    auto& shard = (*shards)[thread % NumShards];
+    auto* histogram = shard.load();
+    if (histogram == nullptr) {
+        std::unique_ptr<HdrHistogram> created(new HdrHistogram);
+        if (shard.compare_exchange_strong(histogram, created.get())) {
+            histogram = created.release();
+        }
+    }
+    return *histogram;
+}
+
+void Timings::collect(const uint8_t opcode, const hrtime_t nsec,
+                      const size_t thread) {
+    get_shard(opcode, thread).add(nsec);
     auto& interval = interval_counters[opcode];
     interval.count++;
     interval.duration_ns += nsec;
 }
 
+HdrHistogram Timings::merge_shards(const size_t index) const {
+    HdrHistogram ret;
+    const auto* shards = timings[index].load();
+    if (shards != nullptr) {
+        for (const auto& shard : *shards) {
+            const auto* histogram = shard.load();
+            if (histogram != nullptr) {
+                ret += *histogram;
+            }
+        }
+    }
+    return ret;
+}
+
+HdrHistogram Timings::get_histogram(const uint8_t opcode) const {
+    return merge_shards(opcode);
+}
+
+void Timings::collect_phase(const LatencyBreakdown::Phase phase,
+                            const hrtime_t nsec,
+                            const size_t thread) {
+    get_shard(phase_index(phase), thread).add(nsec);
+}
+
+HdrHistogram Timings::get_phase_histogram(
+        const LatencyBreakdown::Phase phase) const {
+    return merge_shards(phase_index(phase));
+}
+
+std::string Timings::generate_phase(const LatencyBreakdown::Phase phase) {
+    return to_string(get_phase_histogram(phase));
+}
+
+uint64_t Timings::get_total(const uint8_t opcode) const {
+    uint64_t ret = 0;
+    const auto* shards = timings[opcode].load();
+    if (shards != nullptr) {
+        for (const auto& shard : *shards) {
+            const auto* histogram = shard.load();
+            if (histogram != nullptr) {
+                ret += histogram->getTotal();
+            }
+        }
+    }
+    return ret;
+}
+
 std::string Timings::generate(const uint8_t opcode) {
-    return timings[opcode].to_string();
+    return to_string(get_histogram(opcode));
+}
+
+std::string Timings::to_string(const HdrHistogram& histogram) {
+    // Keep the legacy buckets so that old clients may still parse the
+    // output (the samples are counted in the legacy bucket holding the
+    // lowest value of their bucket)
+    TimingHistogram legacy;
+    histogram.forEachBucket([&legacy](hrtime_t lowest, hrtime_t,
+                                      uint64_t count) {
+        legacy.add(lowest, uint32_t(count));
+    });
+
+    auto json = legacy.to_json();
+    auto* root = json.get();
+    cJSON_AddNumberToObject(root, "p50",
+                            histogram.getValueAtPercentile(50.0));
+    cJSON_AddNumberToObject(root, "p90",
+                            histogram.getValueAtPercentile(90.0));
+    cJSON_AddNumberToObject(root, "p99",
+                            histogram.getValueAtPercentile(99.0));
+    cJSON_AddNumberToObject(root, "p99.9",
+                            histogram.getValueAtPercentile(99.9));
+    cJSON_AddNumberToObject(root, "max", histogram.getMax());
+
+    char* ptr = cJSON_PrintUnformatted(root);
+    std::string ret(ptr);
+    cJSON_Free(ptr);
+    return ret;
 }
 
 static const uint8_t timings_mutations[] = {
@@ -104,7 +237,7 @@ uint64_t Timings::get_aggregated_mutation_stats() {
 
     uint64_t ret = 0;
     for (auto cmd : timings_mutations) {
-        ret += timings[cmd].get_total();
+        ret += get_total(cmd);
     }
     return ret;
 }
@@ -113,7 +246,7 @@ uint64_t Timings::get_aggregated_retrival_stats() {
 
     uint64_t ret = 0;
     for (auto cmd : timings_retrievals) {
-        ret += timings[cmd].get_total();
+        ret += get_total(cmd);
     }
     return ret;
 }
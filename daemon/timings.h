@@ -18,10 +18,13 @@
 
 #include <platform/platform.h>
 #include <array>
+#include <atomic>
 #include <string>
 #include <mutex>
 #include <cstdint>
 
+#include "hdr_histogram.h"
+#include "latency_breakdown.h"
 #include "timing_histogram.h"
 #include "timing_interval.h"
 
@@ -29,17 +32,57 @@
 
 /** Records timings for each memcached opcode. Each opcode has a histogram of
  * times.
+ *
+ * To avoid having all of the worker threads update the same counters the
+ * histogram for an opcode is split in a number of shards (allocated the
+ * first time a thread records a value for the opcode), and the thread
+ * index selects the shard to use. The shards are merged when the timings
+ * are read.
+ *
+ * The time spent in each phase of the commands (see LatencyBreakdown) is
+ * recorded in the same way when the latency_breakdown setting is enabled.
  */
 class Timings {
 public:
+    /** The number of shards for each opcode */
+    static const size_t NumShards = 16;
+
     Timings(void);
+    ~Timings();
     Timings& operator=(const Timings& other);
     Timings(const Timings&) = delete;
 
     void reset(void);
-    void collect(const uint8_t opcode, const hrtime_t nsec);
+    void collect(const uint8_t opcode, const hrtime_t nsec,
+                 const size_t thread = 0);
     void sample(std::chrono::seconds sample_interval);
+
+    /**
+     * Generate the JSON reported by GET_CMD_TIMER for the opcode. The
+     * legacy histogram is followed by the percentiles "p50", "p90",
+     * "p99", "p99.9" and the "max" value (all in ns).
+     */
     std::string generate(const uint8_t opcode);
+
+    /**
+     * Get the (merged) histogram for the opcode
+     */
+    HdrHistogram get_histogram(const uint8_t opcode) const;
+
+    void collect_phase(const LatencyBreakdown::Phase phase,
+                       const hrtime_t nsec,
+                       const size_t thread = 0);
+
+    /**
+     * Generate the JSON for the phase (in the same format as generate())
+     */
+    std::string generate_phase(const LatencyBreakdown::Phase phase);
+
+    /**
+     * Get the (merged) histogram for the phase
+     */
+    HdrHistogram get_phase_histogram(const LatencyBreakdown::Phase phase) const;
+
     uint64_t get_aggregated_mutation_stats();
     uint64_t get_aggregated_retrival_stats();
 
@@ -54,6 +97,29 @@ private:
 
     cb::sampling::IntervalSeries interval_latency_lookups;
     cb::sampling::IntervalSeries interval_latency_mutations;
-    std::array<TimingHistogram, MAX_NUM_OPCODES> timings;
+
+    using OpcodeTimings = std::array<std::atomic<HdrHistogram*>, NumShards>;
+
+    /**
+     * The histograms for the opcodes are followed by the histograms for
+     * the phases
+     */
+    static const size_t NumHistograms =
+            MAX_NUM_OPCODES + LatencyBreakdown::NumPhases;
+
+    static size_t phase_index(const LatencyBreakdown::Phase phase) {
+        return MAX_NUM_OPCODES + size_t(phase);
+    }
+
+    /** Get the histogram to use for the index (and allocate it) */
+    HdrHistogram& get_shard(const size_t index, const size_t thread);
+
+    HdrHistogram merge_shards(const size_t index) const;
+
+    uint64_t get_total(const uint8_t opcode) const;
+
+    static std::string to_string(const HdrHistogram& histogram);
+
+    std::array<std::atomic<OpcodeTimings*>, NumHistograms> timings;
     std::array<cb::sampling::Interval, MAX_NUM_OPCODES> interval_counters;
 };
@@ -22,7 +22,10 @@
 #include <sys/types.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <limits>
 #include <platform/platform.h>
+#include <stdexcept>
+#include <unordered_map>
 
 #include "topkeys.h"
 
@@ -31,148 +34,266 @@
  *
  * === TopKeys ===
  *
- * The TopKeys class is split into NUM_SHARDS shards, each which owns
- * 1/NUM_SHARDS of the keyspace. This is to allow some level of
- * concurrent access - each shard has a mutex guarding all access.
- * Other than that the TopKeys class is pretty uninteresting - it
- * simply passes on requests to the correct Shard, and when statistics
- * are requested it aggregates information from each shard.
+ * The TopKeys class holds one Shard per thread, and each Shard holds a
+ * SpaceSaving object for the number of operations, the bytes read and
+ * the bytes written. A thread only updates its own Shard so the hot
+ * path doesn't take any locks (or touch cache lines written by other
+ * threads). When statistics are requested the counters from each
+ * Shard are merged.
  *
- * === TopKeys::Shard ===
+ * Merging Space-Saving summaries: a key which isn't monitored by a
+ * full summary may have occurred up to min (the lowest count in the
+ * summary) times in it, so the merged count is the sum of the counts
+ * where the key is monitored plus the sum of min for the other
+ * summaries, and the same value is added to the error. The merged
+ * counts keeps the property count - error <= real count <= count.
  *
- * This is where the action happens. Each Shard maintains an ordered
- * list of key names and related statistics, orded by when they were
- * last accessed. There is a fixed number of keys each Shard tracks.
-
- * Given we generally track only a small number of keys per shard (10
- * by default), it's highly likely that any one key access will 'miss'
- * - i.e. not find an existing topkey. Therefore this class is
- * optimized for that case, attempting to minimise memory allocation
- * in steady-state.
+ * === SpaceSaving ===
  *
- * Internally Shard consists of a vector of topkey_t, storing the
- * current max_keys top_keys, and a list of topkey_t pointers, used to
- * main the current most -> least recently used ordering:
-
- * max_keys elements. Each element is a tuple of
- * {hash(key), key, topkey_stats}:
- *
- *
- *       vector<topkey_t>
- *   +----------+-------------+---------------+
- *   | size_t   | std::string | topkey_item_t |
- *   +----------+-------------+---------------+
- *   | <hash 1> | <key 1>     | stats 1       | <--- Node1
- *   | <hash 2> | <key 2>     | stats 2       | <--- Node2
- *   | <hash 3> | <key 3>     | stats 3       | <--- Node3
- *   . ....                                   .
- *   | <hash N> | <key N>     | stats N       | <--- NodeN
- *   +----------------------------------------+
- *
- *   Node3 <---> Node1 <---> ... <---> Node2
- *   ^^^                               ^^^
- *   MRU                               LRU
- *
- *
- * Upon a key 'hit', TopKeys::updateKey() is called. That hashes the
- * key, and finds the Shard responsible for that
- * key. TopKeys::Shard::updateKey() is then called.
- *
- * Shard::updateKey() iterates over the vector, searching for a hash
- * match with an existing element, using the actual key string to
- * validate (in case of a hash collision). If it is found, then the
- * stats are simply updated.  If it is not found, then the
- * least-recently-used element is selected as a 'victim' and it's
- * contents is replaced by the incoming key.  Finally the linked-list
- * is updated to move the updated element to the head of the list.
+ * The counters live in an array of Slots read by other threads. The
+ * writer keeps a hash table (linear probing) from the key to the Slot
+ * so that a hit doesn't need to search all of the counters, and a
+ * binary min-heap of the Slots ordered by their count to find the
+ * counter to replace on a miss. Both are O(1) / O(log n) and don't
+ * allocate memory after the object is created.
  */
 
+const size_t SpaceSaving::MaxKeyLength;
+const uint32_t SpaceSaving::Empty;
 
-TopKeys::TopKeys(int mkeys) {
-    for (auto& shard : shards) {
-        shard.setMaxKeys(mkeys);
+static size_t table_size(size_t capacity) {
+    // Keep the load factor of the hash table <= 0.5
+    size_t size = 1;
+    while (size < capacity * 2) {
+        size <<= 1;
     }
+    return size;
 }
 
-TopKeys::~TopKeys() {
+SpaceSaving::SpaceSaving(size_t capacity)
+    : capacity(std::max(capacity, size_t(1))),
+      slots(new Slot[SpaceSaving::capacity]),
+      hashes(SpaceSaving::capacity, 0),
+      table(table_size(SpaceSaving::capacity), Empty),
+      heapPosition(SpaceSaving::capacity, 0) {
+    for (size_t ii = 0; ii < SpaceSaving::capacity; ++ii) {
+        slots[ii].sequence.store(0);
+    }
+    used.store(0);
+    heap.reserve(SpaceSaving::capacity);
 }
 
-TopKeys::Shard& TopKeys::getShard(size_t key_hash) {
-    /* This is special-cased for 8 */
-    static_assert(NUM_SHARDS == 8,
-                  "Topkeys::getShard() special-cased for SHARDS==8");
-    return shards[key_hash & 0x7];
+uint32_t SpaceSaving::find(const const_char_buffer& key, size_t hash) const {
+    const size_t mask = table.size() - 1;
+    for (size_t pos = hash & mask; table[pos] != Empty;
+         pos = (pos + 1) & mask) {
+        const auto slot = table[pos];
+        if (hashes[slot] == hash && slots[slot].nkey == key.len &&
+            std::memcmp(slots[slot].key.data(), key.buf, key.len) == 0) {
+            return slot;
+        }
+    }
+    return Empty;
 }
 
-TopKeys::Shard::topkey_t*
-TopKeys::Shard::searchForKey(size_t key_hash,
-                             const const_char_buffer& key) {
-
-    for (auto& topkey : storage) {
-        if (topkey.first.hash == key_hash) {
-            // Double-check with full compare
-            if (topkey.first.key.compare(0, topkey.first.key.size(),
-                                         key.buf, key.len) == 0) {
-                // Match found.
-                return &topkey;
-            }
-        }
+void SpaceSaving::insertIndex(uint32_t slot) {
+    const size_t mask = table.size() - 1;
+    size_t pos = hashes[slot] & mask;
+    while (table[pos] != Empty) {
+        pos = (pos + 1) & mask;
     }
-    return nullptr;
+    table[pos] = slot;
 }
 
-bool TopKeys::Shard::updateKey(const const_char_buffer& key,
-                               size_t key_hash,
-                               const rel_time_t ct) {
-    try {
-        std::lock_guard<std::mutex> lock(mutex);
+void SpaceSaving::eraseIndex(uint32_t slot) {
+    const size_t mask = table.size() - 1;
+    size_t hole = hashes[slot] & mask;
+    while (table[hole] != slot) {
+        hole = (hole + 1) & mask;
+    }
 
-        topkey_t* found_key = searchForKey(key_hash, key);
+    // Shift back the entries following the hole which can't be found
+    // if we leave it empty (backward shift deletion)
+    for (size_t pos = (hole + 1) & mask; table[pos] != Empty;
+         pos = (pos + 1) & mask) {
+        const size_t ideal = hashes[table[pos]] & mask;
+        if (((pos - ideal) & mask) >= ((pos - hole) & mask)) {
+            table[hole] = table[pos];
+            hole = pos;
+        }
+    }
+    table[hole] = Empty;
+}
 
-        if (found_key == NULL) {
-            // Key not found.
-            if (storage.size() == max_keys) {
-                // Re-use the lowest keys' storage.
-                found_key = list.back();
-                found_key->first.hash = key_hash;
-                found_key->first.key.assign(key.buf, key.len);
-                found_key->second = topkey_item_t(ct);
+void SpaceSaving::writeSlot(uint32_t slot,
+                            const const_char_buffer& key,
+                            uint64_t count,
+                            uint64_t error,
+                            rel_time_t ctime) {
+    auto& s = slots[slot];
+    const auto sequence = s.sequence.load(std::memory_order_relaxed);
+    s.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.count = count;
+    s.error = error;
+    s.ctime = ctime;
+    s.nkey = uint8_t(key.len);
+    std::memcpy(s.key.data(), key.buf, key.len);
+    s.sequence.store(sequence + 2, std::memory_order_release);
+}
 
-                // Move back element to the front, shuffling down the
-                // rest.
-                list.splice(list.begin(), list, --list.end());
+void SpaceSaving::addToSlot(uint32_t slot, uint64_t weight) {
+    auto& s = slots[slot];
+    const auto sequence = s.sequence.load(std::memory_order_relaxed);
+    s.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.count += weight;
+    s.sequence.store(sequence + 2, std::memory_order_release);
+}
 
-            } else {
-                // add a new element to the storage array.
+void SpaceSaving::swapHeap(size_t a, size_t b) {
+    std::swap(heap[a], heap[b]);
+    heapPosition[heap[a]] = uint32_t(a);
+    heapPosition[heap[b]] = uint32_t(b);
+}
 
-                storage.emplace_back(
-                    std::make_pair(KeyId{key_hash,
-                                         std::string(key.buf, key.len)},
-                                   topkey_item_t(ct)));
-                found_key = &storage.back();
+void SpaceSaving::siftUp(size_t pos) {
+    while (pos > 0) {
+        const size_t parent = (pos - 1) / 2;
+        if (slots[heap[parent]].count <= slots[heap[pos]].count) {
+            return;
+        }
+        swapHeap(pos, parent);
+        pos = parent;
+    }
+}
 
-                // Insert the new item to the front of the list
-                list.push_front(found_key);
+void SpaceSaving::siftDown(size_t pos) {
+    for (;;) {
+        size_t smallest = pos;
+        for (size_t child = pos * 2 + 1; child <= pos * 2 + 2; ++child) {
+            if (child < heap.size() &&
+                slots[heap[child]].count < slots[heap[smallest]].count) {
+                smallest = child;
             }
-        } else {
-            // Found - shuffle to the front.
-            auto it = std::find(list.begin(), list.end(),
-                                found_key);
-            list.splice(list.begin(), list, it);
         }
+        if (smallest == pos) {
+            return;
+        }
+        swapHeap(pos, smallest);
+        pos = smallest;
+    }
+}
+
+void SpaceSaving::add(const const_char_buffer& key,
+                      size_t hash,
+                      uint64_t weight,
+                      rel_time_t now) {
+    if (weight == 0 || key.len > MaxKeyLength) {
+        return;
+    }
 
-        // Increment access count.
-        found_key->second.ti_access_count++;
-        return true;
+    auto slot = find(key, hash);
+    if (slot != Empty) {
+        addToSlot(slot, weight);
+        siftDown(heapPosition[slot]);
+        return;
+    }
+
+    const auto inuse = used.load(std::memory_order_relaxed);
+    if (inuse < capacity) {
+        slot = uint32_t(inuse);
+        writeSlot(slot, key, weight, 0, now);
+        hashes[slot] = hash;
+        insertIndex(slot);
+        heap.push_back(slot);
+        heapPosition[slot] = uint32_t(heap.size() - 1);
+        siftUp(heap.size() - 1);
+        used.store(inuse + 1, std::memory_order_release);
+        return;
+    }
+
+    // Replace the key with the lowest count
+    slot = heap.front();
+    const auto min = slots[slot].count;
+    eraseIndex(slot);
+    writeSlot(slot, key, min + weight, min, now);
+    hashes[slot] = hash;
+    insertIndex(slot);
+    siftDown(0);
+}
 
-    } catch (const std::bad_alloc&) {
-        // Failed to update.
-        return false;
+std::vector<SpaceSaving::Counter> SpaceSaving::getCounters() const {
+    std::vector<Counter> ret;
+    const auto inuse = used.load(std::memory_order_acquire);
+    ret.reserve(inuse);
+
+    for (size_t ii = 0; ii < inuse; ++ii) {
+        const auto& s = slots[ii];
+        const auto sequence = s.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) != 0) {
+            // Being updated
+            continue;
+        }
+        Counter counter;
+        counter.count = s.count;
+        counter.error = s.error;
+        counter.ctime = s.ctime;
+        const auto nkey = std::min(size_t(s.nkey), MaxKeyLength);
+        counter.key.assign(s.key.data(), nkey);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.sequence.load(std::memory_order_relaxed) != sequence) {
+            // Updated while we copied it
+            continue;
+        }
+        ret.emplace_back(std::move(counter));
     }
+
+    return ret;
+}
+
+TopKeys::TopKeys(int mkeys, size_t threads)
+    : max_keys(size_t(std::max(mkeys, 1))),
+      shards(std::max(threads, size_t(1))) {
+    for (auto& shard : shards) {
+        shard.store(nullptr);
+    }
+}
+
+TopKeys::~TopKeys() {
+    for (auto& shard : shards) {
+        delete shard.load();
+    }
+}
+
+const SpaceSaving& TopKeys::Shard::get(Statistic statistic) const {
+    switch (statistic) {
+    case Statistic::Ops:
+        return ops;
+    case Statistic::BytesRead:
+        return bytesRead;
+    case Statistic::BytesWritten:
+        return bytesWritten;
+    }
+    throw std::invalid_argument("TopKeys::Shard::get: invalid statistic");
+}
+
+TopKeys::Shard& TopKeys::getShard(size_t thread) {
+    auto& shard = shards[thread % shards.size()];
+    auto* ret = shard.load();
+    if (ret == nullptr) {
+        std::unique_ptr<Shard> created(
+            new Shard(max_keys * CountersPerKey));
+        if (shard.compare_exchange_strong(ret, created.get())) {
+            ret = created.release();
+        }
+    }
+    return *ret;
 }
 
 void TopKeys::updateKey(const void *key, size_t nkey,
-                        rel_time_t operation_time) {
+                        rel_time_t operation_time, size_t thread,
+                        size_t nread, size_t nwritten) {
     cb_assert(key);
     cb_assert(nkey > 0);
 
@@ -181,111 +302,141 @@ void TopKeys::updateKey(const void *key, size_t nkey,
         std::hash<const_char_buffer > hash_fn;
         const size_t key_hash = hash_fn(key_buf);
 
-        getShard(key_hash).updateKey(key_buf, key_hash, operation_time);
+        auto& shard = getShard(thread);
+        shard.ops.add(key_buf, key_hash, 1, operation_time);
+        shard.bytesRead.add(key_buf, key_hash, nread, operation_time);
+        shard.bytesWritten.add(key_buf, key_hash, nwritten, operation_time);
     } catch (std::bad_alloc) {
         // Failed to increment topkeys, continue...
     }
 }
 
-struct tk_context {
-    tk_context(const void *c, ADD_STAT a, rel_time_t t, cJSON *arr)
-        : cookie(c), add_stat(a), current_time(t), array(arr)
-    {
-        // empty
+std::vector<SpaceSaving::Counter> TopKeys::getTopKeys(
+        Statistic statistic) const {
+    struct Merged {
+        SpaceSaving::Counter counter;
+        // The sum of min for the summaries monitoring the key
+        uint64_t monitoredMin;
+    };
+
+    std::unordered_map<std::string, Merged> merged;
+    uint64_t totalMin = 0;
+
+    for (const auto& shard : shards) {
+        const auto* ptr = shard.load();
+        if (ptr == nullptr) {
+            continue;
+        }
+        const auto& summary = ptr->get(statistic);
+        const auto counters = summary.getCounters();
+
+        // A key which isn't monitored may have occurred up to min times
+        // if all of the counters are in use
+        uint64_t min = 0;
+        if (counters.size() == summary.getCapacity()) {
+            min = std::numeric_limits<uint64_t>::max();
+            for (const auto& counter : counters) {
+                min = std::min(min, counter.count);
+            }
+        }
+        totalMin += min;
+
+        for (const auto& counter : counters) {
+            auto iter = merged.find(counter.key);
+            if (iter == merged.end()) {
+                merged.emplace(counter.key, Merged{counter, min});
+            } else {
+                auto& m = iter->second;
+                m.counter.count += counter.count;
+                m.counter.error += counter.error;
+                m.counter.ctime = std::min(m.counter.ctime, counter.ctime);
+                m.monitoredMin += min;
+            }
+        }
     }
 
-    const void *cookie;
-    ADD_STAT add_stat;
-    rel_time_t current_time;
-    cJSON *array;
-};
-
-static void tk_iterfunc(const std::string& key, const topkey_item_t& it,
-                        void *arg) {
-    struct tk_context *c = (struct tk_context*)arg;
-    char val_str[500];
-    /* Note we use accessed time for both 'atime' and 'ctime' below. They have
-     * had the same value since the topkeys code was added; but given that
-     * clients may expect separate values we print both.
-     */
-    rel_time_t created_time = c->current_time - it.ti_ctime;
-    int vlen = snprintf(val_str, sizeof(val_str) - 1, "get_hits=%d,"
-                        "get_misses=0,cmd_set=0,incr_hits=0,incr_misses=0,"
-                        "decr_hits=0,decr_misses=0,delete_hits=0,"
-                        "delete_misses=0,evictions=0,cas_hits=0,cas_badval=0,"
-                        "cas_misses=0,get_replica=0,evict=0,getl=0,unlock=0,"
-                        "get_meta=0,set_meta=0,del_meta=0,ctime=%" PRIu32
-                        ",atime=%" PRIu32, it.ti_access_count,
-                        created_time, created_time);
-    if (vlen > 0 && vlen < (sizeof(val_str) - 1)) {
-        c->add_stat(key.c_str(), key.size(), val_str, vlen, c->cookie);
+    std::vector<SpaceSaving::Counter> ret;
+    ret.reserve(merged.size());
+    for (auto& entry : merged) {
+        auto& m = entry.second;
+        m.counter.count += totalMin - m.monitoredMin;
+        m.counter.error += totalMin - m.monitoredMin;
+        ret.emplace_back(std::move(m.counter));
     }
-}
 
-/**
- * Passing in a list of keys, context, and cJSON array will populate that
- * array with an object for each key in the following format:
- * {
- *    "key": "somekey",
- *    "access_count": nnn,
- *    "ctime": ccc,
- *    "atime": aaa
- * }
- */
-static void tk_jsonfunc(const std::string& key, const topkey_item_t& it,
-                        void* arg) {
-    struct tk_context *c = (struct tk_context*)arg;
-    cJSON *obj = cJSON_CreateObject();
-    cJSON_AddItemToObject(obj, "key", cJSON_CreateString(key.c_str()));
-    cJSON_AddItemToObject(obj, "access_count",
-                          cJSON_CreateNumber(it.ti_access_count));
-    cJSON_AddItemToObject(obj, "ctime", cJSON_CreateNumber(c->current_time
-                                                           - it.ti_ctime));
-    cb_assert(c->array != NULL);
-    cJSON_AddItemToArray(c->array, obj);
+    std::sort(ret.begin(), ret.end(),
+              [](const SpaceSaving::Counter& a,
+                 const SpaceSaving::Counter& b) {
+                  return a.count > b.count;
+              });
+    if (ret.size() > max_keys) {
+        ret.resize(max_keys);
+    }
+    return ret;
 }
 
 ENGINE_ERROR_CODE TopKeys::stats(const void *cookie,
                                  const rel_time_t current_time,
                                  ADD_STAT add_stat) {
-    struct tk_context context(cookie, add_stat, current_time, nullptr);
-
-    for (auto& shard : shards) {
-        shard.accept_visitor(tk_iterfunc, &context);
+    for (const auto& counter : getTopKeys(Statistic::Ops)) {
+        char val_str[500];
+        /* Note we use the time the key was first tracked for both 'atime'
+         * and 'ctime' below. They have had the same value since the
+         * topkeys code was added; but given that clients may expect
+         * separate values we print both.
+         */
+        rel_time_t created_time = current_time - counter.ctime;
+        int vlen = snprintf(val_str, sizeof(val_str) - 1, "get_hits=%" PRIu64
+                            ",get_misses=0,cmd_set=0,incr_hits=0,"
+                            "incr_misses=0,decr_hits=0,decr_misses=0,"
+                            "delete_hits=0,delete_misses=0,evictions=0,"
+                            "cas_hits=0,cas_badval=0,cas_misses=0,"
+                            "get_replica=0,evict=0,getl=0,unlock=0,"
+                            "get_meta=0,set_meta=0,del_meta=0,ctime=%" PRIu32
+                            ",atime=%" PRIu32, counter.count,
+                            created_time, created_time);
+        if (vlen > 0 && vlen < int(sizeof(val_str) - 1)) {
+            add_stat(counter.key.data(), uint16_t(counter.key.size()),
+                     val_str, vlen, cookie);
+        }
     }
 
     return ENGINE_SUCCESS;
 }
 
 /**
- * Passing a set of topkeys, and relevant context data will
- * return a cJSON object containing an array of topkeys (with each key
- * appearing as in the example above for tk_jsonfunc):
- * {
- *   "topkeys": [
- *      { ... }, ..., { ... }
- *    ]
- * }
+ * Create a JSON array of the counters (with the count named name)
  */
-ENGINE_ERROR_CODE TopKeys::json_stats(cJSON *object,
-                                     const rel_time_t current_time) {
-
-    cJSON *topkeys = cJSON_CreateArray();
-    struct tk_context context(nullptr, nullptr, current_time, topkeys);
-
-    /* Collate the topkeys JSON object */
-    for (auto& shard : shards) {
-        shard.accept_visitor(tk_jsonfunc, &context);
+static cJSON* tk_json_array(const std::vector<SpaceSaving::Counter>& counters,
+                            const char* name,
+                            const rel_time_t* current_time) {
+    cJSON *array = cJSON_CreateArray();
+    for (const auto& counter : counters) {
+        cJSON *obj = cJSON_CreateObject();
+        cJSON_AddItemToObject(obj, "key",
+                              cJSON_CreateString(counter.key.c_str()));
+        cJSON_AddItemToObject(obj, name, cJSON_CreateNumber(counter.count));
+        cJSON_AddItemToObject(obj, "error", cJSON_CreateNumber(counter.error));
+        if (current_time != nullptr) {
+            cJSON_AddItemToObject(obj, "ctime",
+                                  cJSON_CreateNumber(*current_time -
+                                                     counter.ctime));
+        }
+        cJSON_AddItemToArray(array, obj);
     }
-
-    cJSON_AddItemToObject(object, "topkeys", topkeys);
-    return ENGINE_SUCCESS;
+    return array;
 }
 
-void TopKeys::Shard::accept_visitor(iterfunc_t visitor_func,
-                                    void* visitor_ctx) {
-    std::lock_guard<std::mutex> lock(mutex);
-    for (const auto key : list) {
-        visitor_func(key->first.key, key->second, visitor_ctx);
-    }
+ENGINE_ERROR_CODE TopKeys::json_stats(cJSON *object,
+                                     const rel_time_t current_time) {
+    cJSON_AddItemToObject(object, "topkeys",
+                          tk_json_array(getTopKeys(Statistic::Ops),
+                                        "access_count", &current_time));
+    cJSON_AddItemToObject(object, "topkeys_bytes_read",
+                          tk_json_array(getTopKeys(Statistic::BytesRead),
+                                        "bytes", nullptr));
+    cJSON_AddItemToObject(object, "topkeys_bytes_written",
+                          tk_json_array(getTopKeys(Statistic::BytesWritten),
+                                        "bytes", nullptr));
+    return ENGINE_SUCCESS;
 }
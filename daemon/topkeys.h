@@ -23,26 +23,117 @@
 #include <memcached/engine.h>
 #include <cJSON.h>
 
-#include <mutex>
-#include <list>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
 /*
  * TopKeys
  *
- * Tracks the top N most recently accessed keys. The details are
- * accessible by a stats call, which is used by ns_server to print the
- * top keys list in the GUI.
+ * Tracks the most frequently accessed keys (by the number of operations,
+ * the bytes read and the bytes written). The details are accessible by a
+ * stats call, which is used by ns_server to print the top keys list in
+ * the GUI.
  */
 
-struct topkey_item_t {
-    topkey_item_t(rel_time_t create_time)
-        : ti_ctime(create_time),
-          ti_access_count(0) { }
+/**
+ * SpaceSaving is an implementation of the Space-Saving algorithm
+ * (Metwally, Agrawal and El Abbadi) which finds the heavy hitters in a
+ * stream of keys with a fixed number of counters. When a key which isn't
+ * monitored arrives and all of the counters are in use, the counter with
+ * the lowest count is given to the new key, and the old count becomes the
+ * error of the new key (the count is an upper bound, and count - error a
+ * lower bound of the real count).
+ *
+ * Only a single thread may update the counters, but any thread may read
+ * them without blocking the writer. Each counter is protected by a
+ * sequence number (a seqlock); the readers skip the counters being
+ * updated while they copied them.
+ */
+class SpaceSaving {
+public:
+    /** The longest key we track (the longest key allowed by the protocol) */
+    static const size_t MaxKeyLength = 250;
+
+    struct Counter {
+        std::string key;
+        /** An upper bound of the weight of the key */
+        uint64_t count;
+        /** The maximum overestimation of count */
+        uint64_t error;
+        /** The time the key was first monitored */
+        rel_time_t ctime;
+    };
+
+    explicit SpaceSaving(size_t capacity);
+
+    /**
+     * Add the weight to the counter for the key (only called by the
+     * thread owning the object)
+     *
+     * @param key the key
+     * @param hash the hash of the key
+     * @param weight the weight to add (ignored if 0)
+     * @param now the current time
+     */
+    void add(const const_char_buffer& key,
+             size_t hash,
+             uint64_t weight,
+             rel_time_t now);
+
+    /**
+     * Get a copy of the counters in use (in no particular order)
+     */
+    std::vector<Counter> getCounters() const;
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        uint64_t count;
+        uint64_t error;
+        rel_time_t ctime;
+        uint8_t nkey;
+        std::array<char, MaxKeyLength> key;
+    };
 
-    rel_time_t ti_ctime; /* Time this item was created */
-    int ti_access_count; /* Int count for number of times key has been accessed */
+    static const uint32_t Empty = 0xffffffff;
+
+    /** Get the index of the slot monitoring the key (or Empty) */
+    uint32_t find(const const_char_buffer& key, size_t hash) const;
+    void insertIndex(uint32_t slot);
+    void eraseIndex(uint32_t slot);
+
+    void writeSlot(uint32_t slot,
+                   const const_char_buffer& key,
+                   uint64_t count,
+                   uint64_t error,
+                   rel_time_t ctime);
+    void addToSlot(uint32_t slot, uint64_t weight);
+
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+    void swapHeap(size_t a, size_t b);
+
+    const size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    /** The number of slots in use */
+    std::atomic<size_t> used;
+
+    // The members below are only used by the writer
+
+    /** The hash of the key in each slot */
+    std::vector<size_t> hashes;
+    /** Open addressing hash table (linear probing) of slot indexes */
+    std::vector<uint32_t> table;
+    /** Binary min-heap of the slots in use ordered by their count */
+    std::vector<uint32_t> heap;
+    /** The position of each slot in the heap */
+    std::vector<uint32_t> heapPosition;
 };
 
 /* Class to track the "top" keys in a bucket.
@@ -50,15 +141,31 @@ struct topkey_item_t {
 class TopKeys {
 public:
     /* Constructor.
-     * @param mkeys Number of keys stored in each shard (i.e. up to
-     * mkeys * SHARDS will be tracked).
+     * @param mkeys Number of keys to report for each of the statistics.
+     * @param threads Number of threads which may update the keys (each
+     *                thread updates its own set of counters, which are
+     *                merged when the statistics are requested).
      */
-    TopKeys(int mkeys);
+    TopKeys(int mkeys, size_t threads = 1);
     ~TopKeys();
 
+    /**
+     * Count an operation on a key
+     *
+     * @param key the key
+     * @param nkey the length of the key
+     * @param operation_time the current time
+     * @param thread the index of the calling thread (at most one thread
+     *               may use a given index at the same time)
+     * @param nread the number of bytes read from the value of the key
+     * @param nwritten the number of bytes written to the value of the key
+     */
     void updateKey(const void *key,
                    size_t nkey,
-                   rel_time_t operation_time);
+                   rel_time_t operation_time,
+                   size_t thread = 0,
+                   size_t nread = 0,
+                   size_t nwritten = 0);
 
     ENGINE_ERROR_CODE stats(const void *cookie,
                             const rel_time_t current_time,
@@ -66,96 +173,75 @@ public:
 
     /**
      * Passing a set of topkeys, and relevant context data will
-     * return a cJSON object containing an array of topkeys:
+     * return a cJSON object containing an array of the keys with the
+     * most operations, and arrays of the keys with the most bytes read
+     * and written (sorted by the count):
      * {
      *   "topkeys": [
      *      {
      *          "key": "somekey",
      *          "access_count": nnn,
-     *          "ctime": ccc,
-     *          "atime": aaa
+     *          "error": eee,
+     *          "ctime": ccc
+     *      }, ..., { ... }
+     *    ],
+     *   "topkeys_bytes_read": [
+     *      {
+     *          "key": "somekey",
+     *          "bytes": nnn,
+     *          "error": eee
      *      }, ..., { ... }
-     *    ]
+     *    ],
+     *   "topkeys_bytes_written": [ ... ]
      * }
+     *
+     * The counts are upper bounds; the real value is between
+     * count - error and count.
      */
     ENGINE_ERROR_CODE json_stats(cJSON *object,
                                  const rel_time_t current_time);
 
+    enum class Statistic { Ops, BytesRead, BytesWritten };
 
-private:
-    // Number of shards the keyspace is broken into. Permits some level of
-    // concurrent update (there is one mutex per shard).
-    static const int NUM_SHARDS = 8;
-
-    class Shard;
-
-    Shard& getShard(size_t key_hash);
-
-    // One of N Shards which the keyspace has been broken
-    // into.
-    // Responsible for tracking the top {mkeys} within it's keyspace.
-    class Shard {
-    public:
+    /**
+     * Get the top keys for one of the statistics (merged from all of the
+     * threads)
+     *
+     * @param statistic the statistic to sort the keys by
+     * @return up to mkeys keys sorted by their count (highest first)
+     */
+    std::vector<SpaceSaving::Counter> getTopKeys(Statistic statistic) const;
 
-        void setMaxKeys(int mkeys) {
-            max_keys = mkeys;
-            storage.reserve(max_keys);
-            // reallocating storage invalidates the LRU list.
-            list.clear();
+private:
+    /**
+     * The number of counters used per reported key. Space-Saving
+     * guarantees that all keys with more than 1/m of the total weight
+     * are monitored by m counters, and the more counters the smaller
+     * the error of the reported keys.
+     */
+    static const size_t CountersPerKey = 4;
+
+    // The counters owned by a single thread
+    struct Shard {
+        Shard(size_t capacity)
+            : ops(capacity),
+              bytesRead(capacity),
+              bytesWritten(capacity) {
         }
 
-        // Updates the topkey 'ranking' for the specified key.
-        // If the item does not exist it will be created (with it's creation
-        // time set to operation_time), otherwise the existing item will be
-        // updated.
-        // On success returns true, If insufficient memory to create a
-        // new item, returns false.
-        bool updateKey(const const_char_buffer& key,
-                       size_t key_hash,
-                       rel_time_t operation_time);
-
-        typedef void (*iterfunc_t)(const std::string& key,
-                                   const topkey_item_t& it,
-                                   void *arg);
+        const SpaceSaving& get(Statistic statistic) const;
 
-        /* For each key in this shard, invoke the given callback function.
-         */
-        void accept_visitor(iterfunc_t visitor_func, void* visitor_ctx);
-
-    private:
-
-        struct KeyId {
-            size_t hash;
-            std::string key;
-        };
-
-        // Pair of the key's string and the statistics related to it.
-        typedef std::pair<KeyId, topkey_item_t> topkey_t;
-
-        // An ordered list of topkey_t*, used for LRU.
-        typedef std::list<topkey_t*> key_history_t;
-
-        // Vector topket_t, used for actual topke storage.
-        typedef std::vector<topkey_t> key_storage_t;
-
-        // Searches for the given key. If found returns a pointer to the
-        // topkey_t, else returns NULL.
-        topkey_t* searchForKey(size_t hash, const const_char_buffer& key);
-
-        // Maxumum numbers of keys to be tracked per shard.
-        unsigned int max_keys;
-
-        // mutex to serial access to this shard.
-        std::mutex mutex;
+        SpaceSaving ops;
+        SpaceSaving bytesRead;
+        SpaceSaving bytesWritten;
+    };
 
-        // list of keys, ordered from most-recently used (front) to least recently
-        // used (back).
-        key_history_t list;
+    // Get the shard for the thread (created the first time it is used)
+    Shard& getShard(size_t thread);
 
-        // Underlying topkey storage.
-        key_storage_t storage;
-    };
+    const size_t max_keys;
 
-    // array of topkey shards.
-    std::array<Shard, NUM_SHARDS> shards;
+    // The shards (one per thread), allocated the first time the thread
+    // updates a key
+    std::vector<std::atomic<Shard*>> shards;
 };
@@ -17,16 +17,258 @@
 
 
 #include "tracing.h"
+#include "executorpool.h"
+#include "task.h"
 
 #include <phosphor/phosphor.h>
 #include <phosphor/tools/export.h>
+#include <platform/platform.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 // TODO: MB-20640 The default config should be configurable from memcached.json
 static phosphor::TraceConfig lastConfig{
         phosphor::TraceConfig(phosphor::BufferMode::ring, 20 * 1024 * 1024)};
 static std::mutex configMutex;
 
+/**
+ * The size of the chunks the trace is exported in. Exporting the trace in
+ * chunks means that we never hold more than a chunk of the JSON in memory
+ * in addition to the trace buffer.
+ */
+static const size_t TraceChunkSize = 1024 * 1024;
+
+/**
+ * A trace being exported. The exporter keeps a reference to the context,
+ * so they have to live together.
+ */
+struct TraceDump {
+    explicit TraceDump(phosphor::TraceContext&& ctx)
+        : context(std::move(ctx)),
+          exporter(context),
+          lastTouched(std::chrono::steady_clock::now()) {
+    }
+
+    /**
+     * Append the next chunk (at most length bytes) of the JSON to the
+     * string. The exporter writes directly into the string so that we
+     * don't have to copy it.
+     */
+    void readChunk(std::string& out, size_t length) {
+        const auto offset = out.size();
+        out.resize(offset + length);
+        out.resize(offset + exporter.read(&out[offset], length));
+    }
+
+    phosphor::TraceContext context;
+    phosphor::tools::JSONExport exporter;
+    std::chrono::steady_clock::time_point lastTouched;
+};
+
+/**
+ * Stop tracing (if it is running) and take the trace buffer
+ *
+ * @return the trace or nullptr if there isn't a trace buffer
+ */
+static std::unique_ptr<TraceDump> takeTrace() {
+    std::lock_guard<phosphor::TraceLog> lh(PHOSPHOR_INSTANCE);
+    if (PHOSPHOR_INSTANCE.isEnabled()) {
+        PHOSPHOR_INSTANCE.stop(lh);
+    }
+
+    phosphor::TraceContext context = PHOSPHOR_INSTANCE.getTraceContext(lh);
+    if (context.getBuffer() == nullptr) {
+        return nullptr;
+    }
+    return std::unique_ptr<TraceDump>(new TraceDump(std::move(context)));
+}
+
+/**
+ * The chunked dumps in progress. Dumps which haven't been touched for
+ * DumpTimeout are released the next time a dump is started (in case the
+ * client went away without reading it).
+ */
+static std::mutex dumpsMutex;
+static std::map<uint64_t, std::unique_ptr<TraceDump>> dumps;
+static uint64_t nextDumpId = 1;
+static const std::chrono::minutes DumpTimeout(5);
+
+/**
+ * Expand the %p (pid) and %d (timestamp) placeholders in the name of a
+ * trace file (the same placeholders as accepted by save-on-stop)
+ */
+static std::string expandTraceFilename(const std::string& pattern) {
+    const time_t now = time(nullptr);
+    struct tm utc_time;
+#ifdef WIN32
+    gmtime_s(&utc_time, &now);
+#else
+    gmtime_r(&now, &utc_time);
+#endif
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y.%m.%dT%H.%M.%SZ", &utc_time);
+
+    std::string ret;
+    for (size_t ii = 0; ii < pattern.size(); ++ii) {
+        if (pattern[ii] == '%' && ii + 1 < pattern.size()) {
+            if (pattern[ii + 1] == 'p') {
+                ret.append(std::to_string(cb_getpid()));
+                ++ii;
+                continue;
+            } else if (pattern[ii + 1] == 'd') {
+                ret.append(timestamp);
+                ++ii;
+                continue;
+            }
+        }
+        ret.push_back(pattern[ii]);
+    }
+    return ret;
+}
+
+/**
+ * Write the trace to a file, a chunk at a time
+ *
+ * @return true if the file was written successfully
+ */
+static bool writeTraceFile(TraceDump& dump, const std::string& filename) {
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == nullptr) {
+        LOG_WARNING(nullptr, "Failed to open trace file %s: %s",
+                    filename.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::vector<char> chunk(TraceChunkSize);
+    bool success = true;
+    while (success && !dump.exporter.done()) {
+        const auto nr = dump.exporter.read(chunk.data(), chunk.size());
+        success = fwrite(chunk.data(), 1, nr, fp) == nr;
+    }
+    if (fclose(fp) != 0) {
+        success = false;
+    }
+
+    if (success) {
+        LOG_NOTICE(nullptr, "Trace written to %s", filename.c_str());
+    } else {
+        LOG_WARNING(nullptr, "Failed to write trace file %s: %s",
+                    filename.c_str(), strerror(errno));
+    }
+    return success;
+}
+
+/**
+ * The TraceFileTask writes a trace to a file on the executor pool so that
+ * the front end thread isn't blocked while we write a large trace.
+ */
+class TraceFileTask : public Task {
+public:
+    TraceFileTask(std::unique_ptr<TraceDump> dump_, std::string filename_)
+        : dump(std::move(dump_)),
+          filename(std::move(filename_)) {
+        setPriority(Priority::Low);
+    }
+
+    virtual bool execute() override {
+        writeTraceFile(*dump, filename);
+        return true;
+    }
+
+    virtual const char* getName() const override {
+        return "trace_file";
+    }
+
+private:
+    std::unique_ptr<TraceDump> dump;
+    const std::string filename;
+};
+
+/**
+ * The ContinuousTraceTask rotates the trace every interval. The trace
+ * buffer is swapped with a new one (which only pause tracing for the time
+ * it takes to allocate the new buffer), and the old buffer is written to
+ * a new file. The task reschedules itself until it is stopped.
+ */
+class ContinuousTraceTask
+    : public Task,
+      public std::enable_shared_from_this<ContinuousTraceTask> {
+public:
+    ContinuousTraceTask(std::string pattern_,
+                        std::chrono::seconds interval_)
+        : pattern(std::move(pattern_)),
+          interval(interval_),
+          stopped(false) {
+        setPriority(Priority::Low);
+    }
+
+    virtual bool execute() override {
+        if (stopped.load()) {
+            return true;
+        }
+
+        auto dump = rotate();
+        if (dump) {
+            writeTraceFile(*dump, expandTraceFilename(pattern));
+        }
+
+        // We're called with the task mutex held so we may reschedule
+        // ourself
+        std::shared_ptr<Task> self = shared_from_this();
+        executorPool->scheduleAfter(self, interval);
+        return true;
+    }
+
+    virtual const char* getName() const override {
+        return "trace_rotate";
+    }
+
+    void stop() {
+        stopped.store(true);
+    }
+
+private:
+    /**
+     * Take the current trace buffer and restart tracing with a new one
+     *
+     * @return the trace or nullptr if tracing isn't running
+     */
+    std::unique_ptr<TraceDump> rotate() {
+        std::unique_lock<std::mutex> guard(configMutex);
+        const auto config = lastConfig;
+        guard.unlock();
+
+        std::lock_guard<phosphor::TraceLog> lh(PHOSPHOR_INSTANCE);
+        if (!PHOSPHOR_INSTANCE.isEnabled()) {
+            // Someone stopped the trace. Leave it for trace.dump
+            return nullptr;
+        }
+        PHOSPHOR_INSTANCE.stop(lh);
+        phosphor::TraceContext context = PHOSPHOR_INSTANCE.getTraceContext(lh);
+        PHOSPHOR_INSTANCE.start(lh, config);
+
+        if (context.getBuffer() == nullptr) {
+            return nullptr;
+        }
+        return std::unique_ptr<TraceDump>(new TraceDump(std::move(context)));
+    }
+
+    const std::string pattern;
+    const std::chrono::seconds interval;
+    std::atomic<bool> stopped;
+};
+
+static std::mutex continuousMutex;
+static std::shared_ptr<ContinuousTraceTask> continuousTask;
+
 
 ENGINE_ERROR_CODE ioctlGetTracingStatus(Connection*,
                                         const StrToStrMap&,
@@ -46,20 +288,158 @@ ENGINE_ERROR_CODE ioctlGetTracingConfig(Connection*,
 ENGINE_ERROR_CODE ioctlGetTracingDump(Connection*,
                                       const StrToStrMap&,
                                       std::string& value) {
-    std::lock_guard<phosphor::TraceLog> lh(PHOSPHOR_INSTANCE);
-    if (PHOSPHOR_INSTANCE.isEnabled()) {
-        PHOSPHOR_INSTANCE.stop(lh);
+    auto dump = takeTrace();
+    if (!dump) {
+        return ENGINE_EINVAL;
     }
 
-    phosphor::TraceContext context = PHOSPHOR_INSTANCE.getTraceContext(lh);
-    if (context.getBuffer() == nullptr) {
+    // Use trace.dump.begin / trace.dump.chunk to avoid building the
+    // entire JSON document in memory
+    while (!dump->exporter.done()) {
+        dump->readChunk(value, TraceChunkSize);
+    }
+
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE ioctlGetTracingBeginDump(Connection*,
+                                           const StrToStrMap&,
+                                           std::string& value) {
+    auto dump = takeTrace();
+    if (!dump) {
+        return ENGINE_EINVAL;
+    }
+
+    std::lock_guard<std::mutex> guard(dumpsMutex);
+    const auto now = std::chrono::steady_clock::now();
+    for (auto iter = dumps.begin(); iter != dumps.end();) {
+        if (now - iter->second->lastTouched > DumpTimeout) {
+            iter = dumps.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    const auto id = nextDumpId++;
+    dumps[id] = std::move(dump);
+    value = std::to_string(id);
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Parse the id of a dump
+ *
+ * @return the id or 0 if it isn't a valid id
+ */
+static uint64_t parseDumpId(const std::string& value) {
+    uint64_t id;
+    if (!safe_strtoull(value.c_str(), &id)) {
+        return 0;
+    }
+    return id;
+}
+
+ENGINE_ERROR_CODE ioctlGetTracingDumpChunk(Connection*,
+                                           const StrToStrMap& arguments,
+                                           std::string& value) {
+    auto arg = arguments.find("id");
+    if (arg == arguments.end()) {
         return ENGINE_EINVAL;
     }
-    // TODO-PERF: This copies the phosphor::String into a std::string; which 
-    // for large dumps could be inefficient. Consider refactoring to remove
-    // the need to copy.
-    value = *phosphor::tools::JSONExport(context).read();
 
+    std::lock_guard<std::mutex> guard(dumpsMutex);
+    auto iter = dumps.find(parseDumpId(arg->second));
+    if (iter == dumps.end()) {
+        return ENGINE_KEY_ENOENT;
+    }
+
+    auto& dump = *iter->second;
+    if (dump.exporter.done()) {
+        // The client read the last chunk; tell it that we're done
+        dumps.erase(iter);
+        return ENGINE_SUCCESS;
+    }
+    dump.readChunk(value, TraceChunkSize);
+    dump.lastTouched = std::chrono::steady_clock::now();
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE ioctlSetTracingClearDump(Connection*,
+                                           const StrToStrMap&,
+                                           const std::string& value) {
+    std::lock_guard<std::mutex> guard(dumpsMutex);
+    if (dumps.erase(parseDumpId(value)) == 0) {
+        return ENGINE_KEY_ENOENT;
+    }
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE ioctlSetTracingDumpToFile(Connection* c,
+                                            const StrToStrMap&,
+                                            const std::string& value) {
+    if (value.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    auto dump = takeTrace();
+    if (!dump) {
+        return ENGINE_EINVAL;
+    }
+
+    const auto filename = expandTraceFilename(value);
+    LOG_NOTICE(c, "%u: IOCTL_SET: writing trace to %s", c->getId(),
+               filename.c_str());
+    std::shared_ptr<Task> task = std::make_shared<TraceFileTask>(
+            std::move(dump), filename);
+    std::lock_guard<std::mutex> guard(task->getMutex());
+    executorPool->schedule(task, true);
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE ioctlSetTracingContinuous(Connection* c,
+                                            const StrToStrMap& arguments,
+                                            const std::string& value) {
+    uint64_t interval = 60;
+    auto arg = arguments.find("interval");
+    if (arg != arguments.end()) {
+        if (!safe_strtoull(arg->second.c_str(), &interval) ||
+            interval == 0) {
+            return ENGINE_EINVAL;
+        }
+    }
+
+    // Each file needs a unique name
+    if (!value.empty() && value.find("%d") == std::string::npos) {
+        return ENGINE_EINVAL;
+    }
+
+    std::lock_guard<std::mutex> guard(continuousMutex);
+    if (continuousTask) {
+        continuousTask->stop();
+        continuousTask.reset();
+    }
+
+    if (value.empty()) {
+        LOG_NOTICE(c, "%u: IOCTL_SET: continuous tracing disabled",
+                   c->getId());
+        return ENGINE_SUCCESS;
+    }
+
+    {
+        std::lock_guard<std::mutex> lh(configMutex);
+        if (!PHOSPHOR_INSTANCE.isEnabled()) {
+            PHOSPHOR_INSTANCE.start(lastConfig);
+        }
+    }
+
+    continuousTask = std::make_shared<ContinuousTraceTask>(
+            value, std::chrono::seconds(interval));
+    std::shared_ptr<Task> task = continuousTask;
+    std::lock_guard<std::mutex> lh(task->getMutex());
+    executorPool->scheduleAfter(task, std::chrono::seconds(interval));
+
+    LOG_NOTICE(c, "%u: IOCTL_SET: continuous tracing to %s every %u s",
+               c->getId(), value.c_str(), unsigned(interval));
     return ENGINE_SUCCESS;
 }
 
@@ -49,6 +49,52 @@ ENGINE_ERROR_CODE ioctlGetTracingDump(Connection*,
                                       const StrToStrMap&,
                                       std::string& value);
 
+/**
+ * IOCTL Get callback to start a chunked dump of the last trace (stops
+ * tracing if it is running)
+ * @param[out] value The id of the dump (used with trace.dump.chunk)
+ */
+ENGINE_ERROR_CODE ioctlGetTracingBeginDump(Connection*,
+                                           const StrToStrMap&,
+                                           std::string& value);
+
+/**
+ * IOCTL Get callback to get the next chunk of a dump (specified with
+ * the "id" argument). The dump is released once it is fully read.
+ * @param[out] value The next chunk of the trace (empty when done)
+ */
+ENGINE_ERROR_CODE ioctlGetTracingDumpChunk(Connection*,
+                                           const StrToStrMap& arguments,
+                                           std::string& value);
+
+/**
+ * IOCTL Set callback to release a dump before it is fully read
+ * @param value The id of the dump
+ */
+ENGINE_ERROR_CODE ioctlSetTracingClearDump(Connection*,
+                                           const StrToStrMap&,
+                                           const std::string& value);
+
+/**
+ * IOCTL Set callback to dump the last trace to a file (stops tracing if
+ * it is running). The file is written by the executor pool.
+ * @param value The name of the file (accepts the %p and %d placeholders)
+ */
+ENGINE_ERROR_CODE ioctlSetTracingDumpToFile(Connection* c,
+                                            const StrToStrMap&,
+                                            const std::string& value);
+
+/**
+ * IOCTL Set callback to enable continuous tracing. The trace is written
+ * to a new file every "interval" seconds (60 by default) without
+ * stopping the trace.
+ * @param value The name of the files (must contain the %d placeholder),
+ *              or an empty string to disable continuous tracing
+ */
+ENGINE_ERROR_CODE ioctlSetTracingContinuous(Connection* c,
+                                            const StrToStrMap& arguments,
+                                            const std::string& value);
+
 /**
  * IOCTL Set callback to set the tracing config to use when it starts
  * @param value The Phosphor trace config string to start tracing with
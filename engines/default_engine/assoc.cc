@@ -66,20 +66,33 @@ void assoc_destroy() {
     }
 }
 
-hash_item *assoc_find(struct default_engine *engine, uint32_t hash, const hash_key *key) {
-    hash_item *it;
+#if defined(__GNUC__)
+#define ASSOC_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define ASSOC_PREFETCH(addr) (void)(addr)
+#endif
+
+/*
+ * Get the address of the bucket in the hash table the hash maps to.
+ * assoc->lock is assumed to be held by the caller.
+ */
+static hash_item** assoc_bucket(struct default_engine *engine, uint32_t hash) {
     unsigned int oldbucket;
-    hash_item *ret = NULL;
-    int depth = 0;
-    cb_mutex_enter(&engine->assoc->lock);
     if (engine->assoc->expanding &&
         (oldbucket = (hash & hashmask(engine->assoc->hashpower - 1))) >= engine->assoc->expand_bucket)
     {
-        it = engine->assoc->old_hashtable[oldbucket];
-    } else {
-        it = engine->assoc->primary_hashtable[hash & hashmask(engine->assoc->hashpower)];
+        return &engine->assoc->old_hashtable[oldbucket];
     }
+    return &engine->assoc->primary_hashtable[hash & hashmask(engine->assoc->hashpower)];
+}
 
+/*
+ * Search the hash chain starting at it for the key.
+ * assoc->lock is assumed to be held by the caller.
+ */
+static hash_item *assoc_find_in_chain(hash_item *it, const hash_key *key) {
+    hash_item *ret = NULL;
+    int depth = 0;
     while (it) {
         const hash_key* it_key = item_get_key(it);
         if ((hash_key_get_key_len(key) == hash_key_get_key_len(it_key)) &&
@@ -93,10 +106,43 @@ hash_item *assoc_find(struct default_engine *engine, uint32_t hash, const hash_k
         ++depth;
     }
     MEMCACHED_ASSOC_FIND(hash_key_get_key(key), hash_key_get_key_len(key), depth);
+    return ret;
+}
+
+hash_item *assoc_find(struct default_engine *engine, uint32_t hash, const hash_key *key) {
+    hash_item *ret;
+    cb_mutex_enter(&engine->assoc->lock);
+    ret = assoc_find_in_chain(*assoc_bucket(engine, hash), key);
     cb_mutex_exit(&engine->assoc->lock);
     return ret;
 }
 
+void assoc_find_multi(struct default_engine *engine, const uint32_t *hash,
+                      const hash_key *keys, size_t nkeys, hash_item **items) {
+    size_t ii;
+    cb_mutex_enter(&engine->assoc->lock);
+
+    /*
+     * The buckets for the keys are spread all over the hash table so we'll
+     * most likely miss the cache for every one of them. Issue the loads in
+     * two passes before we start comparing keys so that the memory accesses
+     * overlap rather than stalling on each one in turn: first the buckets,
+     * then the first item in each chain.
+     */
+    for (ii = 0; ii < nkeys; ++ii) {
+        ASSOC_PREFETCH(assoc_bucket(engine, hash[ii]));
+    }
+    for (ii = 0; ii < nkeys; ++ii) {
+        items[ii] = *assoc_bucket(engine, hash[ii]);
+        ASSOC_PREFETCH(items[ii]);
+    }
+    for (ii = 0; ii < nkeys; ++ii) {
+        items[ii] = assoc_find_in_chain(items[ii], &keys[ii]);
+    }
+
+    cb_mutex_exit(&engine->assoc->lock);
+}
+
 /*
     returns the address of the item pointer before the key.  if *item == 0,
     the item wasn't found
@@ -39,6 +39,10 @@ ENGINE_ERROR_CODE assoc_init(struct default_engine *engine);
 void assoc_destroy(void);
 hash_item *assoc_find(struct default_engine *engine, uint32_t hash,
                       const hash_key* key);
+/* look up nkeys keys while holding the lock once (items[i] is NULL if
+ * keys[i] wasn't found) */
+void assoc_find_multi(struct default_engine *engine, const uint32_t *hash,
+                      const hash_key *keys, size_t nkeys, hash_item **items);
 int assoc_insert(struct default_engine *engine, uint32_t hash,
                  hash_item *item);
 void assoc_delete(struct default_engine *engine, uint32_t hash,
@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <vector>
 
 #include "default_engine_internal.h"
 #include "memcached/util.h"
@@ -45,6 +46,13 @@ static ENGINE_ERROR_CODE default_get(ENGINE_HANDLE* handle,
                                      item** item,
                                      const DocKey& key,
                                      uint16_t vbucket);
+static ENGINE_ERROR_CODE default_get_multi(ENGINE_HANDLE* handle,
+                                           const void* cookie,
+                                           const DocKey* keys,
+                                           const uint16_t* vbuckets,
+                                           size_t nkeys,
+                                           item** items,
+                                           ENGINE_ERROR_CODE* status);
 static ENGINE_ERROR_CODE default_get_stats(ENGINE_HANDLE* handle,
                   const void *cookie,
                   const char *stat_key,
@@ -130,6 +138,7 @@ void default_engine_constructor(struct default_engine* engine, bucket_id_t id)
     engine->engine.remove = default_item_delete;
     engine->engine.release = default_item_release;
     engine->engine.get = default_get;
+    engine->engine.get_multi = default_get_multi;
     engine->engine.get_stats = default_get_stats;
     engine->engine.reset_stats = default_reset_stats;
     engine->engine.store = default_store;
@@ -336,6 +345,48 @@ static ENGINE_ERROR_CODE default_get(ENGINE_HANDLE* handle,
    }
 }
 
+static ENGINE_ERROR_CODE default_get_multi(ENGINE_HANDLE* handle,
+                                           const void* cookie,
+                                           const DocKey* keys,
+                                           const uint16_t* vbuckets,
+                                           size_t nkeys,
+                                           item** items,
+                                           ENGINE_ERROR_CODE* status) {
+   struct default_engine *engine = get_handle(handle);
+
+   try {
+      // Only look up the keys for the vbuckets we handle
+      std::vector<DocKey> lookup;
+      std::vector<size_t> index;
+      lookup.reserve(nkeys);
+      index.reserve(nkeys);
+      for (size_t ii = 0; ii < nkeys; ++ii) {
+         items[ii] = NULL;
+         if (handled_vbucket(engine, vbuckets[ii])) {
+            lookup.push_back(keys[ii]);
+            index.push_back(ii);
+         } else {
+            status[ii] = ENGINE_NOT_MY_VBUCKET;
+         }
+      }
+
+      std::vector<hash_item*> found(lookup.size());
+      if (!item_get_multi(engine, cookie, lookup.data(), lookup.size(),
+                          found.data())) {
+         return ENGINE_ENOMEM;
+      }
+
+      for (size_t ii = 0; ii < lookup.size(); ++ii) {
+         items[index[ii]] = found[ii];
+         status[index[ii]] = found[ii] ? ENGINE_SUCCESS : ENGINE_KEY_ENOENT;
+      }
+   } catch (const std::bad_alloc&) {
+      return ENGINE_ENOMEM;
+   }
+
+   return ENGINE_SUCCESS;
+}
+
 static ENGINE_ERROR_CODE default_get_stats(ENGINE_HANDLE* handle,
                                            const void* cookie,
                                            const char* stat_key,
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <time.h>
 #include <inttypes.h>
+#include <vector>
 
 #include <platform/cb_malloc.h>
 #include <platform/crc32c.h>
@@ -24,6 +25,9 @@ static hash_item *do_item_alloc(struct default_engine *engine,
                                 uint8_t datatype);
 static hash_item *do_item_get(struct default_engine *engine,
                               const hash_key* key);
+static hash_item *do_item_get_found(struct default_engine *engine,
+                                    const hash_key* key,
+                                    hash_item *it);
 static int do_item_link(struct default_engine *engine, hash_item *it);
 static void do_item_unlink(struct default_engine *engine, hash_item *it);
 static void do_item_release(struct default_engine *engine, hash_item *it);
@@ -482,11 +486,23 @@ static void do_item_stats_sizes(struct default_engine *engine,
 /** wrapper around assoc_find which does the lazy expiration logic */
 hash_item *do_item_get(struct default_engine *engine,
                        const hash_key *key) {
-    rel_time_t current_time = engine->server.core->get_current_time();
     hash_item *it = assoc_find(engine,
                                crc32c(hash_key_get_key(key),
                                       hash_key_get_key_len(key), 0),
                                key);
+    return do_item_get_found(engine, key, it);
+}
+
+/**
+ * The lazy expiration logic for an item returned from the hash table
+ * (it may be NULL if the key wasn't found). Returns the item with its
+ * reference count incremented, or NULL if it doesn't exist (or expired).
+ * items.lock must be held by the caller.
+ */
+static hash_item *do_item_get_found(struct default_engine *engine,
+                                    const hash_key *key,
+                                    hash_item *it) {
+    rel_time_t current_time = engine->server.core->get_current_time();
     int was_found = 0;
 
     if (engine->config.verbose > 2) {
@@ -653,6 +669,46 @@ hash_item *item_get(struct default_engine *engine,
     return it;
 }
 
+/*
+ * Look up multiple items. All of the keys are hashed before we grab the
+ * lock so that we only hold the locks (once) while we're walking the
+ * hash chains.
+ */
+bool item_get_multi(struct default_engine *engine,
+                    const void *cookie,
+                    const DocKey* keys,
+                    size_t nkeys,
+                    hash_item** items) {
+    std::vector<hash_key> hkeys(nkeys);
+    std::vector<uint32_t> hashes(nkeys);
+
+    size_t ii;
+    for (ii = 0; ii < nkeys; ++ii) {
+        if (!hash_key_create(&hkeys[ii], keys[ii].buf, keys[ii].len,
+                             engine, cookie)) {
+            break;
+        }
+        hashes[ii] = crc32c(hash_key_get_key(&hkeys[ii]),
+                            hash_key_get_key_len(&hkeys[ii]), 0);
+    }
+
+    const bool success = (ii == nkeys);
+    if (success) {
+        cb_mutex_enter(&engine->items.lock);
+        assoc_find_multi(engine, hashes.data(), hkeys.data(), nkeys, items);
+        for (size_t jj = 0; jj < nkeys; ++jj) {
+            items[jj] = do_item_get_found(engine, &hkeys[jj], items[jj]);
+        }
+        cb_mutex_exit(&engine->items.lock);
+    }
+
+    for (size_t jj = 0; jj < ii; ++jj) {
+        hash_key_destroy(&hkeys[jj]);
+    }
+
+    return success;
+}
+
 /*
  * Decrements the reference count on an item and adds it to the freelist if
  * needed.
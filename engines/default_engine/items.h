@@ -156,6 +156,22 @@ hash_item *item_get(struct default_engine *engine,
                     const void *key,
                     const size_t nkey);
 
+/**
+ * Get multiple items from the cache
+ *
+ * @param engine handle to the storage engine
+ * @param cookie connection cookie
+ * @param keys the keys for the items to get
+ * @param nkeys the number of keys
+ * @param items where to store the items (NULL if the item doesn't exist)
+ * @return false if we failed to allocate memory for the keys
+ */
+bool item_get_multi(struct default_engine *engine,
+                    const void *cookie,
+                    const DocKey* keys,
+                    size_t nkeys,
+                    hash_item** items);
+
 /**
  * Reset the item statistics
  * @param engine handle to the storage engine
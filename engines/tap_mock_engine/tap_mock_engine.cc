@@ -839,6 +839,7 @@ struct EngineGlue {
         interface.remove = item_delete;
         interface.release = item_release;
         interface.get = get;
+        interface.get_multi = NULL;
         interface.get_stats = get_stats;
         interface.reset_stats = reset_stats;
         interface.store = store;
@@ -19,6 +19,10 @@
 #include <memcached/extension.h>
 #include <memcached/visibility.h>
 #include <platform/platform.h>
+#include <string>
+#include <time.h>
+#include <utility>
+#include <vector>
 
 /**
  * Response codes for audit operations.
@@ -113,6 +117,59 @@ AUDIT_ERROR_CODE put_audit_event(Audit* handle,
                                  const void* payload,
                                  const size_t length);
 
+/**
+ * An audit event generated by the memcached core. The front-end threads
+ * only copy the fields of the event into the record, and the audit daemon
+ * formats the record as JSON on its own thread.
+ */
+struct AuditEventRecord {
+    /** The time the event happened (seconds since epoch) */
+    time_t time = 0;
+    /** The fraction of the second the event happened (usec) */
+    uint32_t usec = 0;
+    std::string peername;
+    std::string sockname;
+    /**
+     * The credentials of the peer (for unix domain sockets) formatted as
+     * a JSON object, or empty if not known
+     */
+    std::string peer_credentials;
+    /** The user authenticated on the connection */
+    std::string user;
+    /**
+     * The event specific members of the event. All of the values are
+     * strings, and the keys must be string literals.
+     */
+    std::vector<std::pair<const char*, std::string>> fields;
+};
+
+/**
+ * Put an audit event generated by the memcached core into the audit
+ * trail. The record is formatted by the audit daemon.
+ *
+ * @param audit_eventid The identifier for the event to insert
+ * @param record the event to insert to the audit trail
+ * @return AUDIT_SUCCESS if the event was successfully added to the audit
+ *                       queue (may be dropped at a later time)
+ *         AUDIT_FAILED if an error occured while trying to insert the
+ *                      event to the audit queue.
+ */
+MEMCACHED_PUBLIC_API
+AUDIT_ERROR_CODE put_audit_event_record(Audit* handle,
+                                        uint32_t audit_eventid,
+                                        AuditEventRecord record);
+
+/**
+ * Check if an audit event is enabled. This is a cheap check (it doesn't
+ * lock anything) which should be used to avoid creating the payload for
+ * events which would be dropped by the audit daemon.
+ *
+ * @param audit_eventid The identifier for the event to check
+ * @return true if auditing is enabled and the event isn't disabled
+ */
+MEMCACHED_PUBLIC_API
+bool is_audit_event_enabled(Audit* handle, uint32_t audit_eventid);
+
 /**
  * Shut down the audit daemon
  *
@@ -613,6 +613,42 @@ extern "C" {
          * @param level the current log level
          */
         void (*set_log_level)(ENGINE_HANDLE* handle, EXTENSION_LOG_LEVEL level);
+
+        /**
+         * Retrieve multiple items in a single call. This allows the engine
+         * to amortize the cost of the lookups (locking, hashing etc) over
+         * all of the keys.
+         *
+         * The status for each of the keys is returned in the status array.
+         * A key may fail with ENGINE_EWOULDBLOCK in which case the engine
+         * will notify the cookie when the operation completes, and the
+         * caller should call get_multi again with only the keys which
+         * blocked.
+         *
+         * This method is optional; if it is NULL the core will use get()
+         * for each key. It is the last member of the struct to keep the
+         * offsets of the other members unchanged.
+         *
+         * @param handle the engine handle
+         * @param cookie The cookie provided by the frontend
+         * @param keys array of nkeys keys to look up
+         * @param vbuckets array of nkeys virtual bucket ids (one per key)
+         * @param nkeys the number of keys to look up
+         * @param items output array (nkeys) receiving the located items
+         * @param status output array (nkeys) receiving the status for
+         *               each key
+         *
+         * @return ENGINE_SUCCESS if the status array was populated, or
+         *         a standard engine error code if the entire operation
+         *         failed (the content of items and status is undefined)
+         */
+        ENGINE_ERROR_CODE (*get_multi)(ENGINE_HANDLE* handle,
+                                       const void* cookie,
+                                       const DocKey* keys,
+                                       const uint16_t* vbuckets,
+                                       size_t nkeys,
+                                       item** items,
+                                       ENGINE_ERROR_CODE* status);
     } ENGINE_HANDLE_V1;
 
     /**
@@ -18,6 +18,8 @@
 
 #ifdef __cplusplus
 
+#include <cstdint>
+
 /**
  * RBAC in memcached
  *
@@ -211,6 +213,22 @@ enum class PrivilegeAccess {
     Fail,
     Stale
 };
+
+/**
+ * A set of privileges, where the bit (1 << privilege) is set for each
+ * privilege in the set.
+ */
+typedef uint32_t PrivilegeMask;
+
+static_assert(int(Privilege::CollectionManagement) < 32,
+              "PrivilegeMask is too small to hold all privileges");
+
+/**
+ * Get the PrivilegeMask containing a single privilege
+ */
+inline PrivilegeMask privilegeToMask(Privilege privilege) {
+    return PrivilegeMask(1) << int(privilege);
+}
 #else
 /**
  * We still have a ton of C code in our system, but I don't want
@@ -63,6 +63,8 @@ extern "C"
      * See section 3.1 Magic byte
      */
     typedef enum {
+        PROTOCOL_BINARY_AREQ = 0x08,
+        PROTOCOL_BINARY_ARES = 0x18,
         PROTOCOL_BINARY_REQ = 0x80,
         PROTOCOL_BINARY_RES = 0x81
     } protocol_binary_magic;
@@ -139,6 +141,15 @@ extern "C"
          * etc).
          */
         PROTOCOL_BINARY_RESPONSE_ETMPFAIL = 0x86,
+        /** The bucket exceeded the rate of requests (or bytes) it is
+         * allowed to receive, and the request was rejected. Retrying the
+         * operation later may succeed. */
+        PROTOCOL_BINARY_RESPONSE_RATE_LIMITED = 0x87,
+
+        /** The deadline the client specified for the request passed
+         * before the server started (or resumed) executing it, so the
+         * request was never sent to the engine. */
+        PROTOCOL_BINARY_RESPONSE_DEADLINE_EXCEEDED = 0x88,
 
         /*
          * Sub-document specific responses.
@@ -295,6 +306,13 @@ extern "C"
          * vbuckets on the node */
         PROTOCOL_BINARY_CMD_GET_ALL_VB_SEQNOS = 0x48,
 
+        /* Retrieve multiple documents in a single command */
+        PROTOCOL_BINARY_CMD_GET_MULTI = 0x49,
+
+        /* Get the server side trace spans of the recent requests on the
+         * connection */
+        PROTOCOL_BINARY_CMD_GET_TRACE_SPANS = 0x4a,
+
         /* DCP */
         PROTOCOL_BINARY_CMD_DCP_OPEN = 0x50,
         PROTOCOL_BINARY_CMD_DCP_ADD_STREAM = 0x51,
@@ -1271,7 +1289,39 @@ enum class Feature : uint16_t {
     TCPNODELAY = 0x03,
     MUTATION_SEQNO = 0x04,
     TCPDELAY = 0x05,
-    XATTR = 0x06
+    XATTR = 0x06,
+    UNORDERED_EXECUTION = 0x07,
+    DEADLINE = 0x08,
+    TRACING = 0x09
+};
+
+/**
+ * The identifiers of the frame infos which may be present in the framing
+ * extras of a request using the alternative request format
+ * (PROTOCOL_BINARY_AREQ). Each frame info starts with a byte containing
+ * the identifier in the upper 4 bits and the length of the data
+ * following it in the lower 4 bits.
+ */
+enum class FrameInfoId : uint8_t {
+    /** 4 bytes (network byte order) containing the number of
+     * microseconds the client is willing to wait for the response */
+    Timeout = 0x01
+};
+
+/**
+ * The identifiers of the frame infos which may be present in the framing
+ * extras of a response using the alternative response format
+ * (PROTOCOL_BINARY_ARES). The frame infos use the same encoding as
+ * in the requests.
+ */
+enum class ResponseFrameInfoId : uint8_t {
+    /** 2 bytes (network byte order) containing the encoded time spent
+     * by the server from the request was read until the response was
+     * created (see docs/BinaryProtocol.md for the encoding) */
+    ServerDuration = 0x00,
+    /** 2 bytes (network byte order) containing the encoded time spent
+     * executing the command (in the engine) */
+    EngineDuration = 0x01
 };
 }
 using protocol_binary_hello_features_t = mcbp::Feature;
@@ -1990,6 +2040,56 @@ using protocol_binary_hello_features_t = mcbp::Feature;
      */
     typedef protocol_binary_response_no_extras protocol_binary_response_get_all_vb_seqnos;
 
+    /**
+     * Definition of the request packet for the command
+     * PROTOCOL_BINARY_CMD_GET_MULTI
+     *
+     * Header: No extras and no key.
+     *
+     * Body: A "list" of keys to look up. Each entry consists of a
+     *       protocol_binary_get_multi_entry (in network byte order)
+     *       immediately followed by the key.
+     *
+     *    Byte/     0       |       1       |       2       |       3       |
+     *       /              |               |               |               |
+     *      |0 1 2 3 4 5 6 7|0 1 2 3 4 5 6 7|0 1 2 3 4 5 6 7|0 1 2 3 4 5 6 7|
+     *      +---------------+---------------+---------------+---------------+
+     *     0| VBID          | VBID          | KEYLEN        | KEYLEN        |
+     *      +---------------+---------------+---------------+---------------+
+     *     4| KEY (KEYLEN bytes)                                            |
+     *      +---------------+---------------+---------------+---------------+
+     *
+     * Response: The server sends a GETK style response (flags in the extras,
+     *       the key and the value) for each document found, and a response
+     *       with the key and the status code for each key which failed with
+     *       another error than "key not found". Misses are silent (like
+     *       GETKQ). The sequence is terminated by an empty response
+     *       with the status code set to success. All of the responses use
+     *       the opaque from the request.
+     */
+    typedef protocol_binary_request_no_extras protocol_binary_request_get_multi;
+
+    typedef struct {
+        uint16_t vbucket;
+        uint16_t keylen;
+    } protocol_binary_get_multi_entry;
+
+    /**
+     * Definition of the request packet for the command
+     * PROTOCOL_BINARY_CMD_GET_TRACE_SPANS
+     *
+     * Header: No key. The extras may contain the opaque (4 bytes, as
+     *         found in the header of the request) of the request to get
+     *         the span for.
+     *
+     * Response: A JSON array with the spans of the most recent requests
+     *           on the connection (or the span for the requested opaque,
+     *           or KEY_ENOENT if it isn't known). Requires that the
+     *           connection enabled the Tracing feature.
+     */
+    typedef protocol_binary_request_no_extras
+        protocol_binary_request_get_trace_spans;
+
     /**
      * Message format for PROTOCOL_BINARY_CMD_GET_KEYS
      *
@@ -2030,6 +2130,12 @@ inline std::string to_string(const Feature& feature) {
         return "Mutation seqno";
     case Feature::XATTR:
         return "XATTR";
+    case Feature::UNORDERED_EXECUTION:
+        return "Unordered execution";
+    case Feature::DEADLINE:
+        return "Deadline";
+    case Feature::TRACING:
+        return "Tracing";
     }
     throw std::invalid_argument("mcbp::to_string: unknown feature: " +
                                 std::to_string(uint16_t(feature)));
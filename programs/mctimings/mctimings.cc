@@ -19,6 +19,7 @@
 
 #include <array>
 #include <string>
+#include <utility>
 #include <vector>
 #include <iostream>
 #include <cstdlib>
@@ -61,6 +62,23 @@ static cJSON *getArray(cJSON *root, const char *key) {
     return obj;
 }
 
+/**
+ * Format a duration (in ns) with a suitable time unit
+ */
+static std::string formatDuration(uint64_t nsec) {
+    char buffer[32];
+    if (nsec < 1000) {
+        snprintf(buffer, sizeof(buffer), "%u ns", unsigned(nsec));
+    } else if (nsec < 1000000) {
+        snprintf(buffer, sizeof(buffer), "%.2f us", double(nsec) / 1e3);
+    } else if (nsec < 1000000000) {
+        snprintf(buffer, sizeof(buffer), "%.2f ms", double(nsec) / 1e6);
+    } else {
+        snprintf(buffer, sizeof(buffer), "%.2f s", double(nsec) / 1e9);
+    }
+    return std::string(buffer);
+}
+
 // A single bin of a histogram. Holds the raw count and cumulative total (to
 // allow percentile to be calculated).
 struct Bin {
@@ -140,6 +158,14 @@ public:
             dump("s ", 80, 0, wayout[4]);
         }
         std::cout << "Total: " << total << " operations" << std::endl;
+
+        if (!percentiles.empty()) {
+            for (const auto& p : percentiles) {
+                std::cout << p.first << ": " << formatDuration(p.second)
+                          << (&p == &percentiles.back() ? "" : ", ");
+            }
+            std::cout << std::endl;
+        }
     }
 
 private:
@@ -202,6 +228,16 @@ private:
             oldwayout = true;
         }
 
+        // Servers recording the timings in HDR histograms report the
+        // percentiles (in ns) as well
+        percentiles.clear();
+        for (const auto* key : {"p50", "p90", "p99", "p99.9", "max"}) {
+            auto* obj = cJSON_GetObjectItem(root, key);
+            if (obj != nullptr) {
+                percentiles.emplace_back(key, uint64_t(obj->valuedouble));
+            }
+        }
+
         // Calculate total and cumulative counts, and find the highest value.
         max = total = 0;
 
@@ -272,6 +308,9 @@ private:
     bool oldwayout;
 
     uint64_t total;
+
+    // The percentiles reported by the server (in ns)
+    std::vector<std::pair<std::string, uint64_t>> percentiles;
 };
 
 std::string opcode2string(uint8_t opcode) {
@@ -366,42 +405,58 @@ static void request_stat_timings(BIO *bio, const char* key, int verbose) {
     ensure_send(bio, &request, sizeof(request.bytes));
     ensure_send(bio, key, keylen);
 
-    ensure_recv(bio, &response, sizeof(response.bytes));
-    uint32_t buffsize = ntohl(response.message.header.response.bodylen);
-    std::vector<char> buffer(buffsize + 1, 0);
+    // The stat may return a single histogram (without a key) or one
+    // histogram per key (for instance "latency_breakdown" returns one
+    // per phase). The last packet is the empty terminator.
+    while (true) {
+        ensure_recv(bio, &response, sizeof(response.bytes));
+        uint32_t buffsize = ntohl(response.message.header.response.bodylen);
+        const uint16_t namelen = ntohs(response.message.header.response.keylen);
+        std::vector<char> buffer(buffsize + 1, 0);
+
+        ensure_recv(bio, buffer.data(), buffsize);
+        protocol_binary_response_status status;
+        status = (protocol_binary_response_status)ntohs(response.message.header.response.status);
+        if (status != PROTOCOL_BINARY_RESPONSE_SUCCESS) {
+            switch (status) {
+            case PROTOCOL_BINARY_RESPONSE_KEY_ENOENT:
+                std::cerr <<"Cannot find statistic: " << key << std::endl;
+                break;
+            case PROTOCOL_BINARY_RESPONSE_EACCESS:
+                std::cerr << "Not authorized to access timings data" << std::endl;
+                break;
+            default:
+                std::cerr << "Command failed: "
+                          << memcached_status_2_text(status)
+                          << std::endl;
+            }
+            exit(EXIT_FAILURE);
+        }
 
-    ensure_recv(bio, buffer.data(), buffsize);
-    protocol_binary_response_status status;
-    status = (protocol_binary_response_status)ntohs(response.message.header.response.status);
-    if (status != PROTOCOL_BINARY_RESPONSE_SUCCESS) {
-        switch (status) {
-        case PROTOCOL_BINARY_RESPONSE_KEY_ENOENT:
-            std::cerr <<"Cannot find statistic: " << key << std::endl;
-            break;
-        case PROTOCOL_BINARY_RESPONSE_EACCESS:
-            std::cerr << "Not authorized to access timings data" << std::endl;
-            break;
-        default:
-            std::cerr << "Command failed: "
-                      << memcached_status_2_text(status)
-                      << std::endl;
+        if (buffsize == 0) {
+            return;
         }
-        exit(EXIT_FAILURE);
-    }
 
-    Timings timings;
-    try {
-        timings.initialize(buffer);
-    } catch (std::string &msg) {
-        std::cerr << "Fatal error: " << msg << std::endl;
-        exit(EXIT_FAILURE);
-    }
+        std::string name(key);
+        if (namelen > 0) {
+            name.assign(buffer.data(), namelen);
+            buffer.erase(buffer.begin(), buffer.begin() + namelen);
+        }
 
-    if (verbose) {
-        timings.dumpHistogram(key);
-    } else {
-        std::cout << key << " " << timings.getTotal() << " operations"
-                  << std::endl;
+        Timings timings;
+        try {
+            timings.initialize(buffer);
+        } catch (std::string &msg) {
+            std::cerr << "Fatal error: " << msg << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if (verbose) {
+            timings.dumpHistogram(name);
+        } else {
+            std::cout << name << " " << timings.getTotal() << " operations"
+                      << std::endl;
+        }
     }
 }
 
@@ -454,7 +509,8 @@ int main(int argc, char** argv) {
                       << " [-P pass] [-b bucket] [-s] -v [opcode / stat_name]*" << std::endl
                       << std::endl
                       << "Example:" << std::endl
-                      << "    mctimings -h localhost:11210 -v GET SET";
+                      << "    mctimings -h localhost:11210 -v GET SET" << std::endl
+                      << "    mctimings -h localhost:11210 -v latency_breakdown";
             exit(EXIT_FAILURE);
         }
     }
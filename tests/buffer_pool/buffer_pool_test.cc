@@ -0,0 +1,115 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+#include <daemon/buffer_pool.h>
+#include <gtest/gtest.h>
+
+#include <platform/cb_malloc.h>
+#include <vector>
+
+TEST(BufferPoolTest, ClassSize) {
+    EXPECT_EQ(2048u, BufferPool::getClassSize(1));
+    EXPECT_EQ(2048u, BufferPool::getClassSize(2048));
+    EXPECT_EQ(4096u, BufferPool::getClassSize(2049));
+    EXPECT_EQ(BufferPool::maxSize, BufferPool::getClassSize(BufferPool::maxSize));
+    EXPECT_EQ(0u, BufferPool::getClassSize(BufferPool::maxSize + 1));
+
+    EXPECT_EQ(0, BufferPool::getClassIndex(2048));
+    EXPECT_EQ(1, BufferPool::getClassIndex(4096));
+    EXPECT_EQ(-1, BufferPool::getClassIndex(3000));
+    EXPECT_EQ(int(BufferPool::numClasses) - 1,
+              BufferPool::getClassIndex(BufferPool::maxSize));
+}
+
+TEST(BufferPoolTest, AllocateRoundsUp) {
+    BufferPool pool;
+    bool hit;
+    size_t size = 3000;
+    char* buf = pool.allocate(size, hit);
+    ASSERT_NE(nullptr, buf);
+    EXPECT_FALSE(hit);
+    EXPECT_EQ(4096u, size);
+    pool.release(buf, size);
+}
+
+TEST(BufferPoolTest, ReuseBuffer) {
+    BufferPool pool;
+    bool hit;
+    size_t size = 2048;
+    char* buf = pool.allocate(size, hit);
+    EXPECT_FALSE(hit);
+    pool.release(buf, size);
+    EXPECT_EQ(2048u, pool.getCachedBytes());
+
+    // We should get the same buffer back
+    size = 100;
+    EXPECT_EQ(buf, pool.allocate(size, hit));
+    EXPECT_TRUE(hit);
+    EXPECT_EQ(2048u, size);
+    EXPECT_EQ(0u, pool.getCachedBytes());
+
+    // But not if we ask for another size class
+    size = 4096;
+    char* other = pool.allocate(size, hit);
+    EXPECT_FALSE(hit);
+
+    pool.release(buf, 2048);
+    pool.release(other, 4096);
+    EXPECT_EQ(2048u + 4096u, pool.getCachedBytes());
+}
+
+TEST(BufferPoolTest, HugeBuffersAreNotCached) {
+    BufferPool pool;
+    bool hit;
+    size_t size = BufferPool::maxSize * 2;
+    char* buf = pool.allocate(size, hit);
+    ASSERT_NE(nullptr, buf);
+    EXPECT_FALSE(hit);
+    EXPECT_EQ(BufferPool::maxSize * 2, size);
+    pool.release(buf, size);
+    EXPECT_EQ(0u, pool.getCachedBytes());
+
+    // A buffer not matching a size class is freed as well
+    pool.release(reinterpret_cast<char*>(cb_malloc(3000)), 3000);
+    EXPECT_EQ(0u, pool.getCachedBytes());
+}
+
+TEST(BufferPoolTest, Watermarks) {
+    BufferPool pool;
+    const size_t size = BufferPool::maxSize;
+    const size_t high = BufferPool::highWatermark / size;
+    const size_t low = BufferPool::lowWatermark / size;
+
+    std::vector<char*> buffers;
+    for (size_t ii = 0; ii < high + 1; ++ii) {
+        size_t sz = size;
+        bool hit;
+        buffers.push_back(pool.allocate(sz, hit));
+    }
+
+    // Fill the pool up to the high watermark
+    for (size_t ii = 0; ii < high; ++ii) {
+        pool.release(buffers[ii], size);
+    }
+    EXPECT_EQ(high * size, pool.getCachedBytes());
+
+    // The next release trims the pool down to the low watermark before
+    // adding the buffer
+    pool.release(buffers[high], size);
+    EXPECT_EQ((low + 1) * size, pool.getCachedBytes());
+}
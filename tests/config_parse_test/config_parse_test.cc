@@ -18,9 +18,13 @@
 #include <platform/platform.h>
 #include <gtest/gtest.h>
 #include <cJSON_utils.h>
+#include <daemon/cpu_topology.h>
 #include <daemon/settings.h>
 #include <platform/dirutils.h>
 
+#include <iostream>
+#include <thread>
+
 class SettingsTest : public ::testing::Test {
 public:
     /**
@@ -284,6 +288,24 @@ TEST_F(SettingsTest, Threads) {
     }
 }
 
+TEST_F(SettingsTest, ReplicationThreads) {
+    nonNumericValuesShouldFail("replication_threads");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "replication_threads", 2);
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(2, settings.getNumReplicationThreads());
+        EXPECT_TRUE(settings.has.replication_threads);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "replication_threads", -1);
+    expectFail(obj);
+}
+
 TEST_F(SettingsTest, Interfaces) {
     nonArrayValuesShouldFail("interfaces");
 
@@ -401,6 +423,108 @@ TEST_F(SettingsTest, InterfacesMissingSSLFiles) {
     cb::io::rmrf(key_pattern);
 }
 
+#ifndef WIN32
+TEST_F(SettingsTest, InterfacesUnixSocket) {
+    unique_cJSON_ptr array(cJSON_CreateArray());
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "port", 11209);
+    cJSON_AddStringToObject(obj.get(), "path", "/tmp/memcached.sock");
+    cJSON_AddStringToObject(obj.get(), "permissions", "0600");
+    cJSON_AddStringToObject(obj.get(), "owner", "couchbase");
+    cJSON_AddStringToObject(obj.get(), "group", "sidecar");
+    cJSON_AddItemToArray(array.get(), obj.release());
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "port", 11210);
+    cJSON_AddItemToArray(array.get(), obj.release());
+
+    unique_cJSON_ptr root(cJSON_CreateObject());
+    cJSON_AddItemToObject(root.get(), "interfaces", array.release());
+
+    try {
+        Settings settings(root);
+        ASSERT_EQ(2, settings.getInterfaces().size());
+
+        const auto& ifc0 = settings.getInterfaces()[0];
+        EXPECT_TRUE(ifc0.isUnixSocket());
+        EXPECT_EQ(11209, ifc0.port);
+        EXPECT_EQ("/tmp/memcached.sock", ifc0.path);
+        EXPECT_EQ(0600, ifc0.permissions);
+        EXPECT_EQ("couchbase", ifc0.owner);
+        EXPECT_EQ("sidecar", ifc0.group);
+
+        const auto& ifc1 = settings.getInterfaces()[1];
+        EXPECT_FALSE(ifc1.isUnixSocket());
+        EXPECT_EQ(0660, ifc1.permissions);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
+TEST_F(SettingsTest, InterfacesInvalidUnixSocket) {
+    // The port must be specified (it identifies the interface)
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddStringToObject(obj.get(), "path", "/tmp/memcached.sock");
+    EXPECT_THROW(interface ifc(obj.get()), std::invalid_argument);
+    cJSON_AddNumberToObject(obj.get(), "port", 0);
+    EXPECT_THROW(interface ifc(obj.get()), std::invalid_argument);
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "port", 11209);
+    cJSON_AddStringToObject(obj.get(), "path", "");
+    EXPECT_THROW(interface ifc(obj.get()), std::invalid_argument);
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "port", 11209);
+    cJSON_AddStringToObject(obj.get(), "path", std::string(200, 'a').c_str());
+    EXPECT_THROW(interface ifc(obj.get()), std::invalid_argument);
+
+    for (const auto& permissions : {"", "rw", "0999", "10000"}) {
+        obj.reset(cJSON_CreateObject());
+        cJSON_AddStringToObject(obj.get(), "permissions", permissions);
+        EXPECT_THROW(interface ifc(obj.get()), std::invalid_argument)
+            << permissions;
+    }
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "permissions", 660);
+    EXPECT_THROW(interface ifc(obj.get()), std::invalid_argument);
+
+    // The port can't be shared with a TCP interface
+    unique_cJSON_ptr array(cJSON_CreateArray());
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "port", 11210);
+    cJSON_AddItemToArray(array.get(), obj.release());
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "port", 11210);
+    cJSON_AddStringToObject(obj.get(), "path", "/tmp/memcached.sock");
+    cJSON_AddItemToArray(array.get(), obj.release());
+    unique_cJSON_ptr root(cJSON_CreateObject());
+    cJSON_AddItemToObject(root.get(), "interfaces", array.release());
+    expectFail(root);
+
+    // The operating system could pick the port of the unix domain socket
+    // for a TCP interface with port 0 (in either order)
+    for (const bool unixFirst : {true, false}) {
+        array.reset(cJSON_CreateArray());
+        unique_cJSON_ptr tcp(cJSON_CreateObject());
+        cJSON_AddNumberToObject(tcp.get(), "port", 0);
+        obj.reset(cJSON_CreateObject());
+        cJSON_AddNumberToObject(obj.get(), "port", 11209);
+        cJSON_AddStringToObject(obj.get(), "path", "/tmp/memcached.sock");
+        if (unixFirst) {
+            cJSON_AddItemToArray(array.get(), obj.release());
+            cJSON_AddItemToArray(array.get(), tcp.release());
+        } else {
+            cJSON_AddItemToArray(array.get(), tcp.release());
+            cJSON_AddItemToArray(array.get(), obj.release());
+        }
+        root.reset(cJSON_CreateObject());
+        cJSON_AddItemToObject(root.get(), "interfaces", array.release());
+        expectFail(root);
+    }
+}
+#endif
+
 TEST_F(SettingsTest, InterfacesInvalidSslEntry) {
     nonArrayValuesShouldFail("interfaces");
 
@@ -622,6 +746,20 @@ TEST_F(SettingsTest, ConnectionIdleTime) {
     }
 }
 
+TEST_F(SettingsTest, ConnectionCompactTime) {
+    nonNumericValuesShouldFail("connection_compact_time");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "connection_compact_time", 60);
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(60, settings.getConnectionCompactTime());
+        EXPECT_TRUE(settings.has.connection_compact_time);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
 TEST_F(SettingsTest, BioDrainBufferSize) {
     nonNumericValuesShouldFail("bio_drain_buffer_sz");
 
@@ -773,6 +911,115 @@ TEST_F(SettingsTest, Breakpad) {
     cb::io::rmrf(minidump_dir);
 }
 
+TEST_F(SettingsTest, CpuAffinity) {
+    nonObjectValuesShouldFail("cpu_affinity");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    // All of the attributes are optional
+    EXPECT_NO_THROW(CpuAffinitySettings settings(obj.get()));
+
+    cJSON_AddStringToObject(obj.get(), "dispatcher", "0");
+    cJSON_AddStringToObject(obj.get(), "workers", "2-5,8");
+    cJSON_AddTrueToObject(obj.get(), "numa_binding");
+    try {
+        CpuAffinitySettings settings(obj.get());
+        EXPECT_EQ(std::vector<int>({0}),
+                  settings.getCpus(ThreadClass::Dispatcher));
+        EXPECT_EQ(std::vector<int>({2, 3, 4, 5, 8}),
+                  settings.getCpus(ThreadClass::Workers));
+        EXPECT_TRUE(settings.getCpus(ThreadClass::Executors).empty());
+        EXPECT_TRUE(settings.isNumaBinding());
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    cJSON_ReplaceItemInObject(obj.get(), "workers", cJSON_CreateString("5-2"));
+    EXPECT_THROW(CpuAffinitySettings settings(obj.get()),
+                 std::invalid_argument);
+    cJSON_ReplaceItemInObject(obj.get(), "workers", cJSON_CreateNumber(2));
+    EXPECT_THROW(CpuAffinitySettings settings(obj.get()),
+                 std::invalid_argument);
+    cJSON_ReplaceItemInObject(obj.get(), "workers", cJSON_CreateString("2"));
+    cJSON_ReplaceItemInObject(obj.get(), "numa_binding",
+                              cJSON_CreateString("true"));
+    EXPECT_THROW(CpuAffinitySettings settings(obj.get()),
+                 std::invalid_argument);
+}
+
+TEST(CpuListTest, Parse) {
+    EXPECT_TRUE(cpu_list_parse("").empty());
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}),
+              cpu_list_parse("0-3,8,10-11\n"));
+    EXPECT_EQ(std::vector<int>({1, 2}), cpu_list_parse("2,1,2"));
+    EXPECT_THROW(cpu_list_parse("1,,2"), std::invalid_argument);
+    EXPECT_THROW(cpu_list_parse("a"), std::invalid_argument);
+    EXPECT_THROW(cpu_list_parse("-1"), std::invalid_argument);
+    EXPECT_THROW(cpu_list_parse("4096"), std::invalid_argument);
+}
+
+TEST(CpuListTest, ToString) {
+    EXPECT_EQ("", cpu_list_to_string({}));
+    EXPECT_EQ("0-3,8,10-11", cpu_list_to_string({0, 1, 2, 3, 8, 10, 11}));
+}
+
+TEST(CpuTopologyTest, ThreadCpus) {
+    CpuTopology topology({{0, {0, 1, 2, 3}}, {1, {4, 5, 6, 7}}});
+    int node;
+
+    // Without NUMA binding all threads use all of the configured CPUs
+    EXPECT_EQ(std::vector<int>({1, 5}),
+              topology.getThreadCpus({1, 5}, false, 1, node));
+    EXPECT_EQ(-1, node);
+
+    // With NUMA binding the threads are spread across the nodes
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3}),
+              topology.getThreadCpus({}, true, 0, node));
+    EXPECT_EQ(0, node);
+    EXPECT_EQ(std::vector<int>({5}),
+              topology.getThreadCpus({1, 5}, true, 3, node));
+    EXPECT_EQ(1, node);
+    EXPECT_EQ(1, topology.getNode(6));
+    EXPECT_EQ(-1, topology.getNode(8));
+}
+
+/**
+ * memcached binds the main thread to the background CPUs before it
+ * creates the other threads. A thread without any configured CPUs (ex:
+ * the workers) inherits that binding, and should be bound back to the
+ * CPUs the process was started with (and not to the inherited ones)
+ */
+TEST(CpuAffinityTest, UnconfiguredThreadsUseProcessCpus) {
+    cpu_affinity_capture_process();
+    const auto process = cpu_affinity_get_process();
+    if (process.size() < 2) {
+        std::cerr << "Note: skipping test; it needs at least two CPUs"
+                  << std::endl;
+        return;
+    }
+
+    CpuAffinitySettings affinity;
+    affinity.setCpus(ThreadClass::Background, {process.front()});
+    ASSERT_EQ(0, cpu_affinity_set_current_thread(
+                         affinity.getCpus(ThreadClass::Background)));
+
+    std::vector<int> inherited;
+    std::vector<int> bound;
+    int err = -1;
+    std::thread worker([&affinity, &inherited, &bound, &err]() {
+        inherited = cpu_affinity_get_current_thread();
+        err = cpu_affinity_set_current_thread(
+                affinity.getCpus(ThreadClass::Workers));
+        bound = cpu_affinity_get_current_thread();
+    });
+    worker.join();
+    EXPECT_EQ(0, cpu_affinity_set_current_thread({}));
+
+    EXPECT_EQ(std::vector<int>({process.front()}), inherited);
+    EXPECT_EQ(0, err);
+    EXPECT_EQ(process, bound);
+    EXPECT_EQ(process, cpu_affinity_get_current_thread());
+}
+
 TEST_F(SettingsTest, max_packet_size) {
     nonNumericValuesShouldFail("max_packet_size");
 
@@ -886,6 +1133,150 @@ TEST_F(SettingsTest, DedupeNmvbMaps) {
     }
 }
 
+TEST_F(SettingsTest, OffloadThreshold) {
+    nonNumericValuesShouldFail("offload_threshold");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "offload_threshold", 65536);
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(65536u, settings.getOffloadThreshold());
+        EXPECT_TRUE(settings.has.offload_threshold);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "offload_threshold", -1);
+    expectFail(obj);
+}
+
+TEST_F(SettingsTest, LatencyBreakdown) {
+    nonBooleanValuesShouldFail("latency_breakdown");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddTrueToObject(obj.get(), "latency_breakdown");
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isLatencyBreakdown());
+        EXPECT_TRUE(settings.has.latency_breakdown);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddFalseToObject(obj.get(), "latency_breakdown");
+    try {
+        Settings settings(obj);
+        EXPECT_FALSE(settings.isLatencyBreakdown());
+        EXPECT_TRUE(settings.has.latency_breakdown);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
+TEST_F(SettingsTest, SlowOpThreshold) {
+    nonNumericValuesShouldFail("slow_op_threshold");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "slow_op_threshold", 250);
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(250u, settings.getSlowOpThreshold());
+        EXPECT_TRUE(settings.has.slow_op_threshold);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "slow_op_threshold", -1);
+    expectFail(obj);
+}
+
+TEST_F(SettingsTest, SslKtls) {
+    nonBooleanValuesShouldFail("ssl_ktls");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddTrueToObject(obj.get(), "ssl_ktls");
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isSslKtls());
+        EXPECT_TRUE(settings.has.ssl_ktls);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddFalseToObject(obj.get(), "ssl_ktls");
+    try {
+        Settings settings(obj);
+        EXPECT_FALSE(settings.isSslKtls());
+        EXPECT_TRUE(settings.has.ssl_ktls);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
+TEST_F(SettingsTest, SslSessionCacheSize) {
+    nonNumericValuesShouldFail("ssl_session_cache_size");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "ssl_session_cache_size", 1000);
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(1000u, settings.getSslSessionCacheSize());
+        EXPECT_TRUE(settings.has.ssl_session_cache_size);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "ssl_session_cache_size", -1);
+    expectFail(obj);
+}
+
+TEST_F(SettingsTest, SslSessionTimeout) {
+    nonNumericValuesShouldFail("ssl_session_timeout");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "ssl_session_timeout", 300);
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(300u, settings.getSslSessionTimeout());
+        EXPECT_TRUE(settings.has.ssl_session_timeout);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "ssl_session_timeout", 0);
+    expectFail(obj);
+}
+
+TEST_F(SettingsTest, SslSessionTickets) {
+    nonBooleanValuesShouldFail("ssl_session_tickets");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddTrueToObject(obj.get(), "ssl_session_tickets");
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isSslSessionTickets());
+        EXPECT_TRUE(settings.has.ssl_session_tickets);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddFalseToObject(obj.get(), "ssl_session_tickets");
+    try {
+        Settings settings(obj);
+        EXPECT_FALSE(settings.isSslSessionTickets());
+        EXPECT_TRUE(settings.has.ssl_session_tickets);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
 TEST(SettingsUpdateTest, EmptySettingsShouldWork) {
     Settings updated;
     Settings settings;
@@ -966,6 +1357,23 @@ TEST(SettingsUpdateTest, AuditFileIsNotDynamic) {
                  std::invalid_argument);
 }
 
+TEST(SettingsUpdateTest, CpuAffinityIsNotDynamic) {
+    Settings updated;
+    Settings settings;
+    CpuAffinitySettings affinity;
+    affinity.setCpus(ThreadClass::Workers, {0, 1});
+    // setting it to the same value should work
+    settings.setCpuAffinity(affinity);
+    updated.setCpuAffinity(affinity);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should fail
+    affinity.setNumaBinding(true);
+    updated.setCpuAffinity(affinity);
+    EXPECT_THROW(settings.updateSettings(updated, false),
+                 std::invalid_argument);
+}
+
 TEST(SettingsUpdateTest, ThreadsIsNotDynamic) {
     Settings updated;
     Settings settings;
@@ -980,6 +1388,20 @@ TEST(SettingsUpdateTest, ThreadsIsNotDynamic) {
                  std::invalid_argument);
 }
 
+TEST(SettingsUpdateTest, ReplicationThreadsIsNotDynamic) {
+    Settings updated;
+    Settings settings;
+    // setting it to the same value should work
+    settings.setNumReplicationThreads(2);
+    updated.setNumReplicationThreads(settings.getNumReplicationThreads());
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should fail
+    updated.setNumReplicationThreads(0);
+    EXPECT_THROW(settings.updateSettings(updated, false),
+                 std::invalid_argument);
+}
+
 TEST(SettingsUpdateTest, InterfaceIdenticalArraysShouldWork) {
     Settings updated;
     Settings settings;
@@ -1097,6 +1519,16 @@ TEST(SettingsUpdateTest, InterfaceSomeValuesMayNotChange) {
         EXPECT_THROW(settings.updateSettings(updated, false),
                      std::invalid_argument);
     }
+
+    {
+        Settings updated;
+        interface myifc;
+        myifc.path.assign("/tmp/memcached.sock");
+        updated.addInterface(myifc);
+
+        EXPECT_THROW(settings.updateSettings(updated, false),
+                     std::invalid_argument);
+    }
 }
 
 TEST(SettingsUpdateTest, InterfaceDifferentArraySizeShouldFail) {
@@ -1454,3 +1886,115 @@ TEST(SettingsUpdateTest, DedupeNmvbMapsIsDynamic) {
     EXPECT_NO_THROW(settings.updateSettings(updated, true));
     EXPECT_FALSE(settings.isDedupeNmvbMaps());
 }
+
+TEST(SettingsUpdateTest, OffloadThresholdIsDynamic) {
+    Settings settings;
+    Settings updated;
+    // setting it to the same value should work
+    settings.setOffloadThreshold(1024);
+    updated.setOffloadThreshold(settings.getOffloadThreshold());
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should also work
+    updated.setOffloadThreshold(0);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_EQ(1024u, settings.getOffloadThreshold());
+    EXPECT_NO_THROW(settings.updateSettings(updated, true));
+    EXPECT_EQ(0u, settings.getOffloadThreshold());
+}
+
+TEST(SettingsUpdateTest, LatencyBreakdownIsDynamic) {
+    Settings settings;
+    Settings updated;
+    // setting it to the same value should work
+    settings.setLatencyBreakdown(false);
+    updated.setLatencyBreakdown(settings.isLatencyBreakdown());
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should also work
+    updated.setLatencyBreakdown(true);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_FALSE(settings.isLatencyBreakdown());
+    EXPECT_NO_THROW(settings.updateSettings(updated, true));
+    EXPECT_TRUE(settings.isLatencyBreakdown());
+}
+
+TEST(SettingsUpdateTest, SlowOpThresholdIsDynamic) {
+    Settings settings;
+    Settings updated;
+    // setting it to the same value should work
+    settings.setSlowOpThreshold(100);
+    updated.setSlowOpThreshold(settings.getSlowOpThreshold());
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should also work
+    updated.setSlowOpThreshold(0);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_EQ(100u, settings.getSlowOpThreshold());
+    EXPECT_NO_THROW(settings.updateSettings(updated, true));
+    EXPECT_EQ(0u, settings.getSlowOpThreshold());
+}
+
+TEST(SettingsUpdateTest, SslKtlsIsDynamic) {
+    Settings settings;
+    Settings updated;
+    // setting it to the same value should work
+    settings.setSslKtls(true);
+    updated.setSslKtls(settings.isSslKtls());
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should also work
+    updated.setSslKtls(false);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_TRUE(settings.isSslKtls());
+    EXPECT_NO_THROW(settings.updateSettings(updated, true));
+    EXPECT_FALSE(settings.isSslKtls());
+}
+
+TEST(SettingsUpdateTest, SslSessionCacheSizeIsDynamic) {
+    Settings settings;
+    Settings updated;
+    // setting it to the same value should work
+    settings.setSslSessionCacheSize(1000);
+    updated.setSslSessionCacheSize(settings.getSslSessionCacheSize());
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should also work
+    updated.setSslSessionCacheSize(0);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_EQ(1000u, settings.getSslSessionCacheSize());
+    EXPECT_NO_THROW(settings.updateSettings(updated, true));
+    EXPECT_EQ(0u, settings.getSslSessionCacheSize());
+}
+
+TEST(SettingsUpdateTest, SslSessionTimeoutIsDynamic) {
+    Settings settings;
+    Settings updated;
+    // setting it to the same value should work
+    settings.setSslSessionTimeout(300);
+    updated.setSslSessionTimeout(settings.getSslSessionTimeout());
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should also work
+    updated.setSslSessionTimeout(60);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_EQ(300u, settings.getSslSessionTimeout());
+    EXPECT_NO_THROW(settings.updateSettings(updated, true));
+    EXPECT_EQ(60u, settings.getSslSessionTimeout());
+}
+
+TEST(SettingsUpdateTest, SslSessionTicketsIsDynamic) {
+    Settings settings;
+    Settings updated;
+    // setting it to the same value should work
+    settings.setSslSessionTickets(true);
+    updated.setSslSessionTickets(settings.isSslSessionTickets());
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should also work
+    updated.setSslSessionTickets(false);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_TRUE(settings.isSslSessionTickets());
+    EXPECT_NO_THROW(settings.updateSettings(updated, true));
+    EXPECT_FALSE(settings.isSslSessionTickets());
+}
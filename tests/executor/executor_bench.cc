@@ -0,0 +1,134 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Microbenchmark for the executor pool measuring the throughput of small
+ * tasks and the time they wait for an executor, with and without a slow
+ * task occupying one of the executors.
+ */
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <daemon/executorpool.h>
+#include <daemon/task.h>
+#include <future>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const size_t tasks = 100000;
+
+/**
+ * The task used to occupy an executor (simulating a slow SASL
+ * authentication or bucket creation)
+ */
+class SlowTask : public Task {
+public:
+    SlowTask(std::shared_future<void> gate_)
+        : gate(gate_) {
+    }
+
+    virtual bool execute() override {
+        gate.wait();
+        return true;
+    }
+
+    std::shared_future<void> gate;
+};
+
+/**
+ * A task which just counts the number of times it was executed
+ */
+class CountingTask : public Task {
+public:
+    CountingTask(std::atomic<size_t>& counter_)
+        : counter(counter_) {
+    }
+
+    virtual bool execute() override {
+        ++counter;
+        return true;
+    }
+
+    virtual const char* getName() const override {
+        return "counting";
+    }
+
+    std::atomic<size_t>& counter;
+};
+
+class ExecutorBench : public ::testing::TestWithParam<bool> {
+protected:
+    void SetUp() override {
+        executorpool.reset(new ExecutorPool(4));
+        gate = std::shared_future<void>(release.get_future());
+        if (GetParam()) {
+            std::shared_ptr<Task> task = std::make_shared<SlowTask>(gate);
+            std::lock_guard<std::mutex> guard(task->getMutex());
+            executorpool->schedule(task);
+        }
+    }
+
+    void TearDown() override {
+        release.set_value();
+        executorpool.reset();
+    }
+
+    std::unique_ptr<ExecutorPool> executorpool;
+    std::promise<void> release;
+    std::shared_future<void> gate;
+};
+
+TEST_P(ExecutorBench, Throughput) {
+    std::atomic<size_t> counter(0);
+    std::vector<std::shared_ptr<Task>> list;
+    list.reserve(tasks);
+    for (size_t ii = 0; ii < tasks; ++ii) {
+        list.emplace_back(std::make_shared<CountingTask>(counter));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (auto& task : list) {
+        std::lock_guard<std::mutex> guard(task->getMutex());
+        executorpool->schedule(task);
+    }
+
+    const auto deadline = start + std::chrono::seconds(60);
+    while (counter < tasks && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    const auto duration = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(tasks, counter);
+
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        duration).count();
+    auto stats = executorpool->getTaskStats()["counting"];
+    std::cout << "    " << (GetParam() ? "with" : "without")
+              << " a slow task: " << double(ns) / tasks << " ns/task, "
+              << executorpool->getStolenTasks() << " tasks stolen"
+              << std::endl
+              << "    wait times: " << stats.waitTimes.to_string()
+              << std::endl;
+}
+
+INSTANTIATE_TEST_CASE_P(SlowTask,
+                        ExecutorBench,
+                        ::testing::Bool());
@@ -15,11 +15,14 @@
  *   limitations under the License.
  */
 #include <atomic>
+#include <chrono>
 #include <daemon/executorpool.h>
 #include <daemon/task.h>
+#include <future>
 #include <gtest/gtest.h>
 #include <memory>
 #include <platform/backtrace.h>
+#include <vector>
 
 class ExecutorTest : public ::testing::Test {
 protected:
@@ -130,6 +133,191 @@ TEST_F(ExecutorTest, RescheduleMissingLock) {
     EXPECT_TRUE(cmd->executionComplete);
 }
 
+/**
+ * A task which blocks the executor running it until the gate is opened
+ */
+class BlockingTask : public Task {
+public:
+    BlockingTask(std::shared_future<void> gate_)
+        : gate(gate_) {
+    }
+
+    virtual bool execute() override {
+        started.set_value();
+        gate.wait();
+        return true;
+    }
+
+    std::shared_future<void> gate;
+    std::promise<void> started;
+};
+
+/**
+ * A task which records its id in a shared list when it is run
+ */
+class RecordingTask : public Task {
+public:
+    RecordingTask(int id_, std::mutex& mutex_, std::condition_variable& cond_,
+                  std::vector<int>& executed_)
+        : id(id_),
+          mutex(mutex_),
+          cond(cond_),
+          executed(executed_) {
+    }
+
+    virtual bool execute() override {
+        std::lock_guard<std::mutex> guard(mutex);
+        executed.push_back(id);
+        cond.notify_all();
+        return true;
+    }
+
+    virtual const char* getName() const override {
+        return "recording";
+    }
+
+    int id;
+    std::mutex& mutex;
+    std::condition_variable& cond;
+    std::vector<int>& executed;
+};
+
+/**
+ * Test fixture running tasks which needs to observe the order they
+ * were executed in
+ */
+class ExecutorSchedulingTest : public ::testing::Test {
+protected:
+    void SetUp() {
+        gate = std::shared_future<void>(release.get_future());
+    }
+
+    void TearDown() {
+        open();
+        executorpool.reset();
+    }
+
+    void createPool(size_t size) {
+        executorpool.reset(new ExecutorPool(size));
+    }
+
+    /**
+     * Occupy one of the executors until the gate is opened
+     */
+    void block() {
+        auto* cmd = new BlockingTask(gate);
+        auto started = cmd->started.get_future();
+        std::shared_ptr<Task> task(cmd);
+        {
+            std::lock_guard<std::mutex> guard(task->getMutex());
+            executorpool->schedule(task);
+        }
+        started.wait();
+    }
+
+    void open() {
+        if (!opened) {
+            opened = true;
+            release.set_value();
+        }
+    }
+
+    std::shared_ptr<Task> schedule(int id, Task::Priority priority) {
+        std::shared_ptr<Task> task = std::make_shared<RecordingTask>(
+            id, mutex, cond, executed);
+        task->setPriority(priority);
+        std::lock_guard<std::mutex> guard(task->getMutex());
+        executorpool->schedule(task);
+        return task;
+    }
+
+    bool waitFor(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return cond.wait_for(lock, std::chrono::seconds(30), [this, count]() {
+            return executed.size() >= count;
+        });
+    }
+
+    std::unique_ptr<ExecutorPool> executorpool;
+    std::promise<void> release;
+    std::shared_future<void> gate;
+    bool opened = false;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<int> executed;
+};
+
+TEST_F(ExecutorSchedulingTest, Priorities) {
+    createPool(1);
+    block();
+
+    schedule(3, Task::Priority::Low);
+    schedule(2, Task::Priority::Medium);
+    schedule(1, Task::Priority::High);
+    schedule(4, Task::Priority::Low);
+
+    open();
+    ASSERT_TRUE(waitFor(4));
+    EXPECT_EQ(std::vector<int>({1, 2, 3, 4}), executed);
+}
+
+TEST_F(ExecutorSchedulingTest, WorkStealing) {
+    createPool(4);
+    block();
+
+    // The tasks are distributed round robin, so some of them are queued
+    // behind the blocked task and must be stolen by the idle executors
+    for (int ii = 0; ii < 16; ++ii) {
+        schedule(ii, Task::Priority::Medium);
+    }
+
+    ASSERT_TRUE(waitFor(16));
+    EXPECT_LT(0u, executorpool->getStolenTasks());
+    open();
+}
+
+TEST_F(ExecutorSchedulingTest, ScheduleAfter) {
+    createPool(2);
+
+    std::shared_ptr<Task> task = std::make_shared<RecordingTask>(
+        1, mutex, cond, executed);
+    const auto start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> guard(task->getMutex());
+        executorpool->scheduleAfter(task, std::chrono::milliseconds(50));
+    }
+
+    ASSERT_TRUE(waitFor(1));
+    EXPECT_LE(std::chrono::milliseconds(50),
+              std::chrono::steady_clock::now() - start);
+}
+
+TEST_F(ExecutorSchedulingTest, ScheduleAfterMissingLock) {
+    createPool(1);
+    std::shared_ptr<Task> task = std::make_shared<RecordingTask>(
+        1, mutex, cond, executed);
+    EXPECT_THROW(executorpool->scheduleAfter(task,
+                                             std::chrono::milliseconds(1)),
+                 std::logic_error);
+}
+
+TEST_F(ExecutorSchedulingTest, TaskStats) {
+    createPool(2);
+    for (int ii = 0; ii < 10; ++ii) {
+        schedule(ii, Task::Priority::Medium);
+    }
+    ASSERT_TRUE(waitFor(10));
+
+    // The stats are updated before the task is executed
+    auto stats = executorpool->getTaskStats();
+    ASSERT_NE(stats.end(), stats.find("recording"));
+    auto& recording = stats["recording"];
+    EXPECT_EQ(10u, recording.scheduled);
+    EXPECT_EQ(0u, recording.queued);
+    EXPECT_EQ(10u, recording.waitTimes.get_total());
+}
+
 static std::terminate_handler default_terminate_handler;
 
 static void my_terminate_handler() {
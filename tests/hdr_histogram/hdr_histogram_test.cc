@@ -0,0 +1,150 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <cJSON_utils.h>
+#include <daemon/hdr_histogram.h>
+#include <daemon/timings.h>
+#include <gtest/gtest.h>
+#include <memcached/protocol_binary.h>
+
+TEST(HdrHistogramTest, Empty) {
+    HdrHistogram histogram;
+    EXPECT_EQ(0u, histogram.getTotal());
+    EXPECT_EQ(0u, histogram.getMax());
+    EXPECT_EQ(0u, histogram.getValueAtPercentile(50.0));
+}
+
+TEST(HdrHistogramTest, BucketBounds) {
+    // The small values are recorded exactly
+    for (hrtime_t ii = 0; ii < HdrHistogram::SubBucketCount; ++ii) {
+        const auto index = HdrHistogram::getIndex(ii);
+        EXPECT_EQ(ii, HdrHistogram::getLowestValue(index));
+        EXPECT_EQ(ii, HdrHistogram::getHighestValue(index));
+    }
+
+    // The buckets are contiguous, and each value belongs to the bucket
+    // covering it
+    for (size_t ii = 1; ii < HdrHistogram::NumBuckets; ++ii) {
+        EXPECT_EQ(HdrHistogram::getHighestValue(ii - 1) + 1,
+                  HdrHistogram::getLowestValue(ii));
+    }
+
+    for (hrtime_t value : {hrtime_t(64), hrtime_t(1000), hrtime_t(123456),
+                           hrtime_t(999999999)}) {
+        const auto index = HdrHistogram::getIndex(value);
+        EXPECT_LE(HdrHistogram::getLowestValue(index), value);
+        EXPECT_GE(HdrHistogram::getHighestValue(index), value);
+        // Within ~3%
+        EXPECT_LE(HdrHistogram::getHighestValue(index) -
+                          HdrHistogram::getLowestValue(index),
+                  value / 32);
+    }
+
+    // Values out of the range end up in the last bucket
+    EXPECT_EQ(HdrHistogram::NumBuckets - 1,
+              HdrHistogram::getIndex(hrtime_t(1) << 40));
+}
+
+TEST(HdrHistogramTest, Percentiles) {
+    HdrHistogram histogram;
+    for (hrtime_t ii = 1; ii <= 1000; ++ii) {
+        histogram.add(ii * 1000);
+    }
+    EXPECT_EQ(1000u, histogram.getTotal());
+    EXPECT_EQ(1000000u, histogram.getMax());
+
+    const auto p50 = histogram.getValueAtPercentile(50.0);
+    EXPECT_GE(p50, 500000u);
+    EXPECT_LE(p50, 500000u + 500000u / 32);
+
+    const auto p99 = histogram.getValueAtPercentile(99.0);
+    EXPECT_GE(p99, 990000u);
+    EXPECT_LE(p99, 990000u + 990000u / 32);
+
+    // Never report a value above the max
+    EXPECT_EQ(1000000u, histogram.getValueAtPercentile(100.0));
+}
+
+TEST(HdrHistogramTest, Merge) {
+    HdrHistogram a;
+    HdrHistogram b;
+    a.add(10);
+    b.add(20);
+    b.add(30000);
+    a += b;
+    EXPECT_EQ(3u, a.getTotal());
+    EXPECT_EQ(30000u, a.getMax());
+    EXPECT_EQ(10u, a.getValueAtPercentile(1.0));
+
+    uint64_t count = 0;
+    a.forEachBucket([&count](hrtime_t, hrtime_t, uint64_t c) { count += c; });
+    EXPECT_EQ(3u, count);
+
+    a.reset();
+    EXPECT_EQ(0u, a.getTotal());
+    EXPECT_EQ(0u, a.getMax());
+}
+
+TEST(TimingsTest, MergeShards) {
+    Timings timings;
+    for (size_t thread = 0; thread < Timings::NumShards * 2; ++thread) {
+        timings.collect(PROTOCOL_BINARY_CMD_GET, 1000 * (thread + 1), thread);
+    }
+
+    const auto histogram = timings.get_histogram(PROTOCOL_BINARY_CMD_GET);
+    EXPECT_EQ(Timings::NumShards * 2, histogram.getTotal());
+    EXPECT_EQ(1000u * Timings::NumShards * 2, histogram.getMax());
+    EXPECT_EQ(Timings::NumShards * 2,
+              timings.get_aggregated_retrival_stats());
+    EXPECT_EQ(0u, timings.get_aggregated_mutation_stats());
+
+    timings.reset();
+    EXPECT_EQ(0u, timings.get_histogram(PROTOCOL_BINARY_CMD_GET).getTotal());
+}
+
+TEST(TimingsTest, Generate) {
+    Timings timings;
+    timings.collect(PROTOCOL_BINARY_CMD_SET, 500);
+    timings.collect(PROTOCOL_BINARY_CMD_SET, 15000);
+
+    unique_cJSON_ptr json(
+            cJSON_Parse(timings.generate(PROTOCOL_BINARY_CMD_SET).c_str()));
+    ASSERT_NE(nullptr, json.get());
+    // The legacy histogram is still reported
+    EXPECT_EQ(1, cJSON_GetObjectItem(json.get(), "ns")->valueint);
+    auto* us = cJSON_GetObjectItem(json.get(), "us");
+    ASSERT_NE(nullptr, us);
+    EXPECT_EQ(1, cJSON_GetArrayItem(us, 1)->valueint);
+
+    // The percentiles are reported as the upper bound of the bucket
+    const auto p50 = cJSON_GetObjectItem(json.get(), "p50")->valueint;
+    EXPECT_LE(500, p50);
+    EXPECT_GE(500 + 500 / 32, p50);
+    EXPECT_EQ(15000, cJSON_GetObjectItem(json.get(), "max")->valueint);
+    EXPECT_NE(nullptr, cJSON_GetObjectItem(json.get(), "p99.9"));
+}
+
+TEST(TimingsTest, Assign) {
+    Timings a;
+    Timings b;
+    a.collect(PROTOCOL_BINARY_CMD_GET, 100, 3);
+    a.collect(PROTOCOL_BINARY_CMD_GET, 200, 4);
+    b.collect(PROTOCOL_BINARY_CMD_SET, 100, 5);
+    b = a;
+    EXPECT_EQ(2u, b.get_histogram(PROTOCOL_BINARY_CMD_GET).getTotal());
+    EXPECT_EQ(0u, b.get_histogram(PROTOCOL_BINARY_CMD_SET).getTotal());
+}
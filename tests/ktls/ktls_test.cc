@@ -0,0 +1,73 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <daemon/ktls.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <vector>
+
+static std::string to_hex(const std::vector<uint8_t>& data) {
+    std::string ret;
+    char buffer[3];
+    for (const auto& c : data) {
+        snprintf(buffer, sizeof(buffer), "%02x", c);
+        ret.append(buffer);
+    }
+    return ret;
+}
+
+/**
+ * The commonly used test vector for the TLS 1.2 PRF with SHA256
+ */
+TEST(Tls12PrfTest, Sha256) {
+    const uint8_t secret[] = {0x9b, 0xbe, 0x43, 0x6b, 0xa9, 0x40, 0xf0, 0x17,
+                              0xb1, 0x76, 0x52, 0x84, 0x9a, 0x71, 0xdb, 0x35};
+    const uint8_t seed[] = {0xa0, 0xba, 0x9f, 0x93, 0x6c, 0xda, 0x31, 0x18,
+                            0x27, 0xa6, 0xf7, 0x96, 0xff, 0xd5, 0x19, 0x8c};
+
+    std::vector<uint8_t> out(100);
+    ASSERT_TRUE(tls12_prf(EVP_sha256(),
+                          secret,
+                          sizeof(secret),
+                          "test label",
+                          seed,
+                          sizeof(seed),
+                          out.data(),
+                          out.size()));
+    EXPECT_EQ(
+            "e3f229ba727be17b8d122620557cd453c2aab21d07c3d495329b52d4e61edb5a"
+            "6b301791e90d35c9c9a46b4e14baf9af0fa022f7077def17abfd3797c0564bab"
+            "4fbc91666e9def9b97fce34f796789baa48082d122ee42c5a72e5a5110fff701"
+            "87347b66",
+            to_hex(out));
+}
+
+TEST(Tls12PrfTest, PartialBlock) {
+    // The output is the prefix of the longer output when the requested
+    // length isn't a multiple of the digest size
+    const uint8_t secret[] = {1, 2, 3, 4};
+    const uint8_t seed[] = {5, 6, 7, 8};
+    std::vector<uint8_t> full(64);
+    std::vector<uint8_t> partial(40);
+    ASSERT_TRUE(tls12_prf(EVP_sha256(), secret, sizeof(secret), "key expansion",
+                          seed, sizeof(seed), full.data(), full.size()));
+    ASSERT_TRUE(tls12_prf(EVP_sha256(), secret, sizeof(secret), "key expansion",
+                          seed, sizeof(seed), partial.data(), partial.size()));
+    full.resize(partial.size());
+    EXPECT_EQ(to_hex(full), to_hex(partial));
+}
@@ -0,0 +1,105 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <daemon/latency_breakdown.h>
+#include <daemon/timings.h>
+#include <gtest/gtest.h>
+
+using Phase = LatencyBreakdown::Phase;
+
+TEST(LatencyBreakdownTest, Inactive) {
+    LatencyBreakdown latency;
+    EXPECT_FALSE(latency.isActive());
+    EXPECT_FALSE(latency.isExecuted());
+    latency.start(100);
+    EXPECT_TRUE(latency.isActive());
+    latency.reset();
+    EXPECT_FALSE(latency.isActive());
+}
+
+TEST(LatencyBreakdownTest, Simple) {
+    LatencyBreakdown latency;
+    latency.start(100);
+    latency.enterEngine(150);
+    latency.exitEngine(400);
+    EXPECT_TRUE(latency.isExecuted());
+    latency.written(1000);
+
+    EXPECT_EQ(50u, latency.getDuration(Phase::Queue));
+    EXPECT_EQ(250u, latency.getDuration(Phase::Engine));
+    EXPECT_EQ(0u, latency.getDuration(Phase::Ewouldblock));
+    EXPECT_EQ(600u, latency.getDuration(Phase::Send));
+}
+
+TEST(LatencyBreakdownTest, Ewouldblock) {
+    LatencyBreakdown latency;
+    latency.start(100);
+    latency.enterEngine(100);
+    latency.exitEngine(200);
+    // The engine notifies us 1000ns later, and the worker thread
+    // runs the command 100ns after that
+    latency.notify(1200);
+    latency.enterEngine(1300);
+    latency.exitEngine(1350);
+    latency.written(1400);
+
+    EXPECT_EQ(100u, latency.getDuration(Phase::Queue));
+    EXPECT_EQ(150u, latency.getDuration(Phase::Engine));
+    EXPECT_EQ(1000u, latency.getDuration(Phase::Ewouldblock));
+    EXPECT_EQ(50u, latency.getDuration(Phase::Send));
+}
+
+TEST(LatencyBreakdownTest, NotifiedBeforeEngineReturns) {
+    LatencyBreakdown latency;
+    latency.start(100);
+    latency.enterEngine(100);
+    latency.notify(150);
+    latency.exitEngine(200);
+    latency.enterEngine(250);
+    latency.exitEngine(300);
+
+    EXPECT_EQ(50u, latency.getDuration(Phase::Queue));
+    EXPECT_EQ(150u, latency.getDuration(Phase::Engine));
+    EXPECT_EQ(0u, latency.getDuration(Phase::Ewouldblock));
+}
+
+TEST(LatencyBreakdownTest, PhaseNames) {
+    EXPECT_STREQ("queue", LatencyBreakdown::to_string(Phase::Queue));
+    EXPECT_STREQ("engine", LatencyBreakdown::to_string(Phase::Engine));
+    EXPECT_STREQ("ewouldblock",
+                 LatencyBreakdown::to_string(Phase::Ewouldblock));
+    EXPECT_STREQ("send", LatencyBreakdown::to_string(Phase::Send));
+}
+
+TEST(TimingsTest, Phases) {
+    Timings timings;
+    timings.collect_phase(Phase::Engine, 1000, 1);
+    timings.collect_phase(Phase::Engine, 2000, 2);
+    timings.collect_phase(Phase::Send, 500);
+
+    EXPECT_EQ(2u, timings.get_phase_histogram(Phase::Engine).getTotal());
+    EXPECT_EQ(2000u, timings.get_phase_histogram(Phase::Engine).getMax());
+    EXPECT_EQ(1u, timings.get_phase_histogram(Phase::Send).getTotal());
+    EXPECT_EQ(0u, timings.get_phase_histogram(Phase::Queue).getTotal());
+
+    // The phases don't show up as command timings
+    EXPECT_EQ(0u, timings.get_aggregated_retrival_stats());
+    EXPECT_EQ(0u, timings.get_aggregated_mutation_stats());
+
+    timings.reset();
+    EXPECT_EQ(0u, timings.get_phase_histogram(Phase::Engine).getTotal());
+}
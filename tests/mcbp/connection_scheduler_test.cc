@@ -0,0 +1,173 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <daemon/connection_mcbp.h>
+#include <daemon/connection_scheduler.h>
+#include <event2/event.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+/**
+ * Test the deficit round robin scheduling of the ready connections
+ */
+class ConnectionSchedulerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        base = event_base_new();
+    }
+
+    void TearDown() override {
+        connections.clear();
+        event_base_free(base);
+    }
+
+    Connection& createConnection(Connection::Priority priority) {
+        connections.emplace_back(new McbpConnection(-1, base));
+        connections.back()->setPriority(priority);
+        return *connections.back();
+    }
+
+    /**
+     * Create a runner which records the connections it runs, and spends
+     * the given amount of time for each of them
+     */
+    ConnectionScheduler::Runner createRunner(hrtime_t cost) {
+        return [this, cost](Connection& c, short which) {
+            executed.push_back(&c);
+            events.push_back(which);
+            const auto start = gethrtime();
+            while (gethrtime() - start < cost) {
+                // busy wait
+            }
+        };
+    }
+
+    event_base* base;
+    std::vector<std::unique_ptr<McbpConnection>> connections;
+    std::vector<Connection*> executed;
+    std::vector<short> events;
+    ConnectionScheduler scheduler;
+};
+
+TEST_F(ConnectionSchedulerTest, ScheduleMergesEvents) {
+    auto& c = createConnection(Connection::Priority::Medium);
+    EXPECT_TRUE(scheduler.empty());
+    EXPECT_TRUE(scheduler.schedule(c, EV_READ, gethrtime()));
+    EXPECT_FALSE(scheduler.schedule(c, EV_WRITE, gethrtime()));
+    EXPECT_FALSE(scheduler.empty());
+    EXPECT_EQ(1u, scheduler.getQueueLength(Connection::Priority::Medium));
+
+    EXPECT_FALSE(scheduler.runRound(createRunner(0)));
+    ASSERT_EQ(1u, executed.size());
+    EXPECT_EQ(&c, executed.front());
+    EXPECT_EQ(EV_READ | EV_WRITE, events.front());
+    EXPECT_EQ(0, c.getScheduledEvents());
+    EXPECT_TRUE(scheduler.empty());
+}
+
+TEST_F(ConnectionSchedulerTest, Remove) {
+    auto& c1 = createConnection(Connection::Priority::Low);
+    auto& c2 = createConnection(Connection::Priority::Low);
+    scheduler.schedule(c1, EV_READ, gethrtime());
+    scheduler.schedule(c2, EV_READ, gethrtime());
+
+    // The priority may change while the connection is scheduled
+    c1.setPriority(Connection::Priority::High);
+    scheduler.remove(c1);
+    EXPECT_EQ(0, c1.getScheduledEvents());
+    EXPECT_EQ(1u, scheduler.getQueueLength(Connection::Priority::Low));
+
+    // Removing a connection which isn't scheduled is a noop
+    scheduler.remove(c1);
+
+    scheduler.runRound(createRunner(0));
+    ASSERT_EQ(1u, executed.size());
+    EXPECT_EQ(&c2, executed.front());
+}
+
+TEST_F(ConnectionSchedulerTest, HigherPriorityRunsFirst) {
+    auto& low = createConnection(Connection::Priority::Low);
+    auto& medium = createConnection(Connection::Priority::Medium);
+    auto& high = createConnection(Connection::Priority::High);
+    scheduler.schedule(low, EV_READ, gethrtime());
+    scheduler.schedule(medium, EV_READ, gethrtime());
+    scheduler.schedule(high, EV_READ, gethrtime());
+
+    EXPECT_FALSE(scheduler.runRound(createRunner(0)));
+    ASSERT_EQ(3u, executed.size());
+    EXPECT_EQ(&high, executed[0]);
+    EXPECT_EQ(&medium, executed[1]);
+    EXPECT_EQ(&low, executed[2]);
+}
+
+TEST_F(ConnectionSchedulerTest, ExpensiveClassYields) {
+    // Each of the low priority connections use more than the quantum for
+    // the class, so only one of them may run every round (and it'll have
+    // to wait a round to pay back the deficit)
+    const auto cost = ConnectionScheduler::baseQuantum * 3;
+    for (int ii = 0; ii < 3; ++ii) {
+        scheduler.schedule(createConnection(Connection::Priority::Low),
+                           EV_READ, gethrtime());
+    }
+    auto& high = createConnection(Connection::Priority::High);
+
+    EXPECT_TRUE(scheduler.runRound(createRunner(cost)));
+    EXPECT_EQ(1u, executed.size());
+    EXPECT_GT(0, scheduler.getDeficit(Connection::Priority::Low));
+
+    // The interactive connection gets to run before the next low priority
+    // connection even if it was scheduled later
+    scheduler.schedule(high, EV_READ, gethrtime());
+    executed.clear();
+    EXPECT_TRUE(scheduler.runRound(createRunner(0)));
+    ASSERT_EQ(1u, executed.size());
+    EXPECT_EQ(&high, executed.front());
+
+    // Running the rest of the rounds should drain the queue
+    int rounds = 0;
+    while (scheduler.runRound(createRunner(0))) {
+        ASSERT_LT(++rounds, 10);
+    }
+    EXPECT_TRUE(scheduler.empty());
+    EXPECT_EQ(0, scheduler.getDeficit(Connection::Priority::Low));
+}
+
+TEST_F(ConnectionSchedulerTest, QueueTimes) {
+    scheduler.schedule(createConnection(Connection::Priority::High),
+                       EV_READ, gethrtime());
+    scheduler.schedule(createConnection(Connection::Priority::High),
+                       EV_READ, gethrtime());
+    scheduler.schedule(createConnection(Connection::Priority::Low),
+                       EV_READ, gethrtime());
+    scheduler.runRound(createRunner(0));
+
+    TimingHistogram high(scheduler.getQueueTimes(Connection::Priority::High));
+    TimingHistogram medium(
+        scheduler.getQueueTimes(Connection::Priority::Medium));
+    TimingHistogram low(scheduler.getQueueTimes(Connection::Priority::Low));
+    EXPECT_EQ(2u, high.get_total());
+    EXPECT_EQ(0u, medium.get_total());
+    EXPECT_EQ(1u, low.get_total());
+}
+
+TEST_F(ConnectionSchedulerTest, Weights) {
+    EXPECT_GT(ConnectionScheduler::getWeight(Connection::Priority::High),
+              ConnectionScheduler::getWeight(Connection::Priority::Medium));
+    EXPECT_GT(ConnectionScheduler::getWeight(Connection::Priority::Medium),
+              ConnectionScheduler::getWeight(Connection::Priority::Low));
+}
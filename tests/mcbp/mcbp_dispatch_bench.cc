@@ -0,0 +1,193 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Microbenchmark for the dispatch overhead (privilege check, packet
+ * validation and executor lookup) of GET, SET and NOOP using the
+ * dispatch table compared to walking the function chains (which is how
+ * we used to dispatch the commands).
+ */
+#include "config.h"
+
+#include <chrono>
+#include <daemon/connection_mcbp.h>
+#include <daemon/function_chain.h>
+#include <daemon/mcbp_dispatch_table.h>
+#include <event2/event.h>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <memcached/protocol_binary.h>
+#include <utilities/protocol2text.h>
+#include <vector>
+
+static const size_t iterations = 1000000;
+
+static void noop_executor(McbpConnection*, void*) {
+}
+
+template<Privilege T>
+static PrivilegeAccess require(const Cookie& cookie) {
+    return cookie.connection->checkPrivilege(T);
+}
+
+static PrivilegeAccess empty(const Cookie&) {
+    return PrivilegeAccess::Ok;
+}
+
+class DispatchBench
+    : public ::testing::TestWithParam<protocol_binary_command> {
+protected:
+    void SetUp() override {
+        base = event_base_new();
+        connection.reset(new McbpConnection(-1, base));
+
+        std::array<mcbp_package_execute, 0x100> executors;
+        executors.fill(noop_executor);
+        table.reset(new McbpDispatchTable(executors));
+
+        const auto opcode = GetParam();
+        protocol_binary_request_header header;
+        memset(&header, 0, sizeof(header));
+        header.request.magic = PROTOCOL_BINARY_REQ;
+        header.request.opcode = uint8_t(opcode);
+        header.request.datatype = PROTOCOL_BINARY_RAW_BYTES;
+
+        switch (opcode) {
+        case PROTOCOL_BINARY_CMD_GET:
+            header.request.keylen = 5;
+            header.request.bodylen = 5;
+            break;
+        case PROTOCOL_BINARY_CMD_SET:
+            header.request.extlen = 8;
+            header.request.keylen = 5;
+            header.request.bodylen = 18;
+            break;
+        default:
+            break;
+        }
+
+        packet.resize(sizeof(header) + header.request.bodylen);
+        connection->binary_header = header;
+        auto* req = reinterpret_cast<protocol_binary_request_header*>(
+            packet.data());
+        *req = header;
+        req->request.keylen = htons(header.request.keylen);
+        req->request.bodylen = htonl(header.request.bodylen);
+        connection->read.curr = packet.data() + packet.size();
+    }
+
+    void TearDown() override {
+        connection.reset();
+        event_base_free(base);
+    }
+
+    void report(const char* name,
+                std::chrono::steady_clock::duration duration) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            duration).count();
+        std::cout << "    " << memcached_opcode_2_text(GetParam()) << " "
+                  << name << ": " << double(ns) / iterations << " ns/op"
+                  << std::endl;
+    }
+
+    event_base* base;
+    std::unique_ptr<McbpConnection> connection;
+    std::unique_ptr<McbpDispatchTable> table;
+    std::vector<char> packet;
+};
+
+TEST_P(DispatchBench, DispatchTable) {
+    const auto opcode = GetParam();
+    auto& cookie = connection->getCookieObject();
+    size_t errors = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t ii = 0; ii < iterations; ++ii) {
+        const auto& descriptor = (*table)[opcode];
+        if (!descriptor.accessible ||
+            connection->checkPrivileges(descriptor.privileges) !=
+            PrivilegeAccess::Ok) {
+            ++errors;
+            continue;
+        }
+        if (descriptor.validator != nullptr &&
+            descriptor.validator(cookie) != PROTOCOL_BINARY_RESPONSE_SUCCESS) {
+            ++errors;
+            continue;
+        }
+        descriptor.executor(connection.get(), packet.data());
+    }
+    report("dispatch table", std::chrono::steady_clock::now() - start);
+
+    EXPECT_EQ(0, errors);
+}
+
+TEST_P(DispatchBench, FunctionChains) {
+    const auto opcode = GetParam();
+    auto& cookie = connection->getCookieObject();
+    size_t errors = 0;
+
+    // Build the chains the way we used to set them up
+    FunctionChain<PrivilegeAccess, PrivilegeAccess::Ok, const Cookie&> privileges;
+    switch (opcode) {
+    case PROTOCOL_BINARY_CMD_GET:
+        privileges.push_unique(makeFunction<PrivilegeAccess,
+            PrivilegeAccess::Ok, const Cookie&>(require<Privilege::Read>));
+        break;
+    case PROTOCOL_BINARY_CMD_SET:
+        privileges.push_unique(makeFunction<PrivilegeAccess,
+            PrivilegeAccess::Ok, const Cookie&>(require<Privilege::Write>));
+        break;
+    default:
+        privileges.push_unique(makeFunction<PrivilegeAccess,
+            PrivilegeAccess::Ok, const Cookie&>(empty));
+    }
+
+    FunctionChain<protocol_binary_response_status,
+                  PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                  const Cookie&> validators;
+    validators.push_unique(makeFunction<protocol_binary_response_status,
+                                        PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                                        const Cookie&>(
+        (*table)[opcode].validator));
+
+    std::array<mcbp_package_execute, 0x100> executors;
+    executors.fill(noop_executor);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t ii = 0; ii < iterations; ++ii) {
+        if (privileges.empty() ||
+            privileges.invoke(cookie) != PrivilegeAccess::Ok) {
+            ++errors;
+            continue;
+        }
+        if (validators.invoke(cookie) != PROTOCOL_BINARY_RESPONSE_SUCCESS) {
+            ++errors;
+            continue;
+        }
+        executors[opcode](connection.get(), packet.data());
+    }
+    report("function chains", std::chrono::steady_clock::now() - start);
+
+    EXPECT_EQ(0, errors);
+}
+
+INSTANTIATE_TEST_CASE_P(Opcodes,
+                        DispatchBench,
+                        ::testing::Values(PROTOCOL_BINARY_CMD_GET,
+                                          PROTOCOL_BINARY_CMD_SET,
+                                          PROTOCOL_BINARY_CMD_NOOP));
@@ -114,6 +114,77 @@ namespace BinaryProtocolValidator {
         EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate(PROTOCOL_BINARY_CMD_GETKQ));
     }
 
+    // Test GET_MULTI
+    class GetMultiValidatorTest : public ValidatorTest {
+        virtual void SetUp() override {
+            ValidatorTest::SetUp();
+            memset(blob, 0, sizeof(blob));
+            request = reinterpret_cast<protocol_binary_request_get_multi*>(blob);
+            request->message.header.request.magic = PROTOCOL_BINARY_REQ;
+            request->message.header.request.datatype = PROTOCOL_BINARY_RAW_BYTES;
+            bodylen = 0;
+            addKey(0, "hello");
+            addKey(1, "world");
+        }
+
+    protected:
+        void addKey(uint16_t vbucket, const std::string& key) {
+            protocol_binary_get_multi_entry entry;
+            entry.vbucket = htons(vbucket);
+            entry.keylen = htons(uint16_t(key.size()));
+            uint8_t* ptr = blob + sizeof(request->bytes) + bodylen;
+            memcpy(ptr, &entry, sizeof(entry));
+            memcpy(ptr + sizeof(entry), key.data(), key.size());
+            bodylen += uint32_t(sizeof(entry) + key.size());
+            request->message.header.request.bodylen = htonl(bodylen);
+        }
+
+        int validate() {
+            return ValidatorTest::validate(PROTOCOL_BINARY_CMD_GET_MULTI,
+                                           static_cast<void*>(blob));
+        }
+
+        protocol_binary_request_get_multi* request;
+        uint32_t bodylen;
+        uint8_t blob[1024];
+    };
+
+    TEST_F(GetMultiValidatorTest, CorrectMessage) {
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, validate());
+    }
+    TEST_F(GetMultiValidatorTest, InvalidMagic) {
+        request->message.header.request.magic = 0;
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+    }
+    TEST_F(GetMultiValidatorTest, InvalidExtlen) {
+        request->message.header.request.extlen = 2;
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+    }
+    TEST_F(GetMultiValidatorTest, InvalidKey) {
+        request->message.header.request.keylen = htons(2);
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+    }
+    TEST_F(GetMultiValidatorTest, NoKeys) {
+        request->message.header.request.bodylen = 0;
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+    }
+    TEST_F(GetMultiValidatorTest, TruncatedEntry) {
+        request->message.header.request.bodylen = htonl(bodylen - 1);
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+    }
+    TEST_F(GetMultiValidatorTest, EmptyKey) {
+        addKey(2, "");
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+    }
+    TEST_F(GetMultiValidatorTest, InvalidDatatype) {
+        request->message.header.request.datatype = PROTOCOL_BINARY_DATATYPE_JSON;
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+    }
+    TEST_F(GetMultiValidatorTest, InvalidCas) {
+        request->message.header.request.cas = 1;
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+    }
+
     // Test ADD & ADDQ
     class AddValidatorTest : public ValidatorTest {
         virtual void SetUp() override {
@@ -0,0 +1,156 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <daemon/memcached.h>
+#include <daemon/pending_io_queue.h>
+#include <event2/event.h>
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+/**
+ * Test that notifications racing with a connection being moved to
+ * another worker thread (see migrate_connection) always wake up the
+ * thread the connection was queued on
+ */
+class PendingIoTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        base = event_base_new();
+        settings.setNumWorkerThreads(int(threads.size()));
+        all_buckets[0].stats = new thread_stats[threads.size() + 1];
+
+        for (size_t ii = 0; ii < threads.size(); ++ii) {
+            auto& t = threads[ii];
+            memset(&t, 0, sizeof(t));
+            t.index = int(ii);
+            t.pending_io = new PendingIoQueue;
+            cb_mutex_initialize(&t.mutex);
+            ASSERT_TRUE(create_notification_pipe(&t));
+        }
+
+        connection.reset(new McbpConnection(-1, base));
+        connection->setThread(&threads[0]);
+    }
+
+    void TearDown() override {
+        connection.reset();
+        for (auto& t : threads) {
+            evutil_closesocket(t.notify[0]);
+            evutil_closesocket(t.notify[1]);
+            cb_mutex_destroy(&t.mutex);
+            delete t.pending_io;
+        }
+        delete[] all_buckets[0].stats;
+        all_buckets[0].stats = nullptr;
+        event_base_free(base);
+    }
+
+    /**
+     * Move the connection to the other thread the same way as
+     * migrate_connection does
+     */
+    void migrate() {
+        auto* from = connection->getThread();
+        auto* to = (from == &threads[0]) ? &threads[1] : &threads[0];
+
+        LOCK_THREAD(from);
+        if (from->pending_io->remove(connection.get()) &&
+            from->pending_io->arm()) {
+            notify_thread(from);
+        }
+        connection->setThread(to);
+        auto* owner = add_conn_to_pending_io_list(connection.get());
+        if (owner != nullptr) {
+            notify_thread(owner);
+        }
+        UNLOCK_THREAD(from);
+    }
+
+    /**
+     * Run the thread if it was notified, like the worker thread does
+     * when its notification pipe is readable
+     */
+    bool serve(LIBEVENT_THREAD& me) {
+        char buffer[512];
+        bool notified = false;
+        while (recv(me.notify[0], buffer, sizeof(buffer), 0) > 0) {
+            notified = true;
+        }
+        if (!notified) {
+            return false;
+        }
+
+        LOCK_THREAD((&me));
+        me.pending_io->disarm();
+        Connection* c;
+        while ((c = me.pending_io->pop()) != nullptr) {
+            if (c->getThread() != &me) {
+                auto* target = add_conn_to_pending_io_list(c);
+                if (target != nullptr) {
+                    notify_thread(target);
+                }
+                continue;
+            }
+            c->clearPendingIo();
+        }
+        UNLOCK_THREAD((&me));
+        return true;
+    }
+
+    event_base* base;
+    std::array<LIBEVENT_THREAD, 2> threads;
+    std::unique_ptr<McbpConnection> connection;
+};
+
+TEST_F(PendingIoTest, NotifyWhileMigrating) {
+    std::atomic<bool> done{false};
+    std::thread notifier{[this, &done]() {
+        for (int ii = 0; ii < 100000; ++ii) {
+            notify_io_complete(&connection->getCookieObject(),
+                               ENGINE_SUCCESS);
+        }
+        done = true;
+    }};
+
+    while (!done) {
+        migrate();
+        for (auto& t : threads) {
+            serve(t);
+        }
+    }
+    notifier.join();
+
+    // Let the threads forward the connection between them until
+    // none of them is notified anymore
+    bool notified;
+    do {
+        notified = false;
+        for (auto& t : threads) {
+            notified |= serve(t);
+        }
+    } while (notified);
+
+    // A queue left with a pending wakeup but no notification for its
+    // thread would never be served again
+    for (auto& t : threads) {
+        EXPECT_TRUE(t.pending_io->arm())
+            << "Thread " << t.index << " missed its wakeup";
+    }
+}
@@ -0,0 +1,107 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <daemon/connection_mcbp.h>
+#include <event2/event.h>
+#include <gtest/gtest.h>
+
+/**
+ * A connection where we may change the privileges without rebuilding the
+ * cached privilege mask (like what happens when the privilege database
+ * is updated)
+ */
+class MockConnection : public McbpConnection {
+public:
+    MockConnection(event_base* base)
+        : McbpConnection(-1, base) {
+    }
+
+    void changePrivileges(bool admin_) {
+        admin = admin_;
+    }
+};
+
+/**
+ * Test the privilege mask cached in the connection
+ */
+class PrivilegeMaskTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        base = event_base_new();
+        connection.reset(new MockConnection(base));
+    }
+
+    void TearDown() override {
+        connection.reset();
+        event_base_free(base);
+    }
+
+    event_base* base;
+    std::unique_ptr<MockConnection> connection;
+};
+
+TEST_F(PrivilegeMaskTest, NormalConnection) {
+    EXPECT_EQ(PrivilegeAccess::Ok,
+              connection->checkPrivilege(Privilege::Read));
+    EXPECT_EQ(PrivilegeAccess::Fail,
+              connection->checkPrivilege(Privilege::Stats));
+    EXPECT_EQ(PrivilegeAccess::Ok,
+              connection->checkPrivileges(
+                  privilegeToMask(Privilege::Read) |
+                  privilegeToMask(Privilege::Write)));
+    EXPECT_EQ(PrivilegeAccess::Fail,
+              connection->checkPrivileges(
+                  privilegeToMask(Privilege::Read) |
+                  privilegeToMask(Privilege::Stats)));
+    EXPECT_EQ(PrivilegeAccess::Ok, connection->checkPrivileges(0));
+}
+
+TEST_F(PrivilegeMaskTest, AdminConnection) {
+    connection->setAdmin(true);
+    EXPECT_EQ(PrivilegeAccess::Ok,
+              connection->checkPrivilege(Privilege::Stats));
+    EXPECT_EQ(PrivilegeAccess::Ok,
+              connection->checkPrivilege(Privilege::CollectionManagement));
+
+    connection->setAdmin(false);
+    EXPECT_EQ(PrivilegeAccess::Fail,
+              connection->checkPrivilege(Privilege::Stats));
+}
+
+TEST_F(PrivilegeMaskTest, InvalidatedContextIsRebuilt) {
+    const auto mask = connection->getPrivilegeMask();
+    EXPECT_EQ(PrivilegeAccess::Fail,
+              connection->checkPrivilege(Privilege::Stats));
+
+    // The cached mask is used until the contexts are invalidated
+    connection->changePrivileges(true);
+    EXPECT_EQ(mask, connection->getPrivilegeMask());
+    EXPECT_EQ(PrivilegeAccess::Fail,
+              connection->checkPrivilege(Privilege::Stats));
+
+    Connection::invalidatePrivilegeContexts();
+    EXPECT_NE(mask, connection->getPrivilegeMask());
+    EXPECT_EQ(PrivilegeAccess::Ok,
+              connection->checkPrivilege(Privilege::Stats));
+
+    // And rebuilt again the next time they're invalidated
+    connection->changePrivileges(false);
+    Connection::invalidatePrivilegeContexts();
+    EXPECT_EQ(mask, connection->getPrivilegeMask());
+    EXPECT_EQ(PrivilegeAccess::Fail,
+              connection->checkPrivilege(Privilege::Stats));
+}
@@ -0,0 +1,120 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <utilities/mpsc_queue.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+class Element : public MpscQueueHook<Element> {
+public:
+    Element()
+        : producer(0),
+          sequence(0) {
+    }
+
+    int producer;
+    int sequence;
+};
+
+TEST(MpscQueueTest, EmptyQueue) {
+    IntrusiveMpscQueue<Element> queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(nullptr, queue.pop());
+}
+
+TEST(MpscQueueTest, Fifo) {
+    IntrusiveMpscQueue<Element> queue;
+    std::vector<Element> elements(10);
+
+    for (auto& e : elements) {
+        EXPECT_TRUE(queue.push(&e));
+    }
+    EXPECT_FALSE(queue.empty());
+
+    for (auto& e : elements) {
+        EXPECT_EQ(&e, queue.pop());
+    }
+    EXPECT_EQ(nullptr, queue.pop());
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(MpscQueueTest, NoDuplicates) {
+    IntrusiveMpscQueue<Element> queue;
+    Element a, b;
+
+    EXPECT_TRUE(queue.push(&a));
+    EXPECT_TRUE(a.isMpscLinked());
+    EXPECT_FALSE(queue.push(&a));
+    EXPECT_TRUE(queue.push(&b));
+
+    EXPECT_EQ(&a, queue.pop());
+    EXPECT_FALSE(a.isMpscLinked());
+
+    // Now that it's unlinked we may add it again
+    EXPECT_TRUE(queue.push(&a));
+    EXPECT_EQ(&b, queue.pop());
+    EXPECT_EQ(&a, queue.pop());
+    EXPECT_EQ(nullptr, queue.pop());
+}
+
+TEST(MpscQueueTest, MultipleProducers) {
+    const int producers = 4;
+    const int count = 10000;
+
+    IntrusiveMpscQueue<Element> queue;
+    std::vector<std::vector<Element>> elements;
+    for (int ii = 0; ii < producers; ++ii) {
+        elements.emplace_back(count);
+        for (int jj = 0; jj < count; ++jj) {
+            elements[ii][jj].producer = ii;
+            elements[ii][jj].sequence = jj;
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (int ii = 0; ii < producers; ++ii) {
+        threads.emplace_back([&queue, &elements, ii]() {
+            for (auto& e : elements[ii]) {
+                queue.push(&e);
+            }
+        });
+    }
+
+    // Each producer pushes in order, so the elements from a given
+    // producer should come out of the queue in order
+    std::vector<int> next(producers, 0);
+    int received = 0;
+    while (received < producers * count) {
+        auto* e = queue.pop();
+        if (e == nullptr) {
+            std::this_thread::yield();
+            continue;
+        }
+        EXPECT_EQ(next[e->producer], e->sequence);
+        next[e->producer] = e->sequence + 1;
+        ++received;
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(nullptr, queue.pop());
+    EXPECT_TRUE(queue.empty());
+}
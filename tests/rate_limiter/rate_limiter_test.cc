@@ -0,0 +1,105 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <daemon/rate_limiter.h>
+#include <gtest/gtest.h>
+
+static const hrtime_t second = 1000000000;
+
+TEST(TokenBucketTest, Unlimited) {
+    TokenBucket bucket;
+    EXPECT_EQ(0u, bucket.getRate());
+    EXPECT_EQ(0u, bucket.getWaitTime(1000000, 0));
+}
+
+TEST(TokenBucketTest, StartsFull) {
+    TokenBucket bucket;
+    bucket.setRate(10, second);
+    EXPECT_EQ(10.0, bucket.getTokens(second));
+    EXPECT_EQ(0u, bucket.getWaitTime(10, second));
+    bucket.consume(10);
+    EXPECT_EQ(0.0, bucket.getTokens(second));
+}
+
+TEST(TokenBucketTest, Refill) {
+    TokenBucket bucket;
+    bucket.setRate(10, second);
+    bucket.consume(10);
+
+    // We need to wait 100ms for a single token
+    EXPECT_EQ(second / 10, bucket.getWaitTime(1, second));
+    EXPECT_EQ(0u, bucket.getWaitTime(1, second + second / 5));
+
+    // The bucket never holds more than a second worth of tokens
+    EXPECT_EQ(10.0, bucket.getTokens(10 * second));
+}
+
+TEST(TokenBucketTest, LargeRequest) {
+    TokenBucket bucket;
+    bucket.setRate(100, second);
+
+    // A request larger than the burst size is granted when the bucket is
+    // full, and the next request has to wait for the debt to be paid
+    EXPECT_EQ(0u, bucket.getWaitTime(250, second));
+    bucket.consume(250);
+    EXPECT_EQ(-150.0, bucket.getTokens(second));
+    EXPECT_EQ(0u, bucket.getWaitTime(1, second + (16 * second) / 10));
+}
+
+TEST(RateLimiterTest, Disabled) {
+    RateLimiter limiter;
+    EXPECT_FALSE(limiter.isEnabled());
+    limiter.setOpsLimit(10);
+    EXPECT_TRUE(limiter.isEnabled());
+    limiter.setOpsLimit(0);
+    EXPECT_FALSE(limiter.isEnabled());
+    limiter.setBytesLimit(10);
+    EXPECT_TRUE(limiter.isEnabled());
+    limiter.reset();
+    EXPECT_FALSE(limiter.isEnabled());
+    EXPECT_EQ(0u, limiter.getBytesLimit());
+}
+
+TEST(RateLimiterTest, OpsLimit) {
+    RateLimiter limiter;
+    limiter.setOpsLimit(2);
+    const auto now = gethrtime();
+    EXPECT_EQ(0u, limiter.admit(100, now));
+    EXPECT_EQ(0u, limiter.admit(100, now));
+    EXPECT_NE(0u, limiter.admit(100, now));
+}
+
+TEST(RateLimiterTest, BytesLimit) {
+    RateLimiter limiter;
+    limiter.setBytesLimit(1000);
+    const auto now = gethrtime();
+    EXPECT_EQ(0u, limiter.admit(600, now));
+    // A rejected command doesn't consume any tokens
+    EXPECT_NE(0u, limiter.admit(600, now));
+    EXPECT_EQ(0u, limiter.admit(400, now));
+}
+
+TEST(RateLimiterTest, ToJSON) {
+    RateLimiter limiter;
+    limiter.setOpsLimit(5);
+    limiter.setMaxDelay(100);
+    auto json = limiter.toJSON();
+    EXPECT_EQ(5, cJSON_GetObjectItem(json.get(), "ops")->valueint);
+    EXPECT_EQ(0, cJSON_GetObjectItem(json.get(), "bytes")->valueint);
+    EXPECT_EQ(100, cJSON_GetObjectItem(json.get(), "max_delay")->valueint);
+    EXPECT_NE(nullptr, cJSON_GetObjectItem(json.get(), "delays"));
+}
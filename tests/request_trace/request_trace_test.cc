@@ -0,0 +1,82 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <daemon/request_trace.h>
+#include <gtest/gtest.h>
+#include <memcached/protocol_binary.h>
+
+#include <algorithm>
+
+TEST(ServerDurationTest, Encoding) {
+    EXPECT_EQ(0, encode_server_duration(0));
+    EXPECT_EQ(0xffff, encode_server_duration(hrtime_t(1000) * 1000000000));
+
+    // The absolute precision decrease with the duration, but the error
+    // stays within 2% (or 2 microseconds for short durations)
+    for (hrtime_t micros : {10, 100, 1000, 10000, 100000, 1000000,
+                            10000000}) {
+        const auto encoded = encode_server_duration(micros * 1000);
+        const double decoded = decode_server_duration(encoded);
+        EXPECT_NEAR(double(micros), decoded,
+                    std::max(double(micros) * 0.02, 2.0)) << micros;
+    }
+}
+
+static RequestSpan makeSpan(uint32_t opaque) {
+    RequestSpan span;
+    span.opaque = htonl(opaque);
+    span.opcode = PROTOCOL_BINARY_CMD_GET;
+    span.queue = 1000;
+    span.engine = 2000;
+    span.ewouldblock = 0;
+    span.send = 3000;
+    span.total = 6000;
+    return span;
+}
+
+TEST(RequestSpanLogTest, Find) {
+    RequestSpanLog log;
+    EXPECT_EQ(nullptr, log.find(htonl(1)));
+    log.add(makeSpan(1));
+    log.add(makeSpan(2));
+    ASSERT_NE(nullptr, log.find(htonl(1)));
+    EXPECT_EQ(htonl(2), log.find(htonl(2))->opaque);
+
+    // The oldest spans are overwritten
+    for (uint32_t ii = 0; ii < RequestSpanLog::Capacity; ++ii) {
+        log.add(makeSpan(100 + ii));
+    }
+    EXPECT_EQ(nullptr, log.find(htonl(1)));
+    EXPECT_NE(nullptr, log.find(htonl(100)));
+
+    log.clear();
+    EXPECT_EQ(nullptr, log.find(htonl(100)));
+}
+
+TEST(RequestSpanLogTest, ToJSON) {
+    RequestSpanLog log;
+    log.add(makeSpan(1));
+    log.add(makeSpan(2));
+
+    auto json = log.toJSON();
+    ASSERT_EQ(2, cJSON_GetArraySize(json.get()));
+    auto* span = cJSON_GetArrayItem(json.get(), 0);
+    EXPECT_EQ(1, cJSON_GetObjectItem(span, "opaque")->valueint);
+    EXPECT_STREQ("GET", cJSON_GetObjectItem(span, "opcode")->valuestring);
+    EXPECT_EQ(6, cJSON_GetObjectItem(span, "total")->valueint);
+    EXPECT_EQ(2, cJSON_GetObjectItem(span, "engine")->valueint);
+}
@@ -0,0 +1,118 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <daemon/slow_op_log.h>
+#include <gtest/gtest.h>
+#include <memcached/protocol_binary.h>
+
+#include <cstring>
+
+static SlowOperation makeOperation(uint32_t seconds,
+                                   hrtime_t duration,
+                                   const char* bucket = "default") {
+    SlowOperation op;
+    memset(&op, 0, sizeof(op));
+    op.seconds = seconds;
+    op.opcode = PROTOCOL_BINARY_CMD_GET;
+    op.duration = duration;
+    strncpy(op.bucket.data(), bucket, op.bucket.size() - 1);
+    return op;
+}
+
+TEST(SlowOperationTest, HashKey) {
+    EXPECT_EQ(SlowOperation::hashKey("foo", 3),
+              SlowOperation::hashKey("foo", 3));
+    EXPECT_NE(SlowOperation::hashKey("foo", 3),
+              SlowOperation::hashKey("bar", 3));
+    // FNV-1a offset basis
+    EXPECT_EQ(14695981039346656037ULL, SlowOperation::hashKey("", 0));
+}
+
+TEST(SlowOperationTest, ToJSON) {
+    auto op = makeOperation(1, 200000000);
+    op.ewouldblocks = 2;
+    auto json = op.toJSON();
+    EXPECT_STREQ("GET",
+                 cJSON_GetObjectItem(json.get(), "opcode")->valuestring);
+    EXPECT_STREQ("default",
+                 cJSON_GetObjectItem(json.get(), "bucket")->valuestring);
+    EXPECT_EQ(2, cJSON_GetObjectItem(json.get(), "ewouldblock")->valueint);
+    EXPECT_EQ(nullptr, cJSON_GetObjectItem(json.get(), "phases"));
+
+    op.hasPhases = true;
+    json = op.toJSON();
+    auto* phases = cJSON_GetObjectItem(json.get(), "phases");
+    ASSERT_NE(nullptr, phases);
+    EXPECT_NE(nullptr, cJSON_GetObjectItem(phases, "queue"));
+    EXPECT_EQ(nullptr, cJSON_GetObjectItem(phases, "send"));
+}
+
+TEST(SlowOperationRingTest, Wraparound) {
+    SlowOperationRing ring;
+    for (uint32_t ii = 0; ii < SlowOperationRing::Capacity + 10; ++ii) {
+        ring.add(makeOperation(ii, ii));
+    }
+    EXPECT_EQ(SlowOperationRing::Capacity + 10, ring.getAdded());
+
+    // Only the most recent entries are kept
+    auto entries = ring.getEntries();
+    ASSERT_EQ(SlowOperationRing::Capacity, entries.size());
+    EXPECT_EQ(10u, entries.front().seconds);
+    EXPECT_EQ(SlowOperationRing::Capacity + 9, entries.back().seconds);
+
+    entries = ring.getEntries(SlowOperationRing::Capacity + 5);
+    ASSERT_EQ(5u, entries.size());
+    EXPECT_EQ(SlowOperationRing::Capacity + 5, entries.front().seconds);
+}
+
+TEST(SlowOperationLogTest, ToJSON) {
+    SlowOperationLog log(2);
+    log.add(0, makeOperation(3, 1));
+    log.add(1, makeOperation(1, 1));
+    log.add(1, makeOperation(2, 1, "other"));
+
+    auto json = log.toJSON();
+    ASSERT_EQ(3, cJSON_GetArraySize(json.get()));
+    // Sorted by time
+    EXPECT_STREQ("other",
+                 cJSON_GetObjectItem(cJSON_GetArrayItem(json.get(), 1),
+                                     "bucket")->valuestring);
+
+    json = log.toJSON("default");
+    EXPECT_EQ(2, cJSON_GetArraySize(json.get()));
+}
+
+TEST(SlowOperationLogTest, Summary) {
+    SlowOperationLog log(2);
+    auto summary = log.getSummary();
+    EXPECT_EQ(0u, summary.count);
+    EXPECT_FALSE(summary.hasSlowest);
+
+    log.add(0, makeOperation(1, 100));
+    log.add(1, makeOperation(2, 300));
+    log.add(1, makeOperation(3, 200));
+    summary = log.getSummary();
+    EXPECT_EQ(3u, summary.count);
+    ASSERT_TRUE(summary.hasSlowest);
+    EXPECT_EQ(300u, summary.slowest.duration);
+
+    // Only the operations added since the last summary are reported
+    log.add(0, makeOperation(4, 150));
+    summary = log.getSummary();
+    EXPECT_EQ(1u, summary.count);
+    EXPECT_EQ(150u, summary.slowest.duration);
+}
@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <daemon/ssl_session_cache.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::seconds;
+
+TEST(SslSessionCacheTest, InsertLookup) {
+    SslSessionCache cache(10);
+    const auto now = Clock::now();
+    std::string session;
+    EXPECT_FALSE(cache.lookup("id", session, now));
+
+    cache.insert("id", "session", now + seconds(10));
+    EXPECT_TRUE(cache.lookup("id", session, now));
+    EXPECT_EQ("session", session);
+    EXPECT_EQ(1u, cache.size());
+
+    // Replacing a session doesn't add a new entry
+    cache.insert("id", "other", now + seconds(10));
+    EXPECT_TRUE(cache.lookup("id", session, now));
+    EXPECT_EQ("other", session);
+    EXPECT_EQ(1u, cache.size());
+
+    cache.remove("id");
+    EXPECT_FALSE(cache.lookup("id", session, now));
+    EXPECT_EQ(0u, cache.size());
+}
+
+TEST(SslSessionCacheTest, Expiry) {
+    SslSessionCache cache(10);
+    const auto now = Clock::now();
+    std::string session;
+    cache.insert("id", "session", now + seconds(10));
+    EXPECT_TRUE(cache.lookup("id", session, now + seconds(9)));
+    EXPECT_FALSE(cache.lookup("id", session, now + seconds(10)));
+    // The expired session is removed
+    EXPECT_EQ(0u, cache.size());
+}
+
+TEST(SslSessionCacheTest, Disabled) {
+    SslSessionCache cache(0);
+    const auto now = Clock::now();
+    std::string session;
+    cache.insert("id", "session", now + seconds(10));
+    EXPECT_FALSE(cache.lookup("id", session, now));
+    EXPECT_EQ(0u, cache.size());
+}
+
+TEST(SslSessionCacheTest, EvictLeastRecentlyUsed) {
+    // Use a single shard so that we know which entry gets evicted
+    SslSessionCache cache(2, 1);
+    const auto now = Clock::now();
+    const auto expiry = now + seconds(10);
+    std::string session;
+
+    cache.insert("a", "a", expiry);
+    cache.insert("b", "b", expiry);
+    // Touch a so that b is the least recently used
+    EXPECT_TRUE(cache.lookup("a", session, now));
+    cache.insert("c", "c", expiry);
+
+    EXPECT_EQ(2u, cache.size());
+    EXPECT_EQ(1u, cache.getEvictions());
+    EXPECT_TRUE(cache.lookup("a", session, now));
+    EXPECT_FALSE(cache.lookup("b", session, now));
+    EXPECT_TRUE(cache.lookup("c", session, now));
+}
+
+TEST(SslSessionCacheTest, Bounded) {
+    SslSessionCache cache(64, 4);
+    const auto now = Clock::now();
+    for (int ii = 0; ii < 1000; ++ii) {
+        cache.insert(std::to_string(ii), "session", now + seconds(10));
+    }
+    EXPECT_GE(64u, cache.size());
+
+    cache.setCapacity(8);
+    for (int ii = 0; ii < 1000; ++ii) {
+        cache.insert(std::to_string(ii), "session", now + seconds(10));
+    }
+    EXPECT_GE(8u, cache.size());
+}
+
+TEST(SslTicketKeysTest, Rotation) {
+    SslTicketKeys keys;
+    const auto now = Clock::now();
+    const seconds interval(60);
+
+    const auto first = keys.getEncryptionKey(now, interval);
+    EXPECT_EQ(1u, keys.getRotations());
+
+    // The key is reused within the interval
+    auto key = keys.getEncryptionKey(now + seconds(59), interval);
+    EXPECT_EQ(0, memcmp(first.name, key.name, sizeof(key.name)));
+    EXPECT_EQ(1u, keys.getRotations());
+
+    // and a new key is generated after the interval
+    const auto second = keys.getEncryptionKey(now + seconds(60), interval);
+    EXPECT_NE(0, memcmp(first.name, second.name, sizeof(key.name)));
+    EXPECT_EQ(2u, keys.getRotations());
+}
+
+TEST(SslTicketKeysTest, Decryption) {
+    SslTicketKeys keys;
+    const auto now = Clock::now();
+    const seconds interval(60);
+    const auto first = keys.getEncryptionKey(now, interval);
+
+    SslTicketKeys::Key key;
+    bool renew;
+    ASSERT_TRUE(keys.getDecryptionKey(first.name, key, renew, now, interval));
+    EXPECT_FALSE(renew);
+    EXPECT_EQ(0, memcmp(first.aes, key.aes, sizeof(key.aes)));
+    EXPECT_EQ(0, memcmp(first.hmac, key.hmac, sizeof(key.hmac)));
+
+    // After the rotation the ticket should be replaced
+    ASSERT_TRUE(keys.getDecryptionKey(first.name, key, renew,
+                                      now + seconds(90), interval));
+    EXPECT_TRUE(renew);
+
+    // and after two intervals the key is gone
+    EXPECT_FALSE(keys.getDecryptionKey(first.name, key, renew,
+                                       now + seconds(120), interval));
+
+    const uint8_t unknown[16] = {0};
+    EXPECT_FALSE(keys.getDecryptionKey(unknown, key, renew,
+                                       now + seconds(120), interval));
+}
@@ -15,6 +15,7 @@
 
 #include <atomic>
 #include <algorithm>
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -2227,6 +2228,181 @@ TEST_P(McdTestappTest, IOCTL_Tracing) {
     EXPECT_EQ(cJSON_Array, events->type);
 }
 
+TEST_P(McdTestappTest, IOCTL_TracingChunkedDump) {
+    auto& conn = connectionMap.getConnection(Protocol::Memcached,
+                                             current_phase == phase_ssl,
+                                             AF_INET);
+    conn.authenticate("_admin", "password", "PLAIN");
+
+    conn.ioctl_set("trace.config", "buffer-mode:ring;buffer-size:2000000;"
+                                   "enabled-categories:*");
+    conn.ioctl_set("trace.start", {});
+
+    // Starting the dump stops the trace
+    const auto id = conn.ioctl_get("trace.dump.begin");
+    EXPECT_EQ("disabled", conn.ioctl_get("trace.status"));
+
+    std::string dump;
+    std::string chunk;
+    do {
+        chunk = conn.ioctl_get("trace.dump.chunk?id=" + id);
+        dump.append(chunk);
+    } while (!chunk.empty());
+
+    unique_cJSON_ptr json(cJSON_Parse(dump.c_str()));
+    ASSERT_NE(nullptr, json);
+    auto* events = cJSON_GetObjectItem(json.get(), "traceEvents");
+    ASSERT_NE(nullptr, events);
+    EXPECT_EQ(cJSON_Array, events->type);
+
+    // The dump is released once it is fully read
+    try {
+        conn.ioctl_get("trace.dump.chunk?id=" + id);
+        FAIL() << "The dump should have been released";
+    } catch (ConnectionError& error) {
+        EXPECT_TRUE(error.isNotFound());
+    }
+}
+
+/**
+ * Parse a trace file written by the server. The file is written by the
+ * executor pool, so wait for it to be completely written.
+ *
+ * @return the trace or nullptr if the file isn't valid JSON within 10 sec
+ */
+static unique_cJSON_ptr readTraceFile(const std::string& filename) {
+    const auto timeout = time(NULL) + 10;
+    do {
+        std::ifstream file(filename, std::ifstream::in);
+        const std::string content((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+        unique_cJSON_ptr json(cJSON_Parse(content.c_str()));
+        if (json) {
+            return json;
+        }
+        usleep(100000);
+    } while (time(NULL) < timeout);
+    return unique_cJSON_ptr();
+}
+
+/**
+ * Create an empty directory for the trace files
+ */
+static std::string createTraceDirectory() {
+    const auto dir = cb::io::getcwd() + "/" + cb::io::mktemp("trace_dir");
+    cb::io::rmrf(dir);
+    cb::io::mkdirp(dir);
+    return dir;
+}
+
+TEST_P(McdTestappTest, IOCTL_TracingDumpToFile) {
+    auto& conn = connectionMap.getConnection(Protocol::Memcached,
+                                             current_phase == phase_ssl,
+                                             AF_INET);
+    conn.authenticate("_admin", "password", "PLAIN");
+
+    conn.ioctl_set("trace.config", "buffer-mode:ring;buffer-size:2000000;"
+                                   "enabled-categories:*");
+    conn.ioctl_set("trace.start", {});
+
+    const auto dir = createTraceDirectory();
+    const auto filename = dir + "/trace.json";
+    conn.ioctl_set("trace.dump.file", filename);
+
+    auto json = readTraceFile(filename);
+    ASSERT_NE(nullptr, json) << "Failed to read " << filename;
+    auto* events = cJSON_GetObjectItem(json.get(), "traceEvents");
+    ASSERT_NE(nullptr, events);
+    EXPECT_EQ(cJSON_Array, events->type);
+
+    cb::io::rmrf(dir);
+}
+
+TEST_P(McdTestappTest, IOCTL_TracingContinuous) {
+    auto& conn = connectionMap.getConnection(Protocol::Memcached,
+                                             current_phase == phase_ssl,
+                                             AF_INET);
+    conn.authenticate("_admin", "password", "PLAIN");
+
+    conn.ioctl_set("trace.config", "buffer-mode:ring;buffer-size:2000000;"
+                                   "enabled-categories:*");
+    conn.ioctl_set("trace.start", {});
+
+    // Rotate the trace every second (the timestamp in the name keeps
+    // the files apart)
+    const auto dir = createTraceDirectory();
+    conn.ioctl_set("trace.continuous?interval=1", dir + "/trace.%d.json");
+
+    std::vector<std::string> files;
+    const auto timeout = time(NULL) + 30;
+    while ((files = cb::io::findFilesContaining(dir, "trace.")).size() < 2 &&
+           time(NULL) < timeout) {
+        usleep(100000);
+    }
+
+    // Disabling the rotation leaves the trace running
+    conn.ioctl_set("trace.continuous", {});
+    EXPECT_EQ("enabled", conn.ioctl_get("trace.status"));
+
+    ASSERT_LE(2u, files.size()) << "The trace wasn't rotated";
+    for (const auto& file : files) {
+        auto json = readTraceFile(file);
+        ASSERT_NE(nullptr, json) << "Failed to read " << file;
+        auto* events = cJSON_GetObjectItem(json.get(), "traceEvents");
+        ASSERT_NE(nullptr, events);
+        EXPECT_EQ(cJSON_Array, events->type);
+    }
+
+    conn.ioctl_set("trace.stop", {});
+    cb::io::rmrf(dir);
+}
+
+TEST_P(McdTestappTest, IOCTL_RateLimit) {
+    auto& conn = connectionMap.getConnection(Protocol::Memcached,
+                                             current_phase == phase_ssl,
+                                             AF_INET);
+    conn.authenticate("_admin", "password", "PLAIN");
+
+    // Allow a single operation per second, and reject the rest right away
+    conn.ioctl_set("ratelimit.max_delay?bucket=default", "0");
+    conn.ioctl_set("ratelimit.ops?bucket=default", "1");
+
+    unique_cJSON_ptr json(cJSON_Parse(
+        conn.ioctl_get("ratelimit?bucket=default").c_str()));
+    ASSERT_NE(nullptr, json);
+    EXPECT_EQ(1, cJSON_GetObjectItem(json.get(), "ops")->valueint);
+    EXPECT_EQ(0, cJSON_GetObjectItem(json.get(), "bytes")->valueint);
+
+    union {
+        protocol_binary_request_no_extras request;
+        protocol_binary_response_no_extras response;
+        char bytes[1024];
+    } buffer;
+    const std::string key{"IOCTL_RateLimit"};
+
+    // The first get should be admitted, the second one rejected
+    for (auto status : {PROTOCOL_BINARY_RESPONSE_KEY_ENOENT,
+                        PROTOCOL_BINARY_RESPONSE_RATE_LIMITED}) {
+        size_t len = mcbp_raw_command(buffer.bytes, sizeof(buffer.bytes),
+                                      PROTOCOL_BINARY_CMD_GET, key.c_str(),
+                                      key.length(), NULL, 0);
+        safe_send(buffer.bytes, len, false);
+        safe_recv_packet(buffer.bytes, sizeof(buffer.bytes));
+        mcbp_validate_response_header(&buffer.response,
+                                      PROTOCOL_BINARY_CMD_GET, status);
+    }
+
+    // The admin connection isn't rate limited
+    EXPECT_NO_THROW(conn.ioctl_get("ratelimit?bucket=default"));
+    EXPECT_NO_THROW(conn.ioctl_get("ratelimit?bucket=default"));
+
+    conn.ioctl_set("ratelimit.ops?bucket=default", "0");
+    EXPECT_THROW(conn.ioctl_set("ratelimit.ops?bucket=default", "foo"),
+                 ConnectionError);
+    EXPECT_THROW(conn.ioctl_set("ratelimit.ops?bucket=nobucket", "0"),
+                 ConnectionError);
+}
+
 TEST_P(McdTestappTest, Config_ValidateCurrentConfig) {
     union {
         protocol_binary_request_no_extras request;
@@ -2878,6 +3054,310 @@ void set_xattr_feature(bool enable) {
     set_feature(mcbp::Feature::XATTR, enable);
 }
 
+TEST_P(McdTestappTest, UnorderedExecution) {
+    const char* key = "test_unordered_execution";
+    const char* missing = "test_unordered_execution_missing";
+    store_object(key, "value");
+
+    set_feature(mcbp::Feature::UNORDERED_EXECUTION, true);
+
+    // Pipeline two gets (which may complete in any order) followed by a
+    // noop which should act as a barrier and be returned last.
+    union {
+        protocol_binary_request_no_extras request;
+        protocol_binary_response_no_extras response;
+        char bytes[1024];
+    } send, temp, receive;
+
+    size_t len = mcbp_raw_command(send.bytes, sizeof(send.bytes),
+                                  PROTOCOL_BINARY_CMD_GETK,
+                                  missing, strlen(missing), NULL, 0);
+    send.request.message.header.request.opaque = 1;
+
+    size_t len2 = mcbp_raw_command(temp.bytes, sizeof(temp.bytes),
+                                   PROTOCOL_BINARY_CMD_GETK,
+                                   key, strlen(key), NULL, 0);
+    temp.request.message.header.request.opaque = 2;
+    memcpy(send.bytes + len, temp.bytes, len2);
+    len += len2;
+
+    len2 = mcbp_raw_command(temp.bytes, sizeof(temp.bytes),
+                            PROTOCOL_BINARY_CMD_NOOP, NULL, 0, NULL, 0);
+    temp.request.message.header.request.opaque = 3;
+    memcpy(send.bytes + len, temp.bytes, len2);
+    len += len2;
+
+    safe_send(send.bytes, len, false);
+
+    std::set<uint32_t> gets;
+    for (int ii = 0; ii < 2; ++ii) {
+        safe_recv_packet(receive.bytes, sizeof(receive.bytes));
+        const auto& header = receive.response.message.header.response;
+        EXPECT_EQ(PROTOCOL_BINARY_CMD_GETK, header.opcode);
+        if (header.opaque == 1) {
+            EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_KEY_ENOENT, header.status);
+        } else {
+            EXPECT_EQ(2u, header.opaque);
+            EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, header.status);
+        }
+        gets.insert(header.opaque);
+    }
+    EXPECT_EQ(2u, gets.size());
+
+    safe_recv_packet(receive.bytes, sizeof(receive.bytes));
+    EXPECT_EQ(PROTOCOL_BINARY_CMD_NOOP,
+              receive.response.message.header.response.opcode);
+    EXPECT_EQ(3u, receive.response.message.header.response.opaque);
+
+    set_feature(mcbp::Feature::UNORDERED_EXECUTION, false);
+    delete_object(key);
+}
+
+/**
+ * Convert the packet to the alternative request format with a timeout
+ * frame info (of the given number of microseconds) in the framing extras.
+ */
+static size_t add_timeout_frame(char* packet, size_t len, uint32_t usec) {
+    auto* req = reinterpret_cast<protocol_binary_request_header*>(packet);
+    const uint16_t keylen = ntohs(req->request.keylen);
+    const uint8_t framing = 1 + sizeof(usec);
+    const size_t header = sizeof(*req);
+    memmove(packet + header + framing, packet + header, len - header);
+    packet[header] = char((uint8_t(mcbp::FrameInfoId::Timeout) << 4) |
+                          sizeof(usec));
+    usec = htonl(usec);
+    memcpy(packet + header + 1, &usec, sizeof(usec));
+
+    req->request.magic = PROTOCOL_BINARY_AREQ;
+    req->bytes[2] = framing;
+    req->bytes[3] = uint8_t(keylen);
+    req->request.bodylen = htonl(ntohl(req->request.bodylen) + framing);
+    return len + framing;
+}
+
+TEST_P(McdTestappTest, Deadline) {
+    const char* key = "test_deadline";
+    store_object(key, "value");
+
+    set_feature(mcbp::Feature::DEADLINE, true);
+
+    union {
+        protocol_binary_request_no_extras request;
+        protocol_binary_response_no_extras response;
+        char bytes[1024];
+    } send, receive;
+
+    // A request with a generous timeout is executed
+    size_t len = mcbp_raw_command(send.bytes, sizeof(send.bytes),
+                                  PROTOCOL_BINARY_CMD_GET,
+                                  key, strlen(key), NULL, 0);
+    len = add_timeout_frame(send.bytes, len, 60 * 1000 * 1000);
+    safe_send(send.bytes, len, false);
+    safe_recv_packet(receive.bytes, sizeof(receive.bytes));
+    mcbp_validate_response_header(&receive.response, PROTOCOL_BINARY_CMD_GET,
+                                  PROTOCOL_BINARY_RESPONSE_SUCCESS);
+
+    // A request which has timed out before it is executed is shed
+    len = mcbp_raw_command(send.bytes, sizeof(send.bytes),
+                           PROTOCOL_BINARY_CMD_GET,
+                           key, strlen(key), NULL, 0);
+    len = add_timeout_frame(send.bytes, len, 0);
+    safe_send(send.bytes, len, false);
+    safe_recv_packet(receive.bytes, sizeof(receive.bytes));
+    mcbp_validate_response_header(&receive.response, PROTOCOL_BINARY_CMD_GET,
+                                  PROTOCOL_BINARY_RESPONSE_DEADLINE_EXCEEDED);
+
+    auto stats = request_stats();
+    EXPECT_LE(1u, extract_single_stat(stats, "cmd_deadline_exceeded"));
+
+    set_feature(mcbp::Feature::DEADLINE, false);
+    delete_object(key);
+}
+
+TEST_P(McdTestappTest, Tracing) {
+    const char* key = "test_tracing";
+    store_object(key, "value");
+
+    set_feature(mcbp::Feature::TRACING, true);
+
+    union {
+        protocol_binary_request_no_extras request;
+        protocol_binary_response_no_extras response;
+        char bytes[1024];
+    } send, receive;
+
+    // The response use the alternative response format with the server
+    // duration in the framing extras
+    size_t len = mcbp_raw_command(send.bytes, sizeof(send.bytes),
+                                  PROTOCOL_BINARY_CMD_GET,
+                                  key, strlen(key), NULL, 0);
+    send.request.message.header.request.opaque = 0xcafef00d;
+    safe_send(send.bytes, len, false);
+    safe_recv_packet(receive.bytes, sizeof(receive.bytes));
+
+    auto& header = receive.response.message.header.response;
+    EXPECT_EQ(PROTOCOL_BINARY_ARES, header.magic);
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, header.status);
+    // safe_recv_packet converted the key length field to host order
+    const uint8_t framing = uint8_t(header.keylen >> 8);
+    EXPECT_EQ(0, header.keylen & 0xff);
+    ASSERT_LE(3, framing);
+    const uint8_t* frame = reinterpret_cast<uint8_t*>(receive.bytes) +
+                           sizeof(header);
+    EXPECT_EQ((uint8_t(mcbp::ResponseFrameInfoId::ServerDuration) << 4) | 2,
+              frame[0]);
+    // The value follows the framing extras and the flags
+    EXPECT_EQ(framing + 4u + strlen("value"), header.bodylen);
+
+    // The span of the request is available through its opaque
+    len = mcbp_raw_command(send.bytes, sizeof(send.bytes),
+                           PROTOCOL_BINARY_CMD_GET_TRACE_SPANS,
+                           NULL, 0, NULL, 0);
+    const uint32_t opaque = 0xcafef00d;
+    memcpy(send.bytes + sizeof(send.request.message.header), &opaque,
+           sizeof(opaque));
+    send.request.message.header.request.extlen = sizeof(opaque);
+    send.request.message.header.request.bodylen = htonl(sizeof(opaque));
+    safe_send(send.bytes, len + sizeof(opaque), false);
+    safe_recv_packet(receive.bytes, sizeof(receive.bytes));
+    EXPECT_EQ(PROTOCOL_BINARY_ARES, header.magic);
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, header.status);
+    const uint8_t spanframing = uint8_t(header.keylen >> 8);
+    const std::string json(receive.bytes + sizeof(header) + spanframing,
+                           header.bodylen - spanframing);
+    unique_cJSON_ptr span(cJSON_Parse(json.c_str()));
+    ASSERT_NE(nullptr, span.get()) << json;
+    EXPECT_STREQ("GET",
+                 cJSON_GetObjectItem(span.get(), "opcode")->valuestring);
+    EXPECT_NE(nullptr, cJSON_GetObjectItem(span.get(), "total"));
+
+    set_feature(mcbp::Feature::TRACING, false);
+
+    // Without tracing the responses use the normal format
+    len = mcbp_raw_command(send.bytes, sizeof(send.bytes),
+                           PROTOCOL_BINARY_CMD_GET,
+                           key, strlen(key), NULL, 0);
+    safe_send(send.bytes, len, false);
+    safe_recv_packet(receive.bytes, sizeof(receive.bytes));
+    mcbp_validate_response_header(&receive.response, PROTOCOL_BINARY_CMD_GET,
+                                  PROTOCOL_BINARY_RESPONSE_SUCCESS);
+
+    delete_object(key);
+}
+
+TEST_P(McdTestappTest, GetMulti) {
+    const std::vector<std::string> keys = {"test_get_multi_1",
+                                           "test_get_multi_missing",
+                                           "test_get_multi_2"};
+    store_object(keys[0].c_str(), "value1");
+    store_object(keys[2].c_str(), "value2");
+
+    std::vector<char> body;
+    for (const auto& key : keys) {
+        protocol_binary_get_multi_entry entry;
+        entry.vbucket = htons(0);
+        entry.keylen = htons(uint16_t(key.size()));
+        const auto* ptr = reinterpret_cast<const char*>(&entry);
+        body.insert(body.end(), ptr, ptr + sizeof(entry));
+        body.insert(body.end(), key.begin(), key.end());
+    }
+
+    union {
+        protocol_binary_request_no_extras request;
+        protocol_binary_response_get response;
+        char bytes[1024];
+    } buffer;
+
+    size_t len = mcbp_raw_command(buffer.bytes, sizeof(buffer.bytes),
+                                  PROTOCOL_BINARY_CMD_GET_MULTI, NULL, 0,
+                                  body.data(), body.size());
+    buffer.request.message.header.request.opaque = 0xdeadbeef;
+    safe_send(buffer.bytes, len, false);
+
+    // The two documents found (the miss is silent)
+    std::set<std::string> found;
+    for (int ii = 0; ii < 2; ++ii) {
+        safe_recv_packet(buffer.bytes, sizeof(buffer.bytes));
+        const auto& header = buffer.response.message.header.response;
+        EXPECT_EQ(PROTOCOL_BINARY_CMD_GET_MULTI, header.opcode);
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, header.status);
+        EXPECT_EQ(0xdeadbeef, header.opaque);
+        EXPECT_EQ(4, header.extlen);
+        found.insert(std::string(buffer.bytes + sizeof(buffer.response.bytes),
+                                 header.keylen));
+    }
+    EXPECT_EQ(1u, found.count(keys[0]));
+    EXPECT_EQ(1u, found.count(keys[2]));
+
+    // And the terminating response
+    safe_recv_packet(buffer.bytes, sizeof(buffer.bytes));
+    const auto& header = buffer.response.message.header.response;
+    EXPECT_EQ(PROTOCOL_BINARY_CMD_GET_MULTI, header.opcode);
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, header.status);
+    EXPECT_EQ(0u, header.bodylen);
+
+    delete_object(keys[0].c_str());
+    delete_object(keys[2].c_str());
+}
+
+TEST_P(McdTestappTest, TracingGetMulti) {
+    const std::string key = "test_tracing_get_multi";
+    store_object(key.c_str(), "value");
+    set_feature(mcbp::Feature::TRACING, true);
+
+    std::vector<char> body;
+    protocol_binary_get_multi_entry entry;
+    entry.vbucket = htons(0);
+    entry.keylen = htons(uint16_t(key.size()));
+    const auto* ptr = reinterpret_cast<const char*>(&entry);
+    body.insert(body.end(), ptr, ptr + sizeof(entry));
+    body.insert(body.end(), key.begin(), key.end());
+
+    union {
+        protocol_binary_request_no_extras request;
+        protocol_binary_response_get response;
+        char bytes[1024];
+    } buffer;
+
+    size_t len = mcbp_raw_command(buffer.bytes, sizeof(buffer.bytes),
+                                  PROTOCOL_BINARY_CMD_GET_MULTI, NULL, 0,
+                                  body.data(), body.size());
+    safe_send(buffer.bytes, len, false);
+
+    // Both the document and the terminating response carry the server
+    // duration in the framing extras (before the extras)
+    for (int ii = 0; ii < 2; ++ii) {
+        safe_recv_packet(buffer.bytes, sizeof(buffer.bytes));
+        const auto& header = buffer.response.message.header.response;
+        EXPECT_EQ(PROTOCOL_BINARY_ARES, header.magic);
+        EXPECT_EQ(PROTOCOL_BINARY_CMD_GET_MULTI, header.opcode);
+        EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, header.status);
+        // safe_recv_packet converted the key length field to host order
+        const uint8_t framing = uint8_t(header.keylen >> 8);
+        const uint8_t keylen = uint8_t(header.keylen & 0xff);
+        ASSERT_LE(3, framing);
+        const auto* frame = reinterpret_cast<uint8_t*>(buffer.bytes) +
+                            sizeof(header);
+        EXPECT_EQ((uint8_t(mcbp::ResponseFrameInfoId::ServerDuration) << 4) | 2,
+                  frame[0]);
+        if (ii == 0) {
+            EXPECT_EQ(4, header.extlen);
+            ASSERT_EQ(key.size(), keylen);
+            const char* payload = buffer.bytes + sizeof(header) + framing + 4;
+            EXPECT_EQ(key, std::string(payload, keylen));
+            EXPECT_EQ("value", std::string(payload + keylen,
+                                           header.bodylen - framing - 4 -
+                                           keylen));
+        } else {
+            EXPECT_EQ(0, keylen);
+            EXPECT_EQ(framing, header.bodylen);
+        }
+    }
+
+    set_feature(mcbp::Feature::TRACING, false);
+    delete_object(key.c_str());
+}
+
 void store_object_w_datatype(const char *key, const void *data, size_t datalen,
                              bool deflate, bool json)
 {
@@ -24,6 +24,17 @@
 #include <platform/compress.h>
 
 class GetSetTest : public TestappClientTest {
+protected:
+    /**
+     * Set the size of the documents inflated and validated by the
+     * executor pool
+     */
+    void setOffloadThreshold(size_t threshold) {
+        cJSON_DeleteItemFromObject(memcached_cfg.get(), "offload_threshold");
+        cJSON_AddNumberToObject(memcached_cfg.get(), "offload_threshold",
+                                threshold);
+        reconfigure();
+    }
 };
 
 INSTANTIATE_TEST_CASE_P(TransportProtocols,
@@ -588,3 +599,66 @@ TEST_P(GetSetTest, TestPrepepndCompressedSourceAndData) {
     memset(expected.data() + input.size(), 'a', append.size());
     EXPECT_EQ(expected, stored.value);
 }
+
+TEST_P(GetSetTest, TestGetLargeCompressedDocument) {
+    MemcachedConnection& conn = getConnection();
+    Document doc;
+    doc.info.cas = Greenstack::CAS::Wildcard;
+    doc.info.compression = Greenstack::Compression::Snappy;
+    doc.info.datatype = Greenstack::Datatype::Raw;
+    doc.info.flags = 0xcaffee;
+    doc.info.id = name;
+
+    // The document is bigger than the offload threshold so it is
+    // inflated by the executor pool
+    setOffloadThreshold(64 * 1024);
+    std::vector<char> input(512 * 1024);
+    std::fill(input.begin(), input.end(), 'a');
+    compress_vector(input, doc.value);
+    conn.mutate(doc, 0, Greenstack::MutationType::Set);
+
+    auto& c = dynamic_cast<MemcachedBinprotConnection&>(conn);
+    c.setDatatypeSupport(false);
+    Document stored;
+    stored = conn.get(name, 0);
+
+    EXPECT_EQ(Greenstack::Compression::None, stored.info.compression);
+    EXPECT_EQ(doc.info.flags, stored.info.flags);
+    std::vector<uint8_t> expected(input.begin(), input.end());
+    EXPECT_EQ(expected, stored.value);
+
+    setOffloadThreshold(1024 * 1024);
+}
+
+TEST_P(GetSetTest, TestSetLargeJsonDocument) {
+    MemcachedConnection& conn = getConnection();
+    auto& c = dynamic_cast<MemcachedBinprotConnection&>(conn);
+    c.setDatatypeSupport(false);
+
+    // The document is bigger than the offload threshold so it is
+    // validated by the executor pool
+    setOffloadThreshold(64 * 1024);
+    std::string json("[");
+    while (json.size() < 512 * 1024) {
+        json.append("\"value\",");
+    }
+    json.append("0]");
+
+    Document doc;
+    doc.info.cas = Greenstack::CAS::Wildcard;
+    doc.info.compression = Greenstack::Compression::None;
+    doc.info.datatype = Greenstack::Datatype::Raw;
+    doc.info.flags = 0xcaffee;
+    doc.info.id = name;
+    std::copy(json.begin(), json.end(), std::back_inserter(doc.value));
+    conn.mutate(doc, 0, Greenstack::MutationType::Set);
+
+    c.setDatatypeSupport(true);
+    Document stored;
+    stored = conn.get(name, 0);
+
+    EXPECT_EQ(Greenstack::Datatype::Json, stored.info.datatype);
+    EXPECT_EQ(doc.value, stored.value);
+
+    setOffloadThreshold(1024 * 1024);
+}
@@ -16,6 +16,10 @@
  */
 #include "testapp_stats.h"
 
+#include <chrono>
+#include <map>
+#include <thread>
+
 INSTANTIATE_TEST_CASE_P(TransportProtocols,
                         StatsTest,
                         ::testing::Values(TransportProtocols::McbpPlain,
@@ -273,6 +277,8 @@ TEST_P(StatsTest, DISABLED_TestConnections) {
         ASSERT_NE(nullptr, json.get());
         // the _this_ pointer should at least be there
         ASSERT_NE(nullptr, cJSON_GetObjectItem(json.get(), "connection"));
+        // and the memory used by the connection
+        EXPECT_NE(nullptr, cJSON_GetObjectItem(json.get(), "memory"));
         if (sock == -1) {
             auto* ptr = cJSON_GetObjectItem(json.get(), "socket");
             if (ptr != nullptr) {
@@ -306,6 +312,105 @@ TEST_P(StatsTest, TestConnectionsInvalidNumber) {
     }
 }
 
+/**
+ * Get the connection stats for all of the connections, keyed by the
+ * address of the connection object in the server
+ */
+static std::map<std::string, unique_cJSON_ptr> getConnectionStats(
+    MemcachedConnection& conn) {
+    std::map<std::string, unique_cJSON_ptr> ret;
+    auto stats = conn.stats("connections");
+    for (auto* c = stats.get()->child; c != nullptr; c = c->next) {
+        unique_cJSON_ptr json(cJSON_Parse(c->valuestring));
+        auto* id = cJSON_GetObjectItem(json.get(), "connection");
+        if (id != nullptr) {
+            ret[id->valuestring] = std::move(json);
+        }
+    }
+    return ret;
+}
+
+/**
+ * Verify that an idle connection gets compacted (and uses less memory),
+ * and that it still works afterwards
+ */
+TEST_P(StatsTest, TestCompactIdleConnection) {
+    MemcachedConnection& conn = getConnection();
+    cJSON_DeleteItemFromObject(memcached_cfg.get(), "connection_compact_time");
+    cJSON_AddNumberToObject(memcached_cfg.get(), "connection_compact_time", 1);
+    reconfigure();
+
+    const auto before = getConnectionStats(conn);
+    auto idle = conn.clone();
+    idle->stats("");
+
+    // Locate the new connection and wait for it to be compacted (the
+    // thread may still wait for the timer scheduled with the previous
+    // compact time)
+    std::string id;
+    size_t memory = 0;
+    size_t compactedMemory = 0;
+    const auto timeout = std::chrono::steady_clock::now() +
+                         std::chrono::seconds(30);
+    while (compactedMemory == 0 &&
+           std::chrono::steady_clock::now() < timeout) {
+        for (auto& entry : getConnectionStats(conn)) {
+            if (before.find(entry.first) != before.end()) {
+                continue;
+            }
+            ASSERT_TRUE(id.empty() || id == entry.first)
+                << "Unexpected new connection";
+            id = entry.first;
+            auto* flag = cJSON_GetObjectItem(entry.second.get(), "compacted");
+            ASSERT_NE(nullptr, flag);
+            const auto bytes = size_t(
+                cJSON_GetObjectItem(entry.second.get(), "memory")->valueint);
+            if (flag->type == cJSON_True) {
+                compactedMemory = bytes;
+            } else {
+                memory = bytes;
+            }
+        }
+        if (compactedMemory == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    ASSERT_FALSE(id.empty()) << "Failed to locate the idle connection";
+    ASSERT_NE(0u, compactedMemory) << "The idle connection wasn't compacted";
+    if (memory != 0) {
+        EXPECT_LT(compactedMemory, memory);
+    }
+
+    // Restore the compact time so that the connection isn't compacted
+    // again before we look at it
+    cJSON_DeleteItemFromObject(memcached_cfg.get(), "connection_compact_time");
+    cJSON_AddNumberToObject(memcached_cfg.get(), "connection_compact_time", 30);
+    reconfigure();
+
+    // The connection should allocate its memory again and serve commands
+    Document doc;
+    doc.info.cas = Greenstack::CAS::Wildcard;
+    doc.info.compression = Greenstack::Compression::None;
+    doc.info.datatype = Greenstack::Datatype::Raw;
+    doc.info.flags = 0xcaffee;
+    doc.info.id = name;
+    doc.value.assign(1024, 'a');
+    idle->mutate(doc, 0, Greenstack::MutationType::Set);
+    const auto fetched = idle->get(name, 0);
+    EXPECT_EQ(doc.value, fetched.value);
+
+    // And it should use more memory again than while it was compacted
+    auto after = getConnectionStats(conn);
+    auto iter = after.find(id);
+    ASSERT_NE(after.end(), iter);
+    EXPECT_EQ(cJSON_False,
+              cJSON_GetObjectItem(iter->second.get(), "compacted")->type);
+    EXPECT_LT(compactedMemory,
+              size_t(cJSON_GetObjectItem(iter->second.get(),
+                                         "memory")->valueint));
+}
+
 TEST_P(StatsTest, TestTopkeys) {
     MemcachedConnection& conn = getConnection();
 
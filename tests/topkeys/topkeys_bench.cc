@@ -50,8 +50,121 @@ TEST_F(TopKeysTest, Basic) {
         }
     }
 
-    // Verify we hit all shards inside TopKeys
+    // Verify that we only report the requested number of keys
     size_t count = 0;
     topkeys->stats(&count, 0, dump_key);
-    EXPECT_EQ(80, count);
+    EXPECT_EQ(10, count);
+}
+
+TEST(SpaceSavingTest, Eviction) {
+    SpaceSaving summary(2);
+    std::hash<const_char_buffer> hash_fn;
+    const_char_buffer a("a", 1), b("b", 1), c("c", 1);
+
+    summary.add(a, hash_fn(a), 5, 0);
+    summary.add(b, hash_fn(b), 1, 0);
+    // c replaces b (the lowest count), and inherits its count as error
+    summary.add(c, hash_fn(c), 1, 0);
+
+    auto counters = summary.getCounters();
+    ASSERT_EQ(2, counters.size());
+    for (const auto& counter : counters) {
+        EXPECT_NE("b", counter.key);
+        if (counter.key == "c") {
+            EXPECT_EQ(2, counter.count);
+            EXPECT_EQ(1, counter.error);
+        } else {
+            EXPECT_EQ(5, counter.count);
+            EXPECT_EQ(0, counter.error);
+        }
+    }
+}
+
+TEST(SpaceSavingTest, ManyEvictions) {
+    // Exercise the hash table (and its backward shift deletion)
+    SpaceSaving summary(8);
+    std::hash<const_char_buffer> hash_fn;
+    for (int ii = 0; ii < 10000; ++ii) {
+        const auto key = "key_" + std::to_string(ii % 100);
+        const_char_buffer buf(key.data(), key.size());
+        summary.add(buf, hash_fn(buf), 1, 0);
+
+        const std::string hot = "hot";
+        const_char_buffer hotbuf(hot.data(), hot.size());
+        summary.add(hotbuf, hash_fn(hotbuf), 1, 0);
+    }
+
+    uint64_t total = 0;
+    bool found = false;
+    for (const auto& counter : summary.getCounters()) {
+        total += counter.count;
+        if (counter.key == "hot") {
+            found = true;
+            EXPECT_LE(counter.count - counter.error, 10000);
+            EXPECT_GE(counter.count, 10000);
+        }
+    }
+    EXPECT_TRUE(found);
+    // The counts always add up to the total weight
+    EXPECT_EQ(20000, total);
+}
+
+TEST(TopKeysMergeTest, HeavyHitters) {
+    TopKeys topkeys(2, 4);
+    const std::string hot = "hot";
+    const std::string warm = "warm";
+
+    for (int jj = 0; jj < 100; ++jj) {
+        for (size_t thread = 0; thread < 4; ++thread) {
+            topkeys.updateKey(hot.data(), hot.size(), 0, thread, 10, 0);
+            if (jj % 2 == 0) {
+                topkeys.updateKey(warm.data(), warm.size(), 0, thread, 0, 20);
+            }
+            const auto cold = "cold_" + std::to_string(jj) + "_" +
+                              std::to_string(thread);
+            topkeys.updateKey(cold.data(), cold.size(), 0, thread);
+        }
+    }
+
+    auto ops = topkeys.getTopKeys(TopKeys::Statistic::Ops);
+    ASSERT_EQ(2, ops.size());
+    EXPECT_EQ("hot", ops[0].key);
+    EXPECT_EQ("warm", ops[1].key);
+    for (const auto& counter : ops) {
+        const uint64_t real = counter.key == "hot" ? 400 : 200;
+        EXPECT_GE(counter.count, real);
+        EXPECT_LE(counter.count - counter.error, real);
+    }
+
+    auto read = topkeys.getTopKeys(TopKeys::Statistic::BytesRead);
+    ASSERT_EQ(1, read.size());
+    EXPECT_EQ("hot", read[0].key);
+    EXPECT_EQ(4000, read[0].count);
+    EXPECT_EQ(0, read[0].error);
+
+    auto written = topkeys.getTopKeys(TopKeys::Statistic::BytesWritten);
+    ASSERT_EQ(1, written.size());
+    EXPECT_EQ("warm", written[0].key);
+    EXPECT_EQ(4000, written[0].count);
+}
+
+TEST(TopKeysMergeTest, JSON) {
+    TopKeys topkeys(10, 2);
+    const std::string key = "key";
+    topkeys.updateKey(key.data(), key.size(), 5, 1, 100, 0);
+
+    cJSON* root = cJSON_CreateObject();
+    EXPECT_EQ(ENGINE_SUCCESS, topkeys.json_stats(root, 10));
+    auto* array = cJSON_GetObjectItem(root, "topkeys");
+    ASSERT_EQ(1, cJSON_GetArraySize(array));
+    auto* obj = cJSON_GetArrayItem(array, 0);
+    EXPECT_STREQ("key", cJSON_GetObjectItem(obj, "key")->valuestring);
+    EXPECT_EQ(1, cJSON_GetObjectItem(obj, "access_count")->valueint);
+    EXPECT_EQ(0, cJSON_GetObjectItem(obj, "error")->valueint);
+    EXPECT_EQ(5, cJSON_GetObjectItem(obj, "ctime")->valueint);
+    EXPECT_EQ(1, cJSON_GetArraySize(
+            cJSON_GetObjectItem(root, "topkeys_bytes_read")));
+    EXPECT_EQ(0, cJSON_GetArraySize(
+            cJSON_GetObjectItem(root, "topkeys_bytes_written")));
+    cJSON_Delete(root);
 }
@@ -0,0 +1,174 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+
+template <typename T>
+class IntrusiveMpscQueue;
+
+/**
+ * An object which wants to be linked into an IntrusiveMpscQueue must
+ * inherit from MpscQueueHook. The hook holds the link pointer used by the
+ * queue, and a flag telling if the object is currently linked into a queue
+ * (an object may only be present in a single queue once).
+ */
+template <typename T>
+class MpscQueueHook {
+public:
+    MpscQueueHook()
+        : mpscNext(nullptr),
+          mpscLinked(false) {
+    }
+
+    MpscQueueHook(const MpscQueueHook&) = delete;
+
+    /**
+     * Is the object currently linked into a queue? Please note that this
+     * is only a snapshot unless the caller is the consumer of the queue
+     * (or otherwise knows that no producer may push the object)
+     */
+    bool isMpscLinked() const {
+        return mpscLinked.load();
+    }
+
+private:
+    friend class IntrusiveMpscQueue<T>;
+
+    std::atomic<MpscQueueHook<T>*> mpscNext;
+    std::atomic<bool> mpscLinked;
+};
+
+/**
+ * IntrusiveMpscQueue is a lock-free, unbounded, intrusive queue which
+ * supports multiple producers and a single consumer (Dmitry Vyukov's
+ * non-blocking MPSC queue).
+ *
+ * push() is wait-free and may be called from any thread. pop() may only
+ * be called by the consumer (it is typically the thread owning the queue).
+ * The queue never allocates any memory; the objects themselves carry the
+ * link (see MpscQueueHook), and it is the callers responsibility to ensure
+ * that an object isn't destroyed while it is linked into a queue.
+ *
+ * T must inherit from MpscQueueHook<T>.
+ */
+template <typename T>
+class IntrusiveMpscQueue {
+public:
+    IntrusiveMpscQueue()
+        : head(&stub),
+          tail(&stub) {
+    }
+
+    IntrusiveMpscQueue(const IntrusiveMpscQueue&) = delete;
+
+    /**
+     * Append an object to the end of the queue.
+     *
+     * @param object the object to add
+     * @return true if the object was added to the queue, false if it was
+     *         already linked into the queue (and left untouched)
+     */
+    bool push(T* object) {
+        MpscQueueHook<T>* node = object;
+        // mpscLinked use sequential consistency so that callers may
+        // flag state in the object before pushing it, and the consumer
+        // is guaranteed to see it after the object is popped.
+        if (node->mpscLinked.exchange(true)) {
+            return false;
+        }
+        link(node);
+        return true;
+    }
+
+    /**
+     * Remove the first object from the queue. May only be called by the
+     * consumer.
+     *
+     * Please note that this method may return nullptr even if the queue
+     * isn't empty when a producer is in the middle of adding an object to
+     * the queue (the object becomes visible when the producer completes
+     * its push). The producer should therefore notify the consumer
+     * _after_ calling push().
+     *
+     * @return the first object in the queue or nullptr if no object is
+     *         available
+     */
+    T* pop() {
+        MpscQueueHook<T>* first = tail;
+        MpscQueueHook<T>* next = first->mpscNext.load(std::memory_order_acquire);
+
+        if (first == &stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail = next;
+            first = next;
+            next = next->mpscNext.load(std::memory_order_acquire);
+        }
+
+        if (next == nullptr) {
+            if (first != head.load(std::memory_order_acquire)) {
+                // A producer is in the middle of pushing an item
+                return nullptr;
+            }
+
+            // first is the last element in the queue, reinsert the stub
+            // so that we may remove it.
+            link(&stub);
+            next = first->mpscNext.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return nullptr;
+            }
+        }
+
+        tail = next;
+        return unlink(first);
+    }
+
+    /**
+     * Check if the queue appears to be empty. May only be called by the
+     * consumer.
+     */
+    bool empty() const {
+        return tail == &stub &&
+               stub.mpscNext.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    void link(MpscQueueHook<T>* node) {
+        node->mpscNext.store(nullptr, std::memory_order_relaxed);
+        auto* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->mpscNext.store(node, std::memory_order_release);
+    }
+
+    T* unlink(MpscQueueHook<T>* node) {
+        node->mpscNext.store(nullptr, std::memory_order_relaxed);
+        node->mpscLinked.store(false);
+        return static_cast<T*>(node);
+    }
+
+    /** The most recently pushed node (written by the producers) */
+    std::atomic<MpscQueueHook<T>*> head;
+
+    /** The oldest node in the queue (only accessed by the consumer) */
+    MpscQueueHook<T>* tail;
+
+    /** Sentinel node used so that the queue never becomes "really" empty */
+    MpscQueueHook<T> stub;
+};
@@ -89,6 +89,8 @@ static const std::map<uint8_t, std::string> commandmap {
     {PROTOCOL_BINARY_CMD_TAP_CHECKPOINT_START,"TAP_CHECKPOINT_START"},
     {PROTOCOL_BINARY_CMD_TAP_CHECKPOINT_END,"TAP_CHECKPOINT_END"},
     {PROTOCOL_BINARY_CMD_GET_ALL_VB_SEQNOS,"GET_ALL_VB_SEQNOS"},
+    {PROTOCOL_BINARY_CMD_GET_MULTI,"GET_MULTI"},
+    {PROTOCOL_BINARY_CMD_GET_TRACE_SPANS,"GET_TRACE_SPANS"},
     {PROTOCOL_BINARY_CMD_DCP_OPEN,"DCP_OPEN"},
     {PROTOCOL_BINARY_CMD_DCP_ADD_STREAM,"DCP_ADD_STREAM"},
     {PROTOCOL_BINARY_CMD_DCP_CLOSE_STREAM,"DCP_CLOSE_STREAM"},
@@ -237,6 +239,10 @@ static const std::map<protocol_binary_response_status, std::string> statusmap {
         "Server too busy"},
     {PROTOCOL_BINARY_RESPONSE_ETMPFAIL,
         "Temporary failure"},
+    {PROTOCOL_BINARY_RESPONSE_RATE_LIMITED,
+        "Rate limited"},
+    {PROTOCOL_BINARY_RESPONSE_DEADLINE_EXCEEDED,
+        "Deadline exceeded"},
 
     /* Sub-document responses */
     {PROTOCOL_BINARY_RESPONSE_SUBDOC_PATH_ENOENT,